@@ -0,0 +1,90 @@
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void arena_init(Arena *arena, size_t chunk_size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK;
+}
+
+// Free chunks newer than `keep` (all of them for NULL)
+static void free_chunks_after(Arena *arena, ArenaChunk *keep) {
+    while (arena->head && arena->head != keep) {
+        ArenaChunk *chunk = arena->head;
+        arena->head = chunk->prev;
+        arena->reserved -= chunk->size;
+        free(chunk);
+    }
+}
+
+void arena_free(Arena *arena) {
+    free_chunks_after(arena, NULL);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void arena_reset(Arena *arena) {
+    ArenaChunk *first = arena->head;
+    while (first && first->prev) first = first->prev;
+    free_chunks_after(arena, first);
+    if (first) first->used = 0;
+    arena->used = 0;
+    arena->resets++;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaChunk *chunk = arena->head;
+    if (!chunk || chunk->size - chunk->used < size) {
+        // Oversized requests get a chunk of their own
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk = malloc(sizeof(ArenaChunk) + chunk_size);
+        if (!chunk) {
+            fprintf(stderr, "Arena allocation failed\n");
+            return NULL;
+        }
+        chunk->prev = arena->head;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        arena->head = chunk;
+        arena->reserved += chunk_size;
+    }
+
+    // The header is a multiple of ARENA_ALIGN on every supported ABI
+    void *ptr = (uint8_t *)(chunk + 1) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+    return ptr;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t len) {
+    char *copy = arena_alloc(arena, len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+ArenaMark arena_mark(const Arena *arena) {
+    ArenaMark mark;
+    mark.chunk = arena->head;
+    mark.used = arena->head ? arena->head->used : 0;
+    return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark) {
+    // Chunks added since the mark are returned to the heap
+    while (arena->head && arena->head != mark.chunk) {
+        arena->used -= arena->head->used;
+        ArenaChunk *chunk = arena->head;
+        arena->head = chunk->prev;
+        arena->reserved -= chunk->size;
+        free(chunk);
+    }
+    if (arena->head) {
+        arena->used -= arena->head->used - mark.used;
+        arena->head->used = mark.used;
+    }
+}
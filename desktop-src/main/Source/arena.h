@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator for memory that lives exactly as long as one page. Nothing
+// is freed on its own: the whole arena is reset when the tab navigates, so
+// a long session does not leave the heap peppered with small page-sized
+// holes. The first chunk is kept across resets and reused by the next page.
+//
+// Short-lived scratch (a string copied only to hand to LVGL) can be given
+// back early with arena_mark() / arena_release(), stack fashion.
+
+#define ARENA_DEFAULT_CHUNK (16 * 1024)
+#define ARENA_ALIGN 8
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *prev; // Older chunk, NULL for the first
+    size_t size;             // Usable bytes after the header
+    size_t used;
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk *head;   // Chunk allocations come from
+    size_t chunk_size;
+    size_t used;        // Bytes handed out since the last reset
+    size_t reserved;    // Bytes held in chunks
+    size_t high_water;  // Most `used` has been, over the arena's life
+    uint32_t resets;
+} Arena;
+
+typedef struct {
+    ArenaChunk *chunk;
+    size_t used;
+} ArenaMark;
+
+void arena_init(Arena *arena, size_t chunk_size);
+void arena_free(Arena *arena);
+// Drop everything allocated; keeps the first chunk for reuse
+void arena_reset(Arena *arena);
+
+void *arena_alloc(Arena *arena, size_t size);
+// NUL-terminated copy of `len` bytes
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+
+ArenaMark arena_mark(const Arena *arena);
+// Give back everything allocated since `mark`
+void arena_release(Arena *arena, ArenaMark mark);
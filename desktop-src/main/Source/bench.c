@@ -0,0 +1,492 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lexbor/core/lexbor.h>
+#include <lexbor/html/html.h>
+#include <lvgl.h>
+
+#include "decode_pool.h"
+#include "file_map.h"
+#include "page_limits.h"
+#include "script.h"
+#include "script_cache.h"
+#include "trace.h"
+
+#define DECODE_CORPUS_SIZE 100
+#define SCRIPT_BENCH_RUNS 5
+#define SCRIPT_BENCH_PREPARE_RUNS 1000
+#define SCRIPT_BENCH_LIBRARY_BYTES (64 * 1024)
+#define PARSE_BENCH_RUNS 200
+#define STRESS_IMPLIED_ALLOWANCE (PAGE_LIMIT_NODES / 4) // Elements the tree builder adds on its own
+
+typedef struct {
+    int decoded;
+    int failed;
+    uint64_t decode_us; // Summed across workers
+} DecodeTally;
+
+static void bench_decode_done(DecodeJob *job, void *user_data) {
+    DecodeTally *tally = (DecodeTally *)user_data;
+    if (job->ok) tally->decoded++;
+    else tally->failed++;
+    tally->decode_us += job->decode_us;
+}
+
+// Decode the corpus once with `workers` threads; returns wall time in us
+static uint64_t decode_corpus(const FileMap *files, int file_count, int workers,
+                              uint32_t box_w, uint32_t box_h, DecodeTally *tally) {
+    // Copies are made up front so the timed part is decoding only
+    uint8_t *inputs[DECODE_CORPUS_SIZE];
+    size_t sizes[DECODE_CORPUS_SIZE];
+    for (int i = 0; i < DECODE_CORPUS_SIZE; i++) {
+        const FileMap *file = &files[i % file_count];
+        sizes[i] = file->size;
+        inputs[i] = malloc(file->size ? file->size : 1);
+        if (inputs[i]) memcpy(inputs[i], file->data, file->size);
+    }
+
+    memset(tally, 0, sizeof(*tally));
+    if (!decode_pool_init(workers)) return 0;
+
+    uint64_t start = trace_now_us();
+    for (int i = 0; i < DECODE_CORPUS_SIZE; i++) {
+        if (!inputs[i]) {
+            tally->failed++;
+            continue;
+        }
+        decode_pool_submit(inputs[i], sizes[i], box_w, box_h, LV_COLOR_DEPTH, bench_decode_done, tally);
+    }
+    decode_pool_wait_idle();
+    decode_pool_poll();
+    uint64_t elapsed = trace_now_us() - start;
+
+    decode_pool_shutdown();
+    return elapsed;
+}
+
+static int bench_decode(int argc, char **argv) {
+    uint32_t box_w = 400, box_h = 300;
+    int first = 0;
+    if (argc >= 2 && strcmp(argv[0], "--box") == 0) {
+        if (sscanf(argv[1], "%ux%u", &box_w, &box_h) != 2) {
+            fprintf(stderr, "Invalid --box, expected WxH\n");
+            return 1;
+        }
+        first = 2;
+    }
+
+    int file_count = argc - first;
+    if (file_count <= 0) {
+        fprintf(stderr, "Usage: --bench-decode [--box WxH] image...\n");
+        return 1;
+    }
+
+    FileMap *files = calloc((size_t)file_count, sizeof(FileMap));
+    if (!files) return 1;
+    for (int i = 0; i < file_count; i++) {
+        if (!file_map_open(&files[i], argv[first + i])) {
+            fprintf(stderr, "Cannot open %s\n", argv[first + i]);
+            for (int j = 0; j < i; j++) file_map_close(&files[j]);
+            free(files);
+            return 1;
+        }
+    }
+
+    int cores = SDL_GetCPUCount();
+    if (cores > DECODE_POOL_MAX_WORKERS) cores = DECODE_POOL_MAX_WORKERS;
+    int runs[2] = {1, cores > 1 ? cores : 2};
+    uint64_t wall[2];
+
+    printf("Decoding %d images (%d files) into %ux%u boxes\n", DECODE_CORPUS_SIZE, file_count, box_w, box_h);
+    for (int r = 0; r < 2; r++) {
+        DecodeTally tally;
+        wall[r] = decode_corpus(files, file_count, runs[r], box_w, box_h, &tally);
+        printf("  %2d worker%s: %8.2f ms wall, %8.2f ms decode, %d ok, %d failed\n",
+               runs[r], runs[r] == 1 ? " " : "s", wall[r] / 1000.0, tally.decode_us / 1000.0,
+               tally.decoded, tally.failed);
+    }
+    if (wall[1] > 0) printf("  speedup: %.2fx\n", (double)wall[0] / (double)wall[1]);
+
+    for (int i = 0; i < file_count; i++) file_map_close(&files[i]);
+    free(files);
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    const char *source;
+} ScriptPattern;
+
+// Common page-script shapes, in the subset of JavaScript Elk supports
+static const ScriptPattern script_patterns[] = {
+    {"arithmetic loop", "let s = 0; for (let i = 0; i < 100000; i++) { s = s + i * 2; }"},
+    {"string building", "let s = ''; for (let i = 0; i < 2000; i++) { s = s + 'x'; }"},
+    {"object fields", "let o = {a: 0, b: 0}; for (let i = 0; i < 50000; i++) { o.a = o.a + 1; o.b = o.a; }"},
+    {"function calls", "let f = function(x) { return x + 1; }; let n = 0; "
+                       "for (let i = 0; i < 20000; i++) { n = f(n); }"},
+    {"recursion", "let fib = function(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }; fib(18);"},
+    {"runaway loop", "let n = 0; for (let i = 0; i >= 0; i++) { n++; }"},
+};
+
+static const char *result_name(ScriptResult result) {
+    switch (result) {
+        case SCRIPT_OK: return "ok";
+        case SCRIPT_ERROR: return "error";
+        case SCRIPT_OVER_BUDGET: return "stopped";
+        default: return "unavailable";
+    }
+}
+
+// Mean time to instrument `source` (a miss), to find it in RAM (a hit) and
+// to read it back from disk after the RAM entries are dropped (a disk hit)
+static void bench_prepare(const char *name, const char *source, size_t len) {
+    size_t code_len = 0;
+    uint64_t start = trace_now_us();
+    for (int r = 0; r < SCRIPT_BENCH_PREPARE_RUNS; r++) free(script_instrument(source, len, &code_len));
+    uint64_t instrument = trace_now_us() - start;
+
+    script_cache_get(source, len, &code_len); // Stored, and queued for disk
+    start = trace_now_us();
+    for (int r = 0; r < SCRIPT_BENCH_PREPARE_RUNS; r++) script_cache_get(source, len, &code_len);
+    uint64_t hit = trace_now_us() - start;
+
+    printf("  %-16s %10lu %14.2f %12.2f", name, (unsigned long)len, (double)instrument / SCRIPT_BENCH_PREPARE_RUNS,
+           (double)hit / SCRIPT_BENCH_PREPARE_RUNS);
+    if (len < SCRIPT_CACHE_DISK_MIN_SOURCE) {
+        printf(" %12s\n", "-"); // Not written to disk
+        return;
+    }
+    uint64_t disk_hit = 0;
+    for (int r = 0; r < SCRIPT_BENCH_PREPARE_RUNS; r++) {
+        script_cache_drop_memory();
+        start = trace_now_us();
+        script_cache_get(source, len, &code_len);
+        disk_hit += trace_now_us() - start;
+    }
+    printf(" %12.2f\n", (double)disk_hit / SCRIPT_BENCH_PREPARE_RUNS);
+}
+
+// Each pattern runs in a fresh page context, best of SCRIPT_BENCH_RUNS
+static int bench_script(int argc, char **argv) {
+    size_t pattern_count = sizeof(script_patterns) / sizeof(script_patterns[0]);
+    printf("Scripts: best of %d runs, %u KB heap, %.0f ms budget\n", SCRIPT_BENCH_RUNS,
+           (unsigned int)(SCRIPT_HEAP_BYTES / 1024), SCRIPT_TIME_BUDGET_US / 1000.0);
+    printf("  %-16s %10s %10s %12s %s\n", "pattern", "ms", "ticks", "heap peak", "result");
+
+    for (size_t p = 0; p < pattern_count; p++) {
+        const ScriptPattern *pattern = &script_patterns[p];
+        uint64_t best = UINT64_MAX;
+        uint32_t ticks = 0;
+        size_t peak = 0;
+        ScriptResult result = SCRIPT_UNAVAILABLE;
+
+        for (int r = 0; r < SCRIPT_BENCH_RUNS; r++) {
+            ScriptContext ctx;
+            if (!script_context_init(&ctx, SCRIPT_HEAP_BYTES, "about:blank", NULL)) return 1;
+            uint64_t start = trace_now_us();
+            result = script_run(&ctx, pattern->source, strlen(pattern->source), pattern->name);
+            uint64_t elapsed = trace_now_us() - start;
+            if (elapsed < best) best = elapsed;
+            ticks = ctx.ticks;
+            if (script_heap_peak(&ctx) > peak) peak = script_heap_peak(&ctx);
+            script_context_free(&ctx);
+        }
+        printf("  %-16s %10.3f %10u %9u KB %s\n", pattern->name, best / 1000.0, (unsigned int)ticks,
+               (unsigned int)(peak / 1024), result_name(result));
+    }
+
+    // Preparing the source against finding it in the script cache. The
+    // patterns are short, so they are also joined into a library-sized one.
+    script_cache_init();
+    printf("Script preparation: %d times each\n", SCRIPT_BENCH_PREPARE_RUNS);
+    printf("  %-16s %10s %14s %12s %12s\n", "pattern", "bytes", "instrument us", "hit us", "disk hit us");
+    char *library = malloc(SCRIPT_BENCH_LIBRARY_BYTES + 1);
+    size_t library_len = 0;
+    for (size_t p = 0; p < pattern_count; p++) {
+        const ScriptPattern *pattern = &script_patterns[p];
+        bench_prepare(pattern->name, pattern->source, strlen(pattern->source));
+    }
+    if (library) {
+        for (size_t p = 0; library_len < SCRIPT_BENCH_LIBRARY_BYTES; p = (p + 1) % pattern_count) {
+            size_t len = strlen(script_patterns[p].source);
+            if (library_len + len + 1 > SCRIPT_BENCH_LIBRARY_BYTES) break;
+            memcpy(library + library_len, script_patterns[p].source, len);
+            library_len += len;
+            library[library_len++] = '\n';
+        }
+        library[library_len] = '\0';
+        bench_prepare("library", library, library_len);
+        free(library);
+    }
+    script_cache_shutdown();
+    return 0;
+}
+
+// Allocator calls lexbor makes, counted through its memory hooks
+static uint32_t parse_allocs;
+
+static void *count_malloc(size_t size) {
+    parse_allocs++;
+    return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size) {
+    parse_allocs++;
+    return realloc(ptr, size);
+}
+
+static void *count_calloc(size_t num, size_t size) {
+    parse_allocs++;
+    return calloc(num, size);
+}
+
+// Parse as a navigation does: chunk parser into `document`
+static bool parse_into(lxb_html_document_t *document, const FileMap *file) {
+    return lxb_html_document_parse_chunk_begin(document) == LXB_STATUS_OK &&
+           lxb_html_document_parse_chunk(document, (const lxb_char_t *)file->data, file->size) == LXB_STATUS_OK &&
+           lxb_html_document_parse_chunk_end(document) == LXB_STATUS_OK;
+}
+
+// Repeated navigations to the same page: a new document each time, as
+// before, against one document cleaned between loads
+static int bench_parse(int argc, char **argv) {
+    int runs = PARSE_BENCH_RUNS, first = 0;
+    if (argc >= 2 && strcmp(argv[0], "--runs") == 0) {
+        runs = atoi(argv[1]);
+        first = 2;
+    }
+    if (argc - first <= 0 || runs <= 0) {
+        fprintf(stderr, "Usage: --bench-parse [--runs N] page.html...\n");
+        return 1;
+    }
+
+    lexbor_memory_setup(count_malloc, count_realloc, count_calloc, free);
+    printf("Parsing each page %d times\n", runs);
+    printf("  %-24s %14s %14s %12s %12s\n", "page", "new allocs", "reused allocs", "new us", "reused us");
+    int status = 0;
+    for (int i = first; i < argc; i++) {
+        FileMap file;
+        if (!file_map_open(&file, argv[i])) {
+            fprintf(stderr, "Cannot open %s\n", argv[i]);
+            status = 1;
+            continue;
+        }
+
+        parse_allocs = 0;
+        bool ok = true;
+        uint64_t start = trace_now_us();
+        for (int r = 0; r < runs && ok; r++) {
+            lxb_html_document_t *document = lxb_html_document_create();
+            ok = document && parse_into(document, &file);
+            if (document) lxb_html_document_destroy(document);
+        }
+        uint64_t fresh_us = trace_now_us() - start;
+        uint32_t fresh_allocs = parse_allocs;
+
+        // The first parse fills the pools; count the loads that reuse them
+        lxb_html_document_t *document = lxb_html_document_create();
+        ok = ok && document && parse_into(document, &file);
+        parse_allocs = 0;
+        start = trace_now_us();
+        for (int r = 0; r < runs && ok; r++) {
+            lxb_html_document_clean(document);
+            ok = parse_into(document, &file);
+        }
+        uint64_t reused_us = trace_now_us() - start;
+        uint32_t reused_allocs = parse_allocs;
+        if (document) lxb_html_document_destroy(document);
+
+        if (!ok) {
+            fprintf(stderr, "Cannot parse %s\n", argv[i]);
+            status = 1;
+        } else {
+            printf("  %-24.24s %14.1f %14.1f %12.1f %12.1f\n", argv[i], (double)fresh_allocs / runs,
+                   (double)reused_allocs / runs, (double)fresh_us / runs, (double)reused_us / runs);
+        }
+        file_map_close(&file);
+    }
+    lexbor_memory_setup(malloc, realloc, calloc, free);
+    return status;
+}
+
+// Growable buffer the stress pages are written into
+typedef struct {
+    char *data;
+    size_t len, capacity;
+} StressPage;
+
+static void stress_put(StressPage *page, const char *text, size_t len) {
+    if (page->len + len + 1 > page->capacity) {
+        size_t capacity = page->capacity ? page->capacity * 2 : 64 * 1024;
+        while (capacity < page->len + len + 1) capacity *= 2;
+        char *grown = realloc(page->data, capacity);
+        if (!grown) return;
+        page->data = grown;
+        page->capacity = capacity;
+    }
+    memcpy(page->data + page->len, text, len);
+    page->len += len;
+    page->data[page->len] = 0;
+}
+
+static void stress_repeat(StressPage *page, const char *text, int times) {
+    size_t len = strlen(text);
+    for (int i = 0; i < times; i++) stress_put(page, text, len);
+}
+
+static void stress_deep(StressPage *page) {
+    stress_repeat(page, "<div>", 20000);
+    stress_repeat(page, "deep", 1);
+    stress_repeat(page, "</div>", 20000);
+}
+
+static void stress_table(StressPage *page) {
+    stress_repeat(page, "<table>", 1);
+    for (int r = 0; r < 400; r++) {
+        stress_repeat(page, "<tr>", 1);
+        stress_repeat(page, "<td>cell</td>", 400);
+        stress_repeat(page, "</tr>", 1);
+    }
+    stress_repeat(page, "</table>", 1);
+}
+
+static void stress_long_text(StressPage *page) {
+    stress_repeat(page, "<p>", 1);
+    stress_repeat(page, "long text \xc3\xa9 ", 300000); // Multi-byte characters across the cut
+    stress_repeat(page, "</p>", 1);
+}
+
+static void stress_many_nodes(StressPage *page) {
+    stress_repeat(page, "<span>x</span>", 200000);
+}
+
+static void stress_big_script(StressPage *page) {
+    stress_repeat(page, "<script>", 1);
+    stress_repeat(page, "var a = '<div>' + 1 < 2;\n", 150000);
+    stress_repeat(page, "</script><p>Text after a large script</p>", 1);
+}
+
+// Markup fragments in random order: unclosed, misnested and stray tags
+static void stress_fuzz(StressPage *page) {
+    static const char *fragments[] = {
+        "<div>", "</div>", "<p>", "</p>", "<b>", "</b>", "<i>", "<table>", "<td>", "</tr>", "<li>",
+        "<ul>", "</ul>", "text ", "<!-- c -->", "<script>x<y</script>", "<svg><g>", "</svg>", "&amp;",
+        "<img src=x>", "<a href='#'>", "</a>", "<", ">", "\xff\xfe", "<style>p{}</style>",
+    };
+    uint32_t seed = 12345;
+    for (int i = 0; i < 300000; i++) {
+        seed = seed * 1103515245u + 12345u; // Fixed seed: the same page every run
+        const char *fragment = fragments[(seed >> 16) % (sizeof(fragments) / sizeof(fragments[0]))];
+        stress_put(page, fragment, strlen(fragment));
+    }
+}
+
+typedef struct {
+    uint32_t nodes;
+    uint32_t depth;
+    size_t text_bytes; // Outside script and style
+} DomCensus;
+
+// Iterative: the deep case would overflow a recursive walk
+static void dom_census(lxb_dom_node_t *root, DomCensus *census) {
+    memset(census, 0, sizeof(*census));
+    uint32_t depth = 0;
+    lxb_dom_node_t *node = root->first_child;
+    while (node) {
+        census->nodes++;
+        if (depth + 1 > census->depth) census->depth = depth + 1;
+        if (node->type == LXB_DOM_NODE_TYPE_TEXT && node->parent->type == LXB_DOM_NODE_TYPE_ELEMENT) {
+            lxb_tag_id_t parent_tag = lxb_dom_element_tag_id(lxb_dom_interface_element(node->parent));
+            if (parent_tag != LXB_TAG_SCRIPT && parent_tag != LXB_TAG_STYLE) {
+                census->text_bytes += lxb_dom_interface_character_data(node)->data.length;
+            }
+        }
+        if (node->first_child) {
+            node = node->first_child;
+            depth++;
+            continue;
+        }
+        while (node && node != root && !node->next) {
+            node = node->parent;
+            depth--;
+        }
+        node = (node && node != root) ? node->next : NULL;
+    }
+}
+
+typedef struct {
+    const char *name;
+    void (*build)(StressPage *page);
+} StressCase;
+
+static const StressCase stress_cases[] = {
+    {"deep-nesting", stress_deep},   {"huge-table", stress_table},   {"long-text", stress_long_text},
+    {"many-nodes", stress_many_nodes}, {"big-script", stress_big_script}, {"fuzz", stress_fuzz},
+};
+
+// Pathological pages through the parser with the page limits in place.
+// With a directory, each page is also written there to be opened in the
+// browser (file://) and the render-stage limits checked by eye.
+static int bench_limits(int argc, char **argv) {
+    const char *dir = argc > 0 ? argv[0] : NULL;
+    printf("Page limits: %u nodes, %lu KB text, depth %u, %u widgets, %u ms render\n",
+           (unsigned int)PAGE_LIMIT_NODES, (unsigned long)(PAGE_LIMIT_TEXT_BYTES / 1024),
+           (unsigned int)PAGE_LIMIT_DEPTH, (unsigned int)PAGE_LIMIT_WIDGETS, (unsigned int)PAGE_LIMIT_RENDER_MS);
+    printf("  %-14s %10s %10s %10s %10s %10s  %s\n", "page", "KB", "nodes", "text KB", "depth", "parse ms",
+           "result");
+
+    int failures = 0;
+    for (size_t c = 0; c < sizeof(stress_cases) / sizeof(stress_cases[0]); c++) {
+        StressPage page = {0};
+        stress_cases[c].build(&page);
+        if (!page.data) return 1;
+
+        if (dir) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s.html", dir, stress_cases[c].name);
+            FILE *file = fopen(path, "wb");
+            if (file) {
+                fwrite(page.data, 1, page.len, file);
+                fclose(file);
+            }
+        }
+
+        uint64_t start = trace_now_us();
+        lxb_html_document_t *document = lxb_html_document_create();
+        ParseGuard guard = {0};
+        bool ok = document && lxb_html_document_parse_chunk_begin(document) == LXB_STATUS_OK;
+        if (ok) {
+            parse_guard_attach(&guard, document);
+            ok = lxb_html_document_parse_chunk(document, (const lxb_char_t *)page.data, page.len) == LXB_STATUS_OK &&
+                 lxb_html_document_parse_chunk_end(document) == LXB_STATUS_OK;
+            parse_guard_detach(&guard);
+        }
+        uint64_t parse_us = trace_now_us() - start;
+
+        DomCensus census = {0};
+        if (ok) dom_census(lxb_dom_interface_node(document), &census);
+        bool held = ok && census.nodes <= PAGE_LIMIT_NODES + STRESS_IMPLIED_ALLOWANCE &&
+                    census.text_bytes <= PAGE_LIMIT_TEXT_BYTES;
+        if (!held) failures++;
+        char notice[160] = "";
+        page_limits_notice(guard.hits, notice, sizeof(notice));
+        printf("  %-14s %10lu %10u %10lu %10u %10.1f  %s%s%s\n", stress_cases[c].name, (unsigned long)(page.len / 1024),
+               (unsigned int)census.nodes, (unsigned long)(census.text_bytes / 1024), (unsigned int)census.depth,
+               parse_us / 1000.0, !ok ? "parse failed" : held ? "held" : "EXCEEDED", notice[0] ? " - " : "", notice);
+
+        if (document) lxb_html_document_destroy(document);
+        free(page.data);
+    }
+    return failures ? 1 : 0;
+}
+
+int bench_run(int argc, char **argv) {
+    if (argc < 2) return -1;
+    if (strcmp(argv[1], "--bench-decode") == 0) return bench_decode(argc - 2, argv + 2);
+    if (strcmp(argv[1], "--bench-script") == 0) return bench_script(argc - 2, argv + 2);
+    if (strcmp(argv[1], "--bench-parse") == 0) return bench_parse(argc - 2, argv + 2);
+    if (strcmp(argv[1], "--bench-limits") == 0) return bench_limits(argc - 2, argv + 2);
+    return -1;
+}
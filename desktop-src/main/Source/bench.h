@@ -0,0 +1,10 @@
+#pragma once
+
+// Command-line benchmarks, run instead of the browser UI:
+//   TactileBrowser --bench-decode [--box WxH] image...
+//   TactileBrowser --bench-script
+//   TactileBrowser --bench-parse [--runs N] page.html...
+//   TactileBrowser --bench-limits [corpus-dir]
+// Returns the process exit code, or -1 if the arguments do not ask for a
+// benchmark.
+int bench_run(int argc, char **argv);
@@ -0,0 +1,210 @@
+#include "decode_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+typedef struct {
+    SDL_Thread *threads[DECODE_POOL_MAX_WORKERS];
+    int worker_count;
+    SDL_mutex *lock;
+    SDL_cond *work_ready; // Signalled when jobs are queued or on shutdown
+    SDL_cond *idle;       // Signalled when a worker finishes a job
+    DecodeJob *pending_head, *pending_tail; // Not started, FIFO
+    DecodeJob *done_head, *done_tail;       // Finished, waiting for poll
+    int running;          // Jobs currently being decoded
+    bool stopping;
+} DecodePool;
+
+static DecodePool pool;
+
+static void job_free(DecodeJob *job) {
+    free(job->data);
+    image_bitmap_free(&job->bitmap);
+    free(job);
+}
+
+static void append(DecodeJob **head, DecodeJob **tail, DecodeJob *job) {
+    job->next = NULL;
+    if (*tail) (*tail)->next = job;
+    else *head = job;
+    *tail = job;
+}
+
+static int worker_main(void *arg) {
+    SDL_LockMutex(pool.lock);
+    for (;;) {
+        while (!pool.pending_head && !pool.stopping) SDL_CondWait(pool.work_ready, pool.lock);
+        if (pool.stopping) break;
+
+        DecodeJob *job = pool.pending_head;
+        pool.pending_head = job->next;
+        if (!pool.pending_head) pool.pending_tail = NULL;
+        pool.running++;
+        SDL_UnlockMutex(pool.lock);
+
+        uint64_t start = trace_now_us();
+        job->ok = image_decode(job->data, job->size, job->box_w, job->box_h, job->color_depth, &job->bitmap);
+        job->decode_us = trace_now_us() - start;
+        // The encoded bytes are not needed past this point
+        free(job->data);
+        job->data = NULL;
+
+        SDL_LockMutex(pool.lock);
+        pool.running--;
+        append(&pool.done_head, &pool.done_tail, job);
+        SDL_CondBroadcast(pool.idle);
+    }
+    SDL_UnlockMutex(pool.lock);
+    return 0;
+}
+
+bool decode_pool_init(int workers) {
+    if (pool.worker_count > 0) return true;
+
+    if (workers <= 0) workers = SDL_GetCPUCount();
+    if (workers < 1) workers = 1;
+    if (workers > DECODE_POOL_MAX_WORKERS) workers = DECODE_POOL_MAX_WORKERS;
+
+    memset(&pool, 0, sizeof(pool));
+    pool.lock = SDL_CreateMutex();
+    pool.work_ready = SDL_CreateCond();
+    pool.idle = SDL_CreateCond();
+    if (!pool.lock || !pool.work_ready || !pool.idle) {
+        fprintf(stderr, "Failed to create decode pool: %s\n", SDL_GetError());
+        decode_pool_shutdown();
+        return false;
+    }
+
+    for (int i = 0; i < workers; i++) {
+        pool.threads[i] = SDL_CreateThread(worker_main, "decode", NULL);
+        if (!pool.threads[i]) {
+            fprintf(stderr, "Failed to start decode worker: %s\n", SDL_GetError());
+            break;
+        }
+        pool.worker_count++;
+    }
+    if (pool.worker_count == 0) {
+        decode_pool_shutdown();
+        return false;
+    }
+    return true;
+}
+
+void decode_pool_shutdown(void) {
+    if (pool.lock) {
+        SDL_LockMutex(pool.lock);
+        pool.stopping = true;
+        SDL_CondBroadcast(pool.work_ready);
+        SDL_UnlockMutex(pool.lock);
+    }
+    for (int i = 0; i < pool.worker_count; i++) SDL_WaitThread(pool.threads[i], NULL);
+
+    while (pool.pending_head) {
+        DecodeJob *job = pool.pending_head;
+        pool.pending_head = job->next;
+        job_free(job);
+    }
+    while (pool.done_head) {
+        DecodeJob *job = pool.done_head;
+        pool.done_head = job->next;
+        job_free(job);
+    }
+
+    if (pool.idle) SDL_DestroyCond(pool.idle);
+    if (pool.work_ready) SDL_DestroyCond(pool.work_ready);
+    if (pool.lock) SDL_DestroyMutex(pool.lock);
+    memset(&pool, 0, sizeof(pool));
+}
+
+int decode_pool_workers(void) {
+    return pool.worker_count;
+}
+
+DecodeJob *decode_pool_submit(uint8_t *data, size_t size, uint32_t box_w, uint32_t box_h,
+                              int color_depth, DecodeDoneCb done, void *user_data) {
+    DecodeJob *job = calloc(1, sizeof(DecodeJob));
+    if (!job) {
+        free(data);
+        return NULL;
+    }
+
+    job->data = data;
+    job->size = size;
+    job->box_w = box_w;
+    job->box_h = box_h;
+    job->color_depth = color_depth;
+    job->done = done;
+    job->user_data = user_data;
+
+    if (pool.worker_count == 0) {
+        // No workers (init failed or not called): decode inline, still
+        // delivering through decode_pool_poll() so callers see one path
+        uint64_t start = trace_now_us();
+        job->ok = image_decode(data, size, box_w, box_h, color_depth, &job->bitmap);
+        job->decode_us = trace_now_us() - start;
+        free(job->data);
+        job->data = NULL;
+        append(&pool.done_head, &pool.done_tail, job);
+        return job;
+    }
+
+    SDL_LockMutex(pool.lock);
+    append(&pool.pending_head, &pool.pending_tail, job);
+    SDL_CondSignal(pool.work_ready);
+    SDL_UnlockMutex(pool.lock);
+    return job;
+}
+
+void decode_pool_cancel(DecodeJob *job) {
+    if (!job) return;
+    if (pool.worker_count == 0) {
+        SDL_AtomicSet(&job->cancelled, 1);
+        return;
+    }
+
+    SDL_LockMutex(pool.lock);
+    // Not started yet: unlink and free right away
+    DecodeJob *prev = NULL;
+    for (DecodeJob *it = pool.pending_head; it; prev = it, it = it->next) {
+        if (it != job) continue;
+        if (prev) prev->next = it->next;
+        else pool.pending_head = it->next;
+        if (pool.pending_tail == it) pool.pending_tail = prev;
+        SDL_UnlockMutex(pool.lock);
+        job_free(job);
+        return;
+    }
+    // Running or done: decode_pool_poll() discards it
+    SDL_AtomicSet(&job->cancelled, 1);
+    SDL_UnlockMutex(pool.lock);
+}
+
+int decode_pool_poll(void) {
+    if (pool.lock) SDL_LockMutex(pool.lock);
+    DecodeJob *job = pool.done_head;
+    pool.done_head = pool.done_tail = NULL;
+    if (pool.lock) SDL_UnlockMutex(pool.lock);
+
+    int delivered = 0;
+    while (job) {
+        DecodeJob *next = job->next;
+        if (!SDL_AtomicGet(&job->cancelled) && job->done) {
+            job->done(job, job->user_data);
+            delivered++;
+        }
+        job_free(job);
+        job = next;
+    }
+    return delivered;
+}
+
+void decode_pool_wait_idle(void) {
+    if (pool.worker_count == 0) return;
+
+    SDL_LockMutex(pool.lock);
+    while (pool.pending_head || pool.running > 0) SDL_CondWait(pool.idle, pool.lock);
+    SDL_UnlockMutex(pool.lock);
+}
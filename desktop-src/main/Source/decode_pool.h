@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#include "image_decode.h"
+
+#define DECODE_POOL_MAX_WORKERS 16
+
+typedef struct DecodeJob DecodeJob;
+
+// Runs on the main thread from decode_pool_poll(). The callback may take
+// `job->bitmap` (zero it afterwards); anything left is freed with the job.
+typedef void (*DecodeDoneCb)(DecodeJob *job, void *user_data);
+
+struct DecodeJob {
+    // Input, owned by the job
+    uint8_t *data;
+    size_t size;
+    uint32_t box_w;
+    uint32_t box_h;
+    int color_depth;
+
+    // Output
+    bool ok;
+    ImageBitmap bitmap;
+    uint64_t decode_us;
+
+    DecodeDoneCb done;
+    void *user_data;
+    SDL_atomic_t cancelled;
+    DecodeJob *next;
+};
+
+// Start `workers` decode threads (0 = one per CPU core). Without workers,
+// jobs are decoded inline on submit and still delivered by the poll.
+bool decode_pool_init(int workers);
+// Stop the workers; unfinished jobs are dropped without callbacks
+void decode_pool_shutdown(void);
+int decode_pool_workers(void);
+
+// Queue a decode of `data` (ownership passes to the pool) to at most
+// box_w x box_h. Returns NULL if the job could not be created.
+DecodeJob *decode_pool_submit(uint8_t *data, size_t size, uint32_t box_w, uint32_t box_h,
+                              int color_depth, DecodeDoneCb done, void *user_data);
+
+// Drop a job from the main thread; its callback will not run. A job already
+// being decoded finishes in the background and is then discarded.
+void decode_pool_cancel(DecodeJob *job);
+
+// Deliver finished jobs to their callbacks. Call from the main loop.
+// Returns the number of callbacks run.
+int decode_pool_poll(void);
+
+// Block until every submitted job has finished (benchmarks and shutdown)
+void decode_pool_wait_idle(void);
@@ -0,0 +1,152 @@
+#include "disk_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+typedef enum {
+    DISK_JOB_WRITE,  // Write `data` to `path` through a temporary file
+    DISK_JOB_REMOVE, // Delete `path`
+} DiskJobKind;
+
+struct DiskJob {
+    DiskJobKind kind;
+    char path[DISK_WRITER_PATH_LENGTH];
+    char *data;
+    size_t size;
+    DiskJob *next;
+};
+
+static void disk_job_run(DiskJob *job) {
+    if (job->kind == DISK_JOB_REMOVE) {
+        remove(job->path);
+        return;
+    }
+    char tmp_path[DISK_WRITER_PATH_LENGTH + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s", job->path);
+    char *slash = strrchr(tmp_path, '/');
+    if (slash) {
+        *slash = '\0';
+        make_dir(tmp_path);
+    }
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", job->path);
+    FILE *file = fopen(tmp_path, "wb");
+    bool ok = file != NULL;
+    if (file) {
+        ok = job->size == 0 || fwrite(job->data, job->size, 1, file) == 1;
+        if (fclose(file) != 0) ok = false;
+    }
+#ifdef _WIN32
+    // rename() does not replace an existing file here
+    if (ok) remove(job->path);
+#endif
+    if (ok && rename(tmp_path, job->path) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", job->path);
+        remove(tmp_path);
+    }
+}
+
+static void disk_job_free(DiskJob *job) {
+    free(job->data);
+    free(job);
+}
+
+static int writer_main(void *arg) {
+    DiskWriter *writer = (DiskWriter *)arg;
+    SDL_LockMutex(writer->lock);
+    for (;;) {
+        while (!writer->head && !writer->stopping) SDL_CondWait(writer->work_ready, writer->lock);
+        // Queued writes are finished before stopping
+        if (!writer->head) break;
+
+        DiskJob *job = writer->head;
+        writer->head = job->next;
+        if (!writer->head) writer->tail = NULL;
+        writer->busy = true;
+        SDL_UnlockMutex(writer->lock);
+
+        disk_job_run(job);
+        disk_job_free(job);
+
+        SDL_LockMutex(writer->lock);
+        writer->busy = false;
+        if (!writer->head) SDL_CondBroadcast(writer->idle);
+    }
+    SDL_UnlockMutex(writer->lock);
+    return 0;
+}
+
+// Takes ownership of `data`
+static void queue_job(DiskWriter *writer, DiskJobKind kind, const char *path, char *data, size_t size) {
+    DiskJob *job = calloc(1, sizeof(DiskJob));
+    if (!job) {
+        free(data);
+        return;
+    }
+    job->kind = kind;
+    snprintf(job->path, sizeof(job->path), "%s", path);
+    job->data = data;
+    job->size = size;
+
+    if (!writer->thread) {
+        disk_job_run(job);
+        disk_job_free(job);
+        return;
+    }
+    SDL_LockMutex(writer->lock);
+    if (writer->tail) writer->tail->next = job;
+    else writer->head = job;
+    writer->tail = job;
+    SDL_CondSignal(writer->work_ready);
+    SDL_UnlockMutex(writer->lock);
+}
+
+bool disk_writer_start(DiskWriter *writer, const char *name) {
+    memset(writer, 0, sizeof(*writer));
+    writer->lock = SDL_CreateMutex();
+    writer->work_ready = SDL_CreateCond();
+    writer->idle = SDL_CreateCond();
+    if (writer->lock && writer->work_ready && writer->idle) {
+        writer->thread = SDL_CreateThread(writer_main, name, writer);
+    }
+    if (!writer->thread) fprintf(stderr, "Failed to start %s writer: %s\n", name, SDL_GetError());
+    return writer->thread != NULL;
+}
+
+void disk_writer_stop(DiskWriter *writer) {
+    if (writer->thread) {
+        SDL_LockMutex(writer->lock);
+        writer->stopping = true;
+        SDL_CondBroadcast(writer->work_ready);
+        SDL_UnlockMutex(writer->lock);
+        SDL_WaitThread(writer->thread, NULL);
+    }
+    if (writer->idle) SDL_DestroyCond(writer->idle);
+    if (writer->work_ready) SDL_DestroyCond(writer->work_ready);
+    if (writer->lock) SDL_DestroyMutex(writer->lock);
+    memset(writer, 0, sizeof(*writer));
+}
+
+void disk_writer_write(DiskWriter *writer, const char *path, char *data, size_t size) {
+    queue_job(writer, DISK_JOB_WRITE, path, data, size);
+}
+
+void disk_writer_remove(DiskWriter *writer, const char *path) {
+    queue_job(writer, DISK_JOB_REMOVE, path, NULL, 0);
+}
+
+void disk_writer_wait_idle(DiskWriter *writer) {
+    if (!writer->thread) return;
+    SDL_LockMutex(writer->lock);
+    while (writer->head || writer->busy) SDL_CondWait(writer->idle, writer->lock);
+    SDL_UnlockMutex(writer->lock);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL2/SDL.h>
+
+#define DISK_WRITER_PATH_LENGTH 512
+
+typedef struct DiskJob DiskJob;
+
+// A thread that writes and deletes files so the UI thread never waits on
+// the disk. Jobs run in the order they were queued, so a file removed
+// after being written is gone afterwards. Without a thread (never started,
+// or it failed to start) jobs run inline.
+typedef struct {
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *work_ready; // Signalled when jobs are queued or on shutdown
+    SDL_cond *idle;       // Signalled when the queue runs dry
+    DiskJob *head, *tail;
+    bool busy;
+    bool stopping;
+} DiskWriter;
+
+bool disk_writer_start(DiskWriter *writer, const char *name);
+// Finishes the queued jobs, then stops the thread
+void disk_writer_stop(DiskWriter *writer);
+
+// Replace `path` with `size` bytes of `data`, creating its directory.
+// Readers see the old file or the new one, never part of it. Takes
+// ownership of `data`.
+void disk_writer_write(DiskWriter *writer, const char *path, char *data, size_t size);
+void disk_writer_remove(DiskWriter *writer, const char *path);
+
+// Block until every queued job has run
+void disk_writer_wait_idle(DiskWriter *writer);
@@ -0,0 +1,100 @@
+#include "file_map.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool file_map_open(FileMap *map, const char *path) {
+    memset(map, 0, sizeof(*map));
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // Mapping a zero-length file fails, but an empty file is still valid input
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        map->data = "";
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return false;
+
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    map->data = view;
+    map->size = (size_t)size.QuadPart;
+    map->handle = mapping;
+    return true;
+}
+
+void file_map_close(FileMap *map) {
+    if (map->handle) {
+        UnmapViewOfFile(map->data);
+        CloseHandle((HANDLE)map->handle);
+    }
+    memset(map, 0, sizeof(*map));
+}
+
+#else
+
+bool file_map_open(FileMap *map, const char *path) {
+    memset(map, 0, sizeof(*map));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    // Mapping a zero-length file fails, but an empty file is still valid input
+    if (st.st_size == 0) {
+        close(fd);
+        map->data = "";
+        return true;
+    }
+
+    void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "mmap failed for %s\n", path);
+        return false;
+    }
+
+    map->data = addr;
+    map->size = (size_t)st.st_size;
+    map->handle = addr;
+    return true;
+}
+
+void file_map_close(FileMap *map) {
+    if (map->handle) munmap(map->handle, map->size);
+    memset(map, 0, sizeof(*map));
+}
+
+#endif
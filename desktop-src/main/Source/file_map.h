@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Read-only view of a whole file. On POSIX and Windows the bytes are
+// memory-mapped, so pages are only faulted in when something touches them.
+typedef struct {
+    const char *data;
+    size_t size;
+    void *handle; // platform mapping handle, NULL for empty files
+} FileMap;
+
+bool file_map_open(FileMap *map, const char *path);
+void file_map_close(FileMap *map);
@@ -0,0 +1,163 @@
+#include "fonts.h"
+#include "file_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FONT_SIZE 14
+#define FONT_GLYPH_CACHE_CNT 64
+#define FONT_PATH_LENGTH 512
+#define FONT_DIR_ENV "TACTILE_FONT_DIR"
+#define FONT_DIR_DEFAULT "fonts"
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} FontRange;
+
+typedef struct {
+    const char *file;
+    const FontRange *ranges;
+    size_t range_count;
+} FallbackFontSpec;
+
+typedef struct {
+    const FallbackFontSpec *spec;
+    lv_font_t proxy;     // Stand-in linked into the fallback chain
+    lv_font_t *font;     // Real TTF font, NULL until first needed
+    FileMap map;
+    bool load_failed;
+} FallbackFont;
+
+// Latin-1 supplement, Latin extended, Greek, Cyrillic and general punctuation
+static const FontRange latin_greek_cyrillic_ranges[] = {
+    {0x00A0, 0x024F}, {0x0370, 0x03FF}, {0x0400, 0x052F},
+    {0x1E00, 0x1FFF}, {0x2000, 0x206F}, {0x20A0, 0x20CF},
+};
+
+// CJK punctuation, kana, unified ideographs, hangul and full-width forms
+static const FontRange cjk_ranges[] = {
+    {0x2E80, 0x9FFF}, {0xAC00, 0xD7AF}, {0xF900, 0xFAFF}, {0xFF00, 0xFFEF},
+};
+
+// Searched in order after Montserrat 14
+static const FallbackFontSpec fallback_specs[] = {
+    {"NotoSans-Regular.ttf", latin_greek_cyrillic_ranges,
+     sizeof(latin_greek_cyrillic_ranges) / sizeof(latin_greek_cyrillic_ranges[0])},
+    {"DroidSansFallbackFull.ttf", cjk_ranges,
+     sizeof(cjk_ranges) / sizeof(cjk_ranges[0])},
+};
+
+#define FALLBACK_COUNT (sizeof(fallback_specs) / sizeof(fallback_specs[0]))
+
+static lv_font_t body_font;
+static FallbackFont fallbacks[FALLBACK_COUNT];
+static int loaded_count = 0;
+
+static bool spec_covers(const FallbackFontSpec *spec, uint32_t letter) {
+    for (size_t i = 0; i < spec->range_count; i++) {
+        if (letter >= spec->ranges[i].first && letter <= spec->ranges[i].last) return true;
+    }
+    return false;
+}
+
+static bool fallback_load(FallbackFont *ff) {
+    const char *dir = getenv(FONT_DIR_ENV);
+    if (!dir || !*dir) dir = FONT_DIR_DEFAULT;
+
+    char path[FONT_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", dir, ff->spec->file);
+
+    // Never retry a missing font on every glyph lookup
+    ff->load_failed = true;
+
+    if (!file_map_open(&ff->map, path)) {
+        fprintf(stderr, "Fallback font not available: %s\n", path);
+        return false;
+    }
+
+    // tiny_ttf reads straight from the mapping, so only touched pages of the
+    // file are ever resident
+    ff->font = lv_tiny_ttf_create_data_ex(ff->map.data, ff->map.size, FONT_SIZE,
+                                          LV_FONT_KERNING_NONE, FONT_GLYPH_CACHE_CNT);
+    if (!ff->font) {
+        fprintf(stderr, "Failed to parse fallback font: %s\n", path);
+        file_map_close(&ff->map);
+        return false;
+    }
+
+    ff->load_failed = false;
+    loaded_count++;
+    return true;
+}
+
+static bool proxy_get_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc,
+                                uint32_t letter, uint32_t letter_next) {
+    FallbackFont *ff = (FallbackFont *)font->user_data;
+
+    // Only load the file for codepoints it is meant to cover, so an odd
+    // symbol does not pull a multi-megabyte CJK font into memory
+    if (!spec_covers(ff->spec, letter)) return false;
+    if (!ff->font && (ff->load_failed || !fallback_load(ff))) return false;
+
+    return ff->font->get_glyph_dsc(ff->font, dsc, letter, letter_next);
+}
+
+static const void *proxy_get_glyph_bitmap(lv_font_glyph_dsc_t *dsc, lv_draw_buf_t *draw_buf) {
+    FallbackFont *ff = (FallbackFont *)dsc->resolved_font->user_data;
+
+    // Hand the glyph over to the real font so its cache entry is released there
+    dsc->resolved_font = ff->font;
+    return ff->font->get_glyph_bitmap(dsc, draw_buf);
+}
+
+static void proxy_release_glyph(const lv_font_t *font, lv_font_glyph_dsc_t *dsc) {
+    FallbackFont *ff = (FallbackFont *)font->user_data;
+    if (ff->font && ff->font->release_glyph) ff->font->release_glyph(ff->font, dsc);
+}
+
+void fonts_init(void) {
+    // Copy the const built-in font so a fallback chain can be attached to it
+    body_font = lv_font_montserrat_14;
+
+    const lv_font_t *next = NULL;
+    for (int i = (int)FALLBACK_COUNT - 1; i >= 0; i--) {
+        FallbackFont *ff = &fallbacks[i];
+        memset(ff, 0, sizeof(*ff));
+        ff->spec = &fallback_specs[i];
+
+        ff->proxy.get_glyph_dsc = proxy_get_glyph_dsc;
+        ff->proxy.get_glyph_bitmap = proxy_get_glyph_bitmap;
+        ff->proxy.release_glyph = proxy_release_glyph;
+        ff->proxy.line_height = body_font.line_height;
+        ff->proxy.base_line = body_font.base_line;
+        ff->proxy.underline_position = body_font.underline_position;
+        ff->proxy.underline_thickness = body_font.underline_thickness;
+        ff->proxy.fallback = next;
+        ff->proxy.user_data = ff;
+        next = &ff->proxy;
+    }
+
+    body_font.fallback = next;
+}
+
+void fonts_deinit(void) {
+    for (size_t i = 0; i < FALLBACK_COUNT; i++) {
+        FallbackFont *ff = &fallbacks[i];
+        if (ff->font) {
+            lv_tiny_ttf_destroy(ff->font);
+            ff->font = NULL;
+        }
+        file_map_close(&ff->map);
+    }
+    loaded_count = 0;
+}
+
+const lv_font_t *fonts_body(void) {
+    return &body_font;
+}
+
+int fonts_loaded_count(void) {
+    return loaded_count;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <lvgl.h>
+
+// Body text font: the compiled-in Montserrat 14 followed by a chain of TTF
+// fallbacks. A fallback file is only mapped and parsed the first time a
+// codepoint in one of its ranges misses every font before it.
+void fonts_init(void);
+void fonts_deinit(void);
+const lv_font_t *fonts_body(void);
+
+// Number of fallback fonts that have been loaded so far (for diagnostics)
+int fonts_loaded_count(void);
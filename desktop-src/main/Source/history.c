@@ -0,0 +1,164 @@
+#include "history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "trace.h"
+
+static FrozenPage *head; // Most recently frozen
+static FrozenPage *tail;
+static size_t page_count;
+static size_t total_bytes;
+static size_t budget = BFCACHE_DEFAULT_BUDGET;
+static lv_obj_t *storage;
+
+static void entry_free(HistoryEntry *entry) {
+    if (entry->frozen) bfcache_destroy(bfcache_take(entry));
+    free(entry->url);
+    free(entry);
+}
+
+void history_init(History *history) {
+    memset(history, 0, sizeof(*history));
+    history->index = -1;
+}
+
+void history_free(History *history) {
+    for (int i = 0; i < history->count; i++) entry_free(history->entries[i]);
+    history_init(history);
+}
+
+void history_push(History *history, const char *url) {
+    HistoryEntry *entry = calloc(1, sizeof(HistoryEntry));
+    char *copy = malloc(strlen(url) + 1);
+    if (!entry || !copy) {
+        fprintf(stderr, "Failed to allocate history entry\n");
+        free(entry);
+        free(copy);
+        return;
+    }
+    strcpy(copy, url);
+    entry->url = copy;
+
+    // A new navigation from the middle of the history forgets the forward part
+    while (history->count > history->index + 1) entry_free(history->entries[--history->count]);
+
+    if (history->count == HISTORY_MAX_ENTRIES) {
+        entry_free(history->entries[0]);
+        memmove(history->entries, history->entries + 1, (HISTORY_MAX_ENTRIES - 1) * sizeof(HistoryEntry *));
+        history->count--;
+    }
+    history->entries[history->count++] = entry;
+    history->index = history->count - 1;
+}
+
+HistoryEntry *history_current(History *history) {
+    return history->index >= 0 ? history->entries[history->index] : NULL;
+}
+
+bool history_can_go(const History *history, int delta) {
+    int target = history->index + delta;
+    return history->index >= 0 && target >= 0 && target < history->count;
+}
+
+HistoryEntry *history_go(History *history, int delta) {
+    if (!history_can_go(history, delta)) return NULL;
+    history->index += delta;
+    return history->entries[history->index];
+}
+
+static void lru_unlink(FrozenPage *page) {
+    if (page->prev) page->prev->next = page->next;
+    else head = page->next;
+    if (page->next) page->next->prev = page->prev;
+    else tail = page->prev;
+    page->prev = page->next = NULL;
+}
+
+void history_drop_frozen(History *history) {
+    for (int i = 0; i < history->count; i++) {
+        if (history->entries[i]->frozen) bfcache_destroy(bfcache_take(history->entries[i]));
+    }
+}
+
+size_t history_frozen_bytes(const History *history) {
+    size_t bytes = 0;
+    for (int i = 0; i < history->count; i++) {
+        if (history->entries[i]->frozen) bytes += history->entries[i]->frozen->bytes;
+    }
+    return bytes;
+}
+
+void bfcache_init(size_t budget_bytes) {
+    budget = budget_bytes;
+}
+
+void bfcache_deinit(void) {
+    while (head) bfcache_destroy(bfcache_take(head->entry));
+    if (storage) lv_obj_delete(storage);
+    storage = NULL;
+}
+
+lv_obj_t *bfcache_storage(void) {
+    // A screen that is never loaded: nothing under it is laid out or drawn
+    if (!storage) storage = lv_obj_create(NULL);
+    return storage;
+}
+
+void bfcache_store(HistoryEntry *entry, FrozenPage *page) {
+    if (entry->frozen) bfcache_destroy(bfcache_take(entry));
+
+    page->entry = entry;
+    entry->frozen = page;
+    page->prev = NULL;
+    page->next = head;
+    if (head) head->prev = page;
+    head = page;
+    if (!tail) tail = page;
+    page_count++;
+    total_bytes += page->bytes;
+
+    while (tail && tail != page && (page_count > BFCACHE_MAX_PAGES || total_bytes > budget)) {
+        FrozenPage *oldest = tail;
+        trace_event("bfcache evicted %s (%zu KB)", oldest->entry->url, oldest->bytes / 1024);
+        bfcache_destroy(bfcache_take(oldest->entry));
+    }
+    // A single page over the whole budget is not worth keeping either
+    if (total_bytes > budget) bfcache_destroy(bfcache_take(entry));
+}
+
+FrozenPage *bfcache_take(HistoryEntry *entry) {
+    FrozenPage *page = entry->frozen;
+    if (!page) return NULL;
+    lru_unlink(page);
+    page_count--;
+    total_bytes -= page->bytes;
+    entry->frozen = NULL;
+    page->entry = NULL;
+    return page;
+}
+
+void bfcache_destroy(FrozenPage *page) {
+    if (!page) return;
+    // The queue first, so deleting its placeholders finds nothing to cancel
+    image_queue_free(&page->images);
+    if (page->root) lv_obj_delete(page->root);
+    style_map_free(&page->styles);
+    script_context_free(&page->scripts);
+    if (page->document) lxb_html_document_destroy(page->document);
+    free(page);
+}
+
+size_t bfcache_estimate(lv_obj_t *root, const StyleMap *styles, size_t source_bytes,
+                        const ScriptContext *scripts) {
+    PageMemory mem;
+    page_memory_measure(&mem, root, true, styles, source_bytes);
+    mem.scripts = scripts->heap_size + script_dom_bytes(&scripts->dom);
+    return page_memory_total(&mem);
+}
+
+size_t bfcache_bytes(void) {
+    return total_bytes;
+}
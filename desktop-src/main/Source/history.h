@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lexbor/html/html.h>
+#include <lvgl.h>
+
+#include "image.h"
+#include "script.h"
+#include "style.h"
+
+#define HISTORY_MAX_ENTRIES 50              // Per tab; the oldest entry is dropped beyond this
+#define BFCACHE_MAX_PAGES 8                 // Frozen pages across all tabs
+#define BFCACHE_DEFAULT_BUDGET (32 * 1024 * 1024)
+
+typedef struct HistoryEntry HistoryEntry;
+
+// A page kept alive for back/forward: its widget subtree (parked on an
+// off-screen LVGL screen), document, computed styles, waiting images and
+// JS context
+typedef struct FrozenPage {
+    lv_obj_t *root;
+    lxb_html_document_t *document;
+    StyleMap styles;
+    ImageQueue images;
+    ScriptContext scripts;
+    int32_t scroll_y;
+    size_t source_bytes;       // Size of the HTML the document was parsed from
+    size_t bytes;              // Estimated footprint counted against the budget
+    HistoryEntry *entry;       // Entry the page belongs to
+    struct FrozenPage *prev;   // Towards most recently frozen
+    struct FrozenPage *next;   // Towards least recently frozen
+} FrozenPage;
+
+struct HistoryEntry {
+    char *url;
+    FrozenPage *frozen; // NULL unless the page is in the back/forward cache
+};
+
+typedef struct {
+    HistoryEntry *entries[HISTORY_MAX_ENTRIES];
+    int count;
+    int index; // Current entry, -1 while empty
+} History;
+
+void history_init(History *history);
+// Drops every entry along with its frozen page
+void history_free(History *history);
+
+// Make `url` the current entry, discarding any forward entries
+void history_push(History *history, const char *url);
+
+HistoryEntry *history_current(History *history);
+bool history_can_go(const History *history, int delta);
+// Move back (negative) or forward; returns the new current entry or NULL
+HistoryEntry *history_go(History *history, int delta);
+
+// Release every frozen page of the history, keeping the entries
+void history_drop_frozen(History *history);
+size_t history_frozen_bytes(const History *history);
+
+void bfcache_init(size_t budget_bytes);
+void bfcache_deinit(void);
+
+// Off-screen parent for frozen widget trees
+lv_obj_t *bfcache_storage(void);
+
+// Take ownership of a frozen page for `entry`, then evict the least recently
+// frozen pages until the cache fits its page count and byte budget
+void bfcache_store(HistoryEntry *entry, FrozenPage *page);
+
+// Remove and return `entry`'s frozen page, or NULL when it was evicted
+FrozenPage *bfcache_take(HistoryEntry *entry);
+
+// Destroy a page that is not (or no longer) in the cache
+void bfcache_destroy(FrozenPage *page);
+
+// Rough bytes a frozen page keeps alive: widgets, label text, the decoded
+// images it pins in the image cache, the DOM built from `source_bytes` and
+// the JS heap
+size_t bfcache_estimate(lv_obj_t *root, const StyleMap *styles, size_t source_bytes,
+                        const ScriptContext *scripts);
+
+size_t bfcache_bytes(void);
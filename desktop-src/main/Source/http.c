@@ -0,0 +1,91 @@
+#include "http.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <curl/curl.h>
+
+#define HTTP_BUFFER_INITIAL (16 * 1024)
+
+// CURL callback - renamed to avoid conflict
+static size_t http_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
+    size_t real_size = size * nmemb;
+    MemoryBuffer *mem = (MemoryBuffer *)userp;
+    if (mem->on_chunk) {
+        mem->on_chunk((const char *)contents, real_size, mem->chunk_ctx);
+        return real_size;
+    }
+    
+    // Doubling keeps a large body to a handful of reallocations instead of
+    // one per network chunk, each leaving the previous block as a hole
+    if (!mem->data) mem->capacity = 0;
+    if (mem->size + real_size + 1 > mem->capacity) {
+        size_t capacity = mem->capacity ? mem->capacity : HTTP_BUFFER_INITIAL;
+        while (capacity < mem->size + real_size + 1) capacity *= 2;
+        char *ptr = realloc(mem->data, capacity);
+        if (!ptr) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            return 0;
+        }
+        mem->data = ptr;
+        mem->capacity = capacity;
+    }
+    
+    memcpy(&(mem->data[mem->size]), contents, real_size);
+    mem->size += real_size;
+    mem->data[mem->size] = 0;
+    return real_size;
+}
+
+void http_configure(CURL *curl, const char *url, MemoryBuffer *buffer) {
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, buffer);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, "TactileBrowser/1.0");
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, ""); // Everything this libcurl can decode
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+}
+
+// Run a blocking transfer into `buffer`
+static bool perform(const char *url, MemoryBuffer *buffer) {
+    CURL *curl = curl_easy_init();
+    if (!curl) {
+        fprintf(stderr, "curl_easy_init failed\n");
+        return false;
+    }
+
+    http_configure(curl, url, buffer);
+    CURLcode res = curl_easy_perform(curl);
+    if (res != CURLE_OK) {
+        fprintf(stderr, "curl_easy_perform failed: %s\n", curl_easy_strerror(res));
+    }
+    
+    curl_easy_cleanup(curl);
+    return res == CURLE_OK;
+}
+
+char *http_fetch(const char *url, size_t *size) {
+    MemoryBuffer chunk = {0};
+    if (!perform(url, &chunk)) {
+        free(chunk.data);
+        chunk.data = NULL;
+    }
+    if (size) *size = chunk.data ? chunk.size : 0;
+    return chunk.data;
+}
+
+bool http_stream(const char *url, HttpChunkCb on_chunk, void *ctx) {
+    MemoryBuffer sink = {0};
+    sink.on_chunk = on_chunk;
+    sink.chunk_ctx = ctx;
+    return perform(url, &sink);
+}
+
+char *download_html(const char *url) {
+    return http_fetch(url, NULL);
+}
+
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <curl/curl.h>
+
+// Sees each chunk of a body as it arrives
+typedef void (*HttpChunkCb)(const char *data, size_t len, void *ctx);
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;      // Bytes allocated at `data`, grown geometrically
+    HttpChunkCb on_chunk; // When set, chunks go here instead of into `data`
+    void *chunk_ctx;
+} MemoryBuffer;
+
+// Common options for every transfer: body collected into `buffer`,
+// redirects followed, browser timeouts, and any content encoding curl
+// supports (gzip, deflate, br, ...) negotiated and decoded as it streams in
+void http_configure(CURL *curl, const char *url, MemoryBuffer *buffer);
+
+// Fetch a URL into a NUL-terminated malloc'd buffer. `size` (optional)
+// receives the byte count, so binary bodies such as images are safe.
+char *http_fetch(const char *url, size_t *size);
+
+// Hand each decoded chunk to `on_chunk` as it arrives without buffering the
+// body. Returns false if the transfer failed.
+bool http_stream(const char *url, HttpChunkCb on_chunk, void *ctx);
+
+// Download HTML content
+char *download_html(const char *url);
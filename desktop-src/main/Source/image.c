@@ -0,0 +1,396 @@
+#include "image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lexbor/dom/interfaces/element.h>
+
+#include "decode_pool.h"
+#include "loader.h"
+#include "image_cache.h"
+#include "image_decode.h"
+#include "style.h"
+#include "trace.h"
+#include "url.h"
+
+#define MAX_ATTR_LENGTH 1024
+#define QUEUE_POLL_MS 16
+#define IMAGE_CANCEL_FACTOR 3 // Decodes further than this many margins away are dropped
+#define PLACEHOLDER_COLOR 0x2A2A2A
+
+// Copy an attribute into `out` as a C string; returns false when missing
+static bool get_attribute(lxb_dom_element_t *element, const char *name, char *out, size_t out_size) {
+    size_t len = 0;
+    const lxb_char_t *value = lxb_dom_element_get_attribute(element, (const lxb_char_t *)name,
+                                                            strlen(name), &len);
+    if (!value || len >= out_size) return false;
+    memcpy(out, value, len);
+    out[len] = 0;
+    return true;
+}
+
+// width="" / height="" in CSS pixels; 0 when absent or not a plain number
+static uint32_t get_dimension(lxb_dom_element_t *element, const char *name) {
+    char value[32];
+    if (!get_attribute(element, name, value, sizeof(value))) return 0;
+    char *end;
+    long n = strtol(value, &end, 10);
+    if (n <= 0 || (*end && strcmp(end, "px") != 0)) return 0;
+    return (uint32_t)n;
+}
+
+// Final layout size: explicit attributes win, a missing one follows the
+// intrinsic aspect ratio, and nothing is wider than the content area
+static void layout_size(uint32_t attr_w, uint32_t attr_h, uint32_t intrinsic_w, uint32_t intrinsic_h,
+                        uint32_t max_width, uint32_t *w, uint32_t *h) {
+    if (attr_w && attr_h) {
+        *w = attr_w;
+        *h = attr_h;
+    } else if (attr_w) {
+        *w = attr_w;
+        *h = (uint32_t)((uint64_t)intrinsic_h * attr_w / intrinsic_w);
+    } else if (attr_h) {
+        *h = attr_h;
+        *w = (uint32_t)((uint64_t)intrinsic_w * attr_h / intrinsic_h);
+    } else {
+        *w = intrinsic_w;
+        *h = intrinsic_h;
+    }
+
+    if (max_width > 0 && *w > max_width) {
+        *h = (uint32_t)((uint64_t)*h * max_width / *w);
+        *w = max_width;
+    }
+    if (*w == 0) *w = 1;
+    if (*h == 0) *h = 1;
+}
+
+static void image_delete_cb(lv_event_t *e) {
+    image_cache_release((const lv_image_dsc_t *)lv_event_get_user_data(e));
+}
+
+static lv_obj_t *create_alt_label(lv_obj_t *parent, lxb_dom_element_t *element) {
+    char alt[256];
+    if (!get_attribute(element, "alt", alt, sizeof(alt)) || !alt[0]) return NULL;
+
+    lv_obj_t *label = lv_label_create(parent);
+    lv_label_set_text_fmt(label, "[%s]", alt);
+    lv_obj_set_width(label, LV_PCT(100));
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_style_text_color(label, lv_color_hex(0x9E9E9E), 0);
+    trace_count(TRACE_WIDGETS, 1);
+    return label;
+}
+
+// Cache entries are keyed on what is known before fetching; the decoded size
+// follows from it and the intrinsic size
+static const lv_image_dsc_t *acquire_cached(const char *url, uint32_t attr_w, uint32_t attr_h,
+                                            uint32_t max_width, uint32_t *w, uint32_t *h) {
+    uint32_t intrinsic_w, intrinsic_h;
+    const lv_image_dsc_t *dsc = image_cache_acquire(url, attr_w ? attr_w : max_width, attr_h,
+                                                    &intrinsic_w, &intrinsic_h);
+    if (dsc) {
+        trace_count(TRACE_IMAGE_CACHE_HITS, 1);
+        layout_size(attr_w, attr_h, intrinsic_w, intrinsic_h, max_width, w, h);
+    }
+    return dsc;
+}
+
+static lv_obj_t *create_image(lv_obj_t *parent, const lv_image_dsc_t *dsc, uint32_t w, uint32_t h) {
+    lv_obj_t *img = lv_image_create(parent);
+    lv_image_set_src(img, dsc);
+    lv_obj_add_event_cb(img, image_delete_cb, LV_EVENT_DELETE, (void *)dsc);
+    // The bitmap never exceeds its intrinsic size, so upscaling happens here
+    lv_obj_set_size(img, (lv_coord_t)w, (lv_coord_t)h);
+    if (w != dsc->header.w || h != dsc->header.h) {
+        lv_image_set_inner_align(img, LV_IMAGE_ALIGN_STRETCH);
+    }
+    trace_count(TRACE_WIDGETS, 1);
+    return img;
+}
+
+// Reserve the final size up front when it is known, so a late image does not
+// push the rest of the page around
+static void placeholder_size(uint32_t attr_w, uint32_t attr_h, uint32_t max_width,
+                             uint32_t *w, uint32_t *h) {
+    *w = attr_w;
+    *h = attr_h;
+    if (max_width > 0 && *w > max_width) {
+        *h = (uint32_t)((uint64_t)*h * max_width / *w);
+        *w = max_width;
+    }
+}
+
+static void remove_pending(ImageQueue *queue, size_t index) {
+    free(queue->items[index].url);
+    queue->items[index] = queue->items[--queue->count];
+    if (queue->count == 0 && queue->timer) lv_timer_pause(queue->timer);
+}
+
+// Look an item up by its placeholder, fetch or decode job
+static PendingImage *find_pending(ImageQueue *queue, const void *key, size_t *index) {
+    for (size_t i = 0; i < queue->count; i++) {
+        PendingImage *item = &queue->items[i];
+        if ((const void *)item->obj == key || (const void *)item->request == key ||
+            (const void *)item->job == key) {
+            *index = i;
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static void placeholder_delete_cb(lv_event_t *e) {
+    ImageQueue *queue = (ImageQueue *)lv_event_get_user_data(e);
+    size_t index;
+    PendingImage *item = find_pending(queue, lv_event_get_target(e), &index);
+    if (!item) return;
+
+    // Navigated away or the subtree was dropped: the image is not wanted
+    loader_cancel(item->request);
+    decode_pool_cancel(item->job);
+    remove_pending(queue, index);
+}
+
+// Swap the placeholder for the image (or the alt text when `dsc` is NULL) in
+// the same position. Only the placeholder's area is redrawn, and nothing is
+// laid out again when the reserved size was right.
+static void finish_pending(ImageQueue *queue, size_t index, const lv_image_dsc_t *dsc) {
+    PendingImage item = queue->items[index];
+    remove_pending(queue, index);
+    lv_obj_remove_event_cb_with_user_data(item.obj, placeholder_delete_cb, queue);
+
+    queue->finished++;
+    if (queue->count == 0) {
+        // With concurrent fetches this approaches the slowest image, not the sum
+        trace_event("%u images settled in %.2fms", queue->finished,
+                    (trace_now_us() - queue->started_us) / 1000.0);
+    }
+
+    lv_obj_t *parent = lv_obj_get_parent(item.obj);
+    lv_obj_t *replacement = dsc ? create_image(parent, dsc, item.w, item.h)
+                                : create_alt_label(parent, item.element);
+    if (replacement) lv_obj_move_to_index(replacement, lv_obj_get_index(item.obj));
+    lv_obj_delete(item.obj);
+}
+
+// Main thread, from decode_pool_poll()
+static void decode_done_cb(DecodeJob *job, void *user_data) {
+    ImageQueue *queue = (ImageQueue *)user_data;
+    size_t index;
+    PendingImage *item = find_pending(queue, job, &index);
+    if (!item) return;
+
+    trace_stage_add(TRACE_STAGE_DECODE, job->decode_us);
+    const lv_image_dsc_t *dsc = NULL;
+    if (job->ok) {
+        trace_count(TRACE_IMAGES_DECODED, 1);
+        dsc = image_cache_insert(item->url, item->attr_w ? item->attr_w : item->max_width, item->attr_h,
+                                 item->intrinsic_w, item->intrinsic_h, &job->bitmap);
+    } else {
+        fprintf(stderr, "Failed to decode image: %s\n", item->url);
+    }
+    item->job = NULL;
+    finish_pending(queue, index, dsc);
+}
+
+// Main thread, from loader_pump(): hand the bytes to the decode pool
+static void fetch_done_cb(LoadRequest *request, void *user_data) {
+    ImageQueue *queue = (ImageQueue *)user_data;
+    size_t index;
+    PendingImage *item = find_pending(queue, request, &index);
+    if (!item) return;
+    item->request = NULL;
+
+    uint8_t *data = (uint8_t *)request->body.data;
+    size_t size = request->body.size;
+    if (!request->ok || !data || !image_probe(data, size, &item->intrinsic_w, &item->intrinsic_h)) {
+        finish_pending(queue, index, NULL);
+        return;
+    }
+    layout_size(item->attr_w, item->attr_h, item->intrinsic_w, item->intrinsic_h, item->max_width,
+                &item->w, &item->h);
+
+    request->body.data = NULL; // Owned by the decode job now
+    item->job = decode_pool_submit(data, size, item->w, item->h, LV_COLOR_DEPTH, decode_done_cb, queue);
+    if (!item->job) finish_pending(queue, index, NULL);
+}
+
+static LoadPriority fetch_priority(int32_t distance) {
+    return distance == 0 ? LOAD_PRIORITY_VISIBLE_IMAGE : LOAD_PRIORITY_OFFSCREEN_IMAGE;
+}
+
+// Start fetching an image; the placeholder stays until the decoded bitmap
+// comes back
+static void load_pending(ImageQueue *queue, size_t index, int32_t distance) {
+    PendingImage *item = &queue->items[index];
+
+    // The same image may have been loaded since this one was queued
+    const lv_image_dsc_t *dsc = acquire_cached(item->url, item->attr_w, item->attr_h, item->max_width,
+                                               &item->w, &item->h);
+    if (dsc) {
+        finish_pending(queue, index, dsc);
+        return;
+    }
+
+    item->request = loader_request(item->url, fetch_priority(distance), queue, fetch_done_cb, queue);
+    if (!item->request) finish_pending(queue, index, NULL);
+}
+
+// Vertical distance from the visible part of the viewport, 0 when on screen
+static int32_t viewport_distance(const lv_area_t *view, lv_obj_t *obj) {
+    lv_area_t area;
+    lv_obj_get_coords(obj, &area);
+    if (area.y2 < view->y1) return view->y1 - area.y2;
+    if (area.y1 > view->y2) return area.y1 - view->y2;
+    return 0;
+}
+
+// Request every waiting image within the margin; the loader starts visible
+// ones first. Images that scrolled far out of range are cancelled and
+// fetched again if they come back.
+static void queue_timer_cb(lv_timer_t *timer) {
+    ImageQueue *queue = (ImageQueue *)lv_timer_get_user_data(timer);
+    if (queue->count == 0) {
+        lv_timer_pause(timer);
+        return;
+    }
+    // Background tabs wait until they are shown
+    if (!lv_obj_is_visible(queue->viewport)) return;
+
+    lv_obj_update_layout(queue->viewport);
+    lv_area_t view;
+    lv_obj_get_coords(queue->viewport, &view);
+
+    // Backwards, because finishing an item moves the last one into its slot
+    for (size_t i = queue->count; i-- > 0;) {
+        PendingImage *item = &queue->items[i];
+        int32_t distance = viewport_distance(&view, item->obj);
+        bool in_flight = item->request || item->job;
+
+        if (in_flight && distance > queue->margin * IMAGE_CANCEL_FACTOR) {
+            loader_cancel(item->request);
+            decode_pool_cancel(item->job);
+            item->request = NULL;
+            item->job = NULL;
+        } else if (item->request) {
+            loader_set_priority(item->request, fetch_priority(distance));
+        } else if (!in_flight && distance <= queue->margin) {
+            load_pending(queue, i, distance);
+        }
+    }
+}
+
+void image_queue_init(ImageQueue *queue, lv_obj_t *viewport) {
+    memset(queue, 0, sizeof(*queue));
+    queue->viewport = viewport;
+    queue->margin = IMAGE_LAZY_MARGIN;
+
+    const char *env = getenv("TACTILE_LAZY_MARGIN");
+    if (env && *env) queue->margin = atoi(env);
+
+    queue->timer = lv_timer_create(queue_timer_cb, QUEUE_POLL_MS, queue);
+    lv_timer_pause(queue->timer);
+}
+
+void image_queue_reset(ImageQueue *queue) {
+    loader_cancel_owner(queue);
+    while (queue->count > 0) {
+        decode_pool_cancel(queue->items[0].job);
+        lv_obj_remove_event_cb_with_user_data(queue->items[0].obj, placeholder_delete_cb, queue);
+        remove_pending(queue, 0);
+    }
+}
+
+void image_queue_free(ImageQueue *queue) {
+    image_queue_reset(queue);
+    free(queue->items);
+    if (queue->timer) lv_timer_delete(queue->timer);
+    memset(queue, 0, sizeof(*queue));
+}
+
+void image_queue_move(ImageQueue *to, ImageQueue *from) {
+    image_queue_reset(to);
+    free(to->items);
+
+    loader_cancel_owner(from);
+    for (size_t i = 0; i < from->count; i++) {
+        PendingImage *item = &from->items[i];
+        decode_pool_cancel(item->job);
+        item->request = NULL;
+        item->job = NULL;
+        lv_obj_remove_event_cb_with_user_data(item->obj, placeholder_delete_cb, from);
+        lv_obj_add_event_cb(item->obj, placeholder_delete_cb, LV_EVENT_DELETE, to);
+    }
+
+    to->items = from->items;
+    to->count = from->count;
+    to->capacity = from->capacity;
+    to->started_us = from->started_us;
+    to->finished = from->finished;
+    from->items = NULL;
+    from->count = 0;
+    from->capacity = 0;
+    if (from->timer) lv_timer_pause(from->timer);
+    if (to->count > 0 && to->timer) lv_timer_resume(to->timer);
+}
+
+lv_obj_t *image_create(ImageQueue *queue, lv_obj_t *parent, lxb_dom_element_t *element,
+                       const char *base_url, lv_coord_t max_width) {
+    char src[MAX_ATTR_LENGTH];
+    if (!get_attribute(element, "src", src, sizeof(src))) return create_alt_label(parent, element);
+
+    char *url = url_resolve(base_url, src);
+    if (!url) return create_alt_label(parent, element);
+
+    // CSS sizes win over the attributes, as in other browsers
+    uint32_t limit = max_width > 0 ? (uint32_t)max_width : 0;
+    lv_coord_t css_w = 0, css_h = 0;
+    style_element_size(element, max_width, &css_w, &css_h);
+    uint32_t attr_w = css_w > 0 ? (uint32_t)css_w : get_dimension(element, "width");
+    uint32_t attr_h = css_h > 0 ? (uint32_t)css_h : get_dimension(element, "height");
+
+    uint32_t w, h;
+    const lv_image_dsc_t *dsc = acquire_cached(url, attr_w, attr_h, limit, &w, &h);
+    if (dsc) {
+        free(url);
+        return create_image(parent, dsc, w, h);
+    }
+
+    if (queue->count == queue->capacity) {
+        size_t capacity = queue->capacity ? queue->capacity * 2 : 16;
+        PendingImage *items = realloc(queue->items, capacity * sizeof(PendingImage));
+        if (!items) {
+            free(url);
+            return create_alt_label(parent, element);
+        }
+        queue->items = items;
+        queue->capacity = capacity;
+    }
+
+    placeholder_size(attr_w, attr_h, limit, &w, &h);
+    lv_obj_t *placeholder = lv_obj_create(parent);
+    lv_obj_remove_style_all(placeholder);
+    lv_obj_remove_flag(placeholder, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(placeholder, (lv_coord_t)w, (lv_coord_t)h);
+    lv_obj_set_style_bg_color(placeholder, lv_color_hex(PLACEHOLDER_COLOR), 0);
+    lv_obj_set_style_bg_opa(placeholder, LV_OPA_COVER, 0);
+    lv_obj_add_event_cb(placeholder, placeholder_delete_cb, LV_EVENT_DELETE, queue);
+
+    if (queue->count == 0) {
+        queue->started_us = trace_now_us();
+        queue->finished = 0;
+    }
+    PendingImage *item = &queue->items[queue->count++];
+    memset(item, 0, sizeof(*item));
+    item->obj = placeholder;
+    item->element = element;
+    item->url = url;
+    item->attr_w = attr_w;
+    item->attr_h = attr_h;
+    item->max_width = limit;
+    lv_timer_resume(queue->timer);
+    trace_count(TRACE_WIDGETS, 1);
+    trace_count(TRACE_IMAGES_DEFERRED, 1);
+    return placeholder;
+}
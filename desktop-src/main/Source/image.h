@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <lexbor/html/html.h>
+#include <lvgl.h>
+
+// How far beyond the visible area (in pixels) images start loading.
+// Overridden by the TACTILE_LAZY_MARGIN environment variable.
+#define IMAGE_LAZY_MARGIN 600
+
+typedef struct {
+    lv_obj_t *obj;              // Placeholder widget
+    lxb_dom_element_t *element; // For the alt text if loading fails
+    char *url;
+    uint32_t attr_w;            // From attributes or CSS, 0 if unknown
+    uint32_t attr_h;
+    uint32_t max_width;
+    struct LoadRequest *request; // Fetch in flight
+    struct DecodeJob *job;      // Decode in flight
+    uint32_t intrinsic_w;       // Known once fetched
+    uint32_t intrinsic_h;
+    uint32_t w;                 // Layout size
+    uint32_t h;
+} PendingImage;
+
+// Images of one page waiting to be fetched; those within the margin are
+// requested, visible ones at a higher priority
+typedef struct {
+    PendingImage *items;
+    size_t count;
+    size_t capacity;
+    lv_obj_t *viewport; // Scrolling content area the distances are measured from
+    lv_timer_t *timer;
+    int32_t margin;
+    uint64_t started_us; // First image queued since the queue was last empty
+    uint32_t finished;   // Images shown or given up on since then
+} ImageQueue;
+
+void image_queue_init(ImageQueue *queue, lv_obj_t *viewport);
+// Forget pending images; call before the page's document is destroyed
+void image_queue_reset(ImageQueue *queue);
+void image_queue_free(ImageQueue *queue);
+
+// Hand the pending images of `from` to the empty queue `to`, e.g. when a page
+// is frozen for the back/forward cache and later restored. Fetches and
+// decodes in flight are cancelled; `to` requests them again once its
+// viewport is visible.
+void image_queue_move(ImageQueue *to, ImageQueue *from);
+
+// Create the widget for an <img> element. Cached images are shown at once;
+// others get a placeholder sized from width/height (attributes or CSS) that
+// is filled in when it comes within the queue's margin of the viewport.
+// Returns NULL if nothing was created.
+lv_obj_t *image_create(ImageQueue *queue, lv_obj_t *parent, lxb_dom_element_t *element,
+                       const char *base_url, lv_coord_t max_width);
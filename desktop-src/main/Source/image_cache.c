@@ -0,0 +1,142 @@
+#include "image_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct CacheEntry {
+    lv_image_dsc_t dsc; // Handed out to widgets
+    ImageBitmap bitmap;
+    char *url;
+    uint32_t width;     // Requested box, part of the key
+    uint32_t height;
+    uint32_t intrinsic_w;
+    uint32_t intrinsic_h;
+    uint32_t refs;
+    struct CacheEntry *prev; // Towards most recently used
+    struct CacheEntry *next; // Towards least recently used
+} CacheEntry;
+
+static CacheEntry *head; // Most recently used
+static CacheEntry *tail;
+static size_t total_bytes;
+static size_t budget = IMAGE_CACHE_DEFAULT_BUDGET;
+
+static void list_unlink(CacheEntry *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void list_push_front(CacheEntry *entry) {
+    entry->prev = NULL;
+    entry->next = head;
+    if (head) head->prev = entry;
+    head = entry;
+    if (!tail) tail = entry;
+}
+
+static void entry_destroy(CacheEntry *entry) {
+    total_bytes -= entry->bitmap.data_size;
+    image_bitmap_free(&entry->bitmap);
+    free(entry->url);
+    free(entry);
+}
+
+// Drop unreferenced entries from the cold end until we fit the budget
+static void evict(void) {
+    CacheEntry *entry = tail;
+    while (entry && total_bytes > budget) {
+        CacheEntry *prev = entry->prev;
+        if (entry->refs == 0) {
+            list_unlink(entry);
+            entry_destroy(entry);
+        }
+        entry = prev;
+    }
+}
+
+static lv_color_format_t color_format(ImagePixelFormat format) {
+    switch (format) {
+        case IMAGE_PIXEL_RGB565A8: return LV_COLOR_FORMAT_RGB565A8;
+        case IMAGE_PIXEL_XRGB8888: return LV_COLOR_FORMAT_XRGB8888;
+        case IMAGE_PIXEL_ARGB8888: return LV_COLOR_FORMAT_ARGB8888;
+        default: return LV_COLOR_FORMAT_RGB565;
+    }
+}
+
+void image_cache_init(size_t budget_bytes) {
+    budget = budget_bytes;
+}
+
+void image_cache_deinit(void) {
+    while (head) {
+        CacheEntry *entry = head;
+        list_unlink(entry);
+        entry_destroy(entry);
+    }
+}
+
+const lv_image_dsc_t *image_cache_acquire(const char *url, uint32_t width, uint32_t height,
+                                          uint32_t *intrinsic_w, uint32_t *intrinsic_h) {
+    for (CacheEntry *entry = head; entry; entry = entry->next) {
+        if (entry->width == width && entry->height == height && strcmp(entry->url, url) == 0) {
+            list_unlink(entry);
+            list_push_front(entry);
+            entry->refs++;
+            *intrinsic_w = entry->intrinsic_w;
+            *intrinsic_h = entry->intrinsic_h;
+            return &entry->dsc;
+        }
+    }
+    return NULL;
+}
+
+const lv_image_dsc_t *image_cache_insert(const char *url, uint32_t width, uint32_t height,
+                                         uint32_t intrinsic_w, uint32_t intrinsic_h,
+                                         ImageBitmap *bitmap) {
+    CacheEntry *entry = calloc(1, sizeof(CacheEntry));
+    char *key = malloc(strlen(url) + 1);
+    if (!entry || !key) {
+        free(entry);
+        free(key);
+        image_bitmap_free(bitmap);
+        return NULL;
+    }
+    strcpy(key, url);
+
+    entry->bitmap = *bitmap;
+    memset(bitmap, 0, sizeof(*bitmap));
+    entry->url = key;
+    entry->width = width;
+    entry->height = height;
+    entry->intrinsic_w = intrinsic_w;
+    entry->intrinsic_h = intrinsic_h;
+    entry->refs = 1;
+
+    entry->dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+    entry->dsc.header.cf = color_format(entry->bitmap.format);
+    entry->dsc.header.w = entry->bitmap.width;
+    entry->dsc.header.h = entry->bitmap.height;
+    entry->dsc.header.stride = entry->bitmap.stride;
+    entry->dsc.data = entry->bitmap.data;
+    entry->dsc.data_size = entry->bitmap.data_size;
+
+    list_push_front(entry);
+    total_bytes += entry->bitmap.data_size;
+    evict();
+    return &entry->dsc;
+}
+
+void image_cache_release(const lv_image_dsc_t *dsc) {
+    if (!dsc) return;
+    // dsc is the first member, so the descriptor address is the entry
+    CacheEntry *entry = (CacheEntry *)dsc;
+    if (entry->refs > 0) entry->refs--;
+    if (entry->refs == 0) evict();
+}
+
+size_t image_cache_bytes(void) {
+    return total_bytes;
+}
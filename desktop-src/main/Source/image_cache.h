@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <lvgl.h>
+
+#include "image_decode.h"
+
+#define IMAGE_CACHE_DEFAULT_BUDGET (8 * 1024 * 1024)
+
+// Decoded images keyed by URL and requested box. Entries in use by a widget
+// are pinned; unused ones are evicted least recently used first once the
+// byte budget is exceeded.
+void image_cache_init(size_t budget_bytes);
+void image_cache_deinit(void);
+
+// Returns a referenced descriptor and the image's intrinsic size, or NULL on
+// a miss. `width`/`height` are the requested box used as the key.
+const lv_image_dsc_t *image_cache_acquire(const char *url, uint32_t width, uint32_t height,
+                                          uint32_t *intrinsic_w, uint32_t *intrinsic_h);
+
+// Takes ownership of `bitmap` (even on failure) and returns a referenced
+// descriptor for it
+const lv_image_dsc_t *image_cache_insert(const char *url, uint32_t width, uint32_t height,
+                                         uint32_t intrinsic_w, uint32_t intrinsic_h,
+                                         ImageBitmap *bitmap);
+
+void image_cache_release(const lv_image_dsc_t *dsc);
+
+size_t image_cache_bytes(void);
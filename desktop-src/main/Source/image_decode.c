@@ -0,0 +1,781 @@
+#include "image_decode.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+#include <zlib.h>
+
+#define MAX_IMAGE_DIMENSION 16384
+#define NO_TARGET UINT32_MAX
+#define INFLATE_CHUNK 8192
+
+// Maps every source row/column to the destination row/column it lands on
+// (nearest sample), or NO_TARGET if it is dropped
+typedef struct {
+    ImageBitmap *bitmap;
+    uint32_t *row_map;
+    uint32_t *col_map;
+} Sampler;
+
+static uint32_t read_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint16_t read_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t min_u32(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+ImageFormat image_sniff(const uint8_t *data, size_t size) {
+    if (size >= 8 && memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) return IMAGE_FORMAT_PNG;
+    if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) return IMAGE_FORMAT_JPEG;
+    if (size >= 6 && (memcmp(data, "GIF87a", 6) == 0 || memcmp(data, "GIF89a", 6) == 0)) return IMAGE_FORMAT_GIF;
+    return IMAGE_FORMAT_UNKNOWN;
+}
+
+bool image_probe(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height) {
+    switch (image_sniff(data, size)) {
+        case IMAGE_FORMAT_PNG:
+            if (size < 24 || memcmp(data + 12, "IHDR", 4) != 0) return false;
+            *width = read_be32(data + 16);
+            *height = read_be32(data + 20);
+            break;
+        case IMAGE_FORMAT_GIF:
+            if (size < 10) return false;
+            *width = read_le16(data + 6);
+            *height = read_le16(data + 8);
+            break;
+        case IMAGE_FORMAT_JPEG: {
+            // Walk the marker segments up to the first start-of-frame
+            size_t pos = 2;
+            bool found = false;
+            while (pos + 9 < size && !found) {
+                if (data[pos] != 0xFF) return false;
+                uint8_t marker = data[pos + 1];
+                if (marker == 0xFF) { pos++; continue; }
+                uint32_t len = ((uint32_t)data[pos + 2] << 8) | data[pos + 3];
+                if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                    *height = ((uint32_t)data[pos + 5] << 8) | data[pos + 6];
+                    *width = ((uint32_t)data[pos + 7] << 8) | data[pos + 8];
+                    found = true;
+                }
+                pos += 2 + len;
+            }
+            if (!found) return false;
+            break;
+        }
+        default:
+            return false;
+    }
+    return *width > 0 && *height > 0 && *width <= MAX_IMAGE_DIMENSION && *height <= MAX_IMAGE_DIMENSION;
+}
+
+static bool bitmap_alloc(ImageBitmap *bitmap, uint32_t width, uint32_t height, int color_depth, bool alpha) {
+    memset(bitmap, 0, sizeof(*bitmap));
+    bitmap->width = width;
+    bitmap->height = height;
+
+    if (color_depth == 32) {
+        bitmap->format = alpha ? IMAGE_PIXEL_ARGB8888 : IMAGE_PIXEL_XRGB8888;
+        bitmap->stride = width * 4;
+        bitmap->data_size = (size_t)bitmap->stride * height;
+    } else {
+        bitmap->format = alpha ? IMAGE_PIXEL_RGB565A8 : IMAGE_PIXEL_RGB565;
+        bitmap->stride = width * 2;
+        bitmap->data_size = (size_t)bitmap->stride * height + (alpha ? (size_t)width * height : 0);
+    }
+
+    // Zeroed so uncovered pixels come out transparent (or black)
+    bitmap->data = calloc(1, bitmap->data_size);
+    return bitmap->data != NULL;
+}
+
+void image_bitmap_free(ImageBitmap *bitmap) {
+    free(bitmap->data);
+    memset(bitmap, 0, sizeof(*bitmap));
+}
+
+static void put_pixel(ImageBitmap *bitmap, uint32_t x, uint32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    uint8_t *row = bitmap->data + (size_t)y * bitmap->stride;
+
+    switch (bitmap->format) {
+        case IMAGE_PIXEL_RGB565A8:
+            bitmap->data[(size_t)bitmap->stride * bitmap->height + (size_t)y * bitmap->width + x] = a;
+            // fall through
+        case IMAGE_PIXEL_RGB565: {
+            uint16_t c = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+            row[x * 2] = (uint8_t)(c & 0xFF);
+            row[x * 2 + 1] = (uint8_t)(c >> 8);
+            break;
+        }
+        case IMAGE_PIXEL_XRGB8888:
+        case IMAGE_PIXEL_ARGB8888:
+            row[x * 4] = b;
+            row[x * 4 + 1] = g;
+            row[x * 4 + 2] = r;
+            row[x * 4 + 3] = bitmap->format == IMAGE_PIXEL_ARGB8888 ? a : 0xFF;
+            break;
+    }
+}
+
+static uint32_t *build_axis_map(uint32_t src, uint32_t dst) {
+    uint32_t *map = malloc(src * sizeof(uint32_t));
+    if (!map) return NULL;
+
+    for (uint32_t i = 0; i < src; i++) map[i] = NO_TARGET;
+    // Sample the centre of each destination cell; with dst <= src every
+    // destination index picks a distinct source index
+    for (uint32_t d = 0; d < dst; d++) {
+        uint32_t s = (uint32_t)(((uint64_t)(2 * d + 1) * src) / (2 * (uint64_t)dst));
+        map[s] = d;
+    }
+    return map;
+}
+
+static bool sampler_init(Sampler *sampler, ImageBitmap *bitmap, uint32_t src_w, uint32_t src_h) {
+    sampler->bitmap = bitmap;
+    sampler->row_map = build_axis_map(src_h, bitmap->height);
+    sampler->col_map = build_axis_map(src_w, bitmap->width);
+    return sampler->row_map && sampler->col_map;
+}
+
+static void sampler_free(Sampler *sampler) {
+    free(sampler->row_map);
+    free(sampler->col_map);
+    sampler->row_map = sampler->col_map = NULL;
+}
+
+static void fit_box(uint32_t src_w, uint32_t src_h, uint32_t box_w, uint32_t box_h,
+                    uint32_t *dst_w, uint32_t *dst_h) {
+    *dst_w = (box_w == 0 || box_w > src_w) ? src_w : box_w;
+    *dst_h = (box_h == 0 || box_h > src_h) ? src_h : box_h;
+}
+
+/**********************
+ *   JPEG (libjpeg)
+ **********************/
+
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} JpegError;
+
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    longjmp(((JpegError *)cinfo->err)->jump, 1);
+}
+
+static void jpeg_quiet(j_common_ptr cinfo, int msg_level) {
+    // Corrupt-data warnings are common on the web and not worth a log line
+}
+
+static bool decode_jpeg(const uint8_t *data, size_t size, uint32_t box_w, uint32_t box_h,
+                        int color_depth, ImageBitmap *out) {
+    struct jpeg_decompress_struct cinfo;
+    JpegError jerr;
+    // Touched after setjmp, so they must survive a longjmp
+    Sampler sampler = {0};
+    uint8_t *volatile row = NULL;
+    volatile bool ok = false;
+
+    memset(out, 0, sizeof(*out));
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpeg_error_exit;
+    jerr.pub.emit_message = jpeg_quiet;
+
+    if (setjmp(jerr.jump)) {
+        goto cleanup;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)data, (unsigned long)size);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) goto cleanup;
+
+    uint32_t dst_w, dst_h;
+    fit_box(cinfo.image_width, cinfo.image_height, box_w, box_h, &dst_w, &dst_h);
+
+    // Let the IDCT do most of the downscaling: pick the smallest 1/N output
+    // that still covers the box
+    unsigned int denom = 1;
+    for (unsigned int d = 8; d > 1; d /= 2) {
+        if ((cinfo.image_width + d - 1) / d >= dst_w && (cinfo.image_height + d - 1) / d >= dst_h) {
+            denom = d;
+            break;
+        }
+    }
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = denom;
+    if (cinfo.jpeg_color_space == JCS_GRAYSCALE) cinfo.out_color_space = JCS_GRAYSCALE;
+    else if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK) cinfo.out_color_space = JCS_CMYK;
+    else cinfo.out_color_space = JCS_RGB;
+
+    jpeg_start_decompress(&cinfo);
+
+    dst_w = min_u32(dst_w, cinfo.output_width);
+    dst_h = min_u32(dst_h, cinfo.output_height);
+    if (!bitmap_alloc(out, dst_w, dst_h, color_depth, false)) goto cleanup;
+    if (!sampler_init(&sampler, out, cinfo.output_width, cinfo.output_height)) goto cleanup;
+
+    row = malloc((size_t)cinfo.output_width * cinfo.output_components);
+    if (!row) goto cleanup;
+
+    int comps = cinfo.output_components;
+    bool adobe_inverted = cinfo.saw_Adobe_marker;
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint32_t sy = cinfo.output_scanline;
+        JSAMPROW rows[1] = {row};
+        jpeg_read_scanlines(&cinfo, rows, 1);
+
+        uint32_t dy = sampler.row_map[sy];
+        if (dy == NO_TARGET) continue;
+
+        for (uint32_t sx = 0; sx < cinfo.output_width; sx++) {
+            uint32_t dx = sampler.col_map[sx];
+            if (dx == NO_TARGET) continue;
+
+            const uint8_t *p = row + (size_t)sx * comps;
+            if (comps == 1) {
+                put_pixel(out, dx, dy, p[0], p[0], p[0], 0xFF);
+            } else if (comps == 4) {
+                // Adobe CMYK JPEGs store inverted values
+                uint32_t c = p[0], m = p[1], y = p[2], k = p[3];
+                if (!adobe_inverted) { c = 255 - c; m = 255 - m; y = 255 - y; k = 255 - k; }
+                put_pixel(out, dx, dy, (uint8_t)(c * k / 255), (uint8_t)(m * k / 255), (uint8_t)(y * k / 255), 0xFF);
+            } else {
+                put_pixel(out, dx, dy, p[0], p[1], p[2], 0xFF);
+            }
+        }
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    ok = true;
+
+cleanup:
+    jpeg_destroy_decompress(&cinfo);
+    free(row);
+    sampler_free(&sampler);
+    if (!ok) image_bitmap_free(out);
+    return ok;
+}
+
+/**********************
+ *   PNG (streaming)
+ **********************/
+
+typedef struct {
+    uint32_t width, height;
+    uint8_t depth, color_type, interlace, channels;
+    uint8_t palette[256][4];
+    bool has_trns;
+    uint16_t trns[3];
+
+    Sampler sampler;
+    uint8_t *cur;  // filter byte followed by the row being filled
+    uint8_t *prev; // previous unfiltered row of the same pass
+    size_t filled;
+    size_t row_bytes;
+    uint32_t bpp;  // Bytes per complete pixel for the filters, at least 1
+    int pass;
+    uint32_t pass_w, pass_h, pass_row;
+    bool done;
+} PngState;
+
+// Adam7 passes: x0, y0, dx, dy. Non-interlaced images use a single 0,0,1,1 pass.
+static const uint8_t adam7[7][4] = {
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2},
+};
+static const uint8_t no_interlace[4] = {0, 0, 1, 1};
+
+static const uint8_t *png_pass(const PngState *st) {
+    return st->interlace ? adam7[st->pass] : no_interlace;
+}
+
+static size_t png_row_bytes(const PngState *st, uint32_t pixels) {
+    return ((size_t)pixels * st->channels * st->depth + 7) / 8;
+}
+
+// Move to the next pass that has pixels; marks the image done after the last
+static void png_start_pass(PngState *st, int pass) {
+    int last = st->interlace ? 7 : 1;
+    for (st->pass = pass; st->pass < last; st->pass++) {
+        const uint8_t *p = png_pass(st);
+        st->pass_w = st->width > p[0] ? (st->width - p[0] + p[2] - 1) / p[2] : 0;
+        st->pass_h = st->height > p[1] ? (st->height - p[1] + p[3] - 1) / p[3] : 0;
+        if (st->pass_w && st->pass_h) break;
+    }
+    if (st->pass >= last) {
+        st->done = true;
+        return;
+    }
+    st->row_bytes = png_row_bytes(st, st->pass_w);
+    st->pass_row = 0;
+    st->filled = 0;
+    memset(st->prev, 0, st->row_bytes + 1);
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+static bool png_unfilter(PngState *st) {
+    uint8_t *x = st->cur + 1;
+    const uint8_t *b = st->prev + 1;
+    size_t len = st->row_bytes, bpp = st->bpp;
+
+    switch (st->cur[0]) {
+        case 0:
+            break;
+        case 1:
+            for (size_t i = bpp; i < len; i++) x[i] += x[i - bpp];
+            break;
+        case 2:
+            for (size_t i = 0; i < len; i++) x[i] += b[i];
+            break;
+        case 3:
+            for (size_t i = 0; i < len; i++) x[i] += (uint8_t)(((i >= bpp ? x[i - bpp] : 0) + b[i]) / 2);
+            break;
+        case 4:
+            for (size_t i = 0; i < len; i++) {
+                x[i] += paeth(i >= bpp ? x[i - bpp] : 0, b[i], i >= bpp ? b[i - bpp] : 0);
+            }
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+static void png_pixel(const PngState *st, const uint8_t *row, uint32_t i, uint8_t rgba[4]) {
+    uint16_t v[4] = {0, 0, 0, 0}; // Raw samples at the source bit depth
+    uint8_t c[4];                 // Samples scaled to 8 bits
+
+    if (st->depth < 8) {
+        size_t bit = (size_t)i * st->depth;
+        uint8_t max = (uint8_t)((1 << st->depth) - 1);
+        v[0] = (row[bit / 8] >> (8 - st->depth - bit % 8)) & max;
+        c[0] = st->color_type == 3 ? (uint8_t)v[0] : (uint8_t)(v[0] * 255 / max);
+    } else if (st->depth == 8) {
+        for (int k = 0; k < st->channels; k++) c[k] = v[k] = row[(size_t)i * st->channels + k];
+    } else {
+        for (int k = 0; k < st->channels; k++) {
+            const uint8_t *p = row + ((size_t)i * st->channels + k) * 2;
+            v[k] = (uint16_t)((p[0] << 8) | p[1]);
+            c[k] = p[0];
+        }
+    }
+
+    switch (st->color_type) {
+        case 0: // Grayscale
+            rgba[0] = rgba[1] = rgba[2] = c[0];
+            rgba[3] = (st->has_trns && v[0] == st->trns[0]) ? 0 : 0xFF;
+            break;
+        case 2: // RGB
+            rgba[0] = c[0]; rgba[1] = c[1]; rgba[2] = c[2];
+            rgba[3] = (st->has_trns && v[0] == st->trns[0] && v[1] == st->trns[1] && v[2] == st->trns[2]) ? 0 : 0xFF;
+            break;
+        case 3: // Palette
+            memcpy(rgba, st->palette[c[0]], 4);
+            break;
+        case 4: // Grayscale + alpha
+            rgba[0] = rgba[1] = rgba[2] = c[0];
+            rgba[3] = c[1];
+            break;
+        default: // RGBA
+            memcpy(rgba, c, 4);
+            break;
+    }
+}
+
+static void png_emit_row(PngState *st) {
+    const uint8_t *p = png_pass(st);
+    uint32_t y = p[1] + st->pass_row * p[3];
+    uint32_t dy = st->sampler.row_map[y];
+    if (dy == NO_TARGET) return;
+
+    const uint8_t *row = st->cur + 1;
+    for (uint32_t i = 0; i < st->pass_w; i++) {
+        uint32_t dx = st->sampler.col_map[p[0] + i * p[2]];
+        if (dx == NO_TARGET) continue;
+
+        uint8_t rgba[4];
+        png_pixel(st, row, i, rgba);
+        put_pixel(st->sampler.bitmap, dx, dy, rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+}
+
+// Feed inflated scanline bytes; every source row is unfiltered (the next row
+// depends on it) but only rows that land in the output are converted
+static bool png_consume(PngState *st, const uint8_t *data, size_t len) {
+    while (len > 0 && !st->done) {
+        size_t take = st->row_bytes + 1 - st->filled;
+        if (take > len) take = len;
+        memcpy(st->cur + st->filled, data, take);
+        st->filled += take;
+        data += take;
+        len -= take;
+
+        if (st->filled < st->row_bytes + 1) break;
+        if (!png_unfilter(st)) return false;
+        png_emit_row(st);
+
+        uint8_t *tmp = st->prev;
+        st->prev = st->cur;
+        st->cur = tmp;
+        st->filled = 0;
+        if (++st->pass_row == st->pass_h) png_start_pass(st, st->pass + 1);
+    }
+    return true;
+}
+
+static bool decode_png(const uint8_t *data, size_t size, uint32_t box_w, uint32_t box_h,
+                       int color_depth, ImageBitmap *out) {
+    PngState st;
+    z_stream zs;
+    bool zs_ready = false, ok = false, saw_ihdr = false;
+    uint8_t *inflated = NULL;
+
+    memset(&st, 0, sizeof(st));
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < 256; i++) st.palette[i][3] = 0xFF;
+
+    size_t pos = 8;
+    while (pos + 12 <= size && !st.done) {
+        uint32_t len = read_be32(data + pos);
+        const uint8_t *type = data + pos + 4;
+        const uint8_t *body = data + pos + 8;
+        if (len > size - pos - 12) break; // Truncated chunk
+        pos += 12 + (size_t)len;
+
+        if (memcmp(type, "IHDR", 4) == 0 && len >= 13) {
+            st.width = read_be32(body);
+            st.height = read_be32(body + 4);
+            st.depth = body[8];
+            st.color_type = body[9];
+            st.interlace = body[12];
+            static const uint8_t channels[7] = {1, 0, 3, 1, 2, 0, 4};
+            if (st.color_type > 6 || !channels[st.color_type]) goto cleanup;
+            if (st.depth != 1 && st.depth != 2 && st.depth != 4 && st.depth != 8 && st.depth != 16) goto cleanup;
+            if (st.depth < 8 && st.color_type != 0 && st.color_type != 3) goto cleanup;
+            if (st.width == 0 || st.height == 0 || st.width > MAX_IMAGE_DIMENSION || st.height > MAX_IMAGE_DIMENSION) goto cleanup;
+            st.channels = channels[st.color_type];
+            st.bpp = (uint32_t)(st.channels * st.depth + 7) / 8;
+            saw_ihdr = true;
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            for (uint32_t i = 0; i < len / 3 && i < 256; i++) {
+                memcpy(st.palette[i], body + i * 3, 3);
+            }
+        } else if (memcmp(type, "tRNS", 4) == 0) {
+            st.has_trns = true;
+            if (st.color_type == 3) {
+                for (uint32_t i = 0; i < len && i < 256; i++) st.palette[i][3] = body[i];
+            } else if (st.color_type == 0 && len >= 2) {
+                st.trns[0] = (uint16_t)((body[0] << 8) | body[1]);
+            } else if (st.color_type == 2 && len >= 6) {
+                for (int k = 0; k < 3; k++) st.trns[k] = (uint16_t)((body[k * 2] << 8) | body[k * 2 + 1]);
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            if (!saw_ihdr) goto cleanup;
+
+            if (!zs_ready) {
+                // First IDAT: everything that affects the output format is known
+                uint32_t dst_w, dst_h;
+                fit_box(st.width, st.height, box_w, box_h, &dst_w, &dst_h);
+                bool alpha = st.has_trns || st.color_type == 4 || st.color_type == 6;
+                if (!bitmap_alloc(out, dst_w, dst_h, color_depth, alpha)) goto cleanup;
+                if (!sampler_init(&st.sampler, out, st.width, st.height)) goto cleanup;
+
+                size_t max_row = png_row_bytes(&st, st.width) + 1;
+                st.cur = malloc(max_row);
+                st.prev = malloc(max_row);
+                inflated = malloc(INFLATE_CHUNK);
+                if (!st.cur || !st.prev || !inflated) goto cleanup;
+                png_start_pass(&st, 0);
+
+                memset(&zs, 0, sizeof(zs));
+                if (inflateInit(&zs) != Z_OK) goto cleanup;
+                zs_ready = true;
+            }
+
+            zs.next_in = (Bytef *)body;
+            zs.avail_in = len;
+            while (zs.avail_in > 0 && !st.done) {
+                zs.next_out = inflated;
+                zs.avail_out = INFLATE_CHUNK;
+                int ret = inflate(&zs, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) goto cleanup;
+                if (!png_consume(&st, inflated, INFLATE_CHUNK - zs.avail_out)) goto cleanup;
+                if (ret == Z_STREAM_END || (ret == Z_BUF_ERROR && zs.avail_out == INFLATE_CHUNK)) break;
+            }
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+    }
+
+    // Drain output zlib may still be holding after the last IDAT
+    while (zs_ready && !st.done) {
+        zs.next_out = inflated;
+        zs.avail_out = INFLATE_CHUNK;
+        int ret = inflate(&zs, Z_SYNC_FLUSH);
+        size_t produced = INFLATE_CHUNK - zs.avail_out;
+        if (!png_consume(&st, inflated, produced)) goto cleanup;
+        if (ret != Z_OK || produced == 0) break;
+    }
+
+    // Truncated images keep whatever rows arrived, like other browsers
+    ok = zs_ready && (st.done || st.pass > 0 || st.pass_row > 0);
+
+cleanup:
+    if (zs_ready) inflateEnd(&zs);
+    free(inflated);
+    free(st.cur);
+    free(st.prev);
+    sampler_free(&st.sampler);
+    if (!ok) image_bitmap_free(out);
+    return ok;
+}
+
+/**********************
+ *   GIF (first frame)
+ **********************/
+
+#define GIF_MAX_CODES 4096
+
+// LZW dictionary and output stack, one per decode: workers decode GIFs in
+// parallel, so nothing here may be shared
+typedef struct {
+    uint16_t prefix[GIF_MAX_CODES];
+    uint8_t suffix[GIF_MAX_CODES];
+    uint8_t stack[GIF_MAX_CODES + 1];
+} GifTables;
+
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+    size_t block_left; // Bytes left in the current data sub-block
+    uint32_t bits;
+    int bit_count;
+} GifBits;
+
+static int gif_read_code(GifBits *r, int code_size) {
+    while (r->bit_count < code_size) {
+        if (r->block_left == 0) {
+            if (r->pos >= r->end || *r->pos == 0) return -1;
+            r->block_left = *r->pos++;
+        }
+        if (r->pos >= r->end) return -1;
+        r->bits |= (uint32_t)*r->pos++ << r->bit_count;
+        r->bit_count += 8;
+        r->block_left--;
+    }
+    int code = (int)(r->bits & ((1u << code_size) - 1));
+    r->bits >>= code_size;
+    r->bit_count -= code_size;
+    return code;
+}
+
+static const uint8_t *gif_skip_blocks(const uint8_t *p, const uint8_t *end) {
+    while (p < end && *p) p += 1 + *p;
+    return p < end ? p + 1 : end;
+}
+
+typedef struct {
+    Sampler *sampler;
+    const uint8_t *palette;
+    int palette_size;
+    int transparent; // Palette index, -1 for none
+    uint32_t left, top, width, height, screen_w, screen_h;
+    bool interlace;
+    uint32_t x, row, pass;
+    uint32_t y; // Frame row the current pixels belong to
+} GifFrame;
+
+// Advance to the next frame row, following the interlaced row order
+static void gif_next_row(GifFrame *f) {
+    static const uint8_t start[4] = {0, 4, 2, 1};
+    static const uint8_t step[4] = {8, 8, 4, 2};
+
+    f->x = 0;
+    f->row++;
+    if (!f->interlace) {
+        f->y = f->row;
+        return;
+    }
+    f->y += step[f->pass];
+    while (f->y >= f->height && f->pass < 3) {
+        f->pass++;
+        f->y = start[f->pass];
+    }
+}
+
+static void gif_put(GifFrame *f, uint8_t index) {
+    if (f->row >= f->height) return;
+
+    uint32_t sx = f->left + f->x, sy = f->top + f->y;
+    if (sx < f->screen_w && sy < f->screen_h) {
+        uint32_t dy = f->sampler->row_map[sy];
+        uint32_t dx = f->sampler->col_map[sx];
+        if (dy != NO_TARGET && dx != NO_TARGET && index < f->palette_size) {
+            const uint8_t *c = f->palette + index * 3;
+            put_pixel(f->sampler->bitmap, dx, dy, c[0], c[1], c[2], index == f->transparent ? 0 : 0xFF);
+        }
+    }
+    if (++f->x == f->width) gif_next_row(f);
+}
+
+static bool gif_decode_lzw(GifFrame *f, GifBits *bits, int min_code_size, GifTables *tables) {
+    uint16_t *prefix = tables->prefix;
+    uint8_t *suffix = tables->suffix;
+    uint8_t *stack = tables->stack;
+
+    if (min_code_size < 2 || min_code_size > 8) return false;
+    int clear = 1 << min_code_size, eoi = clear + 1;
+    int code_size = min_code_size + 1, next = clear + 2;
+    int old = -1;
+    uint8_t first = 0;
+
+    for (int i = 0; i < clear; i++) {
+        prefix[i] = 0;
+        suffix[i] = (uint8_t)i;
+    }
+
+    for (;;) {
+        if (f->row >= f->height) return true;
+        int code = gif_read_code(bits, code_size);
+        if (code < 0 || code == eoi) return true;
+
+        if (code == clear) {
+            code_size = min_code_size + 1;
+            next = clear + 2;
+            old = -1;
+            continue;
+        }
+        if (old < 0) {
+            if (code >= clear) return false;
+            first = (uint8_t)code;
+            gif_put(f, first);
+            old = code;
+            continue;
+        }
+
+        int in = code, sp = 0;
+        if (code > next) return false;
+        if (code == next) {
+            stack[sp++] = first;
+            code = old;
+        }
+        while (code >= clear) {
+            if (sp >= GIF_MAX_CODES) return false;
+            stack[sp++] = suffix[code];
+            code = prefix[code];
+        }
+        first = (uint8_t)code;
+        stack[sp++] = first;
+        while (sp > 0) gif_put(f, stack[--sp]);
+
+        if (next < GIF_MAX_CODES) {
+            prefix[next] = (uint16_t)old;
+            suffix[next] = first;
+            next++;
+            if (next == (1 << code_size) && code_size < 12) code_size++;
+        }
+        old = in;
+    }
+}
+
+static bool decode_gif(const uint8_t *data, size_t size, uint32_t box_w, uint32_t box_h,
+                       int color_depth, ImageBitmap *out) {
+    const uint8_t *p = data + 13, *end = data + size;
+    Sampler sampler = {0};
+    bool ok = false;
+
+    memset(out, 0, sizeof(*out));
+    if (size < 13) return false;
+
+    uint32_t screen_w = read_le16(data + 6), screen_h = read_le16(data + 8);
+    uint8_t flags = data[10];
+    const uint8_t *global_palette = NULL;
+    int global_size = 0;
+    if (flags & 0x80) {
+        global_size = 1 << ((flags & 7) + 1);
+        global_palette = p;
+        p += global_size * 3;
+    }
+
+    int transparent = -1;
+    while (p < end) {
+        uint8_t block = *p++;
+        if (block == 0x21 && p < end) {
+            // Extension; only the graphic control block matters for frame one
+            uint8_t label = *p++;
+            if (label == 0xF9 && p + 5 <= end && p[0] == 4) {
+                transparent = (p[1] & 1) ? p[4] : -1;
+            }
+            p = gif_skip_blocks(p, end);
+        } else if (block == 0x2C && p + 9 <= end) {
+            GifFrame f;
+            memset(&f, 0, sizeof(f));
+            f.left = read_le16(p);
+            f.top = read_le16(p + 2);
+            f.width = read_le16(p + 4);
+            f.height = read_le16(p + 6);
+            uint8_t frame_flags = p[8];
+            p += 9;
+
+            f.palette = global_palette;
+            f.palette_size = global_size;
+            if (frame_flags & 0x80) {
+                f.palette_size = 1 << ((frame_flags & 7) + 1);
+                f.palette = p;
+                p += f.palette_size * 3;
+            }
+            if (!f.palette || p >= end || screen_w == 0 || screen_h == 0 ||
+                screen_w > MAX_IMAGE_DIMENSION || screen_h > MAX_IMAGE_DIMENSION) {
+                break;
+            }
+
+            bool covers = f.left == 0 && f.top == 0 && f.width >= screen_w && f.height >= screen_h;
+            uint32_t dst_w, dst_h;
+            fit_box(screen_w, screen_h, box_w, box_h, &dst_w, &dst_h);
+            if (!bitmap_alloc(out, dst_w, dst_h, color_depth, transparent >= 0 || !covers)) break;
+            if (!sampler_init(&sampler, out, screen_w, screen_h)) break;
+
+            f.sampler = &sampler;
+            f.transparent = transparent;
+            f.screen_w = screen_w;
+            f.screen_h = screen_h;
+            f.interlace = (frame_flags & 0x40) != 0;
+
+            int min_code_size = *p++;
+            GifBits bits = {p, end, 0, 0, 0};
+            GifTables *tables = malloc(sizeof(GifTables));
+            ok = tables && f.width > 0 && f.height > 0 && gif_decode_lzw(&f, &bits, min_code_size, tables);
+            free(tables);
+            break;
+        } else {
+            break; // Trailer or garbage
+        }
+    }
+
+    sampler_free(&sampler);
+    if (!ok) image_bitmap_free(out);
+    return ok;
+}
+
+bool image_decode(const uint8_t *data, size_t size, uint32_t box_w, uint32_t box_h,
+                  int color_depth, ImageBitmap *out) {
+    switch (image_sniff(data, size)) {
+        case IMAGE_FORMAT_PNG: return decode_png(data, size, box_w, box_h, color_depth, out);
+        case IMAGE_FORMAT_JPEG: return decode_jpeg(data, size, box_w, box_h, color_depth, out);
+        case IMAGE_FORMAT_GIF: return decode_gif(data, size, box_w, box_h, color_depth, out);
+        default:
+            memset(out, 0, sizeof(*out));
+            return false;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    IMAGE_FORMAT_UNKNOWN,
+    IMAGE_FORMAT_PNG,
+    IMAGE_FORMAT_JPEG,
+    IMAGE_FORMAT_GIF,
+} ImageFormat;
+
+// Pixel layouts matching LVGL's native formats for 16 and 32 bit displays
+typedef enum {
+    IMAGE_PIXEL_RGB565,   // 2 bytes per pixel
+    IMAGE_PIXEL_RGB565A8, // RGB565 plane followed by an A8 plane
+    IMAGE_PIXEL_XRGB8888, // B, G, R, X in memory
+    IMAGE_PIXEL_ARGB8888, // B, G, R, A in memory
+} ImagePixelFormat;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride; // Bytes per row of the colour plane
+    ImagePixelFormat format;
+    uint8_t *data;   // malloc'd
+    size_t data_size;
+} ImageBitmap;
+
+ImageFormat image_sniff(const uint8_t *data, size_t size);
+
+// Read the intrinsic size from the header without decoding pixels
+bool image_probe(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height);
+
+// Decode straight to at most `box_w` x `box_h` pixels (never larger than the
+// intrinsic size). JPEG uses DCT scaling, PNG and GIF drop source rows and
+// columns as they stream out of the decompressor, so a full-resolution copy
+// of the image is never held. `color_depth` is LV_COLOR_DEPTH (16 or 32).
+bool image_decode(const uint8_t *data, size_t size, uint32_t box_w, uint32_t box_h,
+                  int color_depth, ImageBitmap *out);
+
+void image_bitmap_free(ImageBitmap *bitmap);
@@ -0,0 +1,356 @@
+#include "loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+#include "url.h"
+
+typedef struct {
+    LoadRequest *head;
+    LoadRequest *tail;
+} RequestList;
+
+static CURLM *multi;
+static RequestList queued[LOAD_PRIORITY_COUNT];
+static RequestList active;
+// Finished outside the multi handle (could not start, or adopted after it
+// was preloaded) and waiting for the next delivery, plus completed preloads
+// parked until a page asks for them
+static RequestList ready;
+static int active_count;
+static size_t parked_bytes;
+static bool in_perform; // Inside curl_multi_perform(), so inside a transfer callback
+
+static void list_append(RequestList *list, LoadRequest *request) {
+    request->prev = list->tail;
+    request->next = NULL;
+    if (list->tail) list->tail->next = request;
+    else list->head = request;
+    list->tail = request;
+}
+
+static void list_unlink(RequestList *list, LoadRequest *request) {
+    if (request->prev) request->prev->next = request->next;
+    else list->head = request->next;
+    if (request->next) request->next->prev = request->prev;
+    else list->tail = request->prev;
+    request->prev = request->next = NULL;
+}
+
+static void request_free(LoadRequest *request) {
+    free(request->url);
+    free(request->body.data);
+    free(request);
+}
+
+// Take a running transfer out of the multi handle
+static void request_stop(LoadRequest *request) {
+    list_unlink(&active, request);
+    active_count--;
+    curl_multi_remove_handle(multi, request->easy);
+    curl_easy_cleanup(request->easy);
+    request->easy = NULL;
+}
+
+static int origin_active(const char *origin) {
+    int count = 0;
+    for (LoadRequest *r = active.head; r; r = r->next) {
+        if (strcmp(r->origin, origin) == 0) count++;
+    }
+    return count;
+}
+
+// Tracks bytes received and aborts transfers cancelled from a callback,
+// where the handle cannot be removed from the multi handle directly
+static int xferinfo_callback(void *userp, curl_off_t dltotal, curl_off_t dlnow,
+                             curl_off_t ultotal, curl_off_t ulnow) {
+    LoadRequest *request = (LoadRequest *)userp;
+    request->received = (uint64_t)dlnow;
+    return request->cancelled ? 1 : 0;
+}
+
+static bool request_start(LoadRequest *request) {
+    request->easy = curl_easy_init();
+    if (!request->easy) return false;
+
+    http_configure(request->easy, request->url, &request->body);
+    curl_easy_setopt(request->easy, CURLOPT_PRIVATE, request);
+    // Prefer HTTP/2 over TLS and wait for an existing connection to the
+    // origin so requests share it instead of opening new ones
+    curl_easy_setopt(request->easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(request->easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(request->easy, CURLOPT_XFERINFOFUNCTION, xferinfo_callback);
+    curl_easy_setopt(request->easy, CURLOPT_XFERINFODATA, request);
+    curl_easy_setopt(request->easy, CURLOPT_NOPROGRESS, 0L);
+
+    if (curl_multi_add_handle(multi, request->easy) != CURLM_OK) {
+        curl_easy_cleanup(request->easy);
+        request->easy = NULL;
+        return false;
+    }
+    request->start_us = trace_now_us();
+    list_append(&active, request);
+    active_count++;
+    return true;
+}
+
+// Start queued requests, highest priority first. A request whose origin is
+// at its limit is skipped so it does not hold up other origins.
+static void start_queued(void) {
+    for (int p = 0; p < LOAD_PRIORITY_COUNT && active_count < LOADER_MAX_ACTIVE; p++) {
+        LoadRequest *request = queued[p].head;
+        while (request && active_count < LOADER_MAX_ACTIVE) {
+            LoadRequest *next = request->next;
+            if (origin_active(request->origin) < LOADER_MAX_PER_ORIGIN) {
+                list_unlink(&queued[p], request);
+                if (!request_start(request)) {
+                    fprintf(stderr, "Failed to start request: %s\n", request->url);
+                    request->on_ready = true;
+                    list_append(&ready, request);
+                }
+            }
+            request = next;
+        }
+    }
+}
+
+// Keep a finished preload until something requests it, dropping the oldest
+// parked ones beyond the budget
+static void park_preload(LoadRequest *request) {
+    request->on_ready = true;
+    list_append(&ready, request);
+    parked_bytes += request->body.size;
+
+    LoadRequest *oldest = ready.head;
+    while (oldest && parked_bytes > LOADER_PRELOAD_BUDGET) {
+        LoadRequest *next = oldest->next;
+        if (oldest->preload && oldest != request) {
+            parked_bytes -= oldest->body.size;
+            trace_count(TRACE_WASTED_BYTES, (uint32_t)oldest->received);
+            list_unlink(&ready, oldest);
+            request_free(oldest);
+        }
+        oldest = next;
+    }
+}
+
+static void deliver(LoadRequest *request, int *delivered) {
+    if (request->done) {
+        request->done(request, request->user_data);
+        (*delivered)++;
+    }
+    request_free(request);
+}
+
+static void deliver_finished(int *delivered) {
+    // Rescan from the head each time: a callback may cancel other requests
+    LoadRequest *request;
+    for (;;) {
+        for (request = ready.head; request && request->preload; request = request->next) {}
+        if (!request) break;
+        list_unlink(&ready, request);
+        deliver(request, delivered);
+    }
+
+    CURLMsg *msg;
+    int left;
+    while ((msg = curl_multi_info_read(multi, &left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+
+        request = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&request);
+        if (!request) continue;
+
+        if (request->cancelled) {
+            request_stop(request);
+            request_free(request);
+            continue;
+        }
+
+        CURLcode result = msg->data.result;
+        curl_easy_getinfo(request->easy, CURLINFO_RESPONSE_CODE, &request->status);
+        request->complete = result == CURLE_OK;
+        request->ok = result == CURLE_OK && (request->status == 0 ||
+                                             (request->status >= 200 && request->status < 300));
+        if (result != CURLE_OK) {
+            fprintf(stderr, "Request failed: %s: %s\n", request->url, curl_easy_strerror(result));
+        }
+        request->elapsed_us = trace_now_us() - request->start_us;
+        request_stop(request);
+        if (request->preload) park_preload(request);
+        else deliver(request, delivered);
+    }
+}
+
+bool loader_init(void) {
+    if (multi) return true;
+
+    multi = curl_multi_init();
+    if (!multi) {
+        fprintf(stderr, "curl_multi_init failed\n");
+        return false;
+    }
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)LOADER_MAX_PER_ORIGIN);
+    return true;
+}
+
+void loader_shutdown(void) {
+    if (!multi) return;
+
+    while (active.head) {
+        LoadRequest *request = active.head;
+        request_stop(request);
+        request_free(request);
+    }
+    RequestList *lists[LOAD_PRIORITY_COUNT + 1];
+    for (int p = 0; p < LOAD_PRIORITY_COUNT; p++) lists[p] = &queued[p];
+    lists[LOAD_PRIORITY_COUNT] = &ready;
+    for (int i = 0; i <= LOAD_PRIORITY_COUNT; i++) {
+        while (lists[i]->head) {
+            LoadRequest *request = lists[i]->head;
+            list_unlink(lists[i], request);
+            request_free(request);
+        }
+    }
+    curl_multi_cleanup(multi);
+    multi = NULL;
+    parked_bytes = 0;
+}
+
+// A preload of `url` that nobody has claimed yet, queued, running or parked.
+// One cancelled inside a transfer callback is still listed until curl lets
+// go of it, and is then freed without a callback, so it cannot be claimed.
+static LoadRequest *find_preload(const char *url) {
+    for (LoadRequest *r = active.head; r; r = r->next) {
+        if (r->preload && !r->cancelled && strcmp(r->url, url) == 0) return r;
+    }
+    for (LoadRequest *r = ready.head; r; r = r->next) {
+        if (r->preload && !r->cancelled && strcmp(r->url, url) == 0) return r;
+    }
+    for (int p = 0; p < LOAD_PRIORITY_COUNT; p++) {
+        for (LoadRequest *r = queued[p].head; r; r = r->next) {
+            if (r->preload && !r->cancelled && strcmp(r->url, url) == 0) return r;
+        }
+    }
+    return NULL;
+}
+
+static LoadRequest *request_create(const char *url, LoadPriority priority, const void *owner) {
+    LoadRequest *request = calloc(1, sizeof(LoadRequest));
+    if (!request) return NULL;
+    request->url = malloc(strlen(url) + 1);
+    if (!request->url) {
+        free(request);
+        return NULL;
+    }
+    strcpy(request->url, url);
+
+    // URLs without an authority share one bucket
+    if (!url_origin(url, request->origin, sizeof(request->origin))) request->origin[0] = 0;
+    request->priority = priority;
+    request->owner = owner;
+    list_append(&queued[priority], request);
+    return request;
+}
+
+LoadRequest *loader_request(const char *url, LoadPriority priority, const void *owner,
+                            LoadDoneCb done, void *user_data) {
+    if (!multi) return NULL;
+
+    LoadRequest *request = find_preload(url);
+    if (request) {
+        // Claim the speculative fetch; a parked one is delivered on the next pump
+        trace_count(TRACE_PRELOAD_HITS, 1);
+        request->preload = false;
+        if (request->on_ready) parked_bytes -= request->body.size;
+        loader_set_priority(request, priority);
+    } else {
+        request = request_create(url, priority, owner);
+        if (!request) return NULL;
+    }
+
+    request->owner = owner;
+    request->done = done;
+    request->user_data = user_data;
+    return request;
+}
+
+bool loader_preload(const char *url, LoadPriority priority, const void *owner) {
+    if (!multi) return false;
+    if (find_preload(url)) return true;
+
+    LoadRequest *request = request_create(url, priority, owner);
+    if (!request) return false;
+    request->preload = true;
+    trace_count(TRACE_PRELOADS, 1);
+    return true;
+}
+
+void loader_set_priority(LoadRequest *request, LoadPriority priority) {
+    if (request->easy || request->on_ready || request->priority == priority) return;
+    list_unlink(&queued[request->priority], request);
+    request->priority = priority;
+    list_append(&queued[priority], request);
+}
+
+void loader_stream(LoadRequest *request, HttpChunkCb on_chunk, void *ctx) {
+    request->body.on_chunk = on_chunk;
+    request->body.chunk_ctx = ctx;
+}
+
+void loader_cancel(LoadRequest *request) {
+    if (!request || request->cancelled) return;
+    trace_count(TRACE_WASTED_BYTES, (uint32_t)request->received);
+    if (request->easy && in_perform) {
+        request->cancelled = true;
+        request->done = NULL;
+        request->body.on_chunk = NULL;
+        return;
+    }
+    if (request->easy) {
+        request_stop(request);
+    } else if (request->on_ready) {
+        if (request->preload) parked_bytes -= request->body.size;
+        list_unlink(&ready, request);
+    } else list_unlink(&queued[request->priority], request);
+    request_free(request);
+}
+
+void loader_cancel_owner(const void *owner) {
+    LoadRequest *request = active.head;
+    while (request) {
+        LoadRequest *next = request->next;
+        if (request->owner == owner) loader_cancel(request);
+        request = next;
+    }
+    for (int p = 0; p <= LOAD_PRIORITY_COUNT; p++) {
+        request = p < LOAD_PRIORITY_COUNT ? queued[p].head : ready.head;
+        while (request) {
+            LoadRequest *next = request->next;
+            if (request->owner == owner) loader_cancel(request);
+            request = next;
+        }
+    }
+}
+
+void loader_kick(void) {
+    if (!multi || in_perform) return;
+
+    int running = 0;
+    start_queued();
+    in_perform = true;
+    curl_multi_perform(multi, &running);
+    in_perform = false;
+}
+
+int loader_pump(void) {
+    if (!multi) return 0;
+
+    int delivered = 0;
+    loader_kick();
+    deliver_finished(&delivered);
+    return delivered;
+}
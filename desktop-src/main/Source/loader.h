@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "http.h"
+
+#define LOADER_MAX_ACTIVE 16    // Transfers in flight across all origins
+#define LOADER_MAX_PER_ORIGIN 6 // Transfers in flight to one scheme://host:port
+#define LOADER_ORIGIN_LENGTH 256
+#define LOADER_PRELOAD_BUDGET (8 * 1024 * 1024) // Finished preloads nobody claimed yet
+
+// Lower values start first
+typedef enum {
+    LOAD_PRIORITY_DOCUMENT,        // The page being navigated to
+    LOAD_PRIORITY_CSS,             // Render-blocking stylesheets
+    LOAD_PRIORITY_VISIBLE_IMAGE,
+    LOAD_PRIORITY_SCRIPT,
+    LOAD_PRIORITY_OFFSCREEN_IMAGE,
+    LOAD_PRIORITY_COUNT
+} LoadPriority;
+
+typedef struct LoadRequest LoadRequest;
+
+// Runs on the main thread from loader_pump(). The callback may take
+// `request->body.data` (set it to NULL); the request is freed afterwards.
+typedef void (*LoadDoneCb)(LoadRequest *request, void *user_data);
+
+struct LoadRequest {
+    char *url;
+    char origin[LOADER_ORIGIN_LENGTH];
+    LoadPriority priority;
+    const void *owner; // Requests sharing an owner are cancelled together
+
+    // Result, valid in the callback
+    bool ok;           // Transfer succeeded with a 2xx (or non-HTTP) status
+    bool complete;     // Transfer finished, whatever the status
+    long status;
+    MemoryBuffer body;
+    uint64_t elapsed_us; // From start of transfer, excluding time queued
+
+    CURL *easy;        // NULL while queued
+    uint64_t received; // Bytes off the wire so far
+    bool cancelled;    // Aborted from inside a transfer callback, freed when curl lets go
+    bool preload;      // Speculative, not claimed by loader_request() yet
+    bool on_ready;     // Finished, waiting on the ready list
+    uint64_t start_us;
+    LoadDoneCb done;
+    void *user_data;
+    LoadRequest *prev;
+    LoadRequest *next;
+};
+
+bool loader_init(void);
+void loader_shutdown(void);
+
+// Queue a fetch. A matching preload is taken over instead of fetching again.
+// Returns NULL if the request could not be created.
+LoadRequest *loader_request(const char *url, LoadPriority priority, const void *owner,
+                            LoadDoneCb done, void *user_data);
+
+// Start a speculative fetch with no consumer yet. The response is parked
+// (within LOADER_PRELOAD_BUDGET) for a later loader_request() of the same
+// URL; `owner` lets a navigation drop unclaimed preloads.
+bool loader_preload(const char *url, LoadPriority priority, const void *owner);
+
+// Reorder a request that has not started yet
+void loader_set_priority(LoadRequest *request, LoadPriority priority);
+
+// Hand body chunks to `on_chunk` as they arrive instead of collecting them
+// in `body`. Call before the next loader_pump().
+void loader_stream(LoadRequest *request, HttpChunkCb on_chunk, void *ctx);
+
+// Drop a queued or running request; its callback will not run. Bytes it had
+// already received count as wasted. Safe to call from inside a transfer
+// callback: the transfer is then aborted from its progress callback.
+void loader_cancel(LoadRequest *request);
+void loader_cancel_owner(const void *owner);
+
+// Start queued requests and move transfers along without delivering
+// anything. Does nothing from inside a transfer callback; the next
+// loader_pump() picks the new requests up instead.
+void loader_kick(void);
+
+// Drive transfers, start queued requests in priority order within the
+// connection limits and deliver finished ones. Call from the main loop.
+// Returns the number of callbacks run.
+int loader_pump(void);
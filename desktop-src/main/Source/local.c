@@ -0,0 +1,128 @@
+#include "local.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decode %XX escapes of `len` bytes into `out` (at least `len` + 1 bytes).
+// Returns the decoded length.
+static size_t percent_decode(const char *in, size_t len, char *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        int hi, lo;
+        if (in[i] == '%' && i + 2 < len && (hi = hex_value(in[i + 1])) >= 0 && (lo = hex_value(in[i + 2])) >= 0) {
+            out[n++] = (char)(hi << 4 | lo);
+            i += 2;
+        } else {
+            out[n++] = in[i];
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+}
+
+// Whitespace and padding are skipped; anything else invalid fails
+static bool base64_decode(const char *in, size_t len, char *out, size_t *out_len) {
+    uint32_t bits = 0;
+    int bit_count = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == '=' || isspace((unsigned char)in[i])) continue;
+        int v = base64_value(in[i]);
+        if (v < 0) return false;
+        bits = bits << 6 | (uint32_t)v;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            out[n++] = (char)(bits >> bit_count & 0xFF);
+        }
+    }
+    out[n] = '\0';
+    *out_len = n;
+    return true;
+}
+
+bool local_url_is_local(const char *url) {
+    return strncmp(url, "file://", 7) == 0 || strncmp(url, "data:", 5) == 0;
+}
+
+// data:[<mediatype>][;base64],<data>
+static bool open_data(LocalSource *source, const char *url) {
+    const char *comma = strchr(url + 5, ',');
+    if (!comma) return false;
+    const char *payload = comma + 1;
+    size_t payload_len = strcspn(payload, "#");
+
+    // Escapes are undone before base64 decoding, as browsers do
+    char *decoded = malloc(payload_len + 1);
+    if (!decoded) return false;
+    size_t len = percent_decode(payload, payload_len, decoded);
+
+    size_t meta_len = (size_t)(comma - url);
+    if (meta_len >= 7 && strncmp(comma - 7, ";base64", 7) == 0 &&
+        !base64_decode(decoded, len, decoded, &len)) {
+        free(decoded);
+        return false;
+    }
+    source->decoded = decoded;
+    source->data = decoded;
+    source->size = len;
+    return true;
+}
+
+// file:///path and file://localhost/path; other hosts are not ours to read
+static bool open_file(LocalSource *source, const char *url) {
+    const char *path = url + 7;
+    if (strncmp(path, "localhost/", 10) == 0) path += 9;
+    if (path[0] != '/') return false;
+
+    size_t len = strcspn(path, "?#");
+    char *decoded = malloc(len + 1);
+    if (!decoded) return false;
+    percent_decode(path, len, decoded);
+#ifdef _WIN32
+    // file:///C:/dir/page.html
+    const char *fs_path = (isalpha((unsigned char)decoded[1]) && decoded[2] == ':') ? decoded + 1 : decoded;
+#else
+    const char *fs_path = decoded;
+#endif
+
+    bool ok = file_map_open(&source->map, fs_path);
+    if (!ok) fprintf(stderr, "Cannot open %s\n", fs_path);
+    free(decoded);
+    if (!ok) return false;
+    source->data = source->map.data;
+    source->size = source->map.size;
+    return true;
+}
+
+bool local_source_open(LocalSource *source, const char *url) {
+    memset(source, 0, sizeof(*source));
+    if (strncmp(url, "file://", 7) == 0) return open_file(source, url);
+    if (strncmp(url, "data:", 5) == 0) return open_data(source, url);
+    return false;
+}
+
+void local_source_close(LocalSource *source) {
+    file_map_close(&source->map);
+    free(source->decoded);
+    memset(source, 0, sizeof(*source));
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "file_map.h"
+
+// Documents that load without the network: file:// URLs are memory-mapped
+// and handed to the parser as they are, data: URLs are decoded in memory.
+typedef struct {
+    const char *data;
+    size_t size;
+    FileMap map;   // file:// mapping
+    char *decoded; // data: payload
+} LocalSource;
+
+// True for file:// and data: URLs
+bool local_url_is_local(const char *url);
+
+bool local_source_open(LocalSource *source, const char *url);
+void local_source_close(LocalSource *source);
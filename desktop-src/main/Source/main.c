@@ -1,3 +1,5 @@
+#include <ctype.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,79 +10,94 @@
 #include <lexbor/dom/interfaces/element.h>
 #include <lvgl.h>
 
+#include "arena.h"
+#include "bench.h"
+#include "decode_pool.h"
+#include "fonts.h"
+#include "history.h"
+#include "http.h"
+#include "image.h"
+#include "image_cache.h"
+#include "loader.h"
+#include "local.h"
+#include "memory.h"
+#include "page_limits.h"
+#include "preload.h"
+#include "script.h"
+#include "script_cache.h"
+#include "snapshot.h"
+#include "style.h"
+#include "trace.h"
+#include "url.h"
+
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
-#define MAX_TABS 10
-#define MAX_URL_LENGTH 512
-
-typedef struct {
-    char *data;
-    size_t size;
-} MemoryBuffer;
+#define MAX_URL_LENGTH 512      // Address bar input
+#define TAB_NAME_LENGTH 24
+#define SNAPSHOT_IMAGE_COLOR 0x2A2A2A // Matches the image placeholders
+#define DEFAULT_URL "https://example.com"
+#define ABOUT_MEMORY_URL "about:memory"
+#define TAB_MEMORY_BUDGET (96 * 1024 * 1024) // All tabs together, frozen pages included
+#define TAB_BUDGET_ENV "TACTILE_TAB_BUDGET_MB"
+#define MEMORY_CHECK_MS 1000
+#define DOCUMENT_REUSE_MAX_SOURCE (1024 * 1024) // Larger pages' documents are destroyed, not kept
+#define SOAK_POLL_MS 50
+#define SOAK_DEFAULT_NAVIGATIONS 1000
+#define SOAK_WARMUP 60                // Navigations before sampling, while history and caches fill
+#define SOAK_LEAK_LIMIT 64            // Bytes per navigation the heap may lose before the soak fails
+#define SOAK_RESIDENT_LEAK_LIMIT 4096 // The same for the resident set, which grows a page at a time
 
 typedef struct {
-    char url[MAX_URL_LENGTH];
-    lv_obj_t *content_area;
+    char *url;
+    const char *title;             // Of the last rendered document (in `arena`), NULL before that
+    lv_obj_t *page;                // Tabview page
+    lv_obj_t *content_area;        // Created when the tab is first shown
     lv_obj_t *scroll_container;
+    lxb_html_document_t *document; // Current page, kept for incremental restyle
+    StyleMap styles;
+    ImageQueue images;             // <img> placeholders waiting to load
+    size_t source_bytes;           // Size of the current document's HTML
+    uint32_t generation;           // Bumped by every navigation
+    struct Navigation *navigation; // Document load in flight
+    History history;               // Back/forward entries, recent ones frozen in the bfcache
+    ScriptScheduler scripts;       // Scripts of the current page and their JS context
+    Snapshot snapshot;             // Mapped while its painted boxes are on screen
+    uint64_t last_active_us;       // When the tab was last shown, for discarding
+    bool discarded;                // Page dropped under memory pressure; reloads on activation
+    int32_t restore_scroll_y;      // Applied when the next load renders, 0 for none
+    size_t accounted_bytes;        // Last memory_timer_cb() measurement
+    Arena arena;                   // Strings that live as long as the current page
+    lxb_html_document_t *spare_document; // Cleaned, for the next navigation to parse into
+    uint32_t parse_limit_hits;     // PageLimitHit flags from parsing the current document
 } Tab;
 
+// A document load in flight. Chunks are parsed as they arrive; the tab's
+// generation tells a finished load whether a newer navigation replaced it.
+typedef struct Navigation {
+    Tab *tab;
+    uint32_t generation;
+    LoadRequest *request;          // NULL once delivered
+    lxb_html_document_t *document; // Parsed chunk by chunk
+    PreloadScanner scanner;
+    ParseGuard guard;              // Node and text limits, while parsing
+    lxb_status_t status;
+    uint64_t parse_us;
+    size_t source_bytes;
+} Navigation;
+
 // Global variables
-static Tab tabs[MAX_TABS];
-static int tab_count = 1;
+// Background tabs that were never shown are just a URL and a tabview button;
+// each Tab is allocated on its own so pointers to it stay valid as this grows
+static Tab **tabs;
+static int tab_count;
+static int tab_capacity;
 static int active_tab = 0;
 static lv_obj_t *address_bar;
+static lv_obj_t *btn_back, *btn_forward;
 static lv_obj_t *tabview;
 static lv_indev_t *mouse_indev, *kb_indev, *wheel_indev;
 static lv_group_t *input_group;
-
-// CURL callback - renamed to avoid conflict
-static size_t http_write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t real_size = size * nmemb;
-    MemoryBuffer *mem = (MemoryBuffer *)userp;
-    
-    char *ptr = realloc(mem->data, mem->size + real_size + 1);
-    if (!ptr) {
-        fprintf(stderr, "Memory reallocation failed\n");
-        return 0;
-    }
-    
-    mem->data = ptr;
-    memcpy(&(mem->data[mem->size]), contents, real_size);
-    mem->size += real_size;
-    mem->data[mem->size] = 0;
-    return real_size;
-}
-
-// Download HTML content
-char *download_html(const char *url) {
-    CURL *curl = curl_easy_init();
-    MemoryBuffer chunk = {0};
-    
-    if (!curl) {
-        fprintf(stderr, "curl_easy_init failed\n");
-        return NULL;
-    }
-
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, http_write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &chunk);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "TactileBrowser/1.0");
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        fprintf(stderr, "curl_easy_perform failed: %s\n", curl_easy_strerror(res));
-        free(chunk.data);
-        chunk.data = NULL;
-    }
-    
-    curl_easy_cleanup(curl);
-    return chunk.data;
-}
+static size_t tab_memory_budget = TAB_MEMORY_BUDGET;
 
 // Safe string duplication
 char* safe_strdup(const char* s) {
@@ -103,40 +120,202 @@ char* safe_strndup(const char* s, size_t n) {
     return result;
 }
 
-// Extract title from HTML document
-char* extract_title(lxb_html_document_t *document) {
+// Extract title from HTML document. The copy lives in the page arena.
+const char *extract_title(lxb_html_document_t *document, Arena *arena) {
     lxb_dom_element_t *root = lxb_dom_document_element(lxb_dom_interface_document(document));
-    if (!root) return safe_strdup("Untitled");
+    if (!root) return "Untitled";
 
     lxb_dom_collection_t *collection = lxb_dom_collection_make(lxb_dom_interface_document(document), 16);
-    if (!collection) return safe_strdup("Untitled");
+    if (!collection) return "Untitled";
 
     lxb_status_t status = lxb_dom_elements_by_tag_name(root, collection, 
                                                        (const lxb_char_t *)"title", 5);
     
     if (status != LXB_STATUS_OK || lxb_dom_collection_length(collection) == 0) {
         lxb_dom_collection_destroy(collection, true);
-        return safe_strdup("Untitled");
+        return "Untitled";
     }
 
     lxb_dom_element_t *title_element = lxb_dom_collection_element(collection, 0);
     size_t text_len = 0;
     lxb_char_t *text = lxb_dom_node_text_content(lxb_dom_interface_node(title_element), &text_len);
     
-    char *result = (text && text_len > 0) ? 
-                   safe_strndup((const char*)text, text_len) : 
-                   safe_strdup("Untitled");
+    const char *result = (text && text_len > 0) ? 
+                         arena_strndup(arena, (const char*)text, text_len) : 
+                         NULL;
     
     if (text) lxb_dom_document_destroy_text(lxb_dom_interface_document(document), text);
     lxb_dom_collection_destroy(collection, true);
     
-    return result ? result : safe_strdup("Untitled");
+    return result ? result : "Untitled";
+}
+
+// Tags that never produce widgets
+static bool is_hidden_tag(lxb_tag_id_t tag) {
+    switch (tag) {
+        case LXB_TAG_HEAD: case LXB_TAG_TITLE: case LXB_TAG_META: case LXB_TAG_LINK:
+        case LXB_TAG_SCRIPT: case LXB_TAG_STYLE: case LXB_TAG_NOSCRIPT: case LXB_TAG_TEMPLATE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Tags laid out as their own vertical box
+static bool is_block_tag(lxb_tag_id_t tag) {
+    switch (tag) {
+        case LXB_TAG_BODY: case LXB_TAG_DIV: case LXB_TAG_P: case LXB_TAG_H1: case LXB_TAG_H2:
+        case LXB_TAG_H3: case LXB_TAG_H4: case LXB_TAG_H5: case LXB_TAG_H6: case LXB_TAG_UL:
+        case LXB_TAG_OL: case LXB_TAG_LI: case LXB_TAG_SECTION: case LXB_TAG_ARTICLE:
+        case LXB_TAG_HEADER: case LXB_TAG_FOOTER: case LXB_TAG_NAV: case LXB_TAG_MAIN:
+        case LXB_TAG_BLOCKQUOTE: case LXB_TAG_PRE: case LXB_TAG_TABLE: case LXB_TAG_TR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Images count too: a box holding one needs a container rather than a label
+static bool has_block_children(lxb_dom_node_t *node) {
+    for (lxb_dom_node_t *child = node->first_child; child; child = child->next) {
+        if (child->type != LXB_DOM_NODE_TYPE_ELEMENT) continue;
+        lxb_tag_id_t tag = lxb_dom_element_tag_id(lxb_dom_interface_element(child));
+        if (is_block_tag(tag) || tag == LXB_TAG_IMG) return true;
+    }
+    return false;
+}
+
+// Transparent vertical box; spacing between children comes from flex
+static lv_obj_t *create_block_container(lv_obj_t *parent) {
+    lv_obj_t *cont = lv_obj_create(parent);
+    lv_obj_remove_style_all(cont);
+    lv_obj_set_size(cont, LV_PCT(100), LV_SIZE_CONTENT);
+    lv_obj_set_flex_flow(cont, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_style_pad_row(cont, 10, 0);
+    lv_obj_remove_flag(cont, LV_OBJ_FLAG_SCROLLABLE);
+    trace_count(TRACE_WIDGETS, 1);
+    return cont;
+}
+
+// Narrow `text` to the run without surrounding whitespace
+static void trim_text(const lxb_char_t **text, size_t *len) {
+    while (*len > 0 && isspace(**text)) { (*text)++; (*len)--; }
+    while (*len > 0 && isspace((*text)[*len - 1])) (*len)--;
+}
+
+// Label for a run of text, trimmed of surrounding whitespace. Returns NULL
+// when nothing visible is left. The NUL-terminated copy LVGL needs is
+// scratch in `arena`, given back as soon as the label has its own.
+static lv_obj_t *create_text_label(lv_obj_t *parent, Arena *arena, const lxb_char_t *text, size_t len) {
+    trim_text(&text, &len);
+    if (len == 0) return NULL;
+
+    ArenaMark mark = arena_mark(arena);
+    char *str = arena_strndup(arena, (const char *)text, len);
+    if (!str) return NULL;
+
+    lv_obj_t *label = lv_label_create(parent);
+    lv_label_set_text(label, str);
+    lv_obj_set_width(label, LV_PCT(100));
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    arena_release(arena, mark);
+    trace_count(TRACE_WIDGETS, 1);
+    return label;
+}
+
+// What one render may still spend, against the PAGE_LIMIT_* profile
+typedef struct {
+    size_t widgets;       // Left to create
+    uint32_t depth;       // Of the box being filled
+    uint64_t deadline_us;
+    uint32_t hits;        // PageLimitHit flags
+} RenderBudget;
+
+// False once a limit stops the render; the rest of the page is left out
+static bool render_budget_ok(RenderBudget *budget) {
+    if (budget->widgets == 0) budget->hits |= PAGE_LIMIT_HIT_WIDGETS;
+    else if (trace_now_us() > budget->deadline_us) budget->hits |= PAGE_LIMIT_HIT_TIME;
+    else return true;
+    return false;
+}
+
+static void render_children(Tab *tab, lxb_dom_node_t *node, lv_obj_t *parent,
+                            int32_t parent_style, RenderBudget *budget);
+
+static void render_element(Tab *tab, lxb_dom_element_t *el, lv_obj_t *parent,
+                           int32_t parent_style, RenderBudget *budget) {
+    lxb_dom_node_t *node = lxb_dom_interface_node(el);
+    lxb_tag_id_t tag_id = lxb_dom_element_tag_id(el);
+    if (is_hidden_tag(tag_id)) return;
+
+    if (tag_id == LXB_TAG_IMG) {
+        if (image_create(&tab->images, parent, el, tab->url, tab->styles.viewport_width)) budget->widgets--;
+        return;
+    }
+
+    // Past the depth limit a block is flattened into one label below
+    if (is_block_tag(tag_id) && has_block_children(node)) {
+        if (budget->depth < PAGE_LIMIT_DEPTH) {
+            lv_obj_t *cont = create_block_container(parent);
+            int32_t style = style_attach(&tab->styles, el, cont, parent_style);
+            budget->widgets--;
+            budget->depth++;
+            render_children(tab, node, cont, style, budget);
+            budget->depth--;
+            return;
+        }
+        budget->hits |= PAGE_LIMIT_HIT_DEPTH;
+    }
+
+    // Leaf blocks and inline elements collapse into one label
+    size_t text_len = 0;
+    lxb_char_t *text = lxb_dom_node_text_content(node, &text_len);
+    if (!text) return;
+
+    lv_obj_t *label = create_text_label(parent, &tab->arena, text, text_len);
+    if (label) {
+        style_attach(&tab->styles, el, label, parent_style);
+        budget->widgets--;
+    }
+    lxb_dom_document_destroy_text(lxb_dom_interface_document(tab->document), text);
+}
+
+static void render_children(Tab *tab, lxb_dom_node_t *node, lv_obj_t *parent,
+                            int32_t parent_style, RenderBudget *budget) {
+    for (lxb_dom_node_t *child = node->first_child; child && render_budget_ok(budget); child = child->next) {
+        if (child->type == LXB_DOM_NODE_TYPE_ELEMENT) {
+            render_element(tab, lxb_dom_interface_element(child), parent, parent_style, budget);
+        } else if (child->type == LXB_DOM_NODE_TYPE_TEXT) {
+            // Bare text inherits the enclosing box's style through LVGL
+            lxb_dom_character_data_t *data = lxb_dom_interface_character_data(child);
+            if (create_text_label(parent, &tab->arena, data->data.data, data->data.length)) budget->widgets--;
+        }
+    }
+}
+
+// First thing on a page that was cut short
+static void add_limits_notice(lv_obj_t *parent, uint32_t hits) {
+    char text[160];
+    if (!page_limits_notice(hits, text, sizeof(text))) return;
+    lv_obj_t *label = lv_label_create(parent);
+    lv_label_set_text(label, text);
+    lv_obj_set_width(label, LV_PCT(100));
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_style_text_color(label, lv_color_hex(0xFFD93D), 0);
+    lv_obj_move_to_index(label, 0);
 }
 
 // Render HTML elements to LVGL objects
-void render_html_content(lxb_html_document_t *document, lv_obj_t *container) {
+void render_html_content(Tab *tab) {
+    uint64_t start = trace_now_us();
+    lv_obj_t *container = tab->content_area;
+    lxb_html_document_t *document = tab->document;
+
     lv_obj_clean(container);
-    
+    style_map_reset(&tab->styles);
+    lv_obj_update_layout(container);
+    style_set_viewport(&tab->styles, lv_obj_get_content_width(container));
+
     lxb_dom_element_t *root = lxb_dom_document_element(lxb_dom_interface_document(document));
     if (!root) return;
 
@@ -150,125 +329,780 @@ void render_html_content(lxb_html_document_t *document, lv_obj_t *container) {
     }
 
     lxb_dom_element_t *body = lxb_dom_collection_element(body_collection, 0);
-    if (!body) {
-        lxb_dom_collection_destroy(body_collection, true);
+    lxb_dom_collection_destroy(body_collection, true);
+    if (!body) return;
+
+    RenderBudget budget = {PAGE_LIMIT_WIDGETS, 0, start + PAGE_LIMIT_RENDER_MS * 1000ull, 0};
+    lv_obj_t *body_cont = create_block_container(container);
+    int32_t body_style = style_attach(&tab->styles, body, body_cont, -1);
+    render_children(tab, lxb_dom_interface_node(body), body_cont, body_style, &budget);
+    add_limits_notice(body_cont, tab->parse_limit_hits | budget.hits);
+
+    trace_stage_add(TRACE_STAGE_RENDER, trace_now_us() - start);
+}
+
+// Paint the saved snapshot of `url` while the page itself loads. Labels point
+// straight into the mapped text arena, so the file stays mapped until the
+// widgets go.
+static bool paint_snapshot(Tab *tab, const char *url) {
+    uint64_t start = trace_now_us();
+    Snapshot *snap = &tab->snapshot;
+    if (!snapshot_open(snap, url)) return false;
+
+    uint32_t count = snap->header->box_count;
+    lv_obj_t **objs = malloc((count ? count : 1) * sizeof(lv_obj_t *));
+    if (!objs) {
+        snapshot_close(snap);
+        return false;
+    }
+
+    lv_coord_t viewport_width = lv_obj_get_content_width(tab->content_area);
+    for (uint32_t i = 0; i < count; i++) {
+        const SnapshotBox *box = &snap->boxes[i];
+        lv_obj_t *parent = box->parent == SNAPSHOT_NONE ? tab->content_area : objs[box->parent];
+        lv_obj_t *obj;
+        if (box->kind == SNAPSHOT_BOX_BLOCK) {
+            obj = create_block_container(parent);
+        } else if (box->kind == SNAPSHOT_BOX_TEXT) {
+            obj = lv_label_create(parent);
+            lv_label_set_text_static(obj, snapshot_text(snap, box->text));
+            lv_obj_set_width(obj, LV_PCT(100));
+            lv_label_set_long_mode(obj, LV_LABEL_LONG_WRAP);
+            trace_count(TRACE_WIDGETS, 1);
+        } else {
+            obj = lv_obj_create(parent);
+            lv_obj_remove_style_all(obj);
+            lv_obj_remove_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+            lv_obj_set_size(obj, box->w, box->h);
+            lv_obj_set_style_bg_color(obj, lv_color_hex(SNAPSHOT_IMAGE_COLOR), 0);
+            lv_obj_set_style_bg_opa(obj, LV_OPA_COVER, 0);
+            trace_count(TRACE_WIDGETS, 1);
+        }
+        if (box->style != SNAPSHOT_NONE) {
+            ComputedStyle style;
+            snapshot_style(snap, box->style, &style);
+            style_apply_computed(obj, &style, viewport_width);
+        }
+        objs[i] = obj;
+    }
+    free(objs);
+    if (tab->restore_scroll_y) {
+        lv_obj_update_layout(tab->content_area);
+        lv_obj_scroll_to_y(tab->content_area, tab->restore_scroll_y, LV_ANIM_OFF);
+    }
+
+    uint64_t elapsed = trace_now_us() - start;
+    trace_count(TRACE_SNAPSHOT_HITS, 1);
+    trace_stage_add(TRACE_STAGE_RENDER, elapsed);
+    trace_event("snapshot painted %u boxes in %.2fms", (unsigned int)count, elapsed / 1000.0);
+    return true;
+}
+
+static bool is_javascript_type(lxb_dom_element_t *el) {
+    size_t len = 0;
+    const lxb_char_t *type = lxb_dom_element_get_attribute(el, (const lxb_char_t *)"type", 4, &len);
+    if (!type || len == 0) return true;
+    char value[64];
+    snprintf(value, sizeof(value), "%.*s", (int)len, (const char *)type);
+    for (char *c = value; *c; c++) *c = (char)tolower((unsigned char)*c);
+    return strstr(value, "javascript") != NULL || strstr(value, "ecmascript") != NULL;
+}
+
+// Queue the page's scripts: inline ones with their text, external ones
+// fetched (or claimed from the preload scanner) at script priority. None
+// runs until the page has been painted.
+static void collect_scripts(Tab *tab) {
+    lxb_dom_document_t *doc = lxb_dom_interface_document(tab->document);
+    lxb_dom_element_t *root = lxb_dom_document_element(doc);
+    lxb_dom_collection_t *collection = root ? lxb_dom_collection_make(doc, 16) : NULL;
+    if (!collection) return;
+    if (lxb_dom_elements_by_tag_name(root, collection, (const lxb_char_t *)"script", 6) != LXB_STATUS_OK) {
+        lxb_dom_collection_destroy(collection, true);
         return;
     }
 
-    lxb_dom_node_t *node = lxb_dom_interface_node(body)->first_child;
-    lv_coord_t y_offset = 10;
+    script_scheduler_init(&tab->scripts, tab->url, tab->document);
+    size_t count = lxb_dom_collection_length(collection);
+    for (size_t i = 0; i < count; i++) {
+        lxb_dom_element_t *el = lxb_dom_collection_element(collection, i);
+        if (!is_javascript_type(el)) continue;
 
-    while (node && y_offset < 2000) { // Prevent infinite scrolling
-        if (node->type == LXB_DOM_NODE_TYPE_ELEMENT) {
-            const lxb_tag_id_t tag_id = lxb_dom_element_tag_id((lxb_dom_element_t *)node);
-            
-            if (tag_id == LXB_TAG_P || tag_id == LXB_TAG_H1 || tag_id == LXB_TAG_H2 || 
-                tag_id == LXB_TAG_H3 || tag_id == LXB_TAG_A || tag_id == LXB_TAG_DIV) {
-                
-                size_t text_len = 0;
-                lxb_char_t *text = lxb_dom_node_text_content(node, &text_len);
-                
-                if (text && text_len > 0) {
-                    char *str = safe_strndup((const char *)text, text_len);
-                    if (str && strlen(str) > 0) {
-                        lv_obj_t *label = lv_label_create(container);
-                        lv_label_set_text(label, str);
-                        lv_obj_set_width(label, SCREEN_WIDTH - 40);
-                        lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
-                        
-                        // Style based on tag type - use available font
-                        if (tag_id == LXB_TAG_H1 || tag_id == LXB_TAG_H2 || tag_id == LXB_TAG_H3) {
-                            lv_obj_set_style_text_font(label, &lv_font_montserrat_14, 0); // Use available font
-                            lv_obj_set_style_text_color(label, lv_color_hex(0xFFFFFF), 0);
-                            y_offset += 10;
-                        } else if (tag_id == LXB_TAG_A) {
-                            lv_obj_set_style_text_color(label, lv_color_hex(0x4A90E2), 0);
-                        } else {
-                            lv_obj_set_style_text_color(label, lv_color_hex(0xE0E0E0), 0);
-                        }
-                        
-                        lv_obj_align(label, LV_ALIGN_TOP_LEFT, 20, y_offset);
-                        y_offset += lv_obj_get_height(label) + 10;
-                    }
-                    free(str);
-                    lxb_dom_document_destroy_text(lxb_dom_interface_document(document), text);
-                }
+        size_t src_len = 0;
+        const lxb_char_t *src = lxb_dom_element_get_attribute(el, (const lxb_char_t *)"src", 3, &src_len);
+        if (src && src_len > 0) {
+            char *ref = safe_strndup((const char *)src, src_len);
+            char *url = url_resolve(tab->url, ref);
+            free(ref);
+            if (!url) continue;
+            // async wins over defer, as in browsers; both only apply to external scripts
+            ScriptMode mode = SCRIPT_CLASSIC;
+            if (lxb_dom_element_has_attribute(el, (const lxb_char_t *)"async", 5)) {
+                mode = SCRIPT_ASYNC;
+            } else if (lxb_dom_element_has_attribute(el, (const lxb_char_t *)"defer", 5)) {
+                mode = SCRIPT_DEFER;
             }
+            script_scheduler_add_external(&tab->scripts, url, mode);
+            free(url);
+            continue;
         }
-        node = node->next;
+
+        size_t text_len = 0;
+        lxb_char_t *text = lxb_dom_node_text_content(lxb_dom_interface_node(el), &text_len);
+        if (!text) continue;
+        script_scheduler_add_inline(&tab->scripts, (const char *)text, text_len);
+        lxb_dom_document_destroy_text(doc, text);
     }
-    
-    lxb_dom_collection_destroy(body_collection, true);
+    lxb_dom_collection_destroy(collection, true);
+}
+
+// The widget showing `el`: its own record's, or for an inline element
+// folded into an ancestor's label, that label's record. One index probe
+// per ancestor, so applying a journal costs its length times the depth.
+static StyleRecord *find_record(Tab *tab, lxb_dom_element_t *el) {
+    for (lxb_dom_node_t *node = lxb_dom_interface_node(el); node; node = node->parent) {
+        if (node->type != LXB_DOM_NODE_TYPE_ELEMENT) continue;
+        int32_t found = style_find(&tab->styles, lxb_dom_interface_element(node));
+        if (found >= 0) return &tab->styles.records[found];
+    }
+    return NULL;
+}
+
+// Bring the widgets up to date with everything scripts changed since the
+// last frame: labels get their new text, style edits go through one
+// style_flush(), and removed elements rebuild the page once. LVGL then
+// lays the result out a single time when it draws the frame.
+static void apply_script_mutations(Tab *tab) {
+    ScriptDom *dom = &tab->scripts.context.dom;
+    if (dom->journal_count == 0 && dom->removed_count == 0) return;
+    uint64_t start = trace_now_us();
+    uint32_t mutations = dom->mutations;
+    size_t elements = dom->journal_count;
+
+    bool rebuild = dom->removed_count > 0;
+    for (size_t i = 0; i < dom->journal_count && !rebuild; i++) {
+        DomMutation *m = &dom->journal[i];
+        if (m->kinds & DOM_MUTATION_STYLE) style_invalidate_element(&tab->styles, m->element, STYLE_DEP_INLINE);
+        if (m->kinds & DOM_MUTATION_CLASS) style_invalidate_element(&tab->styles, m->element, STYLE_DEP_CLASS);
+        if (!(m->kinds & DOM_MUTATION_TEXT)) continue;
+
+        StyleRecord *rec = find_record(tab, m->element);
+        if (!rec) continue; // Not rendered, e.g. past the render budget
+        if (!lv_obj_check_type(rec->obj, &lv_label_class)) {
+            rebuild = true; // A container now holding bare text
+            break;
+        }
+        size_t len = 0;
+        lxb_char_t *text = lxb_dom_node_text_content(lxb_dom_interface_node(rec->element), &len);
+        const lxb_char_t *visible = text;
+        trim_text(&visible, &len);
+        ArenaMark mark = arena_mark(&tab->arena);
+        char *str = arena_strndup(&tab->arena, visible ? (const char *)visible : "", len);
+        if (str) lv_label_set_text(rec->obj, str);
+        arena_release(&tab->arena, mark);
+        if (text) lxb_dom_document_destroy_text(lxb_dom_interface_document(tab->document), text);
+    }
+
+    if (rebuild) {
+        int32_t scroll_y = lv_obj_get_scroll_y(tab->content_area);
+        image_queue_reset(&tab->images);
+        render_html_content(tab);
+        lv_obj_update_layout(tab->content_area);
+        lv_obj_scroll_to_y(tab->content_area, scroll_y, LV_ANIM_OFF);
+    } else {
+        style_flush(&tab->styles);
+    }
+    // Removed subtrees are destroyed only now that no widget refers to them
+    script_dom_journal_clear(dom);
+    trace_event("mutations: %u calls on %zu elements applied in %.2fms%s", (unsigned int)mutations, elements,
+                (trace_now_us() - start) / 1000.0, rebuild ? " (page rebuilt)" : "");
+}
+
+// Keep a finished document for the tab's next load. Cleaning empties it but
+// keeps lexbor's first pool chunks, hash tables and parser, so the next
+// parse starts without allocating them again. Documents of very large
+// pages hold more than a typical page needs and are destroyed instead.
+static void recycle_document(Tab *tab, lxb_html_document_t *document, size_t source_bytes) {
+    if (tab->spare_document || source_bytes > DOCUMENT_REUSE_MAX_SOURCE) {
+        lxb_html_document_destroy(document);
+        return;
+    }
+    lxb_html_document_clean(document);
+    tab->spare_document = document;
+}
+
+static lxb_html_document_t *take_document(Tab *tab) {
+    lxb_html_document_t *document = tab->spare_document;
+    tab->spare_document = NULL;
+    return document ? document : lxb_html_document_create();
+}
+
+// Drop the current page's widgets, computed styles, pending loads and document
+static void release_page(Tab *tab) {
+    lv_obj_clean(tab->content_area);
+    snapshot_close(&tab->snapshot);
+    image_queue_reset(&tab->images);
+    script_scheduler_free(&tab->scripts);
+    loader_cancel_owner(tab); // Preloads the old page never claimed
+    style_map_reset(&tab->styles);
+    if (tab->document) {
+        recycle_document(tab, tab->document, tab->source_bytes);
+        tab->document = NULL;
+    }
+    tab->title = NULL;
+    tab->parse_limit_hits = 0;
+    arena_reset(&tab->arena);
+}
+
+static void navigation_free(Navigation *nav) {
+    preload_scanner_free(&nav->scanner);
+    parse_guard_detach(&nav->guard);
+    if (nav->document) lxb_html_document_destroy(nav->document); // Possibly mid-parse: not reused
+    free(nav);
+}
+
+// Stop the tab's load in flight and count what it had cost so far
+static void navigation_abandon(Tab *tab) {
+    Navigation *nav = tab->navigation;
+    if (!nav) return;
+    tab->navigation = NULL;
+    trace_count(TRACE_NAVS_ABANDONED, 1);
+    trace_count(TRACE_WASTED_PARSE_US, (uint32_t)nav->parse_us);
+    loader_cancel(nav->request);
+    navigation_free(nav);
+}
+
+static void show_page_error(Tab *tab, const char *message) {
+    lv_obj_clean(tab->content_area);
+    lv_obj_t *error_label = lv_label_create(tab->content_area);
+    lv_label_set_text(error_label, message);
+    lv_obj_center(error_label);
+    lv_obj_set_style_text_color(error_label, lv_color_hex(0xFF6B6B), 0);
+}
+
+// Each decoded chunk goes to the preload scanner (to start subresource
+// fetches early) and straight on into lexbor's chunk parser
+static void navigation_chunk(const char *data, size_t len, void *ctx) {
+    Navigation *nav = (Navigation *)ctx;
+    preload_scan(data, len, &nav->scanner);
+    if (nav->status != LXB_STATUS_OK) return;
+
+    uint64_t start = trace_now_us();
+    nav->source_bytes += len;
+    nav->status = lxb_html_document_parse_chunk(nav->document, (const lxb_char_t *)data, len);
+    nav->parse_us += trace_now_us() - start;
+}
+
+static int tab_index(const Tab *tab) {
+    for (int i = 0; i < tab_count; i++) {
+        if (tabs[i] == tab) return i;
+    }
+    return -1;
+}
+
+static void rename_tab(Tab *tab) {
+    int index = tab_index(tab);
+    if (index < 0 || !tab->title) return;
+    char name[TAB_NAME_LENGTH + 4];
+    snprintf(name, sizeof(name), "%.*s%s", TAB_NAME_LENGTH, tab->title,
+             strlen(tab->title) > TAB_NAME_LENGTH ? "..." : "");
+    lv_tabview_rename_tab(tabview, (uint32_t)index, name);
+}
+
+// The whole document has been fed to the parser (or the fetch failed):
+// finish parsing and put the page on screen
+static void navigation_finish(Navigation *nav, bool complete, uint64_t elapsed_us) {
+    Tab *tab = nav->tab;
+    tab->navigation = NULL;
+    uint64_t fetch_us = elapsed_us > nav->parse_us ? elapsed_us - nav->parse_us : 0;
+    trace_stage_add(TRACE_STAGE_FETCH, fetch_us);
+
+    if (!complete) {
+        // Offline: a painted snapshot is better than an error
+        if (tab->snapshot.header) trace_event("revalidation failed, keeping snapshot of %s", tab->url);
+        else show_page_error(tab, "Failed to load page. Check your connection.");
+        navigation_free(nav);
+        return;
+    }
+
+    uint64_t stage_start = trace_now_us();
+    if (nav->status == LXB_STATUS_OK) nav->status = lxb_html_document_parse_chunk_end(nav->document);
+    parse_guard_detach(&nav->guard);
+    if (nav->status != LXB_STATUS_OK) {
+        show_page_error(tab, "Failed to parse HTML content");
+        navigation_free(nav);
+        return;
+    }
+    trace_stage_add(TRACE_STAGE_PARSE, trace_now_us() - stage_start + nav->parse_us);
+
+    // Name the tab after the document
+    tab->title = extract_title(nav->document, &tab->arena);
+    rename_tab(tab);
+
+    // Render content. The document stays alive with the page so later
+    // attribute or viewport changes can restyle just the affected records.
+    tab->document = nav->document;
+    tab->source_bytes = nav->source_bytes;
+    tab->parse_limit_hits = nav->guard.hits;
+    nav->document = NULL;
+    navigation_free(nav);
+
+    // The fresh page replaces a painted snapshot where the user left it
+    // (or, for a discarded tab coming back, where it was)
+    bool had_snapshot = tab->snapshot.header != NULL;
+    int32_t scroll_y = had_snapshot ? lv_obj_get_scroll_y(tab->content_area) : tab->restore_scroll_y;
+    render_html_content(tab);
+    snapshot_close(&tab->snapshot);
+    if (scroll_y) {
+        lv_obj_update_layout(tab->content_area);
+        lv_obj_scroll_to_y(tab->content_area, scroll_y, LV_ANIM_OFF);
+    }
+    tab->restore_scroll_y = 0;
+
+    // Scripts see the rendered page, from the frame after it is drawn
+    collect_scripts(tab);
+    script_scheduler_start(&tab->scripts);
+    trace_page_end();
+
+    // Local documents load as fast as a snapshot would
+    if (!local_url_is_local(tab->url)) {
+        lv_obj_update_layout(tab->content_area);
+        snapshot_save(tab->url, tab->content_area, &tab->styles);
+    }
+}
+
+static void navigation_done(LoadRequest *request, void *user_data) {
+    Navigation *nav = (Navigation *)user_data;
+    Tab *tab = nav->tab;
+    nav->request = NULL;
+    if (tab->navigation != nav || nav->generation != tab->generation) {
+        // Superseded; nothing from a stale load may reach the screen
+        trace_count(TRACE_NAVS_ABANDONED, 1);
+        trace_count(TRACE_WASTED_PARSE_US, (uint32_t)nav->parse_us);
+        trace_count(TRACE_WASTED_BYTES, (uint32_t)request->received);
+        navigation_free(nav);
+        return;
+    }
+    navigation_finish(nav, request->complete, request->elapsed_us);
+}
+
+// file:// and data: documents are parsed straight from the mapping or the
+// decoded buffer in one chunk, with no copy and no network stack involved.
+// The "fetch" stage then measures only opening and mapping the input.
+static void navigation_load_local(Navigation *nav, const char *url) {
+    uint64_t start = trace_now_us();
+    LocalSource source;
+    if (!local_source_open(&source, url)) {
+        nav->tab->navigation = NULL;
+        show_page_error(nav->tab, "Cannot open local document");
+        navigation_free(nav);
+        return;
+    }
+    navigation_chunk(source.data, source.size, nav);
+    navigation_finish(nav, true, trace_now_us() - start);
+    local_source_close(&source);
+}
+
+// Enable the back/forward buttons to match the active tab's history
+static void update_history_buttons(void) {
+    History *history = &tabs[active_tab]->history;
+    lv_obj_set_state(btn_back, LV_STATE_DISABLED, !history_can_go(history, -1));
+    lv_obj_set_state(btn_forward, LV_STATE_DISABLED, !history_can_go(history, 1));
+}
+
+// Park the tab's page in the back/forward cache under its history entry
+// instead of destroying it
+static void freeze_page(Tab *tab) {
+    HistoryEntry *entry = history_current(&tab->history);
+    lv_obj_t *root = lv_obj_get_child(tab->content_area, 0);
+    if (!entry || !tab->document || !root) return;
+
+    FrozenPage *page = calloc(1, sizeof(FrozenPage));
+    if (!page) return;
+    page->scroll_y = lv_obj_get_scroll_y(tab->content_area);
+    page->root = root;
+    lv_obj_set_parent(root, bfcache_storage());
+    page->document = tab->document;
+    tab->document = NULL;
+    page->styles = tab->styles;
+    style_map_init(&tab->styles, 0);
+    // Waiting images stop loading and resume where they were on restore
+    image_queue_init(&page->images, root);
+    image_queue_move(&page->images, &tab->images);
+    // Scripts not run yet are dropped with the page's other pending loads
+    script_context_suspend(&tab->scripts.context);
+    page->scripts = tab->scripts.context;
+    memset(&tab->scripts.context, 0, sizeof(tab->scripts.context));
+    page->source_bytes = tab->source_bytes;
+    page->bytes = bfcache_estimate(root, &page->styles, page->source_bytes, &page->scripts);
+    bfcache_store(entry, page);
+}
+
+// Put a frozen page back on screen. Returns false when it was evicted.
+static bool restore_page(Tab *tab, HistoryEntry *entry) {
+    FrozenPage *page = bfcache_take(entry);
+    if (!page) return false;
+
+    uint64_t start = trace_now_us();
+    int32_t scroll_y = page->scroll_y;
+    lv_obj_set_parent(page->root, tab->content_area);
+    tab->document = page->document;
+    tab->source_bytes = page->source_bytes;
+    style_map_free(&tab->styles);
+    tab->styles = page->styles;
+    image_queue_move(&tab->images, &page->images);
+    script_scheduler_free(&tab->scripts);
+    tab->scripts.context = page->scripts;
+    memset(&page->scripts, 0, sizeof(page->scripts));
+    script_context_resume(&tab->scripts.context);
+    page->root = NULL;
+    page->document = NULL;
+    style_map_init(&page->styles, 0);
+    bfcache_destroy(page);
+
+    // The window may have been resized while the page was frozen
+    lv_obj_update_layout(tab->content_area);
+    style_set_viewport(&tab->styles, lv_obj_get_content_width(tab->content_area));
+    style_flush(&tab->styles);
+    lv_obj_update_layout(tab->content_area);
+    lv_obj_scroll_to_y(tab->content_area, scroll_y, LV_ANIM_OFF);
+
+    trace_count(TRACE_BFCACHE_HITS, 1);
+    trace_stage_add(TRACE_STAGE_RENDER, trace_now_us() - start);
+    return true;
+}
+
+// Stop whatever the tab is loading and take its page off screen, frozen for
+// back/forward when `freeze` is set
+static void leave_page(Tab *tab, bool freeze) {
+    tab->generation++;
+    tab->restore_scroll_y = 0;
+    navigation_abandon(tab);
+    if (freeze) freeze_page(tab);
+    release_page(tab);
+}
+
+// Estimated bytes of the tab's live page
+static void tab_memory(Tab *tab, PageMemory *mem) {
+    page_memory_measure(mem, tab->content_area, false, &tab->styles, tab->document ? tab->source_bytes : 0);
+    mem->scripts = tab->scripts.context.heap_size + script_dom_bytes(&tab->scripts.context.dom);
+}
+
+static size_t tab_memory_total(Tab *tab) {
+    PageMemory mem;
+    tab_memory(tab, &mem);
+    return page_memory_total(&mem) + history_frozen_bytes(&tab->history);
+}
+
+static void memory_line(lv_obj_t *parent, uint32_t color, const char *fmt, ...) LV_FORMAT_ATTRIBUTE(3, 4);
+static void memory_line(lv_obj_t *parent, uint32_t color, const char *fmt, ...) {
+    char text[MAX_URL_LENGTH + 64];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+
+    lv_obj_t *label = lv_label_create(parent);
+    lv_label_set_text(label, text);
+    lv_obj_set_width(label, LV_PCT(100));
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+    lv_obj_set_style_text_color(label, lv_color_hex(color), 0);
+}
+
+#define KB(bytes) ((unsigned long)((bytes) / 1024))
+
+// about:memory: what every tab costs and the shared caches
+static void render_memory_page(Tab *page_tab) {
+    lv_obj_clean(page_tab->content_area);
+    lv_obj_t *cont = create_block_container(page_tab->content_area);
+    lv_obj_set_style_pad_all(cont, 20, 0);
+
+    memory_line(cont, 0xFFFFFF, "Memory");
+    size_t total = 0;
+    for (int i = 0; i < tab_count; i++) {
+        Tab *tab = tabs[i];
+        PageMemory mem;
+        tab_memory(tab, &mem);
+        size_t frozen = history_frozen_bytes(&tab->history);
+        size_t tab_total = page_memory_total(&mem) + frozen;
+        total += tab_total;
+        memory_line(cont, 0x4A90E2, "Tab %d%s%s: %s", i + 1, i == active_tab ? " (active)" : "",
+                    tab->discarded ? " (discarded)" : !tab->content_area ? " (not loaded)" : "", tab->url);
+        memory_line(cont, 0xE0E0E0,
+                    "%lu KB: widgets %lu KB, text %lu KB, DOM %lu KB, styles %lu KB, images %lu KB, "
+                    "JS heap %lu KB (peak %lu KB), frozen pages %lu KB",
+                    KB(tab_total), KB(mem.widgets), KB(mem.text), KB(mem.dom), KB(mem.styles),
+                    KB(mem.images), KB(mem.scripts), KB(script_heap_peak(&tab->scripts.context)), KB(frozen));
+        memory_line(cont, 0xE0E0E0, "Page arena: %lu KB used, %lu KB reserved, peak %lu KB over %u pages",
+                    KB(tab->arena.used), KB(tab->arena.reserved), KB(tab->arena.high_water),
+                    (unsigned int)tab->arena.resets);
+    }
+
+    memory_line(cont, 0xFFFFFF, "Totals");
+    memory_line(cont, 0xE0E0E0, "Tabs: %lu KB of a %lu KB budget", KB(total), KB(tab_memory_budget));
+    memory_line(cont, 0xE0E0E0, "Image cache: %lu KB (shared, pinned images are counted per tab above)",
+                KB(image_cache_bytes()));
+    memory_line(cont, 0xE0E0E0, "Back/forward cache: %lu KB", KB(bfcache_bytes()));
+    ScriptCacheStats script_stats;
+    script_cache_stats(&script_stats);
+    memory_line(cont, 0xE0E0E0, "Script cache: %lu KB in memory, %lu KB on disk (%u hits, %u from disk, %u misses)",
+                KB(script_stats.memory_bytes), KB(script_stats.disk_bytes), (unsigned int)script_stats.hits,
+                (unsigned int)script_stats.disk_hits, (unsigned int)script_stats.misses);
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+    lv_mem_monitor_t monitor;
+    lv_mem_monitor(&monitor);
+    memory_line(cont, 0xE0E0E0, "LVGL heap: %lu KB used of %lu KB, peak %lu KB, %d%% fragmented",
+                KB(monitor.total_size - monitor.free_size), KB(monitor.total_size), KB(monitor.max_used),
+                (int)monitor.frag_pct);
+#endif
+}
+
+// Reduce a background tab to its URL, history and scroll position. The
+// page comes back (from its snapshot, if any) when the tab is shown again.
+static void discard_tab(Tab *tab) {
+    int32_t scroll_y = lv_obj_get_scroll_y(tab->content_area);
+    leave_page(tab, false);
+    history_drop_frozen(&tab->history);
+    if (tab->spare_document) {
+        lxb_html_document_destroy(tab->spare_document);
+        tab->spare_document = NULL;
+    }
+    tab->discarded = true;
+    tab->restore_scroll_y = scroll_y;
+
+    lv_obj_t *label = lv_label_create(tab->content_area);
+    lv_label_set_text(label, "Discarded to save memory");
+    lv_obj_center(label);
+    lv_obj_set_style_text_color(label, lv_color_hex(0x808080), 0);
+    trace_event("discarded tab %s", tab->url);
 }
 
-// Load URL into specified tab
+// Discard least recently shown background tabs until all tabs fit the budget
+static void memory_timer_cb(lv_timer_t *timer) {
+    size_t total = 0;
+    for (int i = 0; i < tab_count; i++) {
+        Tab *tab = tabs[i];
+        tab->accounted_bytes = (tab->discarded || !tab->content_area) ? 0 : tab_memory_total(tab);
+        total += tab->accounted_bytes;
+    }
+
+    while (total > tab_memory_budget) {
+        Tab *victim = NULL;
+        for (int i = 0; i < tab_count; i++) {
+            Tab *tab = tabs[i];
+            if (i == active_tab || tab->accounted_bytes == 0) continue;
+            if (!victim || tab->last_active_us < victim->last_active_us) victim = tab;
+        }
+        if (!victim) return; // Only the active tab is left
+        discard_tab(victim);
+        total -= victim->accounted_bytes;
+        victim->accounted_bytes = 0;
+    }
+}
+
+// Start of every display refresh, before LVGL lays out and draws: animation
+// frame callbacks run, then the DOM changes they and earlier timers made
+// reach the widgets in one batch
+static void frame_start_cb(lv_event_t *e) {
+    for (int i = 0; i < tab_count; i++) {
+        Tab *tab = tabs[i];
+        if (!script_context_ready(&tab->scripts.context)) continue;
+        script_context_frame(&tab->scripts.context, i != active_tab);
+        if (tab->document) apply_script_mutations(tab);
+    }
+}
+
+// Fetch `url` into the tab. The document downloads through the loader while
+// the UI keeps running, so a later navigation can supersede it.
+// A saved snapshot is painted first and replaced once the fetch completes.
+// Local documents are read and rendered at once.
+static void begin_navigation(Tab *tab, const char *url) {
+    if (strcmp(url, ABOUT_MEMORY_URL) == 0) {
+        render_memory_page(tab);
+        return;
+    }
+
+    bool local = local_url_is_local(url);
+    if (!local && !paint_snapshot(tab, url)) {
+        lv_obj_t *loading_label = lv_label_create(tab->content_area);
+        lv_label_set_text(loading_label, "Loading...");
+        lv_obj_center(loading_label);
+        lv_obj_set_style_text_color(loading_label, lv_color_hex(0xFFD93D), 0);
+    }
+
+    Navigation *nav = calloc(1, sizeof(Navigation));
+    if (!nav) return;
+    nav->tab = tab;
+    nav->generation = tab->generation;
+    preload_scanner_init(&nav->scanner, url, tab);
+    nav->document = take_document(tab);
+    if (local && nav->document) {
+        nav->status = lxb_html_document_parse_chunk_begin(nav->document);
+        if (nav->status == LXB_STATUS_OK) parse_guard_attach(&nav->guard, nav->document);
+        tab->navigation = nav;
+        navigation_load_local(nav, url);
+        return;
+    }
+    nav->request = nav->document ? loader_request(url, LOAD_PRIORITY_DOCUMENT, nav, navigation_done, nav) : NULL;
+    if (!nav->request) {
+        show_page_error(tab, "Failed to load page. Check your connection.");
+        navigation_free(nav);
+        return;
+    }
+    nav->status = lxb_html_document_parse_chunk_begin(nav->document);
+    if (nav->status == LXB_STATUS_OK) parse_guard_attach(&nav->guard, nav->document);
+    loader_stream(nav->request, navigation_chunk, nav);
+    tab->navigation = nav;
+}
+
+static void set_tab_url(Tab *tab, const char *url) {
+    // Copy first: `url` may be the old URL or the address bar's own text
+    char *copy = safe_strdup(url);
+    if (!copy) return;
+    free(tab->url);
+    tab->url = copy;
+    if (tab == tabs[active_tab]) lv_textarea_set_text(address_bar, tab->url);
+}
+
+static bool url_is_loadable(const char *url) {
+    return strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0 ||
+           local_url_is_local(url) || strcmp(url, ABOUT_MEMORY_URL) == 0;
+}
+
+// Navigate the specified tab to a new URL, adding it to the tab's history
 void load_url(const char *url, int tab_index) {
-    if (!url || strlen(url) == 0 || tab_index >= MAX_TABS) return;
+    if (!url || strlen(url) == 0 || tab_index < 0 || tab_index >= tab_count) return;
+    Tab *tab = tabs[tab_index];
     
     // Validate URL format
-    if (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) {
-        lv_obj_t *error_label = lv_label_create(tabs[tab_index].content_area);
-        lv_label_set_text(error_label, "Invalid URL format. Please use http:// or https://");
+    if (!url_is_loadable(url)) {
+        lv_obj_t *error_label = lv_label_create(tab->content_area);
+        lv_label_set_text(error_label, "Invalid URL format. Please use http://, https://, file:// or data:");
         lv_obj_center(error_label);
         lv_obj_set_style_text_color(error_label, lv_color_hex(0xFF6B6B), 0);
         return;
     }
 
-    // FIX: Create a temporary buffer to avoid overlap
-    char temp_url[MAX_URL_LENGTH];
-    strncpy(temp_url, url, MAX_URL_LENGTH - 1);
-    temp_url[MAX_URL_LENGTH - 1] = '\0';
-    
-    // Update tab URL using the temporary buffer
-    strncpy(tabs[tab_index].url, temp_url, MAX_URL_LENGTH - 1);
-    tabs[tab_index].url[MAX_URL_LENGTH - 1] = '\0';
-
-    // Show loading message
-    lv_obj_clean(tabs[tab_index].content_area);
-    lv_obj_t *loading_label = lv_label_create(tabs[tab_index].content_area);
-    lv_label_set_text(loading_label, "Loading...");
-    lv_obj_center(loading_label);
-    lv_obj_set_style_text_color(loading_label, lv_color_hex(0xFFD93D), 0);
-
-    // Download HTML
-    char *html = download_html(temp_url); // Use temp_url instead of url
-    if (!html) {
-        lv_obj_clean(tabs[tab_index].content_area);
-        lv_obj_t *error_label = lv_label_create(tabs[tab_index].content_area);
-        lv_label_set_text(error_label, "Failed to load page. Check your connection.");
-        lv_obj_center(error_label);
-        lv_obj_set_style_text_color(error_label, lv_color_hex(0xFF6B6B), 0);
+    trace_page_begin(url);
+    leave_page(tab, true);
+    set_tab_url(tab, url);
+    history_push(&tab->history, tab->url);
+    update_history_buttons();
+    begin_navigation(tab, tab->url);
+}
+
+// Fetch the current entry again, dropping the live page rather than freezing it
+static void reload_tab(Tab *tab) {
+    trace_page_begin(tab->url);
+    leave_page(tab, false);
+    begin_navigation(tab, tab->url);
+}
+
+// Back (-1) or forward (+1): a frozen page comes straight back, otherwise
+// the entry is fetched again
+static void go_history(Tab *tab, int delta) {
+    if (!history_can_go(&tab->history, delta)) return;
+    HistoryEntry *entry = tab->history.entries[tab->history.index + delta];
+
+    trace_page_begin(entry->url);
+    leave_page(tab, true);
+    history_go(&tab->history, delta);
+    set_tab_url(tab, entry->url);
+    update_history_buttons();
+    if (restore_page(tab, entry)) {
+        trace_page_end();
         return;
     }
+    begin_navigation(tab, entry->url);
+}
 
-    // Parse HTML
-    lxb_html_document_t *document = lxb_html_document_create();
-    if (!document) {
-        free(html);
-        return;
+// Viewport changes only restyle records that depend on the viewport
+static void content_size_event_cb(lv_event_t *e) {
+    Tab *tab = (Tab *)lv_event_get_user_data(e);
+    if (!tab->document) return;
+
+    style_set_viewport(&tab->styles, lv_obj_get_content_width(tab->content_area));
+    style_flush(&tab->styles);
+}
+
+// Create the scrollable content area in the tab's page
+static void init_tab_content(Tab *tab) {
+    tab->content_area = lv_obj_create(tab->page);
+    lv_obj_set_size(tab->content_area, LV_PCT(100), LV_PCT(100));
+    lv_obj_set_scrollbar_mode(tab->content_area, LV_SCROLLBAR_MODE_AUTO);
+    lv_obj_set_style_bg_color(tab->content_area, lv_color_hex(0x1E1E1E), 0);
+    lv_obj_set_style_border_width(tab->content_area, 0, 0);
+    lv_obj_set_style_text_font(tab->content_area, fonts_body(), 0);
+    lv_obj_add_event_cb(tab->content_area, content_size_event_cb, LV_EVENT_SIZE_CHANGED, tab);
+    image_queue_init(&tab->images, tab->content_area);
+}
+
+// Add a tab record and its tabview button. The content area is only built
+// when the tab is first shown.
+static Tab *add_tab(const char *url, const char *name) {
+    if (tab_count == tab_capacity) {
+        int capacity = tab_capacity ? tab_capacity * 2 : 8;
+        Tab **grown = realloc(tabs, (size_t)capacity * sizeof(Tab *));
+        if (!grown) {
+            fprintf(stderr, "Failed to allocate tab list\n");
+            return NULL;
+        }
+        tabs = grown;
+        tab_capacity = capacity;
     }
 
-    if (lxb_html_document_parse(document, (const lxb_char_t *)html, strlen(html)) != LXB_STATUS_OK) {
-        lv_obj_clean(tabs[tab_index].content_area);
-        lv_obj_t *error_label = lv_label_create(tabs[tab_index].content_area);
-        lv_label_set_text(error_label, "Failed to parse HTML content");
-        lv_obj_center(error_label);
-        lv_obj_set_style_text_color(error_label, lv_color_hex(0xFF6B6B), 0);
-        lxb_html_document_destroy(document);
-        free(html);
-        return;
+    Tab *tab = calloc(1, sizeof(Tab));
+    if (!tab || !(tab->url = safe_strdup(url))) {
+        fprintf(stderr, "Failed to allocate tab\n");
+        free(tab);
+        return NULL;
     }
+    tab->page = lv_tabview_add_tab(tabview, name);
+    history_init(&tab->history);
+    style_map_init(&tab->styles, 0);
+    arena_init(&tab->arena, 0);
+    tab->last_active_us = trace_now_us();
+    tabs[tab_count++] = tab;
+    return tab;
+}
 
-    // Extract title and update tab (simplified for space)
-    char *title = extract_title(document);
-    
-    // Render content
-    render_html_content(document, tabs[tab_index].content_area);
+static void free_tab(Tab *tab) {
+    // Widgets are cleaned up by LVGL, documents are ours
+    navigation_abandon(tab);
+    script_scheduler_free(&tab->scripts);
+    snapshot_close(&tab->snapshot);
+    if (tab->document) lxb_html_document_destroy(tab->document);
+    if (tab->spare_document) lxb_html_document_destroy(tab->spare_document);
+    style_map_free(&tab->styles);
+    image_queue_free(&tab->images);
+    history_free(&tab->history);
+    free(tab->url);
+    arena_free(&tab->arena);
+    free(tab);
+}
 
-    // Cleanup
-    free(title);
-    lxb_html_document_destroy(document);
-    free(html);
+// Make tab `index` the active one, building and loading it on first show
+// and reloading it after a discard
+static void activate_tab(int index) {
+    if (index < 0 || index >= tab_count) return;
+    if (active_tab < tab_count) tabs[active_tab]->last_active_us = trace_now_us();
+    active_tab = index;
+    Tab *tab = tabs[index];
+    tab->last_active_us = trace_now_us();
+    lv_textarea_set_text(address_bar, tab->url);
+    update_history_buttons();
+
+    if (!tab->content_area) {
+        init_tab_content(tab);
+        load_url(tab->url, index);
+    } else if (tab->discarded) {
+        // Keep the scroll position discard_tab() saved
+        int32_t scroll_y = tab->restore_scroll_y;
+        tab->discarded = false;
+        trace_page_begin(tab->url);
+        leave_page(tab, false);
+        tab->restore_scroll_y = scroll_y;
+        begin_navigation(tab, tab->url);
+    }
 }
 
 // Event handlers
@@ -280,30 +1114,25 @@ static void address_bar_event_cb(lv_event_t *e) {
 }
 
 static void refresh_event_cb(lv_event_t *e) {
-    load_url(tabs[active_tab].url, active_tab);
+    reload_tab(tabs[active_tab]);
+}
+
+static void back_event_cb(lv_event_t *e) {
+    go_history(tabs[active_tab], -1);
+}
+
+static void forward_event_cb(lv_event_t *e) {
+    go_history(tabs[active_tab], 1);
 }
 
 static void new_tab_event_cb(lv_event_t *e) {
-    if (tab_count < MAX_TABS) {
-        strncpy(tabs[tab_count].url, "https://example.com", MAX_URL_LENGTH - 1);
-        
-        lv_obj_t *tab_content = lv_tabview_add_tab(tabview, "New Tab");
-        tabs[tab_count].content_area = lv_obj_create(tab_content);
-        lv_obj_set_size(tabs[tab_count].content_area, LV_PCT(100), LV_PCT(100));
-        lv_obj_set_scrollbar_mode(tabs[tab_count].content_area, LV_SCROLLBAR_MODE_AUTO);
-        lv_obj_set_style_bg_color(tabs[tab_count].content_area, lv_color_hex(0x1E1E1E), 0);
-        lv_obj_set_style_border_width(tabs[tab_count].content_area, 0, 0);
-        
-        tab_count++;
-        lv_tabview_set_act(tabview, tab_count - 1, false);
-    }
+    if (!add_tab(DEFAULT_URL, "New Tab")) return;
+    lv_tabview_set_act(tabview, tab_count - 1, false);
+    activate_tab(tab_count - 1);
 }
 
 static void tab_changed_event_cb(lv_event_t *e) {
-    active_tab = lv_tabview_get_tab_act(tabview);
-    if (active_tab < tab_count) {
-        lv_textarea_set_text(address_bar, tabs[active_tab].url);
-    }
+    activate_tab((int)lv_tabview_get_tab_act(tabview));
 }
 
 // Handle Enter key press for address bar
@@ -402,24 +1231,45 @@ void init_browser_ui(void) {
     
     // Main container
     lv_obj_t *main_cont = lv_obj_create(lv_screen_active());
-    lv_obj_set_size(main_cont, SCREEN_WIDTH, SCREEN_HEIGHT);
+    lv_obj_set_size(main_cont, LV_PCT(100), LV_PCT(100));
     lv_obj_set_style_bg_color(main_cont, lv_color_hex(0x0D1117), 0);
     lv_obj_set_style_border_width(main_cont, 0, 0);
     lv_obj_set_style_radius(main_cont, 0, 0);
     lv_obj_set_style_pad_all(main_cont, 0, 0);
+    // Column layout so the page area follows window resizes
+    lv_obj_set_flex_flow(main_cont, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_style_pad_row(main_cont, 0, 0);
 
     // Navigation bar
     lv_obj_t *nav_bar = lv_obj_create(main_cont);
-    lv_obj_set_size(nav_bar, SCREEN_WIDTH, 50);
+    lv_obj_set_size(nav_bar, LV_PCT(100), 50);
     lv_obj_align(nav_bar, LV_ALIGN_TOP_MID, 0, 0);
     lv_obj_set_style_bg_color(nav_bar, lv_color_hex(0x21262D), 0);
     lv_obj_set_style_border_width(nav_bar, 0, 0);
     lv_obj_set_style_radius(nav_bar, 0, 0);
 
     // Navigation buttons
+    btn_back = lv_btn_create(nav_bar);
+    lv_obj_set_size(btn_back, 40, 30);
+    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 10, 0);
+    lv_obj_t *back_label = lv_label_create(btn_back);
+    lv_label_set_text(back_label, LV_SYMBOL_LEFT);
+    lv_obj_center(back_label);
+    lv_obj_add_event_cb(btn_back, back_event_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_add_state(btn_back, LV_STATE_DISABLED);
+
+    btn_forward = lv_btn_create(nav_bar);
+    lv_obj_set_size(btn_forward, 40, 30);
+    lv_obj_align(btn_forward, LV_ALIGN_LEFT_MID, 60, 0);
+    lv_obj_t *forward_label = lv_label_create(btn_forward);
+    lv_label_set_text(forward_label, LV_SYMBOL_RIGHT);
+    lv_obj_center(forward_label);
+    lv_obj_add_event_cb(btn_forward, forward_event_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_add_state(btn_forward, LV_STATE_DISABLED);
+
     lv_obj_t *btn_refresh = lv_btn_create(nav_bar);
     lv_obj_set_size(btn_refresh, 40, 30);
-    lv_obj_align(btn_refresh, LV_ALIGN_LEFT_MID, 10, 0);
+    lv_obj_align(btn_refresh, LV_ALIGN_LEFT_MID, 110, 0);
     lv_obj_t *refresh_label = lv_label_create(btn_refresh);
     lv_label_set_text(refresh_label, LV_SYMBOL_REFRESH);
     lv_obj_center(refresh_label);
@@ -427,7 +1277,7 @@ void init_browser_ui(void) {
 
     lv_obj_t *btn_new_tab = lv_btn_create(nav_bar);
     lv_obj_set_size(btn_new_tab, 40, 30);
-    lv_obj_align(btn_new_tab, LV_ALIGN_LEFT_MID, 60, 0);
+    lv_obj_align(btn_new_tab, LV_ALIGN_LEFT_MID, 160, 0);
     lv_obj_t *new_tab_label = lv_label_create(btn_new_tab);
     lv_label_set_text(new_tab_label, "+");
     lv_obj_center(new_tab_label);
@@ -436,29 +1286,22 @@ void init_browser_ui(void) {
     // Address bar
     address_bar = lv_textarea_create(nav_bar);
     lv_textarea_set_one_line(address_bar, true);
-    lv_obj_set_size(address_bar, SCREEN_WIDTH - 200, 30);
+    lv_obj_set_size(address_bar, SCREEN_WIDTH - 300, 30);
     lv_obj_align(address_bar, LV_ALIGN_RIGHT_MID, -10, 0);
-    lv_textarea_set_text(address_bar, "https://example.com");
+    lv_textarea_set_text(address_bar, DEFAULT_URL);
     lv_obj_set_style_bg_color(address_bar, lv_color_hex(0x0D1117), 0);
     lv_obj_set_style_text_color(address_bar, lv_color_hex(0xF0F6FC), 0);
     lv_obj_add_event_cb(address_bar, address_bar_event_cb, LV_EVENT_READY, NULL);
 
     // Tab view
     tabview = lv_tabview_create(main_cont);
-    lv_obj_set_size(tabview, SCREEN_WIDTH, SCREEN_HEIGHT - 50);
-    lv_obj_align(tabview, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_obj_set_width(tabview, LV_PCT(100));
+    lv_obj_set_flex_grow(tabview, 1);
     lv_obj_set_style_bg_color(tabview, lv_color_hex(0x0D1117), 0);
     lv_obj_add_event_cb(tabview, tab_changed_event_cb, LV_EVENT_VALUE_CHANGED, NULL);
 
     // Create first tab
-    lv_obj_t *tab1 = lv_tabview_add_tab(tabview, "Home");
-    tabs[0].content_area = lv_obj_create(tab1);
-    lv_obj_set_size(tabs[0].content_area, LV_PCT(100), LV_PCT(100));
-    lv_obj_set_scrollbar_mode(tabs[0].content_area, LV_SCROLLBAR_MODE_AUTO);
-    lv_obj_set_style_bg_color(tabs[0].content_area, lv_color_hex(0x1E1E1E), 0);
-    lv_obj_set_style_border_width(tabs[0].content_area, 0, 0);
-    
-    strncpy(tabs[0].url, "https://example.com", MAX_URL_LENGTH - 1);
+    add_tab(DEFAULT_URL, "Home");
 
     // Add input objects to group
     lv_group_add_obj(input_group, address_bar);
@@ -471,8 +1314,189 @@ void init_browser_ui(void) {
     }
 }
 
+// Reopen the tabs of the last session. Only the first one is built and
+// loaded (painting its snapshot straight from disk if there is one); the
+// others stay records until they are shown.
+static void restore_session(void) {
+    char *session = snapshot_session_load();
+    int restored = 0;
+    for (char *line = session ? strtok(session, "\r\n") : NULL; line; line = strtok(NULL, "\r\n")) {
+        if (!url_is_loadable(line)) continue;
+        if (restored == 0) {
+            set_tab_url(tabs[0], line);
+        } else if (!add_tab(line, "Tab")) {
+            break;
+        }
+        restored++;
+    }
+    free(session);
+    activate_tab(0);
+}
+
+// Soak run (--soak [N] [url...]): navigate the first tab N times through
+// the URLs and fail if memory still grows once history and caches have
+// filled. LVGL's pool only holds widgets, so malloc and the resident set
+// are sampled too; lexbor, curl, Elk and the caches leak there. A
+// least-squares slope over each series ignores the page-to-page noise that
+// comparing the first and last sample would not.
+typedef enum {
+    SOAK_WIDGETS,  // LVGL's pool, or the tabs' estimate without one
+    SOAK_MALLOC,
+    SOAK_RESIDENT,
+    SOAK_SERIES
+} SoakSeries;
+
+static const char *soak_series_names[SOAK_SERIES] = {
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+    "LVGL heap",
+#else
+    "tab estimate",
+#endif
+    "malloc",
+    "resident set",
+};
+
+// Bytes per navigation each series may grow by before the soak fails. The
+// resident set moves a page at a time.
+static const double soak_series_limits[SOAK_SERIES] = {SOAK_LEAK_LIMIT, SOAK_LEAK_LIMIT, SOAK_RESIDENT_LEAK_LIMIT};
+
+typedef struct {
+    char **urls;
+    int url_count;
+    int navigations;
+    int done;
+    bool waiting;       // A navigation was started and has not finished
+    double *samples[SOAK_SERIES]; // Bytes after each navigation past the warmup
+    int sample_count;
+    int max_frag;
+    int status;         // Process exit code once finished, -1 while running
+} Soak;
+
+static Soak soak = {.status = -1};
+
+// Bytes of LVGL heap in use and how fragmented the free space is
+static size_t soak_heap_used(int *frag_pct) {
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+    lv_mem_monitor_t monitor;
+    lv_mem_monitor(&monitor);
+    *frag_pct = monitor.frag_pct;
+    return monitor.total_size - monitor.free_size;
+#else
+    // The system allocator reports nothing; fall back to the tabs' estimate
+    *frag_pct = 0;
+    size_t total = 0;
+    for (int i = 0; i < tab_count; i++) total += tab_memory_total(tabs[i]);
+    return total;
+#endif
+}
+
+static void soak_sample(size_t out[SOAK_SERIES], int *frag_pct) {
+    ProcessMemory process;
+    process_memory_sample(&process);
+    out[SOAK_WIDGETS] = soak_heap_used(frag_pct);
+    out[SOAK_MALLOC] = process.malloc_bytes;
+    out[SOAK_RESIDENT] = process.resident_bytes;
+}
+
+// Least-squares slope of `samples` against the navigation number
+static double soak_slope(const double *samples, int count) {
+    double n = count, sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
+    for (int i = 0; i < count; i++) {
+        sum_x += i;
+        sum_y += samples[i];
+        sum_xy += i * samples[i];
+        sum_xx += (double)i * i;
+    }
+    double denominator = n * sum_xx - sum_x * sum_x;
+    return denominator > 0 ? (n * sum_xy - sum_x * sum_y) / denominator : 0;
+}
+
+static void soak_finish(void) {
+    int frag_pct;
+    size_t last[SOAK_SERIES];
+    soak_sample(last, &frag_pct);
+    Arena *arena = &tabs[0]->arena;
+
+    bool pass = soak.sample_count > 1;
+    printf("soak: %d navigations, %d sampled after a warmup of %d\n", soak.done, soak.sample_count, SOAK_WARMUP);
+    for (int s = 0; s < SOAK_SERIES && soak.sample_count > 0; s++) {
+        if (last[s] == 0 && soak.samples[s][0] == 0) {
+            printf("soak: %-13s not reported on this platform\n", soak_series_names[s]);
+            continue;
+        }
+        double slope = soak_slope(soak.samples[s], soak.sample_count);
+        bool grows = slope > soak_series_limits[s];
+        printf("soak: %-13s %lu KB after warmup, %lu KB at the end, %+.1f bytes per navigation%s\n",
+               soak_series_names[s], KB((size_t)soak.samples[s][0]), KB(last[s]), slope, grows ? ", too much" : "");
+        if (grows) pass = false;
+    }
+    printf("soak: fragmentation %d%% at the end, %d%% at worst\n", frag_pct, soak.max_frag);
+    printf("soak: page arena peak %lu KB, %lu KB reserved\n", KB(arena->high_water), KB(arena->reserved));
+    printf("soak: %s\n", soak.sample_count > 1 ? (pass ? "PASS" : "FAIL, memory trends upward") : "FAIL, too few navigations");
+    for (int s = 0; s < SOAK_SERIES; s++) {
+        free(soak.samples[s]);
+        soak.samples[s] = NULL;
+    }
+    soak.status = pass ? 0 : 1;
+}
+
+static void soak_timer_cb(lv_timer_t *timer) {
+    Tab *tab = tabs[0];
+    if (soak.waiting) {
+        if (tab->navigation) return; // Still loading
+        soak.waiting = false;
+        soak.done++;
+        int frag_pct;
+        size_t sample[SOAK_SERIES];
+        soak_sample(sample, &frag_pct);
+        if (soak.done > SOAK_WARMUP) {
+            for (int s = 0; s < SOAK_SERIES; s++) soak.samples[s][soak.sample_count] = (double)sample[s];
+            soak.sample_count++;
+            if (frag_pct > soak.max_frag) soak.max_frag = frag_pct;
+        }
+    }
+    if (soak.done >= soak.navigations) {
+        lv_timer_delete(timer);
+        soak_finish();
+        return;
+    }
+    soak.waiting = true;
+    load_url(soak.urls[soak.done % soak.url_count], 0);
+}
+
+// Recognise --soak; returns false if the arguments do not ask for one
+static bool soak_parse(int argc, char **argv) {
+    if (argc < 2 || strcmp(argv[1], "--soak") != 0) return false;
+    int first = 2;
+    soak.navigations = SOAK_DEFAULT_NAVIGATIONS;
+    if (argc > first && atoi(argv[first]) > 0) soak.navigations = atoi(argv[first++]);
+    static char *default_urls[] = {DEFAULT_URL};
+    soak.urls = argc > first ? argv + first : default_urls;
+    soak.url_count = argc > first ? argc - first : 1;
+    for (int i = 0; i < SOAK_SERIES; i++) {
+        soak.samples[i] = malloc((size_t)soak.navigations * sizeof(double));
+        if (!soak.samples[i]) {
+            fprintf(stderr, "Failed to allocate soak samples\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+static void save_session(void) {
+    const char **urls = malloc((size_t)(tab_count ? tab_count : 1) * sizeof(char *));
+    if (!urls) return;
+    for (int i = 0; i < tab_count; i++) urls[i] = tabs[i]->url;
+    snapshot_session_save(urls, tab_count);
+    free(urls);
+}
+
 // Main function
-int main(void) {
+int main(int argc, char **argv) {
+    int bench_status = bench_run(argc, argv);
+    if (bench_status >= 0) return bench_status;
+    bool soaking = soak_parse(argc, argv);
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         fprintf(stderr, "SDL init failed: %s\n", SDL_GetError());
@@ -481,6 +1505,10 @@ int main(void) {
 
     // Initialize LVGL
     lv_init();
+    fonts_init();
+    image_cache_init(IMAGE_CACHE_DEFAULT_BUDGET);
+    bfcache_init(BFCACHE_DEFAULT_BUDGET);
+    decode_pool_init(0);
     
     // Create display
     lv_display_t *display = lv_sdl_window_create(SCREEN_WIDTH, SCREEN_HEIGHT);
@@ -503,12 +1531,26 @@ int main(void) {
 
     // Initialize CURL
     curl_global_init(CURL_GLOBAL_DEFAULT);
+    loader_init();
+    script_cache_init();
+    snapshot_init();
 
     // Initialize browser UI
     init_browser_ui();
     
-    // Load initial page
-    load_url(tabs[0].url, 0);
+    // Load the initial pages. A soak starts from a single fresh tab and
+    // leaves the saved session alone.
+    if (soaking) {
+        activate_tab(0);
+        lv_timer_create(soak_timer_cb, SOAK_POLL_MS, NULL);
+    } else {
+        restore_session();
+    }
+
+    const char *budget_env = getenv(TAB_BUDGET_ENV);
+    if (budget_env && atoi(budget_env) > 0) tab_memory_budget = (size_t)atoi(budget_env) * 1024 * 1024;
+    lv_timer_create(memory_timer_cb, MEMORY_CHECK_MS, NULL);
+    lv_display_add_event_cb(display, frame_start_cb, LV_EVENT_REFR_START, NULL);
 
     // Main event loop
     bool running = true;
@@ -538,18 +1580,32 @@ int main(void) {
             }
         }
         
+        // Subresource transfers, then finished image decodes replace their
+        // placeholders
+        loader_pump();
+        decode_pool_poll();
+        script_cache_idle();
+
         // Handle LVGL tasks
         lv_timer_handler();
+        if (soak.status >= 0) running = false;
         SDL_Delay(5); // ~200 FPS limit
     }
 
     // Cleanup
-    for (int i = 0; i < tab_count; i++) {
-        // Tabs are automatically cleaned up by LVGL
-    }
+    if (!soaking) save_session();
+    for (int i = 0; i < tab_count; i++) free_tab(tabs[i]);
+    free(tabs);
     
     lv_group_del(input_group);
+    bfcache_deinit();
+    loader_shutdown();
+    script_cache_shutdown();
+    snapshot_shutdown();
+    decode_pool_shutdown();
+    image_cache_deinit();
+    fonts_deinit();
     curl_global_cleanup();
     SDL_Quit();
-    return 0;
+    return soak.status > 0 ? soak.status : 0;
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <mach/mach.h>
+#elif defined(__linux__)
+#include <malloc.h>
+#include <unistd.h>
+#endif
+
+#define WIDGET_OVERHEAD 160 // lv_obj_t plus its style list and event bookkeeping
+#define DOM_BYTES_PER_SOURCE_BYTE 4
+
+static void measure_widget(PageMemory *out, lv_obj_t *obj) {
+    out->widgets += WIDGET_OVERHEAD;
+    if (lv_obj_check_type(obj, &lv_label_class)) {
+        const char *text = lv_label_get_text(obj);
+        if (text) out->text += strlen(text) + 1;
+    } else if (lv_obj_check_type(obj, &lv_image_class)) {
+        // Pinned in the image cache for as long as the widget exists
+        const lv_image_dsc_t *dsc = (const lv_image_dsc_t *)lv_image_get_src(obj);
+        if (dsc && lv_image_src_get_type(dsc) == LV_IMAGE_SRC_VARIABLE) out->images += dsc->data_size;
+    }
+
+    uint32_t children = lv_obj_get_child_count(obj);
+    for (uint32_t i = 0; i < children; i++) measure_widget(out, lv_obj_get_child(obj, (int32_t)i));
+}
+
+void page_memory_measure(PageMemory *out, lv_obj_t *root, bool include_root,
+                         const StyleMap *styles, size_t source_bytes) {
+    memset(out, 0, sizeof(*out));
+    if (root && include_root) {
+        measure_widget(out, root);
+    } else if (root) {
+        uint32_t children = lv_obj_get_child_count(root);
+        for (uint32_t i = 0; i < children; i++) measure_widget(out, lv_obj_get_child(root, (int32_t)i));
+    }
+    if (styles) out->styles = styles->capacity * sizeof(StyleRecord) + styles->index_capacity * sizeof(uint32_t);
+    out->dom = source_bytes * DOM_BYTES_PER_SOURCE_BYTE;
+}
+
+size_t page_memory_total(const PageMemory *mem) {
+    return mem->widgets + mem->text + mem->dom + mem->styles + mem->images + mem->scripts;
+}
+
+void process_memory_sample(ProcessMemory *out) {
+    memset(out, 0, sizeof(*out));
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        out->resident_bytes = counters.WorkingSetSize;
+    }
+#elif defined(__APPLE__)
+    out->malloc_bytes = mstats().bytes_used;
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        out->resident_bytes = info.resident_size;
+    }
+#elif defined(__linux__)
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    out->malloc_bytes = info.uordblks + info.hblkhd; // Arena chunks in use plus mmapped blocks
+#endif
+    // Second field of statm: resident pages
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file) {
+        unsigned long size, resident;
+        if (fscanf(file, "%lu %lu", &size, &resident) == 2) {
+            out->resident_bytes = (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+        }
+        fclose(file);
+    }
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <lvgl.h>
+
+#include "style.h"
+
+// Estimated memory one page keeps alive, by where it lives
+typedef struct {
+    size_t widgets; // LVGL heap: objects with their styles and event lists
+    size_t text;    // Label text
+    size_t dom;     // lexbor document, from the size of its source HTML
+    size_t styles;  // Computed style records
+    size_t images;  // Decoded bitmaps pinned in the image cache by this page
+    size_t scripts; // JS heap arena and DOM side table (set by the caller, which owns the context)
+} PageMemory;
+
+// Walk the widgets under `root` (the root itself included when
+// `include_root` is set). `styles` may be NULL.
+void page_memory_measure(PageMemory *out, lv_obj_t *root, bool include_root,
+                         const StyleMap *styles, size_t source_bytes);
+
+size_t page_memory_total(const PageMemory *mem);
+
+// The whole process, as the platform reports it; zero where it does not.
+// Lexbor, curl, Elk and the caches allocate from the system heap, which
+// the page estimates above and LVGL's pool never see.
+typedef struct {
+    size_t malloc_bytes;   // Handed out by malloc and not yet freed
+    size_t resident_bytes; // Resident set
+} ProcessMemory;
+
+void process_memory_sample(ProcessMemory *out);
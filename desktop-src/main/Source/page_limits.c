@@ -0,0 +1,79 @@
+#include "page_limits.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Back up to the start of a UTF-8 sequence so a cut never splits a character
+static size_t utf8_boundary(const lxb_char_t *text, size_t len) {
+    while (len > 0 && (text[len] & 0xC0) == 0x80) len--;
+    return len;
+}
+
+static lxb_html_token_t *guard_token(lxb_html_tokenizer_t *tkz, lxb_html_token_t *token, void *ctx) {
+    ParseGuard *guard = (ParseGuard *)ctx;
+    if (token->tag_id == LXB_TAG__END_OF_FILE) return guard->tree_callback(tkz, token, guard->tree_ctx);
+
+    bool close = token->type & LXB_HTML_TOKEN_TYPE_CLOSE;
+    if (token->tag_id == LXB_TAG_SCRIPT || token->tag_id == LXB_TAG_STYLE) {
+        guard->raw_tag = close ? LXB_TAG__UNDEF : token->tag_id;
+    }
+    // End tags still reach the tree so what was built closes properly
+    if (close) return guard->tree_callback(tkz, token, guard->tree_ctx);
+
+    if (guard->nodes >= PAGE_LIMIT_NODES) {
+        guard->hits |= PAGE_LIMIT_HIT_NODES;
+        return token; // Dropped
+    }
+
+    if (token->tag_id == LXB_TAG__TEXT && guard->raw_tag == LXB_TAG__UNDEF) {
+        size_t len = (size_t)(token->text_end - token->text_start);
+        size_t left = PAGE_LIMIT_TEXT_BYTES - guard->text_bytes;
+        if (len > left) {
+            guard->hits |= PAGE_LIMIT_HIT_TEXT;
+            len = utf8_boundary(token->text_start, left);
+            if (len == 0) return token;
+            token->text_end = token->text_start + len;
+        }
+        guard->text_bytes += len;
+    }
+    guard->nodes++;
+    return guard->tree_callback(tkz, token, guard->tree_ctx);
+}
+
+void parse_guard_attach(ParseGuard *guard, lxb_html_document_t *document) {
+    memset(guard, 0, sizeof(*guard));
+    lxb_html_parser_t *parser = document->dom_document.parser;
+    if (!parser) return;
+    guard->tkz = parser->tkz;
+    guard->tree_callback = guard->tkz->callback_token_done;
+    guard->tree_ctx = guard->tkz->callback_token_ctx;
+    lxb_html_tokenizer_callback_token_done_set(guard->tkz, guard_token, guard);
+}
+
+void parse_guard_detach(ParseGuard *guard) {
+    if (!guard->tkz) return;
+    lxb_html_tokenizer_callback_token_done_set(guard->tkz, guard->tree_callback, guard->tree_ctx);
+    guard->tkz = NULL;
+}
+
+bool page_limits_notice(uint32_t hits, char *out, size_t size) {
+    if (!hits || size == 0) return false;
+    static const struct {
+        PageLimitHit hit;
+        const char *reason;
+    } reasons[] = {
+        {PAGE_LIMIT_HIT_NODES, "too many elements"},
+        {PAGE_LIMIT_HIT_TEXT, "too much text"},
+        {PAGE_LIMIT_HIT_DEPTH, "nested too deeply"},
+        {PAGE_LIMIT_HIT_WIDGETS, "too much content to show"},
+        {PAGE_LIMIT_HIT_TIME, "took too long to lay out"},
+    };
+    size_t used = (size_t)snprintf(out, size, "This page was shortened:");
+    const char *separator = " ";
+    for (size_t i = 0; i < sizeof(reasons) / sizeof(reasons[0]) && used < size; i++) {
+        if (!(hits & reasons[i].hit)) continue;
+        used += (size_t)snprintf(out + used, size - used, "%s%s", separator, reasons[i].reason);
+        separator = ", ";
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lexbor/html/html.h>
+
+// Resource limits for one page, shared in name and meaning with the ESP
+// build, which carries its own smaller profile. The parser enforces the
+// node and text limits as tokens reach the tree builder; the renderer
+// enforces depth, widgets and time. A page that hits any of them is cut
+// short and shows a notice saying why, instead of exhausting memory or
+// freezing the UI.
+#define PAGE_LIMIT_NODES 50000            // Elements and text runs parsed
+#define PAGE_LIMIT_DEPTH 64               // Nesting rendered as boxes; deeper content is flattened to text
+#define PAGE_LIMIT_WIDGETS 4000           // LVGL objects created
+#define PAGE_LIMIT_TEXT_BYTES (1024 * 1024) // Page text kept, scripts and styles excluded
+#define PAGE_LIMIT_RENDER_MS 250          // Building the widgets
+
+typedef enum {
+    PAGE_LIMIT_HIT_NODES   = 1 << 0,
+    PAGE_LIMIT_HIT_DEPTH   = 1 << 1,
+    PAGE_LIMIT_HIT_WIDGETS = 1 << 2,
+    PAGE_LIMIT_HIT_TEXT    = 1 << 3,
+    PAGE_LIMIT_HIT_TIME    = 1 << 4,
+} PageLimitHit;
+
+// Sits between a document's tokenizer and its tree builder for one parse
+typedef struct {
+    lxb_html_tokenizer_t *tkz;
+    lxb_html_tokenizer_token_f tree_callback; // The tree builder's own hook
+    void *tree_ctx;
+    lxb_tag_id_t raw_tag;  // Script or style whose text is arriving
+    uint32_t nodes;
+    size_t text_bytes;
+    uint32_t hits;         // PageLimitHit flags
+} ParseGuard;
+
+// Call after lxb_html_document_parse_chunk_begin(), and parse_guard_detach()
+// once parsing ends, before the document is parsed again or reused
+void parse_guard_attach(ParseGuard *guard, lxb_html_document_t *document);
+void parse_guard_detach(ParseGuard *guard);
+
+// "This page was shortened: ..." for `hits`; false if there is nothing to say
+bool page_limits_notice(uint32_t hits, char *out, size_t size);
@@ -0,0 +1,267 @@
+#include "preload.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "loader.h"
+#include "url.h"
+
+#define MAX_VALUE_LENGTH 1024
+#define LIKELY_VISIBLE_IMAGES 4
+
+// Kinds the browser consumes; others are recognised but not fetched
+#define PRELOAD_FETCH_MASK ((1u << PRELOAD_IMAGE) | (1u << PRELOAD_SCRIPT))
+
+// First occurrence of `c` in [p, end), or `end`. Compares 16 bytes per step
+// where SSE2 or NEON is available.
+static const char *find_byte(const char *p, const char *end, char c) {
+#if defined(__SSE2__)
+    __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask) return p + __builtin_ctz((unsigned)mask);
+        p += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    uint8x16_t needle = vdupq_n_u8((uint8_t)c);
+    while (end - p >= 16) {
+        uint8x16_t hits = vceqq_u8(vld1q_u8((const uint8_t *)p), needle);
+        if (vmaxvq_u8(hits)) break; // Pinpoint the byte below
+        p += 16;
+    }
+#endif
+    while (p < end && *p != c) p++;
+    return p;
+}
+
+static bool name_equals(const char *name, size_t len, const char *expected) {
+    return strlen(expected) == len && strncasecmp(name, expected, len) == 0;
+}
+
+// Find attribute `name` in the tag body [p, end) by jumping between '='
+// signs, copying its value into `out`
+static bool tag_attribute(const char *p, const char *end, const char *name, char *out) {
+    size_t name_len = strlen(name);
+    const char *eq = find_byte(p, end, '=');
+
+    while (eq < end) {
+        // Attribute name directly before the '=' (spaces allowed)
+        const char *name_end = eq;
+        while (name_end > p && isspace((unsigned char)name_end[-1])) name_end--;
+        const char *name_start = name_end;
+        while (name_start > p && (isalnum((unsigned char)name_start[-1]) || name_start[-1] == '-')) name_start--;
+
+        // Value, quoted or bare
+        const char *v = eq + 1;
+        while (v < end && isspace((unsigned char)*v)) v++;
+        const char *value_end;
+        if (v < end && (*v == '"' || *v == '\'')) {
+            char quote = *v++;
+            value_end = find_byte(v, end, quote);
+        } else {
+            value_end = v;
+            while (value_end < end && !isspace((unsigned char)*value_end)) value_end++;
+        }
+
+        if ((size_t)(name_end - name_start) == name_len && strncasecmp(name_start, name, name_len) == 0) {
+            size_t len = (size_t)(value_end - v);
+            if (len == 0 || len >= MAX_VALUE_LENGTH) return false;
+            memcpy(out, v, len);
+            out[len] = 0;
+            return true;
+        }
+
+        // A '=' inside the value is not an attribute boundary
+        eq = find_byte(value_end < end ? value_end + 1 : end, end, '=');
+    }
+    return false;
+}
+
+// Space-separated token match, e.g. rel="preload stylesheet"
+static bool has_token(const char *list, const char *token) {
+    size_t len = strlen(token);
+    for (const char *p = list; *p;) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        const char *start = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        if ((size_t)(p - start) == len && strncasecmp(start, token, len) == 0) return true;
+    }
+    return false;
+}
+
+static LoadPriority kind_priority(PreloadScanner *scanner, PreloadKind kind) {
+    switch (kind) {
+        case PRELOAD_STYLESHEET:
+        case PRELOAD_FONT:
+            return LOAD_PRIORITY_CSS;
+        case PRELOAD_SCRIPT:
+            return LOAD_PRIORITY_SCRIPT;
+        default:
+            return scanner->images <= LIKELY_VISIBLE_IMAGES ? LOAD_PRIORITY_VISIBLE_IMAGE
+                                                            : LOAD_PRIORITY_OFFSCREEN_IMAGE;
+    }
+}
+
+static void found_resource(PreloadScanner *scanner, PreloadKind kind, const char *ref) {
+    scanner->found[kind]++;
+    if (kind == PRELOAD_IMAGE) scanner->images++;
+    if (!(PRELOAD_FETCH_MASK & (1u << kind))) return;
+
+    char *url = url_resolve(scanner->base_url, ref);
+    if (!url) return;
+    if (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0) {
+        loader_preload(url, kind_priority(scanner, kind), scanner->owner);
+    }
+    free(url);
+}
+
+// Tag body between '<' and '>'
+static void scan_tag(PreloadScanner *scanner, const char *p, const char *end) {
+    const char *name = p;
+    while (p < end && isalnum((unsigned char)*p)) p++;
+    size_t name_len = (size_t)(p - name);
+    char value[MAX_VALUE_LENGTH];
+
+    if (name_equals(name, name_len, "img")) {
+        if (tag_attribute(p, end, "src", value)) found_resource(scanner, PRELOAD_IMAGE, value);
+    } else if (name_equals(name, name_len, "script")) {
+        if (tag_attribute(p, end, "src", value)) found_resource(scanner, PRELOAD_SCRIPT, value);
+    } else if (name_equals(name, name_len, "link")) {
+        char rel[64], as[32];
+        if (!tag_attribute(p, end, "rel", rel) || !tag_attribute(p, end, "href", value)) return;
+
+        if (has_token(rel, "stylesheet")) {
+            found_resource(scanner, PRELOAD_STYLESHEET, value);
+        } else if (has_token(rel, "preload") && tag_attribute(p, end, "as", as)) {
+            if (strcasecmp(as, "style") == 0) found_resource(scanner, PRELOAD_STYLESHEET, value);
+            else if (strcasecmp(as, "script") == 0) found_resource(scanner, PRELOAD_SCRIPT, value);
+            else if (strcasecmp(as, "image") == 0) found_resource(scanner, PRELOAD_IMAGE, value);
+            else if (strcasecmp(as, "font") == 0) found_resource(scanner, PRELOAD_FONT, value);
+        }
+    }
+}
+
+static uint32_t total_found(const PreloadScanner *scanner) {
+    uint32_t total = 0;
+    for (int i = 0; i < PRELOAD_KIND_COUNT; i++) total += scanner->found[i];
+    return total;
+}
+
+void preload_scanner_init(PreloadScanner *scanner, const char *base_url, const void *owner) {
+    memset(scanner, 0, sizeof(*scanner));
+    if (base_url) {
+        scanner->base_url = malloc(strlen(base_url) + 1);
+        if (scanner->base_url) strcpy(scanner->base_url, base_url);
+    }
+    scanner->owner = owner;
+}
+
+void preload_scanner_free(PreloadScanner *scanner) {
+    free(scanner->base_url);
+    scanner->base_url = NULL;
+}
+
+// Past the "-->" that closes the open comment, or `end` with the comment
+// still open and the dashes this chunk ended on remembered for the next
+static const char *skip_comment(PreloadScanner *scanner, const char *p, const char *end) {
+    const char *from = p;
+    for (;;) {
+        const char *close = find_byte(p, end, '>');
+        const char *q = close;
+        while (q > from && close - q < 2 && q[-1] == '-') q--;
+        size_t dashes = (size_t)(close - q) + (q == from ? scanner->comment_dashes : 0);
+        if (close == end) {
+            scanner->comment_dashes = (uint8_t)(dashes < 2 ? dashes : 2);
+            return end;
+        }
+        if (dashes >= 2) {
+            scanner->in_comment = false;
+            return close + 1;
+        }
+        p = close + 1;
+    }
+}
+
+static void begin_comment(PreloadScanner *scanner) {
+    scanner->in_comment = true;
+    scanner->comment_dashes = 0;
+}
+
+void preload_scan(const char *data, size_t len, void *ctx) {
+    PreloadScanner *scanner = (PreloadScanner *)ctx;
+    const char *p = data, *end = data + len;
+    uint32_t before = total_found(scanner);
+
+    if (scanner->carrying && scanner->carry_len < 3 && memcmp(scanner->carry, "!--", scanner->carry_len) == 0) {
+        // A "<!--" cut short by the previous chunk
+        size_t need = 3 - scanner->carry_len, have = len < need ? len : need;
+        if (memcmp(p, "!--" + scanner->carry_len, have) == 0) {
+            if (have < need) {
+                memcpy(scanner->carry + scanner->carry_len, p, have);
+                scanner->carry_len += have;
+                return;
+            }
+            scanner->carrying = false;
+            begin_comment(scanner);
+            p += need;
+        }
+    }
+    if (scanner->carrying) {
+        // Finish the tag that straddled the previous chunk
+        const char *close = find_byte(p, end, '>');
+        size_t take = (size_t)(close - p);
+        if (scanner->carry_len + take > sizeof(scanner->carry)) {
+            scanner->carrying = false; // Too long to be a tag we care about
+        } else {
+            memcpy(scanner->carry + scanner->carry_len, p, take);
+            scanner->carry_len += take;
+            if (close == end) return;
+            scan_tag(scanner, scanner->carry, scanner->carry + scanner->carry_len);
+            scanner->carrying = false;
+        }
+        p = close < end ? close + 1 : end;
+    }
+
+    while (p < end) {
+        // Comments can hold markup that never becomes a request, and may
+        // run on over several chunks
+        if (scanner->in_comment) {
+            p = skip_comment(scanner, p, end);
+            continue;
+        }
+        const char *open = find_byte(p, end, '<');
+        if (open == end) break;
+        const char *body = open + 1;
+
+        if (end - body >= 3 && memcmp(body, "!--", 3) == 0) {
+            begin_comment(scanner);
+            p = body + 3;
+            continue;
+        }
+
+        const char *close = find_byte(body, end, '>');
+        if (close == end) {
+            size_t left = (size_t)(end - body);
+            if (left <= sizeof(scanner->carry)) {
+                memcpy(scanner->carry, body, left);
+                scanner->carry_len = left;
+                scanner->carrying = true;
+            }
+            break;
+        }
+        scan_tag(scanner, body, close);
+        p = close + 1;
+    }
+
+    // Get new fetches on the wire while the document is still downloading
+    if (total_found(scanner) != before) loader_kick();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRELOAD_CARRY 2048 // Longest tag kept across a chunk boundary
+
+typedef enum {
+    PRELOAD_STYLESHEET,
+    PRELOAD_SCRIPT,
+    PRELOAD_IMAGE,
+    PRELOAD_FONT,
+    PRELOAD_KIND_COUNT
+} PreloadKind;
+
+// Byte-level scanner that runs over the document as it arrives, ahead of
+// the tree builder, and starts fetches for the subresources it spots:
+// <img src>, <script src>, <link rel=stylesheet href> and
+// <link rel=preload href as=...>.
+typedef struct {
+    char *base_url;
+    const void *owner;           // Passed to loader_preload()
+    char carry[PRELOAD_CARRY];   // Unfinished tag from the previous chunk
+    size_t carry_len;
+    bool carrying;
+    bool in_comment;             // Inside <!-- --> at the end of the previous chunk
+    uint8_t comment_dashes;      // '-' it ended on, up to the two a "-->" needs
+    uint32_t images;             // Images seen so far, early ones are likely visible
+    uint32_t found[PRELOAD_KIND_COUNT];
+} PreloadScanner;
+
+void preload_scanner_init(PreloadScanner *scanner, const char *base_url, const void *owner);
+void preload_scanner_free(PreloadScanner *scanner);
+
+// Feed the next chunk; matches the http chunk callback signature
+void preload_scan(const char *data, size_t len, void *scanner);
@@ -0,0 +1,634 @@
+#include "script.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elk.h"
+#include "script_cache.h"
+#include "trace.h"
+
+#define CLOCK_CHECK_MASK 255 // Look at the clock every 256 ticks
+
+// Elk natives get no user data; scripts only run on the main thread, one
+// at a time, so the running context is kept here
+static ScriptContext *running;
+
+static jsval_t js_timer_add(struct js *js, jsval_t *args, int nargs);
+static jsval_t js_timer_cancel(struct js *js, jsval_t *args, int nargs);
+
+static jsval_t js_tick(struct js *js, jsval_t *args, int nargs) {
+    ScriptContext *ctx = running;
+    if (!ctx) return js_mkundef();
+    if (++ctx->ticks > ctx->tick_budget ||
+        ((ctx->ticks & CLOCK_CHECK_MASK) == 0 && trace_now_us() > ctx->deadline_us)) {
+        // The error unwinds every frame back to js_eval()
+        ctx->over_budget = true;
+        return js_mkerr(js, "script budget exceeded");
+    }
+    return js_mktrue(); // Loop conditions read it as `__tick()&&(...)`
+}
+
+static jsval_t js_console_log(struct js *js, jsval_t *args, int nargs) {
+    fprintf(stderr, "[js]");
+    for (int i = 0; i < nargs; i++) {
+        if (js_type(args[i]) == JS_STR) {
+            size_t len = 0;
+            const char *str = js_getstr(js, args[i], &len);
+            fprintf(stderr, " %.*s", (int)len, str);
+        } else {
+            fprintf(stderr, " %s", js_str(js, args[i]));
+        }
+    }
+    fputc('\n', stderr);
+    return js_mkundef();
+}
+
+// Handle of `el` for the JS view cache, 0 for none
+static jsval_t element_handle(struct js *js, ScriptDom *dom, lxb_dom_element_t *el) {
+    if (!el) return js_mknum(0);
+    uint32_t handle = script_dom_handle(dom, lxb_dom_interface_node(el));
+    if (!handle) return js_mkerr(js, "out of memory");
+    return js_mknum(handle);
+}
+
+static jsval_t js_dom_by_id(struct js *js, jsval_t *args, int nargs) {
+    if (!running || nargs < 1 || js_type(args[0]) != JS_STR) return js_mknum(0);
+    size_t len = 0;
+    const char *id = js_getstr(js, args[0], &len);
+    return element_handle(js, &running->dom, script_dom_by_id(&running->dom, id, len));
+}
+
+static jsval_t js_dom_query(struct js *js, jsval_t *args, int nargs) {
+    if (!running || nargs < 1 || js_type(args[0]) != JS_STR) return js_mknum(0);
+    size_t len = 0;
+    const char *selector = js_getstr(js, args[0], &len);
+    return element_handle(js, &running->dom, script_dom_query(&running->dom, selector, len));
+}
+
+// Element for the handle in args[0]
+static lxb_dom_element_t *arg_element(jsval_t *args, int nargs) {
+    if (!running || nargs < 1 || js_type(args[0]) != JS_NUM) return NULL;
+    lxb_dom_node_t *node = script_dom_node(&running->dom, (uint32_t)js_getnum(args[0]));
+    return node && node->type == LXB_DOM_NODE_TYPE_ELEMENT ? lxb_dom_interface_element(node) : NULL;
+}
+
+static jsval_t js_dom_attr(struct js *js, jsval_t *args, int nargs) {
+    lxb_dom_element_t *el = arg_element(args, nargs);
+    if (!el || nargs < 2 || js_type(args[1]) != JS_STR) return js_mknull();
+    size_t name_len = 0;
+    const char *name = js_getstr(js, args[1], &name_len);
+    size_t len = 0;
+    const lxb_char_t *value = lxb_dom_element_get_attribute(el, (const lxb_char_t *)name, name_len, &len);
+    return value ? js_mkstr(js, value, len) : js_mknull();
+}
+
+// Element view: the side-table handle plus the fields scripts read most.
+// Made once per handle; the JS side keeps it for later queries.
+static jsval_t js_dom_view(struct js *js, jsval_t *args, int nargs) {
+    lxb_dom_element_t *el = arg_element(args, nargs);
+    if (!el) return js_mknull();
+    jsval_t obj = js_mkobj(js);
+    js_set(js, obj, "__node", args[0]);
+    size_t len = 0;
+    const lxb_char_t *value = lxb_dom_element_tag_name(el, &len);
+    js_set(js, obj, "tagName", js_mkstr(js, value ? (const char *)value : "", value ? len : 0));
+    len = 0;
+    value = lxb_dom_element_id(el, &len);
+    js_set(js, obj, "id", js_mkstr(js, value ? (const char *)value : "", value ? len : 0));
+    len = 0;
+    value = lxb_dom_element_class(el, &len);
+    js_set(js, obj, "className", js_mkstr(js, value ? (const char *)value : "", value ? len : 0));
+    return obj;
+}
+
+static jsval_t js_dom_live(struct js *js, jsval_t *args, int nargs) {
+    return arg_element(args, nargs) ? js_mktrue() : js_mkfalse();
+}
+
+static jsval_t js_dom_released(struct js *js, jsval_t *args, int nargs) {
+    return running && script_dom_take_released(&running->dom) ? js_mktrue() : js_mkfalse();
+}
+
+static jsval_t js_dom_connected(struct js *js, jsval_t *args, int nargs) {
+    if (!running || nargs < 1 || js_type(args[0]) != JS_NUM) return js_mkfalse();
+    return script_dom_connected(&running->dom, (uint32_t)js_getnum(args[0])) ? js_mktrue() : js_mkfalse();
+}
+
+static jsval_t js_dom_text(struct js *js, jsval_t *args, int nargs) {
+    lxb_dom_element_t *el = arg_element(args, nargs);
+    if (!el) return js_mknull();
+    size_t len = 0;
+    lxb_char_t *text = lxb_dom_node_text_content(lxb_dom_interface_node(el), &len);
+    jsval_t result = js_mkstr(js, text ? (const char *)text : "", text ? len : 0);
+    if (text) lxb_dom_document_destroy_text(lxb_dom_interface_node(el)->owner_document, text);
+    return result;
+}
+
+// String form of any value; strings are passed through unquoted
+static const char *arg_string(struct js *js, jsval_t value, size_t *len) {
+    if (js_type(value) == JS_STR) return js_getstr(js, value, len);
+    const char *str = js_str(js, value);
+    *len = strlen(str);
+    return str;
+}
+
+static jsval_t js_dom_set_attr(struct js *js, jsval_t *args, int nargs) {
+    if (!running || nargs < 3 || js_type(args[0]) != JS_NUM || js_type(args[1]) != JS_STR) {
+        return js_mkundef();
+    }
+    size_t name_len = 0, value_len = 0;
+    const char *name = js_getstr(js, args[1], &name_len);
+    const char *value = arg_string(js, args[2], &value_len);
+    script_dom_set_attribute(&running->dom, (uint32_t)js_getnum(args[0]), name, name_len, value, value_len);
+    return js_mkundef();
+}
+
+static jsval_t js_dom_set_text(struct js *js, jsval_t *args, int nargs) {
+    if (!running || nargs < 2 || js_type(args[0]) != JS_NUM) return js_mkundef();
+    size_t len = 0;
+    const char *text = arg_string(js, args[1], &len);
+    script_dom_set_text(&running->dom, (uint32_t)js_getnum(args[0]), text, len);
+    return js_mkundef();
+}
+
+// One view per handle, kept in a JS list so Elk's GC sees it; views of
+// destroyed nodes are dropped on the next lookup. Element methods unwrap
+// the handle in JS, where the property can be read.
+static const char DOM_PRELUDE[] =
+    "let __views = null;"
+    "let __viewsPrune = function() { let prev = null;"
+    "  for (let v = __views; v !== null; v = v.next) {"
+    "    if (__domLive(v.h)) { prev = v; } else { if (prev === null) { __views = v.next; } else { prev.next = v.next; } } } };"
+    "let __view = function(h) {"
+    "  if (h === 0) { return null; }"
+    "  if (__domReleased()) { __viewsPrune(); }"
+    "  for (let v = __views; v !== null; v = v.next) { if (v.h === h) { return v.el; } }"
+    "  let el = __domView(h); if (el !== null) { __views = {h: h, el: el, next: __views}; } return el; };"
+    "document.getElementById = function(id) { return __view(__domById(id)); };"
+    "document.querySelector = function(selector) { return __view(__domQuery(selector)); };"
+    "document.getAttribute = function(el, name) { return __domAttr(el.__node, name); };"
+    "document.textContent = function(el) { return __domText(el.__node); };"
+    "document.isConnected = function(el) { return __domConnected(el.__node); };"
+    "document.setAttribute = function(el, name, value) { __domSetAttr(el.__node, name, value);"
+    "  if (name === \"id\") { el.id = __domAttr(el.__node, \"id\"); }"
+    "  if (name === \"class\") { el.className = __domAttr(el.__node, \"class\"); } };"
+    "document.setTextContent = function(el, text) { __domSetText(el.__node, text); };";
+
+// Callbacks are kept in a JS list so Elk's GC sees them; C only holds ids
+static const char TIMER_PRELUDE[] =
+    "let __timers = null;"
+    "let __take = function(id) { let prev = null;"
+    "  for (let t = __timers; t !== null; t = t.next) {"
+    "    if (t.id === id) { if (prev === null) { __timers = t.next; } else { prev.next = t.next; } return t.fn; }"
+    "    prev = t; }"
+    "  return null; };"
+    "let __fire = function(id, now) { let fn = __take(id); if (fn !== null) { fn(now); } };"
+    "let setTimeout = function(fn, ms) { let id = __timerAdd(ms, 0);"
+    "  __timers = {id: id, fn: fn, next: __timers}; return id; };"
+    "let requestAnimationFrame = function(fn) { let id = __timerAdd(0, 1);"
+    "  __timers = {id: id, fn: fn, next: __timers}; return id; };"
+    "let clearTimeout = function(id) { __timerCancel(id); __take(id); };"
+    "let cancelAnimationFrame = clearTimeout;";
+
+bool script_context_init(ScriptContext *ctx, size_t heap_bytes, const char *page_url,
+                         lxb_html_document_t *document) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->heap = malloc(heap_bytes);
+    if (!ctx->heap) {
+        fprintf(stderr, "Failed to allocate script heap\n");
+        return false;
+    }
+    ctx->heap_size = heap_bytes;
+    ctx->js = js_create(ctx->heap, heap_bytes);
+    if (!ctx->js) {
+        free(ctx->heap);
+        ctx->heap = NULL;
+        return false;
+    }
+    js_setmaxcss(ctx->js, SCRIPT_MAX_C_STACK);
+
+    ctx->time_budget_us = SCRIPT_TIME_BUDGET_US;
+    const char *env = getenv(SCRIPT_BUDGET_ENV);
+    if (env && atoi(env) > 0) ctx->time_budget_us = (uint64_t)atoi(env) * 1000;
+    ctx->tick_budget = SCRIPT_TICK_BUDGET;
+
+    struct js *js = ctx->js;
+    jsval_t global = js_glob(js);
+    js_set(js, global, "__tick", js_mkfun(js_tick));
+
+    jsval_t console = js_mkobj(js);
+    js_set(js, console, "log", js_mkfun(js_console_log));
+    js_set(js, global, "console", console);
+
+    jsval_t doc = js_mkobj(js);
+    if (page_url) js_set(js, doc, "URL", js_mkstr(js, page_url, strlen(page_url)));
+    js_set(js, global, "document", doc);
+
+    js_set(js, global, "__timerAdd", js_mkfun(js_timer_add));
+    js_set(js, global, "__timerCancel", js_mkfun(js_timer_cancel));
+    js_eval(js, TIMER_PRELUDE, sizeof(TIMER_PRELUDE) - 1);
+
+    script_dom_init(&ctx->dom, document);
+    if (document) {
+        js_set(js, global, "__domById", js_mkfun(js_dom_by_id));
+        js_set(js, global, "__domQuery", js_mkfun(js_dom_query));
+        js_set(js, global, "__domView", js_mkfun(js_dom_view));
+        js_set(js, global, "__domLive", js_mkfun(js_dom_live));
+        js_set(js, global, "__domReleased", js_mkfun(js_dom_released));
+        js_set(js, global, "__domAttr", js_mkfun(js_dom_attr));
+        js_set(js, global, "__domText", js_mkfun(js_dom_text));
+        js_set(js, global, "__domConnected", js_mkfun(js_dom_connected));
+        js_set(js, global, "__domSetAttr", js_mkfun(js_dom_set_attr));
+        js_set(js, global, "__domSetText", js_mkfun(js_dom_set_text));
+        js_eval(js, DOM_PRELUDE, sizeof(DOM_PRELUDE) - 1);
+    }
+    return true;
+}
+
+void script_context_free(ScriptContext *ctx) {
+    if (running == ctx) running = NULL;
+    if (ctx->timer) lv_timer_delete(ctx->timer);
+    free(ctx->timers);
+    free(ctx->frame_requests);
+    script_dom_free(&ctx->dom);
+    free(ctx->heap);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+bool script_context_ready(const ScriptContext *ctx) {
+    return ctx->js != NULL;
+}
+
+// Evaluate already instrumented code under the context's budget. Timer
+// and frame callbacks are counted apart from the page's scripts.
+static ScriptResult eval_budgeted(ScriptContext *ctx, const char *code, size_t len, const char *name,
+                                  bool callback) {
+    uint64_t start = trace_now_us();
+    ctx->ticks = 0;
+    ctx->over_budget = false;
+    ctx->deadline_us = start + ctx->time_budget_us;
+    running = ctx;
+    jsval_t result = js_eval(ctx->js, code, len);
+    running = NULL;
+
+    uint64_t elapsed = trace_now_us() - start;
+    ctx->run_us += elapsed;
+    if (callback) {
+        ctx->callbacks++;
+    } else {
+        ctx->runs++;
+        trace_count(TRACE_SCRIPTS_RUN, 1);
+    }
+    trace_stage_add(TRACE_STAGE_SCRIPT, elapsed);
+
+    if (ctx->over_budget) {
+        ctx->killed++;
+        trace_count(TRACE_SCRIPTS_KILLED, 1);
+        fprintf(stderr, "Script %s stopped after %u ticks, %.2fms\n", name, (unsigned int)ctx->ticks,
+                elapsed / 1000.0);
+        return SCRIPT_OVER_BUDGET;
+    }
+    if (js_type(result) == JS_ERR) {
+        fprintf(stderr, "Script %s: %s\n", name, js_str(ctx->js, result));
+        return SCRIPT_ERROR;
+    }
+    return SCRIPT_OK;
+}
+
+ScriptResult script_run(ScriptContext *ctx, const char *source, size_t len, const char *name) {
+    if (!ctx->js) return SCRIPT_UNAVAILABLE;
+
+    size_t code_len = 0;
+    const char *code = script_cache_get(source, len, &code_len);
+    if (!code) return SCRIPT_ERROR;
+    return eval_budgeted(ctx, code, code_len, name, false);
+}
+
+// Timers
+
+static void fire_callback(ScriptContext *ctx, uint32_t id, const char *name) {
+    // The function was instrumented along with the script that passed it
+    char code[64];
+    int len = snprintf(code, sizeof(code), "__fire(%u, %.3f);", (unsigned int)id, trace_now_us() / 1000.0);
+    eval_budgeted(ctx, code, (size_t)len, name, true);
+}
+
+static void timeout_timer_cb(lv_timer_t *timer);
+
+// Point the lv_timer at the earliest timeout, or pause it
+static void timers_reschedule(ScriptContext *ctx) {
+    if (ctx->timer_count == 0 || ctx->suspended) {
+        if (ctx->timer) lv_timer_pause(ctx->timer);
+        return;
+    }
+    uint64_t due = ctx->timers[0].due_us;
+    for (size_t i = 1; i < ctx->timer_count; i++) {
+        if (ctx->timers[i].due_us < due) due = ctx->timers[i].due_us;
+    }
+    uint64_t now = trace_now_us();
+    uint32_t period = due > now ? (uint32_t)((due - now + 999) / 1000) : 1;
+    if (ctx->background && period < SCRIPT_BACKGROUND_TIMER_MS) period = SCRIPT_BACKGROUND_TIMER_MS;
+
+    if (!ctx->timer) {
+        ctx->timer = lv_timer_create(timeout_timer_cb, period, ctx);
+    } else {
+        lv_timer_set_period(ctx->timer, period);
+        lv_timer_reset(ctx->timer);
+        lv_timer_resume(ctx->timer);
+    }
+}
+
+static void timeout_timer_cb(lv_timer_t *timer) {
+    ScriptContext *ctx = (ScriptContext *)lv_timer_get_user_data(timer);
+    uint64_t now = trace_now_us();
+
+    // Take the due ones first: callbacks may add and cancel timers
+    size_t due_count = 0;
+    for (size_t i = 0; i < ctx->timer_count; i++) {
+        if (ctx->timers[i].due_us <= now) due_count++;
+    }
+    uint32_t *due = due_count ? malloc(due_count * sizeof(uint32_t)) : NULL;
+    size_t n = 0, kept = 0;
+    for (size_t i = 0; i < ctx->timer_count; i++) {
+        if (due && ctx->timers[i].due_us <= now) {
+            due[n++] = ctx->timers[i].id;
+        } else {
+            ctx->timers[kept++] = ctx->timers[i];
+        }
+    }
+    ctx->timer_count = kept;
+
+    // Ids grow with registration order, which is firing order for equal delays
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = i + 1; j < n; j++) {
+            if (due[j] < due[i]) {
+                uint32_t tmp = due[i];
+                due[i] = due[j];
+                due[j] = tmp;
+            }
+        }
+    }
+    for (size_t i = 0; i < n && ctx->js; i++) fire_callback(ctx, due[i], "setTimeout callback");
+    free(due);
+    timers_reschedule(ctx);
+}
+
+static jsval_t js_timer_add(struct js *js, jsval_t *args, int nargs) {
+    ScriptContext *ctx = running;
+    if (!ctx) return js_mknum(0);
+    bool frame = nargs > 1 && js_type(args[1]) == JS_NUM && js_getnum(args[1]) != 0;
+    uint32_t id = ++ctx->next_timer_id;
+
+    if (frame) {
+        if (ctx->frame_count == ctx->frame_capacity) {
+            size_t capacity = ctx->frame_capacity ? ctx->frame_capacity * 2 : 8;
+            uint32_t *frames = realloc(ctx->frame_requests, capacity * sizeof(uint32_t));
+            if (!frames) return js_mkerr(js, "out of memory");
+            ctx->frame_requests = frames;
+            ctx->frame_capacity = capacity;
+        }
+        ctx->frame_requests[ctx->frame_count++] = id;
+        return js_mknum(id);
+    }
+
+    if (ctx->timer_count == ctx->timer_capacity) {
+        size_t capacity = ctx->timer_capacity ? ctx->timer_capacity * 2 : 8;
+        ScriptTimer *timers = realloc(ctx->timers, capacity * sizeof(ScriptTimer));
+        if (!timers) return js_mkerr(js, "out of memory");
+        ctx->timers = timers;
+        ctx->timer_capacity = capacity;
+    }
+    double delay = nargs > 0 && js_type(args[0]) == JS_NUM ? js_getnum(args[0]) : 0;
+    if (delay < 0) delay = 0;
+    ScriptTimer *t = &ctx->timers[ctx->timer_count++];
+    t->id = id;
+    t->due_us = trace_now_us() + (uint64_t)(delay * 1000);
+    timers_reschedule(ctx);
+    return js_mknum(id);
+}
+
+static jsval_t js_timer_cancel(struct js *js, jsval_t *args, int nargs) {
+    ScriptContext *ctx = running;
+    if (!ctx || nargs < 1 || js_type(args[0]) != JS_NUM) return js_mkundef();
+    uint32_t id = (uint32_t)js_getnum(args[0]);
+    for (size_t i = 0; i < ctx->timer_count; i++) {
+        if (ctx->timers[i].id != id) continue;
+        ctx->timers[i] = ctx->timers[--ctx->timer_count];
+        break;
+    }
+    for (size_t i = 0; i < ctx->frame_count; i++) {
+        if (ctx->frame_requests[i] != id) continue;
+        memmove(&ctx->frame_requests[i], &ctx->frame_requests[i + 1],
+                (ctx->frame_count - i - 1) * sizeof(uint32_t));
+        ctx->frame_count--;
+        break;
+    }
+    return js_mkundef();
+}
+
+void script_context_frame(ScriptContext *ctx, bool background) {
+    if (!ctx->js) return;
+    if (background != ctx->background) {
+        ctx->background = background;
+        timers_reschedule(ctx);
+    }
+    // Hidden pages get no animation frames until they are shown again
+    if (background || ctx->suspended || ctx->frame_count == 0) return;
+
+    // Requests made by these callbacks wait for the next frame
+    size_t count = ctx->frame_count;
+    uint32_t *ids = malloc(count * sizeof(uint32_t));
+    if (!ids) return;
+    memcpy(ids, ctx->frame_requests, count * sizeof(uint32_t));
+    ctx->frame_count = 0;
+    for (size_t i = 0; i < count && ctx->js; i++) fire_callback(ctx, ids[i], "requestAnimationFrame callback");
+    free(ids);
+}
+
+void script_context_suspend(ScriptContext *ctx) {
+    ctx->suspended = true;
+    if (ctx->timer) {
+        lv_timer_delete(ctx->timer);
+        ctx->timer = NULL;
+    }
+}
+
+void script_context_resume(ScriptContext *ctx) {
+    ctx->suspended = false;
+    timers_reschedule(ctx);
+}
+
+size_t script_heap_peak(const ScriptContext *ctx) {
+    if (!ctx->js) return 0;
+    size_t total = 0, lowest_free = 0;
+    js_stats(ctx->js, &total, &lowest_free, NULL);
+    return total - lowest_free;
+}
+
+void script_scheduler_init(ScriptScheduler *sched, const char *page_url, lxb_html_document_t *document) {
+    memset(sched, 0, sizeof(*sched));
+    sched->document = document;
+    if (page_url) {
+        size_t len = strlen(page_url) + 1;
+        sched->page_url = malloc(len);
+        if (sched->page_url) memcpy(sched->page_url, page_url, len);
+    }
+}
+
+static void frame_ready_cb(lv_event_t *e) {
+    ScriptScheduler *sched = (ScriptScheduler *)lv_event_get_user_data(e);
+    sched->painted = true;
+    lv_display_remove_event_cb_with_user_data(lv_display_get_default(), frame_ready_cb, sched);
+    if (sched->timer) lv_timer_resume(sched->timer);
+}
+
+void script_scheduler_free(ScriptScheduler *sched) {
+    loader_cancel_owner(sched);
+    if (sched->started && !sched->painted) {
+        lv_display_remove_event_cb_with_user_data(lv_display_get_default(), frame_ready_cb, sched);
+    }
+    if (sched->timer) lv_timer_delete(sched->timer);
+    for (size_t i = 0; i < sched->count; i++) {
+        free(sched->items[i].source);
+        free(sched->items[i].url);
+    }
+    free(sched->items);
+    free(sched->page_url);
+    script_context_free(&sched->context);
+    memset(sched, 0, sizeof(*sched));
+}
+
+static PageScript *add_item(ScriptScheduler *sched) {
+    if (sched->count == sched->capacity) {
+        size_t capacity = sched->capacity ? sched->capacity * 2 : 8;
+        PageScript *items = realloc(sched->items, capacity * sizeof(PageScript));
+        if (!items) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            return NULL;
+        }
+        sched->items = items;
+        sched->capacity = capacity;
+    }
+    PageScript *item = &sched->items[sched->count++];
+    memset(item, 0, sizeof(*item));
+    return item;
+}
+
+void script_scheduler_add_inline(ScriptScheduler *sched, const char *source, size_t len) {
+    PageScript *item = add_item(sched);
+    if (!item) return;
+    item->source = malloc(len + 1);
+    if (!item->source) {
+        item->failed = true;
+        return;
+    }
+    memcpy(item->source, source, len);
+    item->source[len] = '\0';
+    item->len = len;
+    item->mode = SCRIPT_CLASSIC;
+}
+
+static void script_fetched(LoadRequest *request, void *user_data) {
+    ScriptScheduler *sched = (ScriptScheduler *)user_data;
+    for (size_t i = 0; i < sched->count; i++) {
+        PageScript *item = &sched->items[i];
+        if (item->request != request) continue;
+        item->request = NULL;
+        if (request->ok && request->body.data) {
+            item->source = request->body.data;
+            item->len = request->body.size;
+            request->body.data = NULL;
+        } else {
+            item->failed = true;
+            fprintf(stderr, "Failed to load script %s\n", item->url);
+        }
+        break;
+    }
+    if (sched->painted && sched->timer) lv_timer_resume(sched->timer);
+}
+
+void script_scheduler_add_external(ScriptScheduler *sched, const char *url, ScriptMode mode) {
+    PageScript *item = add_item(sched);
+    if (!item) return;
+    size_t len = strlen(url) + 1;
+    item->url = malloc(len);
+    if (item->url) memcpy(item->url, url, len);
+    item->mode = (uint8_t)mode;
+    item->request = item->url ? loader_request(url, LOAD_PRIORITY_SCRIPT, sched, script_fetched, sched) : NULL;
+    if (!item->request) item->failed = true;
+}
+
+static bool item_ready(const PageScript *item) {
+    return item->source || item->failed;
+}
+
+// Next script allowed to run now, NULL when waiting on a fetch or finished.
+// Any fetched async script may go; otherwise the first classic script not
+// run yet, then the first deferred one.
+static PageScript *next_runnable(ScriptScheduler *sched, bool *pending) {
+    PageScript *ordered = NULL;
+    *pending = false;
+    for (size_t i = 0; i < sched->count; i++) {
+        PageScript *item = &sched->items[i];
+        if (item->done) continue;
+        *pending = true;
+        if (item->mode == SCRIPT_ASYNC) {
+            if (item_ready(item)) return item;
+        } else if (!ordered || (ordered->mode == SCRIPT_DEFER && item->mode == SCRIPT_CLASSIC)) {
+            ordered = item;
+        }
+    }
+    return ordered && item_ready(ordered) ? ordered : NULL;
+}
+
+static void run_item(ScriptScheduler *sched, PageScript *item) {
+    item->done = true;
+    if (!item->source) return;
+    if (!sched->first_run_us) sched->first_run_us = trace_now_us() - sched->started_us;
+    if (!script_context_ready(&sched->context)) {
+        script_context_init(&sched->context, SCRIPT_HEAP_BYTES, sched->page_url, sched->document);
+    }
+    script_run(&sched->context, item->source, item->len, item->url ? item->url : "inline");
+    free(item->source);
+    item->source = NULL;
+}
+
+static void slice_timer_cb(lv_timer_t *timer) {
+    ScriptScheduler *sched = (ScriptScheduler *)lv_timer_get_user_data(timer);
+    uint64_t start = trace_now_us();
+    bool ran = false;
+    bool pending = false;
+    PageScript *item = NULL;
+    while ((item = next_runnable(sched, &pending))) {
+        if (trace_now_us() - start >= SCRIPT_SLICE_US) break;
+        run_item(sched, item);
+        ran = true;
+    }
+    if (ran) sched->slices++;
+    if (item) return; // Out of time with a script ready; carry on next tick
+
+    // Waiting on fetches (which resume the timer) or all done
+    lv_timer_pause(timer);
+    if (pending) return;
+    const ScriptContext *ctx = &sched->context;
+    if (ctx->runs > 0) {
+        trace_event("scripts: %u run, %u stopped, %.2fms in %u slices, first %.2fms after render",
+                    (unsigned int)ctx->runs, (unsigned int)ctx->killed, ctx->run_us / 1000.0,
+                    (unsigned int)sched->slices, sched->first_run_us / 1000.0);
+    }
+    if (ctx->dom.queries > 0) {
+        trace_event("script DOM: %u queries (%u by id index, %u through the selector engine), %u nodes wrapped",
+                    (unsigned int)ctx->dom.queries, (unsigned int)ctx->dom.index_hits,
+                    (unsigned int)ctx->dom.selector_runs, (unsigned int)ctx->dom.node_count);
+    }
+}
+
+void script_scheduler_start(ScriptScheduler *sched) {
+    if (sched->started || sched->count == 0) return;
+    sched->started = true;
+    sched->started_us = trace_now_us();
+    sched->timer = lv_timer_create(slice_timer_cb, SCRIPT_SLICE_PERIOD_MS, sched);
+    lv_timer_pause(sched->timer);
+    lv_display_add_event_cb(lv_display_get_default(), frame_ready_cb, LV_EVENT_REFR_READY, sched);
+}
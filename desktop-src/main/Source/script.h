@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lvgl.h>
+
+#include "loader.h"
+#include "script_dom.h"
+#include "script_instrument.h"
+
+// JavaScript through the bundled Elk engine. Each page gets one context
+// whose whole JS heap lives in a single arena allocated with the page and
+// freed with it. Every script runs under a budget: source is instrumented
+// so that each block entered and each loop iteration ticks a counter, and
+// a script over its tick or time budget is stopped with an error instead
+// of holding up the LVGL thread.
+
+#define SCRIPT_HEAP_BYTES (256 * 1024)  // Per-page Elk arena
+#define SCRIPT_TIME_BUDGET_US 50000     // Per script run
+#define SCRIPT_TICK_BUDGET 2000000      // Blocks entered and loop iterations per script run
+#define SCRIPT_MAX_C_STACK (128 * 1024) // Deep recursion fails rather than overflowing
+#define SCRIPT_BUDGET_ENV "TACTILE_SCRIPT_BUDGET_MS"
+#define SCRIPT_SLICE_US 8000            // Script time per scheduler tick
+#define SCRIPT_SLICE_PERIOD_MS 16
+#define SCRIPT_BACKGROUND_TIMER_MS 1000 // Timeouts in hidden tabs fire at most this often
+
+typedef enum {
+    SCRIPT_OK,
+    SCRIPT_ERROR,         // Syntax or runtime error
+    SCRIPT_OVER_BUDGET,   // Stopped by the tick or time budget
+    SCRIPT_UNAVAILABLE,   // No context (arena allocation failed)
+} ScriptResult;
+
+typedef struct {
+    uint32_t id;
+    uint64_t due_us;
+} ScriptTimer;
+
+typedef struct {
+    struct js *js;
+    uint8_t *heap;       // Arena holding the whole Elk heap
+    size_t heap_size;
+    uint64_t time_budget_us;
+    uint32_t tick_budget;
+    // Budget state of the script being run
+    uint64_t deadline_us;
+    uint32_t ticks;
+    bool over_budget;
+    // Page totals
+    uint32_t runs;
+    uint32_t killed;
+    uint64_t run_us;
+    uint32_t callbacks;  // Timer and animation frame callbacks run
+    ScriptDom dom;       // Nodes the page's scripts have been handed
+    // setTimeout() and requestAnimationFrame() requests by id; the functions
+    // themselves stay in the JS heap
+    ScriptTimer *timers;
+    size_t timer_count;
+    size_t timer_capacity;
+    uint32_t *frame_requests;
+    size_t frame_count;
+    size_t frame_capacity;
+    uint32_t next_timer_id;
+    lv_timer_t *timer;   // Due at the earliest timeout
+    bool background;     // Tab not shown: timeouts throttled, no frames
+    bool suspended;      // Frozen in the bfcache
+} ScriptContext;
+
+// Allocate the arena and set up the globals (console.log, document.URL,
+// setTimeout() and requestAnimationFrame() with their cancel functions).
+// With a `document`, also the DOM queries: document.getElementById(),
+// document.querySelector(), and since Elk functions have no `this`,
+// document.getAttribute(el, name), document.textContent(el),
+// document.setAttribute(el, name, value), document.setTextContent(el, text)
+// and document.isConnected(el). An element whose node has been removed and
+// destroyed stays detached: reads give null, writes do nothing.
+bool script_context_init(ScriptContext *ctx, size_t heap_bytes, const char *page_url,
+                         lxb_html_document_t *document);
+void script_context_free(ScriptContext *ctx);
+bool script_context_ready(const ScriptContext *ctx);
+
+// Run one script to completion or until its budget runs out. The
+// instrumented code comes from the script cache when the same source has
+// run before. `name` is only used in error messages.
+ScriptResult script_run(ScriptContext *ctx, const char *source, size_t len, const char *name);
+
+// Called as each frame starts: runs the animation frame callbacks due,
+// unless the page is in a `background` tab, which also throttles timeouts
+void script_context_frame(ScriptContext *ctx, bool background);
+
+// Stop timers while the context sits in the bfcache (and may be moved);
+// resume once it is back in place
+void script_context_suspend(ScriptContext *ctx);
+void script_context_resume(ScriptContext *ctx);
+
+// Arena bytes in use at the high-water mark
+size_t script_heap_peak(const ScriptContext *ctx);
+
+typedef enum {
+    SCRIPT_CLASSIC, // Plain <script>: document order
+    SCRIPT_DEFER,   // <script defer src>: document order, after every classic script
+    SCRIPT_ASYNC,   // <script async src>: as soon as it is fetched
+} ScriptMode;
+
+typedef struct {
+    char *source;         // Inline text or fetched body, NULL until available
+    size_t len;
+    char *url;            // External scripts only
+    LoadRequest *request; // Fetch in flight
+    uint8_t mode;         // ScriptMode
+    bool failed;          // Fetch failed; skipped when its turn comes
+    bool done;
+} PageScript;
+
+// Runs a page's scripts only after its first frame has been drawn, a few
+// per LVGL timer tick (up to SCRIPT_SLICE_US of script time), so the page
+// is readable and responsive before any JS has executed
+typedef struct {
+    ScriptContext context; // Created by the first script that runs
+    PageScript *items;     // In document order
+    size_t count;
+    size_t capacity;
+    char *page_url;
+    lxb_html_document_t *document; // Owned by the tab
+    lv_timer_t *timer;
+    bool started;          // The page has rendered
+    bool painted;          // ...and a frame showing it has been drawn
+    uint32_t slices;
+    uint64_t started_us;
+    uint64_t first_run_us; // Delay from render to the first script
+} ScriptScheduler;
+
+void script_scheduler_init(ScriptScheduler *sched, const char *page_url, lxb_html_document_t *document);
+// Cancels fetches and drops scripts that have not run, and the context
+void script_scheduler_free(ScriptScheduler *sched);
+
+void script_scheduler_add_inline(ScriptScheduler *sched, const char *source, size_t len);
+// Fetch starts at once (or claims a preload) at script priority
+void script_scheduler_add_external(ScriptScheduler *sched, const char *url, ScriptMode mode);
+
+// The page has rendered: start running scripts after the next frame
+void script_scheduler_start(ScriptScheduler *sched);
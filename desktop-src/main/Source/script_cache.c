@@ -0,0 +1,323 @@
+#include "script_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disk_writer.h"
+#include "file_map.h"
+#include "script_instrument.h"
+#include "trace.h"
+
+#define SCRIPT_CACHE_PATH_LENGTH DISK_WRITER_PATH_LENGTH
+#define INDEX_FILE "index"
+#define INDEX_LINE_LENGTH 40 // "%016llx %llu\n" with a 20-digit size
+
+typedef struct {
+    uint64_t hash;
+    char *source; // source_len bytes, then the code, NUL-terminated
+    size_t source_len;
+    const char *code;
+    size_t code_len;
+    uint64_t last_used;
+} MemoryEntry;
+
+// A file on disk; `files` is kept oldest first
+typedef struct {
+    uint64_t hash;
+    size_t bytes;
+} DiskEntry;
+
+static MemoryEntry *entries;
+static size_t entry_count, entry_capacity;
+static size_t memory_bytes;
+static uint64_t use_clock;
+
+static DiskEntry *files;
+static size_t file_count, file_capacity;
+static size_t disk_bytes;
+static bool index_dirty;
+static uint64_t index_changed_us; // When `files` last changed
+
+static DiskWriter writer;
+
+static ScriptCacheStats stats;
+
+static const char *cache_dir(void) {
+    const char *dir = getenv(SCRIPT_CACHE_DIR_ENV);
+    return (dir && *dir) ? dir : SCRIPT_CACHE_DIR_DEFAULT;
+}
+
+static void entry_path(uint64_t hash, char *out, size_t out_size) {
+    snprintf(out, out_size, "%s/%016llx.jsc", cache_dir(), (unsigned long long)hash);
+}
+
+static uint64_t hash_source(const char *source, size_t len) {
+    // FNV-1a, 64-bit; picks the entry, the stored source confirms it
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)source[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void index_changed(void) {
+    index_dirty = true;
+    index_changed_us = trace_now_us();
+}
+
+static bool disk_append(uint64_t hash, size_t bytes) {
+    if (file_count == file_capacity) {
+        size_t capacity = file_capacity ? file_capacity * 2 : 64;
+        DiskEntry *grown = realloc(files, capacity * sizeof(DiskEntry));
+        if (!grown) return false;
+        files = grown;
+        file_capacity = capacity;
+    }
+    files[file_count].hash = hash;
+    files[file_count].bytes = bytes;
+    file_count++;
+    disk_bytes += bytes;
+    return true;
+}
+
+static bool disk_find(uint64_t hash, size_t *index) {
+    for (size_t i = 0; i < file_count; i++) {
+        if (files[i].hash != hash) continue;
+        *index = i;
+        return true;
+    }
+    return false;
+}
+
+static void disk_remove_at(size_t index) {
+    disk_bytes -= files[index].bytes;
+    memmove(&files[index], &files[index + 1], (file_count - index - 1) * sizeof(DiskEntry));
+    file_count--;
+    index_changed();
+}
+
+// Drop the entry and queue its file for deletion
+static void disk_delete_at(size_t index) {
+    char path[SCRIPT_CACHE_PATH_LENGTH];
+    entry_path(files[index].hash, path, sizeof(path));
+    disk_writer_remove(&writer, path);
+    disk_remove_at(index);
+}
+
+// Move to the most recently used end
+static void disk_touch(size_t index) {
+    DiskEntry entry = files[index];
+    memmove(&files[index], &files[index + 1], (file_count - index - 1) * sizeof(DiskEntry));
+    files[file_count - 1] = entry;
+    index_changed();
+}
+
+void script_cache_init(void) {
+    disk_writer_start(&writer, "script_cache");
+    char path[SCRIPT_CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", cache_dir(), INDEX_FILE);
+    FILE *file = fopen(path, "r");
+    if (!file) return;
+    unsigned long long hash, bytes;
+    while (fscanf(file, "%llx %llu", &hash, &bytes) == 2) {
+        if (!disk_append((uint64_t)hash, (size_t)bytes)) break;
+    }
+    fclose(file);
+}
+
+static void queue_index(void) {
+    if (!index_dirty) return;
+    char *text = malloc(file_count * INDEX_LINE_LENGTH + 1);
+    if (!text) return;
+    size_t len = 0;
+    for (size_t i = 0; i < file_count; i++) {
+        len += (size_t)snprintf(text + len, INDEX_LINE_LENGTH + 1, "%016llx %llu\n",
+                                (unsigned long long)files[i].hash, (unsigned long long)files[i].bytes);
+    }
+    char path[SCRIPT_CACHE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", cache_dir(), INDEX_FILE);
+    disk_writer_write(&writer, path, text, len);
+    index_dirty = false;
+}
+
+void script_cache_idle(void) {
+    if (index_dirty && trace_now_us() - index_changed_us >= SCRIPT_CACHE_INDEX_DELAY_US) queue_index();
+}
+
+static void memory_free_all(void) {
+    for (size_t i = 0; i < entry_count; i++) free(entries[i].source);
+    free(entries);
+    entries = NULL;
+    entry_count = entry_capacity = memory_bytes = 0;
+}
+
+void script_cache_shutdown(void) {
+    queue_index();
+    disk_writer_stop(&writer);
+    memory_free_all();
+    free(files);
+    files = NULL;
+    file_count = file_capacity = disk_bytes = 0;
+}
+
+void script_cache_drop_memory(void) {
+    disk_writer_wait_idle(&writer);
+    memory_free_all();
+}
+
+// Make room for `bytes` more, least recently used entries first
+static void memory_evict(size_t bytes) {
+    while (entry_count > 0 && memory_bytes + bytes > SCRIPT_CACHE_MEMORY_BUDGET) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < entry_count; i++) {
+            if (entries[i].last_used < entries[oldest].last_used) oldest = i;
+        }
+        memory_bytes -= entries[oldest].source_len + entries[oldest].code_len + 1;
+        free(entries[oldest].source);
+        entries[oldest] = entries[--entry_count];
+    }
+}
+
+// Takes ownership of `block` (the source followed by the code)
+static MemoryEntry *memory_insert(uint64_t hash, char *block, size_t source_len, size_t code_len) {
+    size_t bytes = source_len + code_len + 1;
+    memory_evict(bytes);
+    if (entry_count == entry_capacity) {
+        size_t capacity = entry_capacity ? entry_capacity * 2 : 32;
+        MemoryEntry *grown = realloc(entries, capacity * sizeof(MemoryEntry));
+        if (!grown) return NULL;
+        entries = grown;
+        entry_capacity = capacity;
+    }
+    MemoryEntry *entry = &entries[entry_count++];
+    entry->hash = hash;
+    entry->source = block;
+    entry->source_len = source_len;
+    entry->code = block + source_len;
+    entry->code_len = code_len;
+    entry->last_used = ++use_clock;
+    memory_bytes += bytes;
+    return entry;
+}
+
+// The stored block for `source`, or NULL if the file is missing, stale or
+// holds another script with the same hash
+static char *disk_read(uint64_t hash, const char *source, size_t source_len, size_t *code_len) {
+    char path[SCRIPT_CACHE_PATH_LENGTH];
+    entry_path(hash, path, sizeof(path));
+    FileMap map;
+    if (!file_map_open(&map, path)) return NULL;
+
+    char *block = NULL;
+    const ScriptCacheHeader *header = (const ScriptCacheHeader *)map.data;
+    if (map.size >= sizeof(ScriptCacheHeader) && memcmp(header->magic, SCRIPT_CACHE_MAGIC, 8) == 0 &&
+        header->version == SCRIPT_CACHE_VERSION && header->instrument_version == SCRIPT_INSTRUMENT_VERSION &&
+        header->hash == hash && header->source_len == source_len &&
+        map.size == sizeof(ScriptCacheHeader) + header->source_len + header->code_len + 1 &&
+        memcmp(map.data + sizeof(ScriptCacheHeader), source, source_len) == 0) {
+        size_t bytes = source_len + header->code_len + 1;
+        block = malloc(bytes);
+        if (block) {
+            memcpy(block, map.data + sizeof(ScriptCacheHeader), bytes);
+            *code_len = header->code_len;
+        }
+    }
+    file_map_close(&map);
+    return block;
+}
+
+// Queue the block for the writer and account for it in the index
+static void disk_write(uint64_t hash, const char *block, size_t source_len, size_t code_len) {
+    size_t bytes = sizeof(ScriptCacheHeader) + source_len + code_len + 1;
+    if (source_len < SCRIPT_CACHE_DISK_MIN_SOURCE) return;
+    if (bytes > SCRIPT_CACHE_DISK_BUDGET / 4) return; // One library must not flush the rest
+
+    char *data = malloc(bytes);
+    if (!data) return;
+    ScriptCacheHeader *header = (ScriptCacheHeader *)data;
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SCRIPT_CACHE_MAGIC, 8);
+    header->version = SCRIPT_CACHE_VERSION;
+    header->instrument_version = SCRIPT_INSTRUMENT_VERSION;
+    header->hash = hash;
+    header->source_len = source_len;
+    header->code_len = code_len;
+    memcpy(data + sizeof(*header), block, source_len + code_len + 1);
+
+    // Another script with this hash gives up its file
+    size_t existing;
+    if (disk_find(hash, &existing)) disk_remove_at(existing);
+    if (!disk_append(hash, bytes)) {
+        free(data);
+        return;
+    }
+    char path[SCRIPT_CACHE_PATH_LENGTH];
+    entry_path(hash, path, sizeof(path));
+    // A failed write leaves no file; its index entry is dropped on the next read
+    disk_writer_write(&writer, path, data, bytes);
+    index_changed();
+    while (disk_bytes > SCRIPT_CACHE_DISK_BUDGET && file_count > 1) disk_delete_at(0);
+}
+
+// Instrument `source` into a block holding the source and then the code
+static char *prepare(const char *source, size_t len, size_t *code_len) {
+    uint64_t start = trace_now_us();
+    char *code = script_instrument(source, len, code_len);
+    if (!code) return NULL;
+    char *block = malloc(len + *code_len + 1);
+    if (block) {
+        memcpy(block, source, len);
+        memcpy(block + len, code, *code_len + 1);
+    }
+    free(code);
+    trace_stage_add(TRACE_STAGE_SCRIPT, trace_now_us() - start);
+    return block;
+}
+
+const char *script_cache_get(const char *source, size_t len, size_t *code_len) {
+    uint64_t hash = hash_source(source, len);
+    for (size_t i = 0; i < entry_count; i++) {
+        MemoryEntry *entry = &entries[i];
+        if (entry->hash != hash || entry->source_len != len || memcmp(entry->source, source, len) != 0) continue;
+        entry->last_used = ++use_clock;
+        stats.hits++;
+        *code_len = entry->code_len;
+        return entry->code;
+    }
+
+    char *block = NULL;
+    size_t on_disk;
+    if (disk_find(hash, &on_disk)) {
+        block = disk_read(hash, source, len, code_len);
+        if (block) {
+            stats.disk_hits++;
+            disk_touch(on_disk);
+        } else {
+            disk_delete_at(on_disk); // Stale, damaged or another script's
+        }
+    }
+    if (!block) {
+        block = prepare(source, len, code_len);
+        if (!block) return NULL;
+        stats.misses++;
+        disk_write(hash, block, len, *code_len);
+    }
+
+    MemoryEntry *entry = memory_insert(hash, block, len, *code_len);
+    if (!entry) {
+        // Keep the caller's pointer valid until the next call
+        static char *uncached;
+        free(uncached);
+        uncached = block;
+        return block + len;
+    }
+    return entry->code;
+}
+
+void script_cache_stats(ScriptCacheStats *out) {
+    *out = stats;
+    out->memory_bytes = memory_bytes;
+    out->disk_bytes = disk_bytes;
+}
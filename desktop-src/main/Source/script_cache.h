@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Scripts prepared for Elk (comments stripped, budget ticks inserted),
+// keyed by a hash of their source. Sites ship the same libraries on every
+// page, so most script runs find their code here instead of scanning the
+// source again. A hit compares the whole source, so two scripts with the
+// same hash never share code. Entries live in RAM under a byte budget and
+// are written to disk by a background thread, where an index file keeps
+// them in least recently used order under a budget of its own. The index
+// is written once the cache has been left alone for a while, and at
+// shutdown.
+//
+// File layout: ScriptCacheHeader, the source, then the prepared code,
+// NUL-terminated.
+
+#define SCRIPT_CACHE_MAGIC "TBJSC\0\0"
+#define SCRIPT_CACHE_VERSION 2
+#define SCRIPT_CACHE_DIR_ENV "TACTILE_SCRIPT_CACHE_DIR"
+#define SCRIPT_CACHE_DIR_DEFAULT "script_cache"
+#define SCRIPT_CACHE_MEMORY_BUDGET (2 * 1024 * 1024)
+#define SCRIPT_CACHE_DISK_BUDGET (16 * 1024 * 1024)
+#define SCRIPT_CACHE_DISK_MIN_SOURCE 4096 // Smaller scripts instrument faster than a file reads back
+#define SCRIPT_CACHE_INDEX_DELAY_US 2000000 // Quiet time before the index is written
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t instrument_version; // SCRIPT_INSTRUMENT_VERSION the code was made with
+    uint64_t hash;
+    uint64_t source_len;
+    uint64_t code_len;
+} ScriptCacheHeader;
+
+// Load the disk index and start the writer; the cache works (in RAM only)
+// without an index, and writes inline without a writer
+void script_cache_init(void);
+// Finish the queued writes, write the index back and drop the RAM entries
+void script_cache_shutdown(void);
+// Queue the index write once nothing has changed for a while. Call from
+// the main loop.
+void script_cache_idle(void);
+// Wait for the queued writes, then drop the RAM entries so the next lookup
+// of a stored script reads it from disk (benchmarks)
+void script_cache_drop_memory(void);
+
+// Prepared code for `source`, made and stored on a miss. The pointer stays
+// valid until the next script_cache_* call. NULL on allocation failure.
+const char *script_cache_get(const char *source, size_t len, size_t *code_len);
+
+typedef struct {
+    uint32_t hits;       // Served from RAM
+    uint32_t disk_hits;  // Read back from disk
+    uint32_t misses;
+    size_t memory_bytes;
+    size_t disk_bytes;
+} ScriptCacheStats;
+
+void script_cache_stats(ScriptCacheStats *out);
@@ -0,0 +1,454 @@
+#include "script_dom.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void script_dom_init(ScriptDom *dom, lxb_html_document_t *document) {
+    memset(dom, 0, sizeof(*dom));
+    dom->document = document;
+}
+
+void script_dom_free(ScriptDom *dom) {
+    for (size_t i = 0; i < SCRIPT_DOM_SELECTOR_CACHE; i++) {
+        DomSelector *sel = &dom->selector_cache[i];
+        if (sel->list) lxb_css_selector_list_destroy_memory(sel->list);
+        free(sel->text);
+    }
+    if (dom->selectors) lxb_selectors_destroy(dom->selectors, true);
+    if (dom->css_parser) lxb_css_parser_destroy(dom->css_parser, true);
+    // Detached subtrees belong to the document's memory and go with it
+    free(dom->refs);
+    free(dom->slots);
+    free(dom->ids);
+    free(dom->journal);
+    free(dom->removed);
+    memset(dom, 0, sizeof(*dom));
+}
+
+static size_t hash_pointer(const void *ptr) {
+    uintptr_t x = (uintptr_t)ptr;
+    x ^= x >> 17;
+    x *= (uintptr_t)0x9E3779B97F4A7C15ull;
+    return (size_t)(x ^ (x >> 29));
+}
+
+static size_t hash_id(const lxb_char_t *data, size_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Rebuild the slot table without its tombstones, doubling it only when the
+// live slots alone would fill more than a quarter
+static bool slots_rehash(ScriptDom *dom) {
+    size_t capacity = dom->slot_capacity ? dom->slot_capacity : 64;
+    while ((dom->live_count + 1) * 4 > capacity) capacity *= 2;
+    DomSlot *slots = calloc(capacity, sizeof(DomSlot));
+    if (!slots) return false;
+    for (size_t i = 0; i < dom->slot_capacity; i++) {
+        DomSlot *old = &dom->slots[i];
+        if (!old->handle || old->handle == DOM_SLOT_TOMBSTONE) continue;
+        size_t at = hash_pointer(old->node) & (capacity - 1);
+        while (slots[at].handle) at = (at + 1) & (capacity - 1);
+        slots[at] = *old;
+    }
+    free(dom->slots);
+    dom->slots = slots;
+    dom->slot_capacity = capacity;
+    dom->slot_used = dom->live_count;
+    return true;
+}
+
+static DomSlot *find_slot(const ScriptDom *dom, const lxb_dom_node_t *node) {
+    if (!dom->slot_capacity) return NULL;
+    size_t at = hash_pointer(node) & (dom->slot_capacity - 1);
+    while (dom->slots[at].handle) {
+        if (dom->slots[at].handle != DOM_SLOT_TOMBSTONE && dom->slots[at].node == node) return &dom->slots[at];
+        at = (at + 1) & (dom->slot_capacity - 1);
+    }
+    return NULL;
+}
+
+static uint32_t make_handle(uint32_t index, uint16_t generation) {
+    return ((uint32_t)generation << DOM_HANDLE_INDEX_BITS) | (index + 1);
+}
+
+// Entry for a live handle, NULL for a stale or invalid one
+static DomRef *handle_ref(const ScriptDom *dom, uint32_t handle) {
+    uint32_t index = handle & DOM_HANDLE_INDEX_MASK;
+    if (index == 0 || index > dom->node_count) return NULL;
+    DomRef *ref = &dom->refs[index - 1];
+    if (!ref->node || ref->generation != handle >> DOM_HANDLE_INDEX_BITS) return NULL;
+    return ref;
+}
+
+// A released entry if there is one, else a new one
+static DomRef *take_ref(ScriptDom *dom, uint32_t *index) {
+    if (dom->free_ref) {
+        *index = dom->free_ref - 1;
+        dom->free_ref = dom->refs[*index].next_free;
+        return &dom->refs[*index];
+    }
+    if (dom->node_count == DOM_HANDLE_MAX_REFS) return NULL;
+    if (dom->node_count == dom->node_capacity) {
+        uint32_t capacity = dom->node_capacity ? dom->node_capacity * 2 : 32;
+        if (capacity > DOM_HANDLE_MAX_REFS) capacity = DOM_HANDLE_MAX_REFS;
+        DomRef *refs = realloc(dom->refs, capacity * sizeof(*refs));
+        if (!refs) return NULL;
+        dom->refs = refs;
+        dom->node_capacity = capacity;
+    }
+    *index = dom->node_count++;
+    dom->refs[*index].generation = 0;
+    return &dom->refs[*index];
+}
+
+uint32_t script_dom_handle(ScriptDom *dom, lxb_dom_node_t *node) {
+    if (!node) return 0;
+    DomSlot *slot = find_slot(dom, node);
+    if (slot) return slot->handle;
+
+    // First time a script sees this node
+    if ((dom->slot_used + 1) * 2 > dom->slot_capacity && !slots_rehash(dom)) return 0;
+    uint32_t index;
+    DomRef *ref = take_ref(dom, &index);
+    if (!ref) return 0;
+    ref->node = node;
+    ref->journal = 0;
+    ref->next_free = 0;
+    dom->live_count++;
+    uint32_t handle = make_handle(index, ref->generation);
+
+    size_t at = hash_pointer(node) & (dom->slot_capacity - 1);
+    while (dom->slots[at].handle && dom->slots[at].handle != DOM_SLOT_TOMBSTONE) {
+        at = (at + 1) & (dom->slot_capacity - 1);
+    }
+    if (!dom->slots[at].handle) dom->slot_used++;
+    dom->slots[at].node = node;
+    dom->slots[at].handle = handle;
+    return handle;
+}
+
+lxb_dom_node_t *script_dom_node(const ScriptDom *dom, uint32_t handle) {
+    DomRef *ref = handle_ref(dom, handle);
+    return ref ? ref->node : NULL;
+}
+
+bool script_dom_connected(const ScriptDom *dom, uint32_t handle) {
+    lxb_dom_node_t *node = script_dom_node(dom, handle);
+    lxb_dom_node_t *document = lxb_dom_interface_node(dom->document);
+    while (node && node != document) node = node->parent;
+    return node != NULL;
+}
+
+bool script_dom_take_released(ScriptDom *dom) {
+    bool released = dom->views_released;
+    dom->views_released = false;
+    return released;
+}
+
+// Insert unless the id is already taken: the first element in document
+// order wins, as in browsers
+static bool id_insert(ScriptDom *dom, const lxb_char_t *id, size_t len, lxb_dom_element_t *el, size_t *count) {
+    if ((*count + 1) * 2 > dom->id_capacity) {
+        size_t capacity = dom->id_capacity ? dom->id_capacity * 2 : 64;
+        DomIdEntry *ids = calloc(capacity, sizeof(DomIdEntry));
+        if (!ids) return false;
+        for (size_t i = 0; i < dom->id_capacity; i++) {
+            DomIdEntry *old = &dom->ids[i];
+            if (!old->element) continue;
+            size_t at = hash_id(old->id, old->len) & (capacity - 1);
+            while (ids[at].element) at = (at + 1) & (capacity - 1);
+            ids[at] = *old;
+        }
+        free(dom->ids);
+        dom->ids = ids;
+        dom->id_capacity = capacity;
+    }
+    size_t at = hash_id(id, len) & (dom->id_capacity - 1);
+    while (dom->ids[at].element) {
+        DomIdEntry *entry = &dom->ids[at];
+        if (entry->len == len && memcmp(entry->id, id, len) == 0) return true;
+        at = (at + 1) & (dom->id_capacity - 1);
+    }
+    dom->ids[at].id = id;
+    dom->ids[at].len = len;
+    dom->ids[at].element = el;
+    (*count)++;
+    return true;
+}
+
+// One walk over the whole document; every later lookup is a probe
+static void build_id_index(ScriptDom *dom) {
+    dom->ids_built = true;
+    if (dom->ids) memset(dom->ids, 0, dom->id_capacity * sizeof(DomIdEntry));
+    size_t count = 0;
+    lxb_dom_node_t *node = lxb_dom_interface_node(dom->document);
+    while (node) {
+        if (node->type == LXB_DOM_NODE_TYPE_ELEMENT) {
+            lxb_dom_element_t *el = lxb_dom_interface_element(node);
+            size_t len = 0;
+            const lxb_char_t *id = lxb_dom_element_id(el, &len);
+            if (id && len > 0 && !id_insert(dom, id, len, el, &count)) {
+                fprintf(stderr, "Memory allocation failed for id index\n");
+                return;
+            }
+        }
+        if (node->first_child) {
+            node = node->first_child;
+            continue;
+        }
+        while (node && !node->next) node = node->parent;
+        if (node) node = node->next;
+    }
+}
+
+lxb_dom_element_t *script_dom_by_id(ScriptDom *dom, const char *id, size_t len) {
+    if (!dom->document || len == 0) return NULL;
+    dom->queries++;
+    if (!dom->ids_built) build_id_index(dom);
+    if (!dom->id_capacity) return NULL;
+    dom->index_hits++;
+
+    size_t at = hash_id((const lxb_char_t *)id, len) & (dom->id_capacity - 1);
+    while (dom->ids[at].element) {
+        DomIdEntry *entry = &dom->ids[at];
+        if (entry->len == len && memcmp(entry->id, id, len) == 0) return entry->element;
+        at = (at + 1) & (dom->id_capacity - 1);
+    }
+    return NULL;
+}
+
+// "#name" with nothing after the name
+static bool is_id_selector(const char *selector, size_t len) {
+    if (len < 2 || selector[0] != '#') return false;
+    for (size_t i = 1; i < len; i++) {
+        char c = selector[i];
+        bool ident = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                     c == '-' || c == '_' || (unsigned char)c >= 0x80;
+        if (!ident) return false;
+    }
+    return true;
+}
+
+static lxb_css_selector_list_t *cached_selector(ScriptDom *dom, const char *selector, size_t len) {
+    for (size_t i = 0; i < SCRIPT_DOM_SELECTOR_CACHE; i++) {
+        DomSelector *sel = &dom->selector_cache[i];
+        if (sel->text && strlen(sel->text) == len && memcmp(sel->text, selector, len) == 0) return sel->list;
+    }
+
+    if (!dom->css_parser) {
+        dom->css_parser = lxb_css_parser_create();
+        if (lxb_css_parser_init(dom->css_parser, NULL) != LXB_STATUS_OK) {
+            dom->css_parser = lxb_css_parser_destroy(dom->css_parser, true);
+            return NULL;
+        }
+    }
+    lxb_css_selector_list_t *list = lxb_css_selectors_parse(dom->css_parser, (const lxb_char_t *)selector, len);
+    if (!list) {
+        fprintf(stderr, "Invalid selector: %.*s\n", (int)len, selector);
+        return NULL;
+    }
+    char *text = malloc(len + 1);
+    if (!text) {
+        lxb_css_selector_list_destroy_memory(list);
+        return NULL;
+    }
+    memcpy(text, selector, len);
+    text[len] = '\0';
+
+    DomSelector *slot = &dom->selector_cache[dom->selector_next];
+    dom->selector_next = (dom->selector_next + 1) % SCRIPT_DOM_SELECTOR_CACHE;
+    if (slot->list) lxb_css_selector_list_destroy_memory(slot->list);
+    free(slot->text);
+    slot->text = text;
+    slot->list = list;
+    return list;
+}
+
+static lxb_status_t first_match_cb(lxb_dom_node_t *node, lxb_css_selector_specificity_t spec, void *ctx) {
+    *(lxb_dom_node_t **)ctx = node;
+    return LXB_STATUS_STOP;
+}
+
+lxb_dom_element_t *script_dom_query(ScriptDom *dom, const char *selector, size_t len) {
+    while (len > 0 && (*selector == ' ' || *selector == '\t' || *selector == '\n')) {
+        selector++;
+        len--;
+    }
+    while (len > 0 && (selector[len - 1] == ' ' || selector[len - 1] == '\t' || selector[len - 1] == '\n')) len--;
+    if (!dom->document || len == 0) return NULL;
+    if (is_id_selector(selector, len)) return script_dom_by_id(dom, selector + 1, len - 1);
+
+    dom->queries++;
+    lxb_css_selector_list_t *list = cached_selector(dom, selector, len);
+    if (!list) return NULL;
+    if (!dom->selectors) {
+        dom->selectors = lxb_selectors_create();
+        if (lxb_selectors_init(dom->selectors) != LXB_STATUS_OK) {
+            dom->selectors = lxb_selectors_destroy(dom->selectors, true);
+            return NULL;
+        }
+    }
+
+    // Stops at the first match rather than collecting them all
+    dom->selector_runs++;
+    lxb_dom_node_t *found = NULL;
+    lxb_selectors_find(dom->selectors, lxb_dom_interface_node(dom->document), list, first_match_cb, &found);
+    return found && found->type == LXB_DOM_NODE_TYPE_ELEMENT ? lxb_dom_interface_element(found) : NULL;
+}
+
+static lxb_dom_element_t *handle_element(const ScriptDom *dom, uint32_t handle) {
+    lxb_dom_node_t *node = script_dom_node(dom, handle);
+    return node && node->type == LXB_DOM_NODE_TYPE_ELEMENT ? lxb_dom_interface_element(node) : NULL;
+}
+
+// Fold a mutation into the element's journal entry
+static void journal_add(ScriptDom *dom, uint32_t handle, uint8_t kinds) {
+    dom->mutations++;
+    DomRef *ref = handle_ref(dom, handle);
+    if (!ref) return;
+    if (ref->journal) {
+        dom->journal[ref->journal - 1].kinds |= kinds;
+        return;
+    }
+    if (dom->journal_count == dom->journal_capacity) {
+        size_t capacity = dom->journal_capacity ? dom->journal_capacity * 2 : 16;
+        DomMutation *journal = realloc(dom->journal, capacity * sizeof(*journal));
+        if (!journal) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            return;
+        }
+        dom->journal = journal;
+        dom->journal_capacity = capacity;
+    }
+    DomMutation *entry = &dom->journal[dom->journal_count++];
+    entry->element = lxb_dom_interface_element(ref->node);
+    entry->handle = handle;
+    entry->kinds = kinds;
+    ref->journal = (uint32_t)dom->journal_count;
+}
+
+static bool name_is(const char *name, size_t len, const char *want) {
+    if (strlen(want) != len) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)name[i]) != want[i]) return false;
+    }
+    return true;
+}
+
+bool script_dom_set_attribute(ScriptDom *dom, uint32_t handle, const char *name, size_t name_len,
+                              const char *value, size_t value_len) {
+    lxb_dom_element_t *el = handle_element(dom, handle);
+    if (!el || name_len == 0) return false;
+    if (!lxb_dom_element_set_attribute(el, (const lxb_char_t *)name, name_len,
+                                       (const lxb_char_t *)value, value_len)) {
+        return false;
+    }
+
+    if (name_is(name, name_len, "id")) {
+        dom->ids_built = false;
+    } else if (name_is(name, name_len, "style")) {
+        journal_add(dom, handle, DOM_MUTATION_STYLE);
+    } else if (name_is(name, name_len, "class")) {
+        journal_add(dom, handle, DOM_MUTATION_CLASS);
+    }
+    return true;
+}
+
+bool script_dom_set_text(ScriptDom *dom, uint32_t handle, const char *text, size_t len) {
+    lxb_dom_element_t *el = handle_element(dom, handle);
+    if (!el) return false;
+    lxb_dom_node_t *node = lxb_dom_interface_node(el);
+
+    size_t children = 0;
+    bool has_elements = false;
+    for (lxb_dom_node_t *child = node->first_child; child; child = child->next) {
+        children++;
+        if (child->type == LXB_DOM_NODE_TYPE_ELEMENT) has_elements = true;
+    }
+
+    if (has_elements) {
+        // Widgets and style records still point at these elements until the
+        // journal is applied, so they are only detached for now
+        if (dom->removed_count + children > dom->removed_capacity) {
+            size_t capacity = dom->removed_capacity ? dom->removed_capacity : 16;
+            while (capacity < dom->removed_count + children) capacity *= 2;
+            lxb_dom_node_t **removed = realloc(dom->removed, capacity * sizeof(*removed));
+            if (!removed) return false;
+            dom->removed = removed;
+            dom->removed_capacity = capacity;
+        }
+        while (node->first_child) {
+            lxb_dom_node_t *child = node->first_child;
+            lxb_dom_node_remove(child);
+            dom->removed[dom->removed_count++] = child;
+        }
+        dom->ids_built = false;
+    }
+
+    if (lxb_dom_node_text_content_set(node, (const lxb_char_t *)text, len) != LXB_STATUS_OK) return false;
+    journal_add(dom, handle, has_elements ? DOM_MUTATION_TREE : DOM_MUTATION_TEXT);
+    return true;
+}
+
+// Handles of nodes under `root` go stale before the subtree is destroyed.
+// Their slots become tombstones, so a new node at the same address is not
+// mistaken for the old one, and their entries are released for reuse
+// under the next generation.
+static void forget_subtree(ScriptDom *dom, lxb_dom_node_t *root) {
+    lxb_dom_node_t *node = root;
+    while (node) {
+        DomSlot *slot = find_slot(dom, node);
+        if (slot) {
+            uint32_t index = (slot->handle & DOM_HANDLE_INDEX_MASK) - 1;
+            DomRef *ref = &dom->refs[index];
+            ref->node = NULL;
+            ref->journal = 0;
+            if (++ref->generation < DOM_HANDLE_GENERATIONS) {
+                ref->next_free = dom->free_ref;
+                dom->free_ref = index + 1;
+            }
+            slot->node = NULL;
+            slot->handle = DOM_SLOT_TOMBSTONE;
+            dom->live_count--;
+            dom->views_released = true;
+        }
+        if (node->first_child) {
+            node = node->first_child;
+            continue;
+        }
+        while (node != root && !node->next) node = node->parent;
+        node = node == root ? NULL : node->next;
+    }
+}
+
+void script_dom_journal_clear(ScriptDom *dom) {
+    for (size_t i = 0; i < dom->journal_count; i++) {
+        DomRef *ref = handle_ref(dom, dom->journal[i].handle);
+        if (ref) ref->journal = 0;
+    }
+    dom->journal_count = 0;
+    dom->mutations = 0;
+    for (size_t i = 0; i < dom->removed_count; i++) {
+        forget_subtree(dom, dom->removed[i]);
+        lxb_dom_node_destroy_deep(dom->removed[i]);
+    }
+    dom->removed_count = 0;
+}
+
+size_t script_dom_bytes(const ScriptDom *dom) {
+    size_t bytes = dom->node_capacity * sizeof(DomRef) + dom->slot_capacity * sizeof(DomSlot) +
+                   dom->id_capacity * sizeof(DomIdEntry) + dom->journal_capacity * sizeof(DomMutation) +
+                   dom->removed_capacity * sizeof(lxb_dom_node_t *);
+    for (size_t i = 0; i < SCRIPT_DOM_SELECTOR_CACHE; i++) {
+        if (dom->selector_cache[i].text) bytes += strlen(dom->selector_cache[i].text) + 1;
+    }
+    return bytes;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lexbor/html/html.h>
+#include <lexbor/css/css.h>
+#include <lexbor/selectors/selectors.h>
+
+// The DOM as scripts see it. Nothing is wrapped up front: a node gets an
+// entry in the side table (and a handle scripts refer to it by) the first
+// time a query returns it, so a page whose scripts never touch the DOM
+// pays nothing. Each handle has one JS view, a small object carrying the
+// handle, cached on the JS side where Elk's GC can see it. When a node is
+// destroyed its entry is released for reuse and its view is dropped from
+// the cache the next time one is looked up.
+//
+// getElementById() goes through an id index built on first use;
+// querySelector() answers "#id" from the same index and hands anything
+// else to lexbor's selector engine, with recently parsed selectors kept.
+//
+// Mutations change the lexbor tree at once, so scripts read back what they
+// wrote, but widgets are left alone: each one is noted in a journal, one
+// entry per element however often it changes, and the embedder applies the
+// whole journal in a single pass before the next frame is drawn.
+
+#define SCRIPT_DOM_SELECTOR_CACHE 8
+
+typedef enum {
+    DOM_MUTATION_TEXT  = 1 << 0, // Text replaced; the element had no child elements
+    DOM_MUTATION_STYLE = 1 << 1, // style attribute
+    DOM_MUTATION_CLASS = 1 << 2, // class attribute
+    DOM_MUTATION_TREE  = 1 << 3, // Child elements removed; widgets need rebuilding
+} DomMutationKind;
+
+typedef struct {
+    lxb_dom_element_t *element;
+    uint32_t handle;
+    uint8_t kinds;          // DomMutationKind bits
+} DomMutation;
+
+// A handle is an index into `refs` plus one, tagged with the entry's
+// generation so it goes stale once the entry is released and reused. An
+// entry whose generations run out is retired instead of reused.
+#define DOM_HANDLE_INDEX_BITS 20
+#define DOM_HANDLE_INDEX_MASK ((1u << DOM_HANDLE_INDEX_BITS) - 1)
+#define DOM_HANDLE_MAX_REFS (DOM_HANDLE_INDEX_MASK - 1)
+#define DOM_HANDLE_GENERATIONS (1u << (32 - DOM_HANDLE_INDEX_BITS))
+
+typedef struct {
+    lxb_dom_node_t *node;   // NULL while the entry is free
+    uint32_t journal;       // Index into the journal plus one, 0 for none
+    uint32_t next_free;     // Free list link, index plus one
+    uint16_t generation;    // Bumped each time the entry is released
+} DomRef;
+
+#define DOM_SLOT_TOMBSTONE UINT32_MAX // Slot of a destroyed node; probes go past it
+
+typedef struct {
+    lxb_dom_node_t *node;
+    uint32_t handle;        // Index into `refs` plus one; 0 for an empty slot
+} DomSlot;
+
+typedef struct {
+    const lxb_char_t *id;   // Points into the document's attribute storage
+    size_t len;
+    lxb_dom_element_t *element;
+} DomIdEntry;
+
+typedef struct {
+    char *text;
+    lxb_css_selector_list_t *list;
+} DomSelector;
+
+typedef struct {
+    lxb_html_document_t *document;
+    // Side table: handle -> node, and node -> handle by open addressing
+    DomRef *refs;
+    uint32_t node_count;    // Entries in `refs` ever used
+    uint32_t node_capacity;
+    uint32_t free_ref;      // First released entry, index plus one
+    uint32_t live_count;    // Handles whose node is alive
+    bool views_released;    // Handles went stale since JS last pruned its views
+    DomSlot *slots;
+    size_t slot_capacity;   // Power of two, kept at most half full
+    size_t slot_used;       // Live slots and tombstones
+    // First element in document order for each id
+    DomIdEntry *ids;
+    size_t id_capacity;
+    bool ids_built;
+    // Selector engine, created by the first querySelector() that needs it
+    lxb_css_parser_t *css_parser;
+    lxb_selectors_t *selectors;
+    DomSelector selector_cache[SCRIPT_DOM_SELECTOR_CACHE];
+    uint32_t selector_next; // Ring position of the next eviction
+    // Mutations since the journal was last applied
+    DomMutation *journal;
+    size_t journal_count;
+    size_t journal_capacity;
+    lxb_dom_node_t **removed; // Detached subtrees, destroyed with the journal
+    size_t removed_count;
+    size_t removed_capacity;
+    uint32_t mutations;       // Calls folded into the journal
+    // Counters for the trace
+    uint32_t queries;
+    uint32_t index_hits;
+    uint32_t selector_runs;
+} ScriptDom;
+
+void script_dom_init(ScriptDom *dom, lxb_html_document_t *document);
+void script_dom_free(ScriptDom *dom);
+
+// Handle of `node`, entering it in the side table on first use. 0 when
+// the table cannot grow. Entries are reused once their node is destroyed,
+// under the next generation, so a stale handle is rejected by its
+// generation check. The generation would wrap after 4096 reuses; the
+// entry is retired then instead, so a stale handle never matches again.
+uint32_t script_dom_handle(ScriptDom *dom, lxb_dom_node_t *node);
+// NULL for a stale handle, whose node was removed and destroyed. Scripts
+// holding one see a detached element: reads give null, writes do nothing.
+lxb_dom_node_t *script_dom_node(const ScriptDom *dom, uint32_t handle);
+// Whether the handle's node is still in the document
+bool script_dom_connected(const ScriptDom *dom, uint32_t handle);
+// True once after handles have gone stale, for the JS view cache to prune
+bool script_dom_take_released(ScriptDom *dom);
+
+lxb_dom_element_t *script_dom_by_id(ScriptDom *dom, const char *id, size_t len);
+lxb_dom_element_t *script_dom_query(ScriptDom *dom, const char *selector, size_t len);
+
+// Mutations by handle; false when the handle is stale or not an element.
+// Values need not be NUL-terminated.
+bool script_dom_set_attribute(ScriptDom *dom, uint32_t handle, const char *name, size_t name_len,
+                              const char *value, size_t value_len);
+bool script_dom_set_text(ScriptDom *dom, uint32_t handle, const char *text, size_t len);
+
+// Call once the journal has been applied: empties it and destroys the
+// subtrees mutations detached, whose handles go stale
+void script_dom_journal_clear(ScriptDom *dom);
+
+// Side table, id index and cached selectors, for about:memory
+size_t script_dom_bytes(const ScriptDom *dom);
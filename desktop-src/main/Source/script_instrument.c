@@ -0,0 +1,144 @@
+#include "script_instrument.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TICK_CALL "__tick();"
+#define TICK_CALL_LENGTH (sizeof(TICK_CALL) - 1)
+#define TICK_GUARD "__tick()&&("
+#define TICK_GUARD_LENGTH (sizeof(TICK_GUARD) - 1)
+#define MAX_OPEN_LOOPS 32 // Loop headers nested inside loop headers
+
+// A while or for header whose closing ')' has not been reached
+typedef struct {
+    size_t depth;     // Bracket depth just inside its '('
+    bool is_for;
+    int semicolons;   // Seen at `depth`; a for-in/of header has none
+    size_t cond_start;
+} LoopHeader;
+
+// Skip a string literal starting at `i`; returns the index after it
+static size_t skip_string(const char *s, size_t len, size_t i) {
+    char quote = s[i++];
+    while (i < len && s[i] != quote) {
+        if (s[i] == '\\') i++;
+        i++;
+    }
+    return i < len ? i + 1 : len;
+}
+
+static bool ends_with_word(const char *s, size_t end, const char *word) {
+    size_t n = strlen(word);
+    if (end < n || strncmp(s + end - n, word, n) != 0) return false;
+    return end == n || !(isalnum((unsigned char)s[end - n - 1]) || s[end - n - 1] == '_');
+}
+
+// `word` used as a keyword rather than as a property name (`x.for`)
+static bool ends_with_keyword(const char *s, size_t end, const char *word) {
+    if (!ends_with_word(s, end, word)) return false;
+    size_t i = end - strlen(word);
+    while (i > 0 && isspace((unsigned char)s[i - 1])) i--;
+    return i == 0 || s[i - 1] != '.';
+}
+
+static size_t emit(char *out, size_t n, const char *text, size_t len) {
+    memcpy(out + n, text, len);
+    return n + len;
+}
+
+// A '{' opens a block (rather than an object literal) after ')', "=>" or
+// "else". Loop bodies are the exception: their header already ticks.
+char *script_instrument(const char *source, size_t len, size_t *out_len) {
+    // Worst case every byte is a ';' that opens a for condition
+    char *out = malloc(len * (TICK_GUARD_LENGTH + 1) + 1);
+    if (!out) return NULL;
+
+    LoopHeader loops[MAX_OPEN_LOOPS];
+    size_t loop_count = 0;
+    size_t depth = 0;     // Open (, [ and {
+    size_t loop_body = 0; // `last` right after an instrumented loop header
+    size_t n = 0;
+    size_t last = 0; // End of the last significant token in `out`, 0 for none
+    size_t i = 0;
+    while (i < len) {
+        char c = source[i];
+        if (c == '"' || c == '\'' || c == '`') {
+            size_t end = skip_string(source, len, i);
+            n = emit(out, n, source + i, end - i);
+            i = end;
+            last = n;
+            continue;
+        }
+        if (c == '/' && i + 1 < len && (source[i + 1] == '/' || source[i + 1] == '*')) {
+            // Comments are dropped
+            if (source[i + 1] == '/') {
+                while (i < len && source[i] != '\n') i++;
+            } else {
+                i += 2;
+                while (i + 1 < len && !(source[i] == '*' && source[i + 1] == '/')) i++;
+                i = i + 2 < len ? i + 2 : len;
+            }
+            out[n++] = ' ';
+            continue;
+        }
+        i++;
+        if (isspace((unsigned char)c)) {
+            out[n++] = c;
+            continue;
+        }
+
+        LoopHeader *header = loop_count ? &loops[loop_count - 1] : NULL;
+        if (header && header->depth != depth) header = NULL;
+
+        if (c == '(') {
+            bool is_while = last > 0 && ends_with_keyword(out, last, "while");
+            bool is_for = !is_while && last > 0 && ends_with_keyword(out, last, "for");
+            out[n++] = c;
+            depth++;
+            if ((is_while || is_for) && loop_count < MAX_OPEN_LOOPS) {
+                LoopHeader *loop = &loops[loop_count++];
+                loop->depth = depth;
+                loop->is_for = is_for;
+                loop->semicolons = 0;
+                if (is_while) n = emit(out, n, TICK_GUARD, TICK_GUARD_LENGTH);
+            }
+        } else if (c == ';' && header && header->is_for && header->semicolons < 2) {
+            if (++header->semicolons == 1) {
+                out[n++] = c;
+                n = emit(out, n, TICK_GUARD, TICK_GUARD_LENGTH);
+                header->cond_start = n;
+            } else {
+                // for (;;) has no condition to guard
+                size_t k = header->cond_start;
+                while (k < n && isspace((unsigned char)out[k])) k++;
+                if (k == n) n = emit(out, n, "true", 4);
+                out[n++] = ')';
+                out[n++] = c;
+            }
+        } else if (c == ')' && header) {
+            loop_count--;
+            bool ticks = !header->is_for || header->semicolons > 0;
+            if (!header->is_for || header->semicolons == 1) out[n++] = ')';
+            out[n++] = c;
+            if (ticks) loop_body = n;
+            depth--;
+        } else if (c == '{' && last > 0) {
+            char prev = out[last - 1];
+            bool block = prev == ')' || ends_with_word(out, last, "else") ||
+                         (prev == '>' && last >= 2 && out[last - 2] == '=');
+            out[n++] = c;
+            depth++;
+            if (block && last != loop_body) n = emit(out, n, TICK_CALL, TICK_CALL_LENGTH);
+        } else {
+            if (c == '(' || c == '[' || c == '{') depth++;
+            if ((c == ')' || c == ']' || c == '}') && depth > 0) depth--;
+            out[n++] = c;
+        }
+        last = n;
+    }
+    out[n] = '\0';
+    *out_len = n;
+    return out;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+
+// Budget instrumentation for page scripts, kept apart from the Elk glue so
+// it builds and is tested on its own.
+//
+// Every block entered (function bodies, branches) starts with a __tick()
+// call. Loops tick in their condition instead, which also covers bodies
+// without braces, empty bodies and do-while:
+//   while (c) s        ->  while (__tick()&&(c)) s
+//   for (a; b; c) s    ->  for (a;__tick()&&(b); c) s
+// __tick() returns true, or throws once the script is over budget.
+
+#define SCRIPT_INSTRUMENT_VERSION 2 // Bump when script_instrument() output changes
+
+// Rewrite `source` with budget ticks. Returns a malloc'd NUL-terminated
+// string, NULL on allocation failure.
+char *script_instrument(const char *source, size_t len, size_t *out_len);
@@ -0,0 +1,335 @@
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "disk_writer.h"
+#include "url.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+#define SNAPSHOT_PATH_LENGTH DISK_WRITER_PATH_LENGTH
+#define SESSION_FILE "session"
+
+// Growable arrays the snapshot is assembled in before it is written
+typedef struct {
+    SnapshotBox *boxes;
+    size_t box_count, box_capacity;
+    SnapshotStyle *styles;
+    size_t style_count, style_capacity;
+    char *text;
+    size_t text_size, text_capacity;
+    const StyleMap *map;
+    size_t next_record; // Style records are in widget creation order
+    const char *url;
+    bool failed;
+} SnapshotWriter;
+
+static DiskWriter writer;
+
+static const char *snapshot_dir(void) {
+    const char *dir = getenv(SNAPSHOT_DIR_ENV);
+    return (dir && *dir) ? dir : SNAPSHOT_DIR_DEFAULT;
+}
+
+static void snapshot_path(const char *url, char *out, size_t out_size) {
+    // FNV-1a; the URL stored in the file settles collisions
+    uint32_t h = 2166136261u;
+    for (const char *p = url; *p; p++) {
+        h ^= (uint8_t)*p;
+        h *= 16777619u;
+    }
+    snprintf(out, out_size, "%s/%08x.snap", snapshot_dir(), (unsigned int)h);
+}
+
+static bool grow(void **items, size_t *capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) return true;
+    size_t new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed) new_capacity *= 2;
+    void *grown = realloc(*items, new_capacity * item_size);
+    if (!grown) return false;
+    *items = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+static uint32_t add_text(SnapshotWriter *w, const char *str) {
+    if (!str) return SNAPSHOT_NONE;
+    size_t len = strlen(str) + 1;
+    if (!grow((void **)&w->text, &w->text_capacity, w->text_size + len, 1)) {
+        w->failed = true;
+        return SNAPSHOT_NONE;
+    }
+    memcpy(w->text + w->text_size, str, len);
+    uint32_t offset = (uint32_t)w->text_size;
+    w->text_size += len;
+    return offset;
+}
+
+// Pages use a handful of distinct styles, so the table stays small
+static uint32_t add_style(SnapshotWriter *w, const ComputedStyle *cs) {
+    SnapshotStyle s;
+    memset(&s, 0, sizeof(s));
+    s.color = cs->color;
+    s.bg_color = cs->bg_color;
+    s.pad_left = cs->pad_left;
+    s.pad_all = cs->pad_all;
+    s.margin_top = cs->margin_top;
+    s.margin_bottom = cs->margin_bottom;
+    s.width_value = cs->width.value;
+    s.width_unit = cs->width.unit;
+    s.text_align = cs->text_align;
+    s.text_decor = cs->text_decor;
+    s.has_bg = cs->has_bg;
+
+    for (size_t i = 0; i < w->style_count; i++) {
+        if (memcmp(&w->styles[i], &s, sizeof(s)) == 0) return (uint32_t)i;
+    }
+    if (!grow((void **)&w->styles, &w->style_capacity, w->style_count + 1, sizeof(SnapshotStyle))) {
+        w->failed = true;
+        return SNAPSHOT_NONE;
+    }
+    w->styles[w->style_count] = s;
+    return (uint32_t)w->style_count++;
+}
+
+static uint32_t add_link(SnapshotWriter *w, lxb_dom_element_t *element) {
+    if (lxb_dom_element_tag_id(element) != LXB_TAG_A) return SNAPSHOT_NONE;
+    size_t len = 0;
+    const lxb_char_t *href = lxb_dom_element_get_attribute(element, (const lxb_char_t *)"href", 4, &len);
+    if (!href || len == 0) return SNAPSHOT_NONE;
+
+    char *ref = malloc(len + 1);
+    if (!ref) return SNAPSHOT_NONE;
+    memcpy(ref, href, len);
+    ref[len] = '\0';
+    char *resolved = url_resolve(w->url, ref);
+    free(ref);
+    uint32_t offset = add_text(w, resolved);
+    free(resolved);
+    return offset;
+}
+
+static void add_box(SnapshotWriter *w, lv_obj_t *obj, uint32_t parent) {
+    if (!grow((void **)&w->boxes, &w->box_capacity, w->box_count + 1, sizeof(SnapshotBox))) {
+        w->failed = true;
+        return;
+    }
+    uint32_t index = (uint32_t)w->box_count++;
+    SnapshotBox box;
+    memset(&box, 0, sizeof(box));
+    box.parent = parent;
+    box.style = SNAPSHOT_NONE;
+    box.text = SNAPSHOT_NONE;
+    box.link = SNAPSHOT_NONE;
+    box.w = lv_obj_get_width(obj);
+    box.h = lv_obj_get_height(obj);
+
+    if (w->next_record < w->map->count && w->map->records[w->next_record].obj == obj) {
+        const StyleRecord *rec = &w->map->records[w->next_record++];
+        box.style = add_style(w, &rec->style);
+        box.link = add_link(w, rec->element);
+    }
+
+    if (lv_obj_check_type(obj, &lv_label_class)) {
+        box.kind = SNAPSHOT_BOX_TEXT;
+        box.text = add_text(w, lv_label_get_text(obj));
+    } else if (lv_obj_check_type(obj, &lv_image_class) ||
+               lv_obj_get_style_flex_flow(obj, LV_PART_MAIN) != LV_FLEX_FLOW_COLUMN) {
+        // Decoded images and their placeholders; only block boxes use flex
+        box.kind = SNAPSHOT_BOX_IMAGE;
+    } else {
+        box.kind = SNAPSHOT_BOX_BLOCK;
+    }
+    w->boxes[index] = box;
+
+    if (box.kind != SNAPSHOT_BOX_BLOCK) return;
+    uint32_t children = lv_obj_get_child_count(obj);
+    for (uint32_t i = 0; i < children && !w->failed; i++) {
+        add_box(w, lv_obj_get_child(obj, (int32_t)i), index);
+    }
+}
+
+static void append_section(char *data, size_t *used, const void *section, size_t size) {
+    if (size) memcpy(data + *used, section, size);
+    *used += size;
+}
+
+void snapshot_init(void) {
+    disk_writer_start(&writer, "snapshot");
+}
+
+void snapshot_shutdown(void) {
+    disk_writer_stop(&writer);
+}
+
+bool snapshot_save(const char *url, lv_obj_t *content, const StyleMap *styles) {
+    SnapshotWriter w;
+    memset(&w, 0, sizeof(w));
+    w.map = styles;
+    w.url = url;
+
+    uint32_t url_offset = add_text(&w, url);
+    uint32_t children = lv_obj_get_child_count(content);
+    for (uint32_t i = 0; i < children && !w.failed; i++) {
+        add_box(&w, lv_obj_get_child(content, (int32_t)i), SNAPSHOT_NONE);
+    }
+
+    char *data = NULL;
+    if (w.failed) {
+        fprintf(stderr, "Failed to build snapshot for %s\n", url);
+        goto done;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.saved_at = (uint64_t)time(NULL);
+    header.viewport_width = styles->viewport_width;
+    header.url = url_offset;
+    header.box_count = (uint32_t)w.box_count;
+    header.style_count = (uint32_t)w.style_count;
+    header.text_size = (uint32_t)w.text_size;
+    header.boxes_offset = sizeof(SnapshotHeader);
+    header.styles_offset = header.boxes_offset + header.box_count * (uint32_t)sizeof(SnapshotBox);
+    header.text_offset = header.styles_offset + header.style_count * (uint32_t)sizeof(SnapshotStyle);
+
+    // The widget tree can only be read here; the file is written off the
+    // UI thread, and readers never see it half written
+    size_t size = header.text_offset + w.text_size, used = 0;
+    data = malloc(size);
+    if (!data) {
+        fprintf(stderr, "Failed to build snapshot for %s\n", url);
+        goto done;
+    }
+    append_section(data, &used, &header, sizeof(header));
+    append_section(data, &used, w.boxes, w.box_count * sizeof(SnapshotBox));
+    append_section(data, &used, w.styles, w.style_count * sizeof(SnapshotStyle));
+    append_section(data, &used, w.text, w.text_size);
+    char path[SNAPSHOT_PATH_LENGTH];
+    snapshot_path(url, path, sizeof(path));
+    disk_writer_write(&writer, path, data, size);
+
+done:
+    free(w.boxes);
+    free(w.styles);
+    free(w.text);
+    return data != NULL;
+}
+
+static bool section_fits(size_t file_size, uint32_t offset, uint32_t count, size_t item_size) {
+    return offset % 4 == 0 && offset <= file_size &&
+           (uint64_t)count * item_size <= (uint64_t)(file_size - offset);
+}
+
+static bool string_valid(const Snapshot *snap, uint32_t offset) {
+    return offset == SNAPSHOT_NONE || offset < snap->header->text_size;
+}
+
+static bool snapshot_validate(const Snapshot *snap, const char *url) {
+    const SnapshotHeader *h = snap->header;
+    size_t size = snap->map.size;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 || h->version != SNAPSHOT_VERSION ||
+        h->byte_order != SNAPSHOT_BYTE_ORDER) {
+        return false;
+    }
+    if (!section_fits(size, h->boxes_offset, h->box_count, sizeof(SnapshotBox)) ||
+        !section_fits(size, h->styles_offset, h->style_count, sizeof(SnapshotStyle)) ||
+        !section_fits(size, h->text_offset, h->text_size, 1)) {
+        return false;
+    }
+    // Every string ends inside the arena because the arena ends in a NUL
+    if (h->text_size == 0 || snap->text[h->text_size - 1] != '\0') return false;
+    if (h->url >= h->text_size || strcmp(snap->text + h->url, url) != 0) return false;
+
+    for (uint32_t i = 0; i < h->box_count; i++) {
+        const SnapshotBox *box = &snap->boxes[i];
+        if (box->parent != SNAPSHOT_NONE && box->parent >= i) return false;
+        if (box->parent != SNAPSHOT_NONE && snap->boxes[box->parent].kind != SNAPSHOT_BOX_BLOCK) return false;
+        if (box->style != SNAPSHOT_NONE && box->style >= h->style_count) return false;
+        if (!string_valid(snap, box->text) || !string_valid(snap, box->link)) return false;
+        if (box->kind > SNAPSHOT_BOX_IMAGE) return false;
+    }
+    return true;
+}
+
+bool snapshot_open(Snapshot *snap, const char *url) {
+    memset(snap, 0, sizeof(*snap));
+    char path[SNAPSHOT_PATH_LENGTH];
+    snapshot_path(url, path, sizeof(path));
+    if (!file_map_open(&snap->map, path)) return false;
+
+    if (snap->map.size >= sizeof(SnapshotHeader)) {
+        snap->header = (const SnapshotHeader *)snap->map.data;
+        snap->boxes = (const SnapshotBox *)(snap->map.data + snap->header->boxes_offset);
+        snap->styles = (const SnapshotStyle *)(snap->map.data + snap->header->styles_offset);
+        snap->text = snap->map.data + snap->header->text_offset;
+        // Section pointers are only dereferenced once their offsets check out
+        if (snapshot_validate(snap, url)) return true;
+    }
+    fprintf(stderr, "Ignoring unusable snapshot %s\n", path);
+    snapshot_close(snap);
+    return false;
+}
+
+void snapshot_close(Snapshot *snap) {
+    file_map_close(&snap->map);
+    memset(snap, 0, sizeof(*snap));
+}
+
+const char *snapshot_text(const Snapshot *snap, uint32_t offset) {
+    return offset == SNAPSHOT_NONE ? NULL : snap->text + offset;
+}
+
+void snapshot_style(const Snapshot *snap, uint32_t index, ComputedStyle *out) {
+    const SnapshotStyle *s = &snap->styles[index];
+    memset(out, 0, sizeof(*out));
+    out->color = s->color;
+    out->bg_color = s->bg_color;
+    out->pad_left = s->pad_left;
+    out->pad_all = s->pad_all;
+    out->margin_top = s->margin_top;
+    out->margin_bottom = s->margin_bottom;
+    out->width.value = s->width_value;
+    out->width.unit = s->width_unit;
+    out->text_align = s->text_align;
+    out->text_decor = s->text_decor;
+    out->has_bg = s->has_bg != 0;
+}
+
+void snapshot_session_save(const char *const *urls, int count) {
+    char path[SNAPSHOT_PATH_LENGTH];
+    make_dir(snapshot_dir());
+    snprintf(path, sizeof(path), "%s/%s", snapshot_dir(), SESSION_FILE);
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to save session to %s\n", path);
+        return;
+    }
+    for (int i = 0; i < count; i++) fprintf(file, "%s\n", urls[i]);
+    fclose(file);
+}
+
+char *snapshot_session_load(void) {
+    char path[SNAPSHOT_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", snapshot_dir(), SESSION_FILE);
+    FileMap map;
+    if (!file_map_open(&map, path)) return NULL;
+    char *text = malloc(map.size + 1);
+    if (text) {
+        memcpy(text, map.data, map.size);
+        text[map.size] = '\0';
+    }
+    file_map_close(&map);
+    return text;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lvgl.h>
+
+#include "file_map.h"
+#include "style.h"
+
+// Page snapshots: the rendered box tree of a page (boxes, their computed
+// styles, text and link targets) in a versioned binary file that is mapped
+// back in and painted without fetching, parsing or styling anything.
+// Written after every successful load, off the UI thread; read on startup
+// and on revisits while the real page is fetched again in the background.
+//
+// Layout: SnapshotHeader, then the box array, the style table and the text
+// arena at the offsets the header gives. Every field is fixed width and
+// naturally aligned so the mapped file is used in place. Strings in the
+// arena are NUL-terminated and referenced by byte offset.
+
+#define SNAPSHOT_MAGIC "TBSNAP\0"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304u // Written in host order; a mismatch rejects the file
+#define SNAPSHOT_NONE 0xFFFFFFFFu       // Missing parent, style or string
+#define SNAPSHOT_DIR_ENV "TACTILE_SNAPSHOT_DIR"
+#define SNAPSHOT_DIR_DEFAULT "snapshots"
+
+typedef enum {
+    SNAPSHOT_BOX_BLOCK, // Vertical container
+    SNAPSHOT_BOX_TEXT,  // Wrapped label
+    SNAPSHOT_BOX_IMAGE, // Image or its placeholder, painted as a sized box
+} SnapshotBoxKind;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t saved_at;       // Seconds since the epoch
+    int32_t viewport_width;  // Content width the page was laid out for
+    uint32_t url;            // Text offset of the page URL
+    uint32_t box_count;
+    uint32_t style_count;
+    uint32_t text_size;
+    uint32_t boxes_offset;   // File offsets of the three sections
+    uint32_t styles_offset;
+    uint32_t text_offset;
+} SnapshotHeader;
+
+typedef struct {
+    uint32_t parent; // Index of an earlier box, SNAPSHOT_NONE for top level
+    uint32_t style;  // Style table index, SNAPSHOT_NONE to inherit everything
+    uint32_t text;   // Label text
+    uint32_t link;   // href of the <a> the box was rendered from
+    int32_t w;       // Laid-out size when saved
+    int32_t h;
+    uint8_t kind;    // SnapshotBoxKind
+    uint8_t reserved[3];
+} SnapshotBox;
+
+// ComputedStyle with fixed field widths
+typedef struct {
+    uint32_t color;
+    uint32_t bg_color;
+    int16_t pad_left;
+    int16_t pad_all;
+    int16_t margin_top;
+    int16_t margin_bottom;
+    int16_t width_value;
+    uint8_t width_unit;
+    uint8_t text_align;
+    uint8_t text_decor;
+    uint8_t has_bg;
+    uint8_t reserved[2];
+} SnapshotStyle;
+
+// A validated, mapped snapshot. The sections point into the mapping.
+typedef struct {
+    FileMap map;
+    const SnapshotHeader *header; // NULL when nothing is open
+    const SnapshotBox *boxes;
+    const SnapshotStyle *styles;
+    const char *text;
+} Snapshot;
+
+// Start and stop the thread snapshot files are written on. Stopping
+// finishes the writes already queued.
+void snapshot_init(void);
+void snapshot_shutdown(void);
+
+// Copy the widget tree under `content` (whose children were rendered with
+// `styles`) and queue it as the snapshot for `url`, replacing the previous
+// one atomically. False if it could not be built.
+bool snapshot_save(const char *url, lv_obj_t *content, const StyleMap *styles);
+
+// Map and validate the snapshot for `url`. Returns false when there is none
+// or it is unusable (wrong version, truncated, saved for another URL).
+bool snapshot_open(Snapshot *snap, const char *url);
+void snapshot_close(Snapshot *snap);
+
+// String at `offset` in the text arena, NULL for SNAPSHOT_NONE
+const char *snapshot_text(const Snapshot *snap, uint32_t offset);
+void snapshot_style(const Snapshot *snap, uint32_t index, ComputedStyle *out);
+
+// Session restore: the URLs of the open tabs, one per line
+void snapshot_session_save(const char *const *urls, int count);
+// Returns the malloc'd session text, NULL when there is none
+char *snapshot_session_load(void);
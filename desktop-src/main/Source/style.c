@@ -0,0 +1,491 @@
+#include "style.h"
+#include "trace.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_STYLE_BUFFER 512
+#define NARROW_VIEWPORT 480
+#define DEFAULT_TEXT_COLOR 0xE0E0E0
+
+// Which fields of ComputedStyle a rule sets
+enum {
+    PROP_COLOR         = 1 << 0,
+    PROP_DECOR         = 1 << 1,
+    PROP_MARGIN_TOP    = 1 << 2,
+    PROP_MARGIN_BOTTOM = 1 << 3,
+    PROP_PAD_LEFT      = 1 << 4,
+    PROP_PAD_NARROW    = 1 << 5, // pad_left shrinks on narrow viewports
+};
+
+typedef struct {
+    lxb_tag_id_t tag;
+    uint16_t props;
+    uint32_t color;
+    uint8_t text_decor;
+    int16_t margin_top;
+    int16_t margin_bottom;
+    int16_t pad_left;
+} StyleRule;
+
+// Built-in (user agent) rules for the dark content theme
+static const StyleRule ua_rules[] = {
+    {LXB_TAG_BODY, PROP_PAD_LEFT | PROP_PAD_NARROW, 0, 0, 0, 0, 20},
+    {LXB_TAG_H1, PROP_COLOR | PROP_MARGIN_TOP, 0xFFFFFF, 0, 10, 0, 0},
+    {LXB_TAG_H2, PROP_COLOR | PROP_MARGIN_TOP, 0xFFFFFF, 0, 10, 0, 0},
+    {LXB_TAG_H3, PROP_COLOR | PROP_MARGIN_TOP, 0xFFFFFF, 0, 10, 0, 0},
+    {LXB_TAG_H4, PROP_COLOR, 0xFFFFFF, 0, 0, 0, 0},
+    {LXB_TAG_A, PROP_COLOR | PROP_DECOR, 0x4A90E2, LV_TEXT_DECOR_UNDERLINE, 0, 0, 0},
+    {LXB_TAG_P, PROP_MARGIN_BOTTOM, 0, 0, 0, 10, 0},
+    {LXB_TAG_LI, PROP_PAD_LEFT, 0, 0, 0, 0, 16},
+    {LXB_TAG_BLOCKQUOTE, PROP_PAD_LEFT | PROP_PAD_NARROW | PROP_COLOR, 0xB0B0B0, 0, 0, 0, 20},
+    {LXB_TAG_PRE, PROP_COLOR, 0xC9D1D9, 0, 0, 0, 0},
+};
+
+// CSS color table for fast lookup
+typedef struct {
+    const char *name;
+    uint32_t color;
+} ColorEntry;
+
+static const ColorEntry color_table[] = {
+    {"red", 0xFF0000}, {"green", 0x00FF00}, {"blue", 0x0000FF},
+    {"black", 0x000000}, {"white", 0xFFFFFF}, {"gray", 0x808080},
+    {"yellow", 0xFFFF00}, {"orange", 0xFFA500}, {"purple", 0x800080}
+};
+
+static const StyleRule *find_rule(lxb_tag_id_t tag) {
+    for (size_t i = 0; i < sizeof(ua_rules) / sizeof(ua_rules[0]); i++) {
+        if (ua_rules[i].tag == tag) return &ua_rules[i];
+    }
+    return NULL;
+}
+
+static uint32_t hash_bytes(const lxb_char_t *data, size_t len) {
+    // FNV-1a; 0 is reserved for "no style attribute"
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+static bool parse_color(const char *val, uint32_t *out) {
+    if (val[0] == '#') {
+        unsigned int color;
+        if (sscanf(val + 1, "%06x", &color) == 1) {
+            *out = color;
+            return true;
+        }
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(color_table) / sizeof(color_table[0]); i++) {
+        if (strcmp(val, color_table[i].name) == 0) {
+            *out = color_table[i].color;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_length(const char *val, StyleLength *out) {
+    if (strcmp(val, "auto") == 0) {
+        out->unit = STYLE_LEN_AUTO;
+        out->value = 0;
+        return true;
+    }
+
+    char *end;
+    long v = strtol(val, &end, 10);
+    if (end == val || v < 0 || v > 2000) return false;
+
+    out->value = (int16_t)v;
+    if (strcmp(end, "%") == 0) out->unit = STYLE_LEN_PCT;
+    else if (strcmp(end, "vw") == 0) out->unit = STYLE_LEN_VW;
+    else if (*end == 0 || strcmp(end, "px") == 0) out->unit = STYLE_LEN_PX;
+    else return false;
+    return true;
+}
+
+// Resolve a length to pixels where possible; `deps` picks up STYLE_DEP_VIEWPORT
+static int16_t resolve_px(StyleLength len, lv_coord_t viewport_width, uint8_t *deps) {
+    if (len.unit == STYLE_LEN_VW) {
+        *deps |= STYLE_DEP_VIEWPORT;
+        return (int16_t)(len.value * viewport_width / 100);
+    }
+    return len.unit == STYLE_LEN_PX ? len.value : 0;
+}
+
+// Split the next "key: value" declaration out of a style attribute
+// (modified in place). Returns false at the end of the string.
+static bool next_declaration(char **cursor, char **key, char **value) {
+    char *p = *cursor;
+
+    for (;;) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        if (!*p) {
+            *cursor = p;
+            return false;
+        }
+
+        // Find key
+        char *key_start = p;
+        while (*p && *p != ':' && *p != ';' && !isspace((unsigned char)*p)) p++;
+        while (*p && isspace((unsigned char)*p)) *p++ = 0;
+        if (*p != ':') {
+            // Malformed declaration, skip to the next one
+            while (*p && *p != ';') p++;
+            if (*p) p++;
+            continue;
+        }
+        *p++ = 0;
+
+        while (*p && isspace((unsigned char)*p)) p++;
+        char *val_start = p;
+
+        while (*p && *p != ';') p++;
+        if (*p == ';') *p++ = 0;
+
+        char *val_end = val_start + strlen(val_start);
+        while (val_end > val_start && isspace((unsigned char)val_end[-1])) *--val_end = 0;
+
+        *key = key_start;
+        *value = val_start;
+        *cursor = p;
+        return true;
+    }
+}
+
+// Parse a style attribute (modified in place) into `cs`, recording which
+// inputs were used
+static void apply_inline_style(ComputedStyle *cs, char *style, lv_coord_t viewport_width,
+                               uint8_t *deps) {
+    char *p = style;
+    char *key_start, *val_start;
+
+    while (next_declaration(&p, &key_start, &val_start)) {
+        StyleLength len;
+        if (strcmp(key_start, "color") == 0) {
+            parse_color(val_start, &cs->color);
+        } else if (strcmp(key_start, "background-color") == 0 || strcmp(key_start, "background") == 0) {
+            if (parse_color(val_start, &cs->bg_color)) cs->has_bg = true;
+        } else if (strcmp(key_start, "text-align") == 0) {
+            if (strcmp(val_start, "center") == 0) cs->text_align = LV_TEXT_ALIGN_CENTER;
+            else if (strcmp(val_start, "right") == 0) cs->text_align = LV_TEXT_ALIGN_RIGHT;
+            else if (strcmp(val_start, "left") == 0) cs->text_align = LV_TEXT_ALIGN_LEFT;
+        } else if (strcmp(key_start, "text-decoration") == 0) {
+            if (strcmp(val_start, "underline") == 0) cs->text_decor = LV_TEXT_DECOR_UNDERLINE;
+            else if (strcmp(val_start, "line-through") == 0) cs->text_decor = LV_TEXT_DECOR_STRIKETHROUGH;
+            else if (strcmp(val_start, "none") == 0) cs->text_decor = LV_TEXT_DECOR_NONE;
+        } else if (strcmp(key_start, "padding") == 0 && parse_length(val_start, &len)) {
+            cs->pad_all = resolve_px(len, viewport_width, deps);
+        } else if (strcmp(key_start, "padding-left") == 0 && parse_length(val_start, &len)) {
+            cs->pad_left = resolve_px(len, viewport_width, deps);
+        } else if (strcmp(key_start, "margin") == 0 && parse_length(val_start, &len)) {
+            cs->margin_top = cs->margin_bottom = resolve_px(len, viewport_width, deps);
+        } else if (strcmp(key_start, "margin-top") == 0 && parse_length(val_start, &len)) {
+            cs->margin_top = resolve_px(len, viewport_width, deps);
+        } else if (strcmp(key_start, "margin-bottom") == 0 && parse_length(val_start, &len)) {
+            cs->margin_bottom = resolve_px(len, viewport_width, deps);
+        } else if (strcmp(key_start, "width") == 0 && parse_length(val_start, &len)) {
+            if (len.unit == STYLE_LEN_VW) *deps |= STYLE_DEP_VIEWPORT;
+            cs->width = len;
+        }
+    }
+}
+
+static void compute_style(const StyleMap *map, StyleRecord *rec) {
+    ComputedStyle *cs = &rec->style;
+    uint8_t deps = 0;
+
+    memset(cs, 0, sizeof(*cs));
+    cs->width.unit = STYLE_LEN_PCT;
+    cs->width.value = 100;
+
+    // Inherited properties
+    if (rec->parent >= 0) {
+        const ComputedStyle *ps = &map->records[rec->parent].style;
+        cs->color = ps->color;
+        cs->text_align = ps->text_align;
+        cs->text_decor = ps->text_decor;
+        deps |= STYLE_DEP_PARENT;
+    } else {
+        cs->color = DEFAULT_TEXT_COLOR;
+        cs->text_align = LV_TEXT_ALIGN_LEFT;
+        cs->text_decor = LV_TEXT_DECOR_NONE;
+    }
+
+    const StyleRule *rule = find_rule(lxb_dom_element_tag_id(rec->element));
+    if (rule) {
+        deps |= STYLE_DEP_TAG;
+        if (rule->props & PROP_COLOR) cs->color = rule->color;
+        if (rule->props & PROP_DECOR) cs->text_decor = rule->text_decor;
+        if (rule->props & PROP_MARGIN_TOP) cs->margin_top = rule->margin_top;
+        if (rule->props & PROP_MARGIN_BOTTOM) cs->margin_bottom = rule->margin_bottom;
+        if (rule->props & PROP_PAD_LEFT) cs->pad_left = rule->pad_left;
+        if (rule->props & PROP_PAD_NARROW) {
+            deps |= STYLE_DEP_VIEWPORT;
+            if (map->viewport_width < NARROW_VIEWPORT) cs->pad_left = rule->pad_left / 2;
+        }
+    }
+
+    size_t attr_len = 0;
+    const lxb_char_t *style_attr = lxb_dom_element_get_attribute(rec->element,
+        (const lxb_char_t *)"style", 5, &attr_len);
+    rec->inline_hash = 0;
+    if (style_attr && attr_len > 0) {
+        // Depend on the attribute even if nothing in it was understood, so a
+        // later edit that adds a known property is picked up
+        deps |= STYLE_DEP_INLINE;
+        rec->inline_hash = hash_bytes(style_attr, attr_len);
+        if (attr_len < MAX_STYLE_BUFFER) {
+            char style_buffer[MAX_STYLE_BUFFER];
+            memcpy(style_buffer, style_attr, attr_len);
+            style_buffer[attr_len] = 0;
+            apply_inline_style(cs, style_buffer, map->viewport_width, &deps);
+        }
+    }
+
+    rec->deps = deps;
+}
+
+bool style_element_size(lxb_dom_element_t *element, lv_coord_t viewport_width,
+                        lv_coord_t *width, lv_coord_t *height) {
+    size_t attr_len = 0;
+    const lxb_char_t *style_attr = lxb_dom_element_get_attribute(element,
+        (const lxb_char_t *)"style", 5, &attr_len);
+    if (!style_attr || attr_len == 0 || attr_len >= MAX_STYLE_BUFFER) return false;
+
+    char style_buffer[MAX_STYLE_BUFFER];
+    memcpy(style_buffer, style_attr, attr_len);
+    style_buffer[attr_len] = 0;
+
+    bool found = false;
+    char *p = style_buffer;
+    char *key, *val;
+    while (next_declaration(&p, &key, &val)) {
+        bool is_width = strcmp(key, "width") == 0;
+        if (!is_width && strcmp(key, "height") != 0) continue;
+
+        StyleLength len;
+        if (!parse_length(val, &len) || len.unit == STYLE_LEN_AUTO) continue;
+
+        // Percentages have no containing block here; treat them as viewport relative
+        lv_coord_t px = len.unit == STYLE_LEN_PX ? len.value : (lv_coord_t)(len.value * viewport_width / 100);
+        if (is_width) *width = px;
+        else *height = px;
+        found = true;
+    }
+    return found;
+}
+
+static lv_coord_t resolve_width(StyleLength width, lv_coord_t viewport_width) {
+    switch (width.unit) {
+        case STYLE_LEN_PX: return width.value;
+        case STYLE_LEN_PCT: return lv_pct(width.value);
+        case STYLE_LEN_VW: return (lv_coord_t)(width.value * viewport_width / 100);
+        default: return LV_SIZE_CONTENT;
+    }
+}
+
+// Push only the properties that differ from `old` into the widget
+static void apply_style(lv_obj_t *obj, const ComputedStyle *old, const ComputedStyle *cs,
+                        lv_coord_t viewport_width) {
+    if (!old || old->color != cs->color) {
+        lv_obj_set_style_text_color(obj, lv_color_hex(cs->color), 0);
+    }
+    if (!old || old->text_align != cs->text_align) {
+        lv_obj_set_style_text_align(obj, (lv_text_align_t)cs->text_align, 0);
+    }
+    if (!old || old->text_decor != cs->text_decor) {
+        lv_obj_set_style_text_decor(obj, (lv_text_decor_t)cs->text_decor, 0);
+    }
+    if (!old || old->has_bg != cs->has_bg || old->bg_color != cs->bg_color) {
+        lv_obj_set_style_bg_color(obj, lv_color_hex(cs->bg_color), 0);
+        lv_obj_set_style_bg_opa(obj, cs->has_bg ? LV_OPA_COVER : LV_OPA_TRANSP, 0);
+    }
+    if (!old || old->pad_all != cs->pad_all || old->pad_left != cs->pad_left) {
+        lv_obj_set_style_pad_all(obj, cs->pad_all, 0);
+        lv_obj_set_style_pad_left(obj, cs->pad_left ? cs->pad_left : cs->pad_all, 0);
+    }
+    if (!old || old->margin_top != cs->margin_top) {
+        lv_obj_set_style_margin_top(obj, cs->margin_top, 0);
+    }
+    if (!old || old->margin_bottom != cs->margin_bottom) {
+        lv_obj_set_style_margin_bottom(obj, cs->margin_bottom, 0);
+    }
+    if (!old || old->width.unit != cs->width.unit || old->width.value != cs->width.value ||
+        cs->width.unit == STYLE_LEN_VW) {
+        lv_obj_set_width(obj, resolve_width(cs->width, viewport_width));
+    }
+}
+
+static bool inherited_changed(const ComputedStyle *a, const ComputedStyle *b) {
+    return a->color != b->color || a->text_align != b->text_align || a->text_decor != b->text_decor;
+}
+
+void style_map_init(StyleMap *map, lv_coord_t viewport_width) {
+    memset(map, 0, sizeof(*map));
+    map->viewport_width = viewport_width;
+}
+
+void style_map_reset(StyleMap *map) {
+    map->count = 0;
+    if (map->index) memset(map->index, 0, map->index_capacity * sizeof(*map->index));
+    map->index_failed = false;
+}
+
+void style_map_free(StyleMap *map) {
+    free(map->records);
+    free(map->index);
+    memset(map, 0, sizeof(*map));
+}
+
+static size_t hash_element(const lxb_dom_element_t *element) {
+    uintptr_t x = (uintptr_t)element;
+    x ^= x >> 17;
+    x *= (uintptr_t)0x9E3779B97F4A7C15ull;
+    return (size_t)(x ^ (x >> 29));
+}
+
+static void index_put(uint32_t *index, size_t capacity, const StyleRecord *records, uint32_t record) {
+    size_t at = hash_element(records[record].element) & (capacity - 1);
+    while (index[at]) {
+        // An element attached twice keeps its first record
+        if (records[index[at] - 1].element == records[record].element) return;
+        at = (at + 1) & (capacity - 1);
+    }
+    index[at] = record + 1;
+}
+
+// Index the record just added at `record`
+static void index_add(StyleMap *map, uint32_t record) {
+    if (map->index_failed) return;
+    if ((map->count + 1) * 2 > map->index_capacity) {
+        size_t capacity = map->index_capacity ? map->index_capacity * 2 : 128;
+        uint32_t *index = calloc(capacity, sizeof(*index));
+        if (!index) {
+            map->index_failed = true;
+            return;
+        }
+        for (uint32_t i = 0; i < record; i++) index_put(index, capacity, map->records, i);
+        free(map->index);
+        map->index = index;
+        map->index_capacity = capacity;
+    }
+    index_put(map->index, map->index_capacity, map->records, record);
+}
+
+int32_t style_find(const StyleMap *map, const lxb_dom_element_t *element) {
+    if (map->index_failed) {
+        for (size_t i = 0; i < map->count; i++) {
+            if (map->records[i].element == element) return (int32_t)i;
+        }
+        return -1;
+    }
+    if (!map->index_capacity) return -1;
+    size_t at = hash_element(element) & (map->index_capacity - 1);
+    while (map->index[at]) {
+        uint32_t record = map->index[at] - 1;
+        if (map->records[record].element == element) return (int32_t)record;
+        at = (at + 1) & (map->index_capacity - 1);
+    }
+    return -1;
+}
+
+int32_t style_attach(StyleMap *map, lxb_dom_element_t *element, lv_obj_t *obj, int32_t parent) {
+    if (map->count == map->capacity) {
+        size_t new_capacity = map->capacity ? map->capacity * 2 : 64;
+        StyleRecord *records = realloc(map->records, new_capacity * sizeof(*records));
+        if (!records) {
+            fprintf(stderr, "Memory reallocation failed\n");
+            return parent;
+        }
+        map->records = records;
+        map->capacity = new_capacity;
+    }
+
+    StyleRecord *rec = &map->records[map->count];
+    memset(rec, 0, sizeof(*rec));
+    rec->element = element;
+    rec->obj = obj;
+    rec->parent = parent;
+
+    compute_style(map, rec);
+    apply_style(obj, NULL, &rec->style, map->viewport_width);
+    trace_count(TRACE_RESTYLE, 1);
+
+    index_add(map, (uint32_t)map->count);
+    return (int32_t)map->count++;
+}
+
+void style_apply_computed(lv_obj_t *obj, const ComputedStyle *style, lv_coord_t viewport_width) {
+    apply_style(obj, NULL, style, viewport_width);
+}
+
+void style_invalidate_element(StyleMap *map, lxb_dom_element_t *element, StyleDep reason) {
+    int32_t found = style_find(map, element);
+    if (found < 0) return;
+    StyleRecord *rec = &map->records[found];
+
+    if (reason == STYLE_DEP_INLINE) {
+        // Rewriting the same style attribute is a no-op
+        size_t attr_len = 0;
+        const lxb_char_t *style_attr = lxb_dom_element_get_attribute(element,
+            (const lxb_char_t *)"style", 5, &attr_len);
+        uint32_t hash = (style_attr && attr_len > 0) ? hash_bytes(style_attr, attr_len) : 0;
+        if (hash != rec->inline_hash) rec->dirty = true;
+    } else if (reason == STYLE_DEP_CLASS || (rec->deps & reason)) {
+        // A class edit can introduce an input the record did not use before
+        rec->dirty = true;
+    }
+}
+
+void style_set_viewport(StyleMap *map, lv_coord_t viewport_width) {
+    if (viewport_width == map->viewport_width) return;
+
+    map->viewport_width = viewport_width;
+    for (size_t i = 0; i < map->count; i++) {
+        if (map->records[i].deps & STYLE_DEP_VIEWPORT) map->records[i].dirty = true;
+    }
+}
+
+size_t style_flush(StyleMap *map) {
+    size_t restyled = 0;
+    uint64_t start = trace_now_us();
+    lv_coord_t viewport = map->viewport_width;
+
+    // Records are in document order, so a parent is always settled before
+    // its children are looked at
+    for (size_t i = 0; i < map->count; i++) {
+        StyleRecord *rec = &map->records[i];
+
+        if (!rec->dirty && rec->parent >= 0 && (rec->deps & STYLE_DEP_PARENT) &&
+            map->records[rec->parent].inherited_changed) {
+            rec->dirty = true;
+        }
+        if (!rec->dirty) continue;
+
+        ComputedStyle old = rec->style;
+        compute_style(map, rec);
+        apply_style(rec->obj, &old, &rec->style, viewport);
+        rec->inherited_changed = inherited_changed(&old, &rec->style);
+        restyled++;
+    }
+
+    for (size_t i = 0; i < map->count; i++) {
+        map->records[i].dirty = false;
+        map->records[i].inherited_changed = false;
+    }
+
+    if (restyled > 0) {
+        trace_count(TRACE_RESTYLE, (uint32_t)restyled);
+        trace_count(TRACE_RESTYLE_SKIPPED, (uint32_t)(map->count - restyled));
+        trace_stage_add(TRACE_STAGE_STYLE, trace_now_us() - start);
+        trace_event("restyle: %zu of %zu records (viewport %d)", restyled, map->count, (int)viewport);
+    }
+    return restyled;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lexbor/html/html.h>
+#include <lvgl.h>
+
+// Inputs a computed style was derived from. A record is only recomputed when
+// one of the inputs it actually used changes.
+typedef enum {
+    STYLE_DEP_TAG      = 1 << 0, // built-in rule for the element's tag
+    STYLE_DEP_INLINE   = 1 << 1, // style="" attribute
+    STYLE_DEP_CLASS    = 1 << 2, // class attribute
+    STYLE_DEP_VIEWPORT = 1 << 3, // vw lengths or width-dependent rules
+    STYLE_DEP_PARENT   = 1 << 4, // inherited values from the parent record
+} StyleDep;
+
+typedef enum {
+    STYLE_LEN_AUTO,
+    STYLE_LEN_PX,
+    STYLE_LEN_PCT,
+    STYLE_LEN_VW,
+} StyleLengthUnit;
+
+typedef struct {
+    int16_t value;
+    uint8_t unit; // StyleLengthUnit
+} StyleLength;
+
+typedef struct {
+    // Inherited
+    uint32_t color;
+    uint8_t text_align;  // lv_text_align_t
+    uint8_t text_decor;  // lv_text_decor_t
+    // Not inherited
+    bool has_bg;
+    uint32_t bg_color;
+    int16_t pad_left;
+    int16_t pad_all;
+    int16_t margin_top;
+    int16_t margin_bottom;
+    StyleLength width;
+} ComputedStyle;
+
+typedef struct {
+    lxb_dom_element_t *element;
+    lv_obj_t *obj;
+    int32_t parent;       // Index of the nearest styled ancestor, -1 for none
+    uint32_t inline_hash; // Hash of the style attribute the record was computed from
+    uint8_t deps;         // StyleDep bits
+    bool dirty;
+    bool inherited_changed; // Set during style_flush() for dependants
+    ComputedStyle style;
+} StyleRecord;
+
+// Computed styles of one page, in document order (parents before children)
+typedef struct {
+    StyleRecord *records;
+    size_t count;
+    size_t capacity;
+    // Element -> record index plus one, by open addressing
+    uint32_t *index;
+    size_t index_capacity;  // Power of two, kept at most half full
+    bool index_failed;      // Could not grow; lookups scan the records
+    lv_coord_t viewport_width;
+} StyleMap;
+
+void style_map_init(StyleMap *map, lv_coord_t viewport_width);
+void style_map_reset(StyleMap *map);
+void style_map_free(StyleMap *map);
+
+// Compute the style for an element, apply it to its widget and remember the
+// dependencies. Returns the record index used as `parent` for children.
+int32_t style_attach(StyleMap *map, lxb_dom_element_t *element, lv_obj_t *obj, int32_t parent);
+
+// Apply a computed style to a widget that has no record, e.g. one painted
+// from a page snapshot
+void style_apply_computed(lv_obj_t *obj, const ComputedStyle *style, lv_coord_t viewport_width);
+
+// Index of the record for `element`, -1 if it has none
+int32_t style_find(const StyleMap *map, const lxb_dom_element_t *element);
+
+// Mark records dirty because of a change to one of their inputs
+void style_invalidate_element(StyleMap *map, lxb_dom_element_t *element, StyleDep reason);
+void style_set_viewport(StyleMap *map, lv_coord_t viewport_width);
+
+// Read width/height from an element's style attribute, resolved to pixels.
+// Leaves missing ones untouched; returns false if neither was set.
+bool style_element_size(lxb_dom_element_t *element, lv_coord_t viewport_width,
+                        lv_coord_t *width, lv_coord_t *height);
+
+// Recompute dirty records (and dependants whose inherited values changed).
+// Returns the number of records restyled.
+size_t style_flush(StyleMap *map);
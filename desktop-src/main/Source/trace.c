@@ -0,0 +1,101 @@
+#include "trace.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+#define TRACE_ENV "TACTILE_TRACE"
+#define TRACE_URL_LENGTH 128
+
+static const char *counter_names[TRACE_COUNTER_COUNT] = {
+    "restyles",
+    "restyles_skipped",
+    "widgets",
+    "images_decoded",
+    "image_cache_hits",
+    "images_deferred",
+    "preloads",
+    "preload_hits",
+    "navs_abandoned",
+    "wasted_bytes",
+    "wasted_parse_us",
+    "bfcache_hits",
+    "snapshot_hits",
+    "scripts_run",
+    "scripts_killed",
+};
+
+static const char *stage_names[TRACE_STAGE_COUNT] = {
+    "fetch",
+    "parse",
+    "style",
+    "render",
+    "decode",
+    "script",
+};
+
+static uint32_t counters[TRACE_COUNTER_COUNT];
+static uint64_t stages[TRACE_STAGE_COUNT];
+static char page_url[TRACE_URL_LENGTH];
+static int enabled = -1;
+
+static bool trace_enabled(void) {
+    if (enabled < 0) {
+        const char *env = getenv(TRACE_ENV);
+        enabled = (env && *env && strcmp(env, "0") != 0) ? 1 : 0;
+    }
+    return enabled == 1;
+}
+
+void trace_page_begin(const char *url) {
+    memset(counters, 0, sizeof(counters));
+    memset(stages, 0, sizeof(stages));
+    snprintf(page_url, sizeof(page_url), "%s", url ? url : "");
+}
+
+void trace_page_end(void) {
+    if (!trace_enabled()) return;
+
+    fprintf(stderr, "[trace] %s", page_url);
+    for (int i = 0; i < TRACE_STAGE_COUNT; i++) {
+        fprintf(stderr, " %s=%.2fms", stage_names[i], stages[i] / 1000.0);
+    }
+    for (int i = 0; i < TRACE_COUNTER_COUNT; i++) {
+        fprintf(stderr, " %s=%u", counter_names[i], counters[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+void trace_count(TraceCounter counter, uint32_t amount) {
+    counters[counter] += amount;
+}
+
+uint32_t trace_get(TraceCounter counter) {
+    return counters[counter];
+}
+
+uint64_t trace_now_us(void) {
+    static uint64_t frequency = 0;
+    if (!frequency) frequency = SDL_GetPerformanceFrequency();
+    uint64_t ticks = SDL_GetPerformanceCounter();
+    // Split the conversion so nanosecond counters do not overflow
+    return (ticks / frequency) * 1000000ULL + (ticks % frequency) * 1000000ULL / frequency;
+}
+
+void trace_stage_add(TraceStage stage, uint64_t elapsed_us) {
+    stages[stage] += elapsed_us;
+}
+
+void trace_event(const char *fmt, ...) {
+    if (!trace_enabled()) return;
+
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "[trace] ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
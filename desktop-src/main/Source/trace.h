@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Lightweight per-page trace. Counters and stage timings accumulate between
+// trace_page_begin() and trace_page_end(); the summary is printed to stderr
+// when the TACTILE_TRACE environment variable is set.
+
+typedef enum {
+    TRACE_RESTYLE,          // computed styles (re)calculated
+    TRACE_RESTYLE_SKIPPED,  // records left untouched by an incremental restyle
+    TRACE_WIDGETS,          // LVGL objects created for page content
+    TRACE_IMAGES_DECODED,   // images decoded (cache misses)
+    TRACE_IMAGE_CACHE_HITS, // images served from the decoded image cache
+    TRACE_IMAGES_DEFERRED,  // images given a placeholder to load near the viewport
+    TRACE_PRELOADS,         // speculative fetches started by the preload scanner
+    TRACE_PRELOAD_HITS,     // requests served by an earlier preload
+    TRACE_NAVS_ABANDONED,   // navigations superseded before they rendered
+    TRACE_WASTED_BYTES,     // bytes received by transfers that were then dropped
+    TRACE_WASTED_PARSE_US,  // parser time spent on abandoned navigations
+    TRACE_BFCACHE_HITS,     // back/forward navigations served by a frozen page
+    TRACE_SNAPSHOT_HITS,    // navigations painted from a page snapshot before fetching
+    TRACE_SCRIPTS_RUN,      // scripts executed
+    TRACE_SCRIPTS_KILLED,   // scripts stopped by their execution budget
+    TRACE_COUNTER_COUNT
+} TraceCounter;
+
+typedef enum {
+    TRACE_STAGE_FETCH,
+    TRACE_STAGE_PARSE,
+    TRACE_STAGE_STYLE,
+    TRACE_STAGE_RENDER,
+    TRACE_STAGE_DECODE,
+    TRACE_STAGE_SCRIPT,
+    TRACE_STAGE_COUNT
+} TraceStage;
+
+void trace_page_begin(const char *url);
+void trace_page_end(void);
+
+void trace_count(TraceCounter counter, uint32_t amount);
+uint32_t trace_get(TraceCounter counter);
+
+uint64_t trace_now_us(void);
+void trace_stage_add(TraceStage stage, uint64_t elapsed_us);
+
+// One-line note for work done outside a page load (e.g. an incremental restyle)
+void trace_event(const char *fmt, ...);
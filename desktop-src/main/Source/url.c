@@ -0,0 +1,109 @@
+#include "url.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Length of "scheme:" including the colon, or 0 if `s` has no scheme
+static size_t scheme_length(const char *s) {
+    if (!isalpha((unsigned char)s[0])) return 0;
+    size_t i = 1;
+    while (isalnum((unsigned char)s[i]) || s[i] == '+' || s[i] == '-' || s[i] == '.') i++;
+    return s[i] == ':' ? i + 1 : 0;
+}
+
+// Offset of the path within an absolute URL with an authority
+static size_t authority_end(const char *url) {
+    size_t scheme = scheme_length(url);
+    if (!scheme || strncmp(url + scheme, "//", 2) != 0) return scheme;
+    size_t i = scheme + 2;
+    while (url[i] && url[i] != '/' && url[i] != '?' && url[i] != '#') i++;
+    return i;
+}
+
+static char *concat(const char *a, size_t a_len, const char *b) {
+    size_t b_len = strlen(b);
+    char *out = malloc(a_len + b_len + 1);
+    if (!out) return NULL;
+    memcpy(out, a, a_len);
+    memcpy(out + a_len, b, b_len + 1);
+    return out;
+}
+
+// Collapse "." and ".." segments of the path part in place
+static void remove_dot_segments(char *url) {
+    char *path = url + authority_end(url);
+    char *query = path + strcspn(path, "?#");
+    char saved = *query;
+    *query = 0;
+
+    char *out = path;
+    char *in = path;
+    while (*in) {
+        if (in[0] == '/' && in[1] == '.' && (in[2] == '/' || in[2] == 0)) {
+            in += 2;
+            if (!*in) *out++ = '/';
+        } else if (in[0] == '/' && in[1] == '.' && in[2] == '.' && (in[3] == '/' || in[3] == 0)) {
+            in += 3;
+            while (out > path && *--out != '/') {}
+            if (!*in) *out++ = '/';
+        } else {
+            do { *out++ = *in++; } while (*in && *in != '/');
+        }
+    }
+
+    *query = saved;
+    memmove(out, query, strlen(query) + 1);
+}
+
+char *url_resolve(const char *base, const char *ref) {
+    if (!ref) return NULL;
+    while (isspace((unsigned char)*ref)) ref++;
+    if (!*ref) return NULL;
+
+    char *result;
+    if (scheme_length(ref)) {
+        result = concat("", 0, ref);
+    } else if (!base) {
+        return NULL;
+    } else if (ref[0] == '/' && ref[1] == '/') {
+        result = concat(base, scheme_length(base), ref);
+    } else if (ref[0] == '/') {
+        result = concat(base, authority_end(base), ref);
+    } else if (ref[0] == '?' || ref[0] == '#') {
+        size_t keep = ref[0] == '?' ? strcspn(base, "?#") : strcspn(base, "#");
+        result = concat(base, keep, ref);
+    } else {
+        // Relative path: replace everything after the last '/' of the base path
+        size_t path_start = authority_end(base);
+        size_t path_end = path_start + strcspn(base + path_start, "?#");
+        size_t dir_end = path_end;
+        while (dir_end > path_start && base[dir_end - 1] != '/') dir_end--;
+
+        if (dir_end == path_start) {
+            // Base has no path ("http://host"), so the reference sits at the root
+            char *root = concat(base, path_start, "/");
+            if (!root) return NULL;
+            result = concat(root, strlen(root), ref);
+            free(root);
+        } else {
+            result = concat(base, dir_end, ref);
+        }
+    }
+
+    if (result) remove_dot_segments(result);
+    return result;
+}
+
+bool url_origin(const char *url, char *out, size_t out_size) {
+    size_t scheme = scheme_length(url);
+    if (!scheme || strncmp(url + scheme, "//", 2) != 0) return false;
+
+    size_t end = authority_end(url);
+    if (end >= out_size) return false;
+
+    for (size_t i = 0; i < end; i++) out[i] = (char)tolower((unsigned char)url[i]);
+    out[end] = 0;
+    return true;
+}
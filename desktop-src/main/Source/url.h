@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Resolve `ref` (absolute, scheme-relative, root-relative or relative) against
+// `base`. Returns a malloc'd string, or NULL if the reference is unusable.
+char *url_resolve(const char *base, const char *ref);
+
+// Copy "scheme://host[:port]" of `url` into `out`. Returns false for URLs
+// without an authority.
+bool url_origin(const char *url, char *out, size_t out_size);
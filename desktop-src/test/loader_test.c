@@ -0,0 +1,135 @@
+// loader: preloads cancelled from inside a transfer callback must not be
+// claimed by a later request. Transfers are file:// URLs, so no network.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "loader.h"
+#include "trace.h"
+
+#define PUMP_LIMIT 1000
+
+static int failures;
+
+#define CHECK(cond, ...)                                          \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            failures++;                                           \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);     \
+            printf(__VA_ARGS__);                                  \
+            printf("\n");                                         \
+        }                                                         \
+    } while (0)
+
+// The loader only counts and times; nothing here is checked
+void trace_count(TraceCounter counter, uint32_t amount) {
+    (void)counter;
+    (void)amount;
+}
+
+uint64_t trace_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+typedef struct {
+    int calls;
+    bool ok;
+    char body[64];
+} Result;
+
+static void on_done(LoadRequest *request, void *user_data) {
+    Result *result = (Result *)user_data;
+    result->calls++;
+    result->ok = request->ok;
+    snprintf(result->body, sizeof(result->body), "%.*s", (int)request->body.size,
+             request->body.data ? request->body.data : "");
+}
+
+static void write_file(const char *path, const char *text) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return;
+    fputs(text, file);
+    fclose(file);
+}
+
+// Cancels the preload and asks for the same URL while curl is still
+// inside curl_multi_perform(), with the preload's transfer under way
+typedef struct {
+    const void *preload_owner;
+    const char *preload_url;
+    Result *claimed;
+    LoadRequest *claim;
+    bool fired;
+} ChunkHook;
+
+static void on_document_chunk(const char *data, size_t len, void *ctx) {
+    (void)data;
+    (void)len;
+    ChunkHook *hook = (ChunkHook *)ctx;
+    if (hook->fired) return;
+    hook->fired = true;
+    loader_cancel_owner(hook->preload_owner);
+    hook->claim = loader_request(hook->preload_url, LOAD_PRIORITY_SCRIPT, NULL, on_done, hook->claimed);
+}
+
+static void test_claim_after_cancel_in_perform(const char *dir) {
+    char document_path[512], script_path[512], document_url[600], script_url[600];
+    snprintf(document_path, sizeof(document_path), "%s/document.html", dir);
+    snprintf(script_path, sizeof(script_path), "%s/script.js", dir);
+    snprintf(document_url, sizeof(document_url), "file://%s", document_path);
+    snprintf(script_url, sizeof(script_url), "file://%s", script_path);
+    write_file(document_path, "<html><script src=script.js></script></html>");
+    write_file(script_path, "let answer = 42;");
+
+    static const char preload_owner = 0;
+    Result document = {0}, claimed = {0};
+    ChunkHook hook = { &preload_owner, script_url, &claimed, NULL, false };
+
+    // The document starts first, so its chunk arrives while the preload
+    // has been handed to curl but not finished
+    LoadRequest *request = loader_request(document_url, LOAD_PRIORITY_DOCUMENT, NULL, on_done, &document);
+    CHECK(request != NULL, "document request");
+    if (!request) return;
+    loader_stream(request, on_document_chunk, &hook);
+    CHECK(loader_preload(script_url, LOAD_PRIORITY_OFFSCREEN_IMAGE, &preload_owner), "preload");
+
+    for (int i = 0; i < PUMP_LIMIT && (document.calls == 0 || claimed.calls == 0); i++) loader_pump();
+
+    CHECK(hook.fired, "the document never streamed a chunk");
+    CHECK(hook.claim != NULL, "claim request");
+    CHECK(document.calls == 1, "document delivered %d times", document.calls);
+    CHECK(claimed.calls == 1, "claimed request delivered %d times", claimed.calls);
+    CHECK(claimed.ok && strcmp(claimed.body, "let answer = 42;") == 0, "claimed body \"%s\"", claimed.body);
+
+    remove(document_path);
+    remove(script_path);
+}
+
+int main(void) {
+    char dir[] = "/tmp/loader_test_XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("cannot create a temporary directory\n");
+        return 1;
+    }
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    if (!loader_init()) {
+        printf("loader_init failed\n");
+        return 1;
+    }
+
+    test_claim_after_cancel_in_perform(dir);
+
+    loader_shutdown();
+    curl_global_cleanup();
+    remove(dir);
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("loader: ok\n");
+    return 0;
+}
@@ -0,0 +1,114 @@
+// preload scanner: the same document must yield the same fetches however
+// the network cuts it into chunks, including cuts inside comments, inside
+// their "<!--" and "-->" and inside tags.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "loader.h"
+#include "preload.h"
+
+#define MAX_JOINED 512
+
+static int failures;
+
+#define CHECK(cond, ...)                                          \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            failures++;                                           \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);     \
+            printf(__VA_ARGS__);                                  \
+            printf("\n");                                         \
+        }                                                         \
+    } while (0)
+
+// The scanner's only way out: record what it asks for, fetch nothing
+static char preloaded[MAX_JOINED];
+
+bool loader_preload(const char *url, LoadPriority priority, const void *owner) {
+    (void)priority;
+    (void)owner;
+    size_t used = strlen(preloaded);
+    snprintf(preloaded + used, sizeof(preloaded) - used, "%s%s", used ? "|" : "", url);
+    return true;
+}
+
+void loader_kick(void) {}
+
+typedef struct {
+    const char *document;
+    const char *expected; // Preloaded URLs joined with '|'
+} Case;
+
+static const Case cases[] = {
+    { "<img src=a.png><script src=b.js></script>", "http://x/a.png|http://x/b.js" },
+    { "<p>a<!-- <img src=a.png> <script src=b.js></script> --> <img src=c.png>", "http://x/c.png" },
+    { "<!-- one --><img src=a.png><!-- two <img src=b.png> -->", "http://x/a.png" },
+    // Neither "<!-->" nor a lone '-' before '>' closes the comment
+    { "<!--><img src=a.png> -> - > --><img src=b.png>", "http://x/b.png" },
+    { "<!-- a --- b ---><img src=a.png>", "http://x/a.png" },
+    { "<script src=s.js></script><!-- <script src=t.js></script> --><img src=u.png>", "http://x/s.js|http://x/u.png" },
+};
+
+// Feeds `document` in chunks ending at each of `cuts`, then at its end
+static void scan_in_chunks(const char *document, const size_t *cuts, size_t cut_count) {
+    static const char owner = 0;
+    PreloadScanner scanner;
+    preload_scanner_init(&scanner, "http://x/", &owner);
+    preloaded[0] = 0;
+    size_t len = strlen(document), from = 0;
+    for (size_t i = 0; i <= cut_count; i++) {
+        size_t to = i < cut_count ? cuts[i] : len;
+        preload_scan(document + from, to - from, &scanner);
+        from = to;
+    }
+    preload_scanner_free(&scanner);
+}
+
+static void test_whole(void) {
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        scan_in_chunks(cases[i].document, NULL, 0);
+        CHECK(strcmp(preloaded, cases[i].expected) == 0, "\"%s\": got \"%s\"", cases[i].document, preloaded);
+    }
+}
+
+// Every single cut and every pair of cuts
+static void test_cuts(void) {
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const Case *c = &cases[i];
+        size_t len = strlen(c->document);
+        for (size_t a = 0; a <= len; a++) {
+            for (size_t b = a; b <= len; b++) {
+                size_t cuts[2] = { a, b };
+                scan_in_chunks(c->document, cuts, 2);
+                CHECK(strcmp(preloaded, c->expected) == 0, "\"%s\" cut at %lu and %lu: got \"%s\"", c->document,
+                      (unsigned long)a, (unsigned long)b, preloaded);
+            }
+        }
+    }
+}
+
+// One byte at a time
+static void test_bytewise(void) {
+    size_t cuts[MAX_JOINED];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const Case *c = &cases[i];
+        size_t len = strlen(c->document);
+        for (size_t k = 0; k < len; k++) cuts[k] = k;
+        scan_in_chunks(c->document, cuts, len);
+        CHECK(strcmp(preloaded, c->expected) == 0, "\"%s\" bytewise: got \"%s\"", c->document, preloaded);
+    }
+}
+
+int main(void) {
+    test_whole();
+    test_cuts();
+    test_bytewise();
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("preload: ok\n");
+    return 0;
+}
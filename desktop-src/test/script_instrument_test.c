@@ -0,0 +1,72 @@
+// script_instrument output for blocks and loops, with or without braces
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "script_instrument.h"
+
+static int failures;
+
+typedef struct {
+    const char *source;
+    const char *expected;
+} Case;
+
+static const Case cases[] = {
+    // Blocks
+    { "function f(){return 1;}", "function f(){__tick();return 1;}" },
+    { "if(a){b}else{c}", "if(a){__tick();b}else{__tick();c}" },
+    { "f(() => {g()})", "f(() => {__tick();g()})" },
+    { "let o = {a: 1};", "let o = {a: 1};" },
+
+    // Loops without braces tick in their condition
+    { "while(true) i++;", "while(__tick()&&(true)) i++;" },
+    { "while (1);", "while (__tick()&&(1));" },
+    { "for(;;);", "for(;__tick()&&(true););" },
+    { "for (; ;) x();", "for (;__tick()&&( true);) x();" },
+    { "for(let i=0;i<n;i++) s+=i;", "for(let i=0;__tick()&&(i<n);i++) s+=i;" },
+    { "do x++; while(1)", "do x++; while(__tick()&&(1))" },
+    { "if(a) while(b) c(); else d();", "if(a) while(__tick()&&(b)) c(); else d();" },
+    { "for(;;) for(;;) x;", "for(;__tick()&&(true);) for(;__tick()&&(true);) x;" },
+
+    // Braced loop bodies are not ticked twice; do-while bodies now tick
+    { "while(x){y();}", "while(__tick()&&(x)){y();}" },
+    { "for(i=0;i<3;i++){a()}", "for(i=0;__tick()&&(i<3);i++){a()}" },
+    { "do{x++}while(x<3)", "do{x++}while(__tick()&&(x<3))" },
+
+    // for-in/of runs a bounded number of times; only its block ticks
+    { "for (let k in o) { a(); }", "for (let k in o) {__tick(); a(); }" },
+    { "for (const v of list) use(v);", "for (const v of list) use(v);" },
+
+    // Nesting: brackets inside a header do not end it early
+    { "while(f(function(){for(;;)g();}))h();",
+      "while(__tick()&&(f(function(){__tick();for(;__tick()&&(true);)g();})))h();" },
+    { "for (let x = function(){a;b;}; x; ) y();",
+      "for (let x = function(){__tick();a;b;};__tick()&&( x); ) y();" },
+    { "while(a[(b)]) c;", "while(__tick()&&(a[(b)])) c;" },
+
+    // Not loops
+    { "o.while(1); x . for(2); whilex(3);", "o.while(1); x . for(2); whilex(3);" },
+    { "s = \"while(x)\"; // for(;;)", "s = \"while(x)\";  " },
+    { "t = 'for(;;)' /* while(1) */;", "t = 'for(;;)'  ;" },
+};
+
+int main(void) {
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        const Case *c = &cases[k];
+        size_t out_len;
+        char *out = script_instrument(c->source, strlen(c->source), &out_len);
+        if (!out || out_len != strlen(out) || strcmp(out, c->expected) != 0) {
+            failures++;
+            printf("%s\n  got:      %s\n  expected: %s\n", c->source, out ? out : "(null)", c->expected);
+        }
+        free(out);
+    }
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("script_instrument: ok\n");
+    return 0;
+}
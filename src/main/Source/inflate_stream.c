@@ -0,0 +1,408 @@
+#include "inflate_stream.h"
+
+#include <string.h>
+#include <strings.h>
+
+enum {
+    STATE_GZIP_HEADER,
+    STATE_ZLIB_HEADER,
+    STATE_BLOCK,
+    STATE_STORED_LEN,
+    STATE_STORED_COPY,
+    STATE_TABLE_SIZES,
+    STATE_CODELEN_LENS,
+    STATE_CODE_LENS,
+    STATE_LITLEN,
+    STATE_DIST,
+    STATE_DONE,
+    STATE_ERROR,
+};
+
+typedef enum {
+    STEP_PROGRESS,
+    STEP_NEED_BITS,
+    STEP_STOP,
+} step_t;
+
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+static const uint16_t length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t codelen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static bool have(const inflate_stream_t* s, unsigned n) {
+    return s->bit_count >= n;
+}
+
+static uint32_t take(inflate_stream_t* s, unsigned n) {
+    uint32_t value = (uint32_t)(s->bits & ((1ull << n) - 1));
+    s->bits >>= n;
+    s->bit_count -= n;
+    return value;
+}
+
+// Canonical Huffman table from code lengths. Incomplete codes are allowed
+// (a lone distance code is legal), oversubscribed ones are not.
+static bool build_huffman(inflate_huffman_t* h, const uint8_t* lengths, unsigned n) {
+    uint16_t offsets[16];
+    memset(h->counts, 0, sizeof(h->counts));
+    for (unsigned i = 0; i < n; i++) h->counts[lengths[i]]++;
+    h->counts[0] = 0;
+
+    int left = 1;
+    for (unsigned len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h->counts[len];
+        if (left < 0) return false;
+    }
+
+    offsets[1] = 0;
+    for (unsigned len = 1; len < 15; len++) offsets[len + 1] = offsets[len] + h->counts[len];
+    for (unsigned i = 0; i < n; i++) {
+        if (lengths[i]) h->symbols[offsets[lengths[i]]++] = (uint16_t)i;
+    }
+    return true;
+}
+
+// Decode one symbol without consuming it. Returns -1 when more bits are
+// needed, -2 on an invalid code.
+static int huffman_peek(const inflate_stream_t* s, const inflate_huffman_t* h, unsigned* bits_used) {
+    int code = 0, first = 0, index = 0;
+    for (unsigned len = 1; len < 16; len++) {
+        if (len > s->bit_count) return -1;
+        code |= (int)((s->bits >> (len - 1)) & 1);
+        int count = h->counts[len];
+        if (code - count < first) {
+            *bits_used = len;
+            return h->symbols[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+static void flush(inflate_stream_t* s) {
+    if (s->window_pos > s->flushed && !s->stopped) {
+        if (!s->sink(s->window + s->flushed, s->window_pos - s->flushed, s->ctx)) s->stopped = true;
+    }
+    s->flushed = s->window_pos;
+}
+
+static void put(inflate_stream_t* s, uint8_t byte) {
+    s->window[s->window_pos++] = byte;
+    s->total_out++;
+    if (s->window_pos == INFLATE_WINDOW_SIZE) {
+        flush(s);
+        s->window_pos = 0;
+        s->flushed = 0;
+    }
+}
+
+static void end_block(inflate_stream_t* s) {
+    s->state = s->final_block ? STATE_DONE : STATE_BLOCK;
+}
+
+static void build_fixed(inflate_stream_t* s) {
+    unsigned i = 0;
+    for (; i < 144; i++) s->lengths[i] = 8;
+    for (; i < 256; i++) s->lengths[i] = 9;
+    for (; i < 280; i++) s->lengths[i] = 7;
+    for (; i < 288; i++) s->lengths[i] = 8;
+    build_huffman(&s->litlen, s->lengths, 288);
+    for (i = 0; i < 30; i++) s->lengths[i] = 5;
+    build_huffman(&s->dist, s->lengths, 30);
+}
+
+static step_t fail(inflate_stream_t* s) {
+    s->state = STATE_ERROR;
+    return STEP_STOP;
+}
+
+// gzip member header: fixed 10 bytes, then the optional fields its flags name
+static step_t gzip_header(inflate_stream_t* s) {
+    switch (s->header_step) {
+        case 0:
+            if (!have(s, 32)) return STEP_NEED_BITS;
+            if (take(s, 8) != 0x1F || take(s, 8) != 0x8B || take(s, 8) != 8) return fail(s);
+            s->header_flags = (uint8_t)take(s, 8);
+            s->header_step = 1;
+            return STEP_PROGRESS;
+        case 1: // mtime, xfl, os
+            if (!have(s, 48)) return STEP_NEED_BITS;
+            take(s, 32);
+            take(s, 16);
+            s->header_step = 2;
+            return STEP_PROGRESS;
+        case 2:
+            if (s->header_flags & GZIP_FEXTRA) {
+                if (!have(s, 16)) return STEP_NEED_BITS;
+                s->remaining = take(s, 16);
+            }
+            s->header_step = 3;
+            return STEP_PROGRESS;
+        case 3:
+            if (s->remaining > 0) {
+                if (!have(s, 8)) return STEP_NEED_BITS;
+                take(s, 8);
+                s->remaining--;
+                return STEP_PROGRESS;
+            }
+            s->header_step = 4;
+            return STEP_PROGRESS;
+        case 4: // Zero-terminated name, then comment
+        case 5: {
+            uint8_t flag = s->header_step == 4 ? GZIP_FNAME : GZIP_FCOMMENT;
+            if (s->header_flags & flag) {
+                if (!have(s, 8)) return STEP_NEED_BITS;
+                if (take(s, 8) != 0) return STEP_PROGRESS;
+            }
+            s->header_step++;
+            return STEP_PROGRESS;
+        }
+        default:
+            if (s->header_flags & GZIP_FHCRC) {
+                if (!have(s, 16)) return STEP_NEED_BITS;
+                take(s, 16);
+            }
+            s->state = STATE_BLOCK;
+            return STEP_PROGRESS;
+    }
+}
+
+static step_t code_lengths(inflate_stream_t* s) {
+    unsigned total = s->lit_count + s->dist_count;
+    if (s->index == total) {
+        if (s->lengths[256] == 0) return fail(s); // No end-of-block code
+        if (!build_huffman(&s->litlen, s->lengths, s->lit_count) ||
+            !build_huffman(&s->dist, s->lengths + s->lit_count, s->dist_count)) {
+            return fail(s);
+        }
+        s->state = STATE_LITLEN;
+        return STEP_PROGRESS;
+    }
+
+    unsigned used;
+    int symbol = huffman_peek(s, &s->dist, &used);
+    if (symbol == -1) return STEP_NEED_BITS;
+    if (symbol < 0) return fail(s);
+    if (symbol < 16) {
+        take(s, used);
+        s->lengths[s->index++] = (uint8_t)symbol;
+        return STEP_PROGRESS;
+    }
+
+    unsigned extra = symbol == 16 ? 2 : symbol == 17 ? 3 : 7;
+    if (!have(s, used + extra)) return STEP_NEED_BITS;
+    take(s, used);
+    unsigned repeat = take(s, extra) + (symbol == 18 ? 11 : 3);
+    uint8_t value = 0;
+    if (symbol == 16) {
+        if (s->index == 0) return fail(s);
+        value = s->lengths[s->index - 1];
+    }
+    if (s->index + repeat > total) return fail(s);
+    while (repeat--) s->lengths[s->index++] = value;
+    return STEP_PROGRESS;
+}
+
+static step_t step(inflate_stream_t* s) {
+    unsigned used;
+    int symbol;
+
+    switch (s->state) {
+        case STATE_GZIP_HEADER:
+            return gzip_header(s);
+
+        case STATE_ZLIB_HEADER: {
+            if (!have(s, 16)) return STEP_NEED_BITS;
+            unsigned cmf = (unsigned)(s->bits & 0xFF);
+            unsigned flg = (unsigned)((s->bits >> 8) & 0xFF);
+            // Some servers send bare DEFLATE for "deflate"; only skip a valid header
+            if ((cmf & 0x0F) == 8 && (cmf * 256 + flg) % 31 == 0 && !(flg & 0x20)) take(s, 16);
+            s->state = STATE_BLOCK;
+            return STEP_PROGRESS;
+        }
+
+        case STATE_BLOCK: {
+            if (!have(s, 3)) return STEP_NEED_BITS;
+            s->final_block = take(s, 1);
+            unsigned type = take(s, 2);
+            if (type == 0) {
+                take(s, s->bit_count % 8); // Stored blocks start on a byte boundary
+                s->state = STATE_STORED_LEN;
+            } else if (type == 1) {
+                build_fixed(s);
+                s->state = STATE_LITLEN;
+            } else if (type == 2) {
+                s->state = STATE_TABLE_SIZES;
+            } else {
+                return fail(s);
+            }
+            return STEP_PROGRESS;
+        }
+
+        case STATE_STORED_LEN: {
+            if (!have(s, 32)) return STEP_NEED_BITS;
+            uint32_t len = take(s, 16);
+            if ((take(s, 16) ^ 0xFFFF) != len) return fail(s);
+            s->remaining = len;
+            s->state = STATE_STORED_COPY;
+            return STEP_PROGRESS;
+        }
+
+        case STATE_STORED_COPY:
+            if (s->remaining == 0) {
+                end_block(s);
+                return STEP_PROGRESS;
+            }
+            if (!have(s, 8)) return STEP_NEED_BITS;
+            put(s, (uint8_t)take(s, 8));
+            s->remaining--;
+            return STEP_PROGRESS;
+
+        case STATE_TABLE_SIZES:
+            if (!have(s, 14)) return STEP_NEED_BITS;
+            s->lit_count = (uint16_t)(take(s, 5) + 257);
+            s->dist_count = (uint16_t)(take(s, 5) + 1);
+            s->codelen_count = (uint16_t)(take(s, 4) + 4);
+            if (s->lit_count > 286 || s->dist_count > 30) return fail(s);
+            memset(s->lengths, 0, 19);
+            s->index = 0;
+            s->state = STATE_CODELEN_LENS;
+            return STEP_PROGRESS;
+
+        case STATE_CODELEN_LENS:
+            if (!have(s, 3)) return STEP_NEED_BITS;
+            s->lengths[codelen_order[s->index++]] = (uint8_t)take(s, 3);
+            if (s->index == s->codelen_count) {
+                if (!build_huffman(&s->dist, s->lengths, 19)) return fail(s);
+                memset(s->lengths, 0, sizeof(s->lengths));
+                s->index = 0;
+                s->state = STATE_CODE_LENS;
+            }
+            return STEP_PROGRESS;
+
+        case STATE_CODE_LENS:
+            return code_lengths(s);
+
+        case STATE_LITLEN:
+            symbol = huffman_peek(s, &s->litlen, &used);
+            if (symbol == -1) return STEP_NEED_BITS;
+            if (symbol < 0) return fail(s);
+            if (symbol < 256) {
+                take(s, used);
+                put(s, (uint8_t)symbol);
+            } else if (symbol == 256) {
+                take(s, used);
+                end_block(s);
+            } else {
+                unsigned index = (unsigned)symbol - 257;
+                if (index >= 29) return fail(s);
+                if (!have(s, used + length_extra[index])) return STEP_NEED_BITS;
+                take(s, used);
+                s->match_len = (uint16_t)(length_base[index] + take(s, length_extra[index]));
+                s->state = STATE_DIST;
+            }
+            return STEP_PROGRESS;
+
+        case STATE_DIST: {
+            symbol = huffman_peek(s, &s->dist, &used);
+            if (symbol == -1) return STEP_NEED_BITS;
+            if (symbol < 0 || symbol >= 30) return fail(s);
+            if (!have(s, used + dist_extra[symbol])) return STEP_NEED_BITS;
+            take(s, used);
+            size_t distance = dist_base[symbol] + take(s, dist_extra[symbol]);
+            if (distance > s->total_out || distance > INFLATE_WINDOW_SIZE) return fail(s);
+            for (unsigned i = 0; i < s->match_len; i++) {
+                size_t from = (s->window_pos + INFLATE_WINDOW_SIZE - distance) % INFLATE_WINDOW_SIZE;
+                put(s, s->window[from]);
+            }
+            s->state = STATE_LITLEN;
+            return STEP_PROGRESS;
+        }
+
+        default:
+            return STEP_STOP;
+    }
+}
+
+void inflate_stream_init(inflate_stream_t* stream, inflate_format_t format) {
+    memset(stream, 0, offsetof(inflate_stream_t, window));
+    stream->window_pos = 0;
+    stream->flushed = 0;
+    stream->total_out = 0;
+    stream->sink = NULL;
+    stream->ctx = NULL;
+    stream->state = format == INFLATE_FORMAT_GZIP ? STATE_GZIP_HEADER
+                  : format == INFLATE_FORMAT_ZLIB ? STATE_ZLIB_HEADER
+                  : STATE_BLOCK;
+}
+
+inflate_status_t inflate_stream_feed(inflate_stream_t* stream, const uint8_t* data, size_t len,
+                                     inflate_sink_t sink, void* ctx) {
+    const uint8_t* end = data + len;
+    stream->sink = sink;
+    stream->ctx = ctx;
+
+    while (!stream->stopped) {
+        // Keep at least 57 bits buffered so any single step (at most 48 bits)
+        // can run whenever input remains
+        while (stream->bit_count <= 56 && data < end) {
+            stream->bits |= (uint64_t)*data++ << stream->bit_count;
+            stream->bit_count += 8;
+        }
+        step_t result = step(stream);
+        if (result == STEP_STOP) break;
+        if (result == STEP_NEED_BITS && data == end) break;
+    }
+    flush(stream);
+
+    if (stream->state == STATE_ERROR) return INFLATE_ERROR;
+    if (stream->stopped) return INFLATE_STOPPED;
+    if (stream->state == STATE_DONE) return INFLATE_DONE;
+    return INFLATE_NEED_INPUT;
+}
+
+bool inflate_buffer_sink(const uint8_t* data, size_t len, void* ctx) {
+    inflate_buffer_t* buffer = (inflate_buffer_t*)ctx;
+    size_t room = buffer->capacity - buffer->len;
+    if (len > room) len = room;
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return buffer->len < buffer->capacity;
+}
+
+bool inflate_format_for_encoding(const char* encoding, inflate_format_t* format) {
+    if (!encoding) return false;
+    if (strcasecmp(encoding, "gzip") == 0 || strcasecmp(encoding, "x-gzip") == 0) {
+        *format = INFLATE_FORMAT_GZIP;
+        return true;
+    }
+    if (strcasecmp(encoding, "deflate") == 0) {
+        *format = INFLATE_FORMAT_ZLIB;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// History kept for back-references. DEFLATE allows distances up to 32 KB,
+// but we never keep more than MAX_HTML_SIZE bytes of a page and stop
+// inflating once that is full, so a window at least that large is enough.
+#ifndef INFLATE_WINDOW_SIZE
+#define INFLATE_WINDOW_SIZE 8192
+#endif
+
+typedef enum {
+    INFLATE_FORMAT_RAW,  // Bare DEFLATE
+    INFLATE_FORMAT_ZLIB, // "deflate"; falls back to bare DEFLATE without a zlib header
+    INFLATE_FORMAT_GZIP, // "gzip"
+} inflate_format_t;
+
+typedef enum {
+    INFLATE_NEED_INPUT, // All input consumed, feed more
+    INFLATE_DONE,       // End of the compressed stream
+    INFLATE_STOPPED,    // The sink asked to stop
+    INFLATE_ERROR,
+} inflate_status_t;
+
+// Receives decompressed bytes; return false to stop inflating
+typedef bool (*inflate_sink_t)(const uint8_t* data, size_t len, void* ctx);
+
+// Fixed buffer for inflate_buffer_sink
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+    size_t len;
+} inflate_buffer_t;
+
+// Sink appending to an inflate_buffer_t (the ctx). Output past `capacity`
+// is dropped and the stream is stopped once the buffer is full.
+bool inflate_buffer_sink(const uint8_t* data, size_t len, void* ctx);
+
+typedef struct {
+    uint16_t counts[16];
+    uint16_t symbols[288];
+} inflate_huffman_t;
+
+// Push-style decoder: compressed bytes go in as they arrive from the network
+// in chunks of any size, decoded bytes come out through the sink. Nothing is
+// allocated; the whole state is this struct. Trailer checksums are not
+// verified.
+typedef struct {
+    uint8_t state;
+    uint8_t header_step;
+    uint8_t header_flags;
+    bool final_block;
+    bool stopped;
+    uint64_t bits;
+    uint8_t bit_count;
+    uint32_t remaining;
+    uint16_t lit_count;
+    uint16_t dist_count;
+    uint16_t codelen_count;
+    uint16_t index;
+    uint16_t match_len;
+    uint8_t lengths[320];
+    inflate_huffman_t litlen;
+    inflate_huffman_t dist; // Also holds the code length code while a dynamic header is read
+    uint8_t window[INFLATE_WINDOW_SIZE];
+    size_t window_pos;
+    size_t flushed;
+    size_t total_out;
+    inflate_sink_t sink;
+    void* ctx;
+} inflate_stream_t;
+
+void inflate_stream_init(inflate_stream_t* stream, inflate_format_t format);
+
+inflate_status_t inflate_stream_feed(inflate_stream_t* stream, const uint8_t* data, size_t len,
+                                     inflate_sink_t sink, void* ctx);
+
+// Map a Content-Encoding value to a format. Returns false for identity or
+// encodings we cannot decode.
+bool inflate_format_for_encoding(const char* encoding, inflate_format_t* format);
@@ -1,31 +1,101 @@
 #include <tt_app_manifest.h>
 #include <tt_lvgl_toolbar.h>
+#include <tt_thread.h>
 #include <lvgl.h>
 #include <esp_http_client.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
 #include <lexbor/html/parser.h>
 #include <lexbor/html/interface.h>
 #include <lexbor/dom/interfaces/document.h>
 #include <lexbor/dom/interfaces/element.h>
 #include <lexbor/dom/interfaces/text.h>
 #include <lexbor/dom/interfaces/node.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <strings.h>
+#include "inflate_stream.h"
+#include "page_arena.h"
+#include "page_limits.h"
+#include "render_tree.h"
+#include "subtree_filter.h"
 
 // Memory optimization: Static buffers instead of malloc
-#define MAX_HTML_SIZE 6144
-#define MAX_TEXT_BUFFER 512
 #define MAX_STYLE_BUFFER 256
 #define MAX_URL_LENGTH 256
+#define READ_CHUNK_SIZE 512
+#define FETCH_STACK_SIZE 6144
+#define FETCH_POLL_MS 50
+#define HISTORY_LENGTH 8
+#define BFCACHE_PAGES 2            // Frozen pages kept for back/forward
+#define BFCACHE_BUDGET (24 * 1024) // Estimated bytes those pages may hold
+#define WIDGET_OVERHEAD 96         // Rough lv_obj_t plus style bookkeeping
 
 // Global app handle
 static AppHandle global_app;
 
+static const char* TAG = "browser";
+
 // Static buffers for memory efficiency
 static char html_buffer[MAX_HTML_SIZE];
-static char text_buffer[MAX_TEXT_BUFFER];
 static char style_buffer[MAX_STYLE_BUFFER];
 static char url_buffer[MAX_URL_LENGTH];
+static uint8_t read_chunk[READ_CHUNK_SIZE];
+static inflate_stream_t inflater;
+static page_arena_t page_arena;
+static render_tree_t render_tree;
+static subtree_filter_t subtree_filter;
+static char link_target[MAX_URL_LENGTH]; // Link clicked, followed on the next timer run
+
+// Navigation shared with the fetch worker. Every navigation bumps
+// `generation`; the worker serves `job_generation` and stops early once the
+// two differ. Only one worker runs at a time because it fills html_buffer.
+typedef struct {
+    volatile uint32_t generation;
+    uint32_t job_generation;
+    char url[MAX_URL_LENGTH];         // Being fetched by the worker
+    char pending_url[MAX_URL_LENGTH]; // Waiting for the worker to finish
+    bool has_pending;
+    lv_obj_t* parent;                 // Content container, NULL once hidden
+    ThreadHandle thread;              // NULL when idle
+    lv_timer_t* poll_timer;
+    int read_len;
+    char error[48];                   // Empty on success
+    uint32_t bytes_read;              // Body bytes received, before inflating
+    uint32_t started_ms;
+    // Work spent on navigations that were superseded before rendering
+    uint32_t abandoned;
+    uint32_t wasted_bytes;
+    uint32_t wasted_ms;
+} navigation_t;
+
+static navigation_t nav;
+
+// Back/forward history. Recently left pages stay "frozen": their widget
+// container is hidden inside the content area instead of being deleted, so
+// going back to them needs no fetch, parse or widget build.
+typedef struct {
+    char url[MAX_URL_LENGTH];
+    lv_obj_t* frozen;    // Hidden page container, NULL when not cached
+    int32_t scroll_y;
+    uint32_t bytes;      // Estimated, counted against BFCACHE_BUDGET
+    uint32_t frozen_seq; // Higher is more recently frozen
+} history_entry_t;
+
+static history_entry_t history[HISTORY_LENGTH];
+static int history_count;
+static int history_index = -1;
+static uint32_t frozen_seq;
+
+// UI
+static lv_obj_t* address_bar;
+static lv_obj_t* content_container;
+static lv_obj_t* back_btn;
+static lv_obj_t* forward_btn;
+static lv_obj_t* page_obj;  // Container of the page on screen
+static bool page_rendered;  // page_obj holds a rendered page (not loading or an error)
 
 // CSS color table for fast lookup
 typedef struct {
@@ -40,8 +110,7 @@ static const color_entry_t color_table[] = {
 };
 
 // Forward declarations
-static void fetch_and_render(AppHandle app, const char* url, lv_obj_t* parent);
-static void render_node_tree(lxb_dom_node_t* node, lv_obj_t* parent, int* y_offset);
+static void navigate(const char* url);
 
 // Helper function to get appropriate font based on size
 static const lv_font_t* get_font_for_size(int size) {
@@ -145,45 +214,37 @@ static void apply_inline_style(lv_obj_t* obj, const char* style) {
 }
 
 // Enhanced element rendering with better HTML support
-static lv_obj_t* create_element_widget(lxb_dom_element_t* el, lv_obj_t* parent, const char* tag_name, size_t tag_len) {
+static lv_obj_t* create_element_widget(render_kind_t kind, lv_obj_t* parent) {
     lv_obj_t* widget = NULL;
     
     // Handle different HTML elements
-    if (tag_len == 2 && memcmp(tag_name, "h1", 2) == 0) {
-        widget = lv_label_create(parent);
-        lv_obj_set_style_text_font(widget, &lv_font_montserrat_14, 0);
-        lv_obj_set_style_text_color(widget, lv_color_hex(0x000080), 0);
-    }
-    else if (tag_len == 2 && (memcmp(tag_name, "h2", 2) == 0 || memcmp(tag_name, "h3", 2) == 0)) {
-        widget = lv_label_create(parent);
-        lv_obj_set_style_text_font(widget, &lv_font_montserrat_14, 0);
-        lv_obj_set_style_text_color(widget, lv_color_hex(0x000080), 0);
-    }
-    else if (tag_len == 1 && memcmp(tag_name, "p", 1) == 0) {
-        widget = lv_label_create(parent);
-        lv_obj_set_style_margin_bottom(widget, 10, 0);
-    }
-    else if (tag_len == 1 && memcmp(tag_name, "a", 1) == 0) {
-        widget = lv_label_create(parent);
-        lv_obj_set_style_text_color(widget, lv_color_hex(0x0000EE), 0);
-        lv_obj_set_style_text_decor(widget, LV_TEXT_DECOR_UNDERLINE, 0);
-    }
-    else if (tag_len == 6 && memcmp(tag_name, "button", 6) == 0) {
-        widget = lv_btn_create(parent);
-    }
-    else if (tag_len == 3 && memcmp(tag_name, "div", 3) == 0) {
-        widget = lv_obj_create(parent);
-        lv_obj_set_style_border_width(widget, 0, 0);
-        lv_obj_set_style_bg_opa(widget, LV_OPA_TRANSP, 0);
-    }
-    else if (tag_len == 4 && memcmp(tag_name, "span", 4) == 0) {
-        widget = lv_label_create(parent);
-    }
-    else {
-        // Default container
-        widget = lv_obj_create(parent);
-        lv_obj_set_style_border_width(widget, 0, 0);
-        lv_obj_set_style_bg_opa(widget, LV_OPA_TRANSP, 0);
+    switch (kind) {
+        case RENDER_HEADING:
+            widget = lv_label_create(parent);
+            lv_obj_set_style_text_font(widget, &lv_font_montserrat_14, 0);
+            lv_obj_set_style_text_color(widget, lv_color_hex(0x000080), 0);
+            break;
+        case RENDER_PARAGRAPH:
+            widget = lv_label_create(parent);
+            lv_obj_set_style_margin_bottom(widget, 10, 0);
+            break;
+        case RENDER_LINK:
+            widget = lv_label_create(parent);
+            lv_obj_set_style_text_color(widget, lv_color_hex(0x0000EE), 0);
+            lv_obj_set_style_text_decor(widget, LV_TEXT_DECOR_UNDERLINE, 0);
+            break;
+        case RENDER_BUTTON:
+            widget = lv_btn_create(parent);
+            break;
+        case RENDER_SPAN:
+            widget = lv_label_create(parent);
+            break;
+        default:
+            // Divs and any other element: a plain container
+            widget = lv_obj_create(parent);
+            lv_obj_set_style_border_width(widget, 0, 0);
+            lv_obj_set_style_bg_opa(widget, LV_OPA_TRANSP, 0);
+            break;
     }
     
     if (widget) {
@@ -194,170 +255,221 @@ static lv_obj_t* create_element_widget(lxb_dom_element_t* el, lv_obj_t* parent,
     return widget;
 }
 
-// Optimized DOM tree rendering
-static void render_node_tree(lxb_dom_node_t* node, lv_obj_t* parent, int* y_offset) {
-    if (!node || !parent) return;
-    
-    lxb_dom_node_t* child = lxb_dom_node_first_child(node);
-    
-    while (child) {
-        lxb_dom_node_type_t node_type = child->type;
-        
-        if (node_type == LXB_DOM_NODE_TYPE_TEXT) {
-            size_t len;
-            const lxb_char_t* txt = lxb_dom_node_text_content(child, &len);
-            
-            if (txt && len > 0 && len < MAX_TEXT_BUFFER) {
-                // Use static buffer
-                memcpy(text_buffer, txt, len);
-                text_buffer[len] = 0;
-                
-                // Trim whitespace more efficiently - cast to unsigned char
-                char* start = text_buffer;
-                char* end = text_buffer + len - 1;
-                
-                while (start <= end && isspace((unsigned char)*start)) start++;
-                while (end >= start && isspace((unsigned char)*end)) *end-- = 0;
-                
-                if (start <= end && *start) {
-                    lv_obj_t* lbl = lv_label_create(parent);
-                    lv_label_set_text(lbl, start);
-                    lv_obj_set_width(lbl, lv_pct(100));
-                    lv_label_set_long_mode(lbl, LV_LABEL_LONG_WRAP);
-                    lv_obj_set_pos(lbl, 0, *y_offset);
-                    *y_offset += 25;
-                }
-            }
+static void follow_link_cb(lv_timer_t* timer) {
+    lv_timer_delete(timer);
+    lv_textarea_set_text(address_bar, link_target);
+    navigate(link_target);
+}
+
+// A link owns a copy of its target. Navigating deletes the page, so it is
+// deferred until the click has been handled.
+static void link_event_cb(lv_event_t* e) {
+    char* target = (char*)lv_event_get_user_data(e);
+    if (lv_event_get_code(e) == LV_EVENT_DELETE) {
+        free(target);
+    } else if (lv_event_get_code(e) == LV_EVENT_CLICKED) {
+        strncpy(link_target, target, MAX_URL_LENGTH - 1);
+        link_target[MAX_URL_LENGTH - 1] = 0;
+        lv_timer_create(follow_link_cb, 0, NULL);
+    }
+}
+
+static void attach_link(lv_obj_t* widget, const char* target) {
+    size_t len = strlen(target) + 1;
+    char* copy = malloc(len);
+    if (!copy) return;
+    memcpy(copy, target, len);
+    lv_obj_add_flag(widget, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(widget, link_event_cb, LV_EVENT_ALL, copy);
+}
+
+// Build the widgets for render_tree under `parent`. Each child goes below
+// the previous one; a container's height is added once its last child is in.
+// Returns PAGE_LIMIT_HIT_TIME if painting ran out of time; `bottom` gets
+// the y just below the last widget.
+static uint32_t paint_render_tree(lv_obj_t* parent, int* bottom) {
+    uint32_t start_ms = lv_tick_get();
+    uint32_t hits = 0;
+    lv_obj_t* open[RENDER_TREE_MAX_DEPTH + 1]; // open[0] is `parent`, open[d] holds depth d
+    int y_offset[RENDER_TREE_MAX_DEPTH + 1];
+    int top = 0;
+    open[0] = parent;
+    y_offset[0] = 0;
+    // Long text arrives as several runs that each wrap over a few lines, so
+    // labels are measured against the page width rather than given one line
+    lv_obj_update_layout(parent);
+    int32_t wrap_width = lv_obj_get_content_width(parent);
+
+    for (uint16_t i = 0; i < render_tree.count; i++) {
+        if (lv_tick_elaps(start_ms) > PAGE_LIMIT_RENDER_MS) {
+            hits |= PAGE_LIMIT_HIT_TIME;
+            break;
         }
-        else if (node_type == LXB_DOM_NODE_TYPE_ELEMENT) {
-            lxb_dom_element_t* el = lxb_dom_interface_element(child);
-            
-            // Get element tag name
-            size_t tag_len;
-            const lxb_char_t* tag_name = lxb_dom_element_local_name(el, &tag_len);
-            
-            // Create appropriate widget
-            lv_obj_t* widget = create_element_widget(el, parent, (const char*)tag_name, tag_len);
-            
-            if (widget) {
-                lv_obj_set_pos(widget, 0, *y_offset);
-                
-                // Apply inline styles
-                size_t attr_len;
-                const lxb_char_t* style_attr = lxb_dom_element_get_attribute(el, 
-                    (const lxb_char_t*)"style", 5, &attr_len);
-                
-                if (style_attr && attr_len < MAX_STYLE_BUFFER) {
-                    memcpy(style_buffer, style_attr, attr_len);
-                    style_buffer[attr_len] = 0;
-                    apply_inline_style(widget, style_buffer);
-                }
-                
-                // Handle button text
-                if (tag_len == 6 && memcmp(tag_name, "button", 6) == 0) {
-                    size_t text_len;
-                    const lxb_char_t* btn_text = lxb_dom_node_text_content(child, &text_len);
-                    if (btn_text && text_len > 0 && text_len < MAX_TEXT_BUFFER) {
-                        memcpy(text_buffer, btn_text, text_len);
-                        text_buffer[text_len] = 0;
-                        
-                        lv_obj_t* btn_label = lv_label_create(widget);
-                        lv_label_set_text(btn_label, text_buffer);
-                        lv_obj_center(btn_label);
-                    }
-                }
-                
-                int child_y = 0;
-                render_node_tree(child, widget, &child_y);
-                
-                *y_offset += lv_obj_get_height(widget) + 5;
-            }
+        int depth = render_tree.depth[i];
+        for (; top > depth; top--) y_offset[top - 1] += lv_obj_get_height(open[top]) + 5;
+        lv_obj_t* container = open[top];
+        const char* text = render_tree_string(&render_tree, render_tree.text[i]);
+
+        if (render_tree.kind[i] == RENDER_TEXT) {
+            lv_obj_t* lbl = lv_label_create(container);
+            lv_label_set_text(lbl, text);
+            lv_obj_set_width(lbl, lv_pct(100));
+            lv_label_set_long_mode(lbl, LV_LABEL_LONG_WRAP);
+            lv_obj_set_pos(lbl, 0, y_offset[top]);
+            lv_point_t size;
+            lv_text_get_size(&size, text, lv_obj_get_style_text_font(lbl, LV_PART_MAIN),
+                             lv_obj_get_style_text_letter_space(lbl, LV_PART_MAIN),
+                             lv_obj_get_style_text_line_space(lbl, LV_PART_MAIN), wrap_width, LV_TEXT_FLAG_NONE);
+            y_offset[top] += size.y + 5 > 25 ? size.y + 5 : 25;
+            continue;
         }
-        
-        child = lxb_dom_node_next(child);
+
+        lv_obj_t* widget = create_element_widget((render_kind_t)render_tree.kind[i], container);
+        lv_obj_set_pos(widget, 0, y_offset[top]);
+        if (render_tree.style[i] != RENDER_NONE) {
+            apply_inline_style(widget, render_tree_string(&render_tree, render_tree.style_offset[render_tree.style[i]]));
+        }
+        if (render_tree.link[i] != RENDER_NONE) {
+            attach_link(widget, render_tree_string(&render_tree, render_tree.link_offset[render_tree.link[i]]));
+        }
+        if (render_tree.kind[i] == RENDER_BUTTON && text) {
+            lv_obj_t* btn_label = lv_label_create(widget);
+            lv_label_set_text(btn_label, text);
+            lv_obj_center(btn_label);
+        }
+        open[++top] = widget;
+        y_offset[top] = 0;
     }
+    for (; top > 0; top--) y_offset[top - 1] += lv_obj_get_height(open[top]) + 5;
+    *bottom = y_offset[0];
+    return hits;
 }
 
-// Optimized HTTP fetch with better error handling
-static void fetch_and_render(AppHandle app, const char* url, lv_obj_t* parent) {
-    if (!url || !parent) return;
-    
-    // Clear previous content
-    lv_obj_clean(parent);
-    
-    // Show loading indicator
-    lv_obj_t* loading_lbl = lv_label_create(parent);
-    lv_label_set_text(loading_lbl, "Loading...");
-    lv_obj_set_style_text_color(loading_lbl, lv_color_hex(0x808080), 0);
-    
-    // HTTP client configuration
+// Placed where a page that was cut short stops
+static void add_limits_notice(lv_obj_t* parent, int y, uint32_t hits) {
+    char text[128];
+    if (!page_limits_notice(hits, text, sizeof(text))) return;
+    lv_obj_t* notice = lv_label_create(parent);
+    lv_label_set_text(notice, text);
+    lv_obj_set_width(notice, lv_pct(100));
+    lv_label_set_long_mode(notice, LV_LABEL_LONG_WRAP);
+    lv_obj_set_style_text_color(notice, lv_color_hex(0xB06000), 0);
+    lv_obj_set_pos(notice, 0, y);
+}
+
+// Remembers the response's Content-Encoding while headers arrive
+static esp_err_t http_event_handler(esp_http_client_event_t* evt) {
+    if (evt->event_id == HTTP_EVENT_ON_HEADER &&
+        strcasecmp(evt->header_key, "Content-Encoding") == 0) {
+        bool* compressed = (bool*)evt->user_data;
+        inflate_format_t format;
+        *compressed = inflate_format_for_encoding(evt->header_value, &format);
+        if (*compressed) inflate_stream_init(&inflater, format);
+    }
+    return ESP_OK;
+}
+
+static bool fetch_superseded(void) {
+    return nav.job_generation != nav.generation;
+}
+
+static int32_t fetch_fail(esp_http_client_handle_t client, const char* error) {
+    snprintf(nav.error, sizeof(nav.error), "%s", error);
+    if (client) esp_http_client_cleanup(client);
+    return -1;
+}
+
+// Worker thread: download nav.url into html_buffer. Never touches LVGL; the
+// poll timer picks up the result once the thread has stopped. Between reads
+// it checks whether a newer navigation has superseded it and bails out.
+static int32_t fetch_worker(void* context) {
+    bool compressed = false;
     esp_http_client_config_t cfg = {
-        .url = url,
+        .url = nav.url,
         .timeout_ms = 8000,
         .buffer_size = 1024,
         .buffer_size_tx = 512,
-        .user_agent = "TactileBrowser/1.0"
+        .user_agent = "TactileBrowser/1.0",
+        .event_handler = http_event_handler,
+        .user_data = &compressed
     };
     
     esp_http_client_handle_t client = esp_http_client_init(&cfg);
-    if (!client) {
-        lv_label_set_text(loading_lbl, "HTTP client init failed");
-        return;
-    }
+    if (!client) return fetch_fail(NULL, "HTTP client init failed");
+    // Pages are typically 3-8x smaller compressed; we inflate as we read
+    esp_http_client_set_header(client, "Accept-Encoding", "gzip, deflate");
     
     esp_err_t err = esp_http_client_open(client, 0);
-    if (err != ESP_OK) {
-        lv_label_set_text(loading_lbl, "Connection failed");
-        esp_http_client_cleanup(client);
-        return;
-    }
+    if (err != ESP_OK) return fetch_fail(client, "Connection failed");
     
     int content_length = esp_http_client_fetch_headers(client);
     int status_code = esp_http_client_get_status_code(client);
     
     if (status_code != 200) {
-        snprintf(text_buffer, MAX_TEXT_BUFFER, "HTTP Error: %d", status_code);
-        lv_label_set_text(loading_lbl, text_buffer);
+        snprintf(nav.error, sizeof(nav.error), "HTTP Error: %d", status_code);
         esp_http_client_cleanup(client);
-        return;
+        return -1;
     }
     
-    if (content_length <= 0) {
-        lv_label_set_text(loading_lbl, "No content received");
-        esp_http_client_cleanup(client);
-        return;
+    if (content_length <= 0 && !esp_http_client_is_chunked_response(client)) {
+        return fetch_fail(client, "No content received");
     }
     
-    // Limit content size
-    if (content_length > MAX_HTML_SIZE) content_length = MAX_HTML_SIZE;
-    
-    int read_len = esp_http_client_read(client, html_buffer, content_length);
+    // Read until the body ends or html_buffer is full. Compressed bodies go
+    // through the inflater in small chunks so only the decoded page is kept.
+    int read_len = 0;
+    inflate_buffer_t decoded = { (uint8_t*)html_buffer, MAX_HTML_SIZE - 1, 0 };
+    while (read_len < MAX_HTML_SIZE - 1 && !fetch_superseded()) {
+        if (!compressed) {
+            int n = esp_http_client_read(client, html_buffer + read_len, MAX_HTML_SIZE - 1 - read_len);
+            if (n <= 0) break;
+            read_len += n;
+            nav.bytes_read += (uint32_t)n;
+            continue;
+        }
+        int n = esp_http_client_read(client, (char*)read_chunk, READ_CHUNK_SIZE);
+        if (n <= 0) break;
+        nav.bytes_read += (uint32_t)n;
+        // A corrupt stream keeps whatever decoded cleanly before the error
+        inflate_status_t status = inflate_stream_feed(&inflater, read_chunk, (size_t)n, inflate_buffer_sink, &decoded);
+        read_len = (int)decoded.len;
+        if (status != INFLATE_NEED_INPUT) break;
+    }
     esp_http_client_cleanup(client);
     
-    if (read_len <= 0) {
-        lv_label_set_text(loading_lbl, "Failed to read response");
-        return;
-    }
+    if (read_len <= 0) return fetch_fail(NULL, "Failed to read response");
     
     html_buffer[read_len] = 0;
-    
-    // Remove loading indicator
-    lv_obj_del(loading_lbl);
-    
-    // Parse HTML
-    lxb_html_document_t* document = lxb_html_document_create();
+    nav.read_len = read_len;
+    return 0;
+}
+
+// Parse html_buffer into render_tree, or show why not under `parent`. The
+// document is destroyed before returning, on every path.
+static bool build_page(lv_obj_t* parent, int read_len) {
+    // Parse HTML, dropping what is never rendered before it becomes nodes
+    lxb_html_parser_t* parser = lxb_html_parser_create();
+    lxb_html_document_t* document = NULL;
+    if (parser && lxb_html_parser_init(parser) == LXB_STATUS_OK) document = lxb_html_parse_chunk_begin(parser);
     if (!document) {
+        lxb_html_parser_destroy(parser);
         lv_obj_t* err_lbl = lv_label_create(parent);
         lv_label_set_text(err_lbl, "HTML document creation failed");
-        return;
+        return false;
     }
     
-    lxb_status_t status = lxb_html_document_parse(document, (const lxb_char_t*)html_buffer, read_len);
+    subtree_filter_attach(&subtree_filter, parser, SUBTREE_SKIP_DEFAULT);
+    render_tree_attach(&render_tree, parser);
+    lxb_status_t status = lxb_html_parse_chunk_process(parser, (const lxb_char_t*)html_buffer, read_len);
+    if (status == LXB_STATUS_OK) status = lxb_html_parse_chunk_end(parser);
+    lxb_html_parser_destroy(parser);
+    ESP_LOGD(TAG, "parse skipped %lu nodes, %lu of %d bytes", (unsigned long)subtree_filter.nodes_skipped,
+             (unsigned long)subtree_filter.bytes_skipped, read_len);
     if (status != LXB_STATUS_OK) {
         lv_obj_t* err_lbl = lv_label_create(parent);
         lv_label_set_text(err_lbl, "HTML parsing failed");
         lxb_html_document_destroy(document);
-        return;
+        return false;
     }
     
     lxb_dom_document_t* dom_document = lxb_dom_interface_document(document);
@@ -365,7 +477,7 @@ static void fetch_and_render(AppHandle app, const char* url, lv_obj_t* parent) {
         lv_obj_t* err_lbl = lv_label_create(parent);
         lv_label_set_text(err_lbl, "DOM document interface failed");
         lxb_html_document_destroy(document);
-        return;
+        return false;
     }
     
     lxb_dom_element_t* root = lxb_dom_document_element(dom_document);
@@ -373,62 +485,286 @@ static void fetch_and_render(AppHandle app, const char* url, lv_obj_t* parent) {
         lv_obj_t* err_lbl = lv_label_create(parent);
         lv_label_set_text(err_lbl, "No root element found");
         lxb_html_document_destroy(document);
-        return;
+        return false;
     }
     
-    // Find body element
-    lxb_dom_node_t* body = NULL;
-    lxb_dom_node_t* child = lxb_dom_node_first_child(lxb_dom_interface_node(root));
-    while (child) {
-        if (child->type == LXB_DOM_NODE_TYPE_ELEMENT) {
-            lxb_dom_element_t* elem = lxb_dom_interface_element(child);
-            size_t tag_len;
-            const lxb_char_t* tag_name = lxb_dom_element_local_name(elem, &tag_len);
-            if (tag_name && tag_len == 4 && memcmp(tag_name, "body", 4) == 0) {
-                body = child;
-                break;
-            }
+    // Whatever the tree builder had not finished with when parsing ended
+    render_tree_finish(&render_tree, dom_document);
+    lxb_html_document_destroy(document);
+    return true;
+}
+
+// Free heap, how broken up it is, and what the page arena needed. Free
+// space split into small blocks shows up as a largest block far below the
+// total.
+static void log_heap(const char* when) {
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    unsigned long frag_pct = free_bytes ? 100 - (unsigned long)(largest * 100 / free_bytes) : 0;
+    printf("[mem] %s: %lu free, largest block %lu (%lu%% fragmented), low water %lu; "
+           "arena peak %lu of %lu, %lu allocations to the heap\n", when, (unsigned long)free_bytes,
+           (unsigned long)largest, frag_pct, (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+           (unsigned long)page_arena.high_water, (unsigned long)page_arena.size,
+           (unsigned long)page_arena.fallbacks);
+}
+
+// Everything lexbor allocates for the page comes from the page arena and
+// goes back in one reset, before the first widget is created
+static void render_page(lv_obj_t* parent, int read_len) {
+    page_arena_begin(&page_arena);
+    bool parsed = build_page(parent, read_len);
+    page_arena_end(&page_arena);
+    if (!parsed) return;
+    int bottom;
+    uint32_t hits = subtree_filter.hits | render_tree.hits | paint_render_tree(parent, &bottom);
+    add_limits_notice(parent, bottom, hits);
+#ifdef SOAK_NAVIGATIONS
+    log_heap("rendered"); // Walking the heap for its largest block is not free
+#endif
+}
+
+#ifdef SOAK_NAVIGATIONS
+// Build with -DSOAK_NAVIGATIONS=1000 to load the first page that many more
+// times through the whole navigation path: fetch_worker, build_page and
+// render_page, with history and the back/forward cache filling and
+// evicting as they would in use. Free heap is sampled after each
+// navigation. Once the first tenth has warmed up LVGL's caches, a
+// least-squares line is fitted to the rest and the heap must not fall
+// along it. The sums are kept as samples arrive, so nothing is stored.
+#define SOAK_WARMUP (SOAK_NAVIGATIONS / 10)
+#define SOAK_LEAK_LIMIT 1.0 // Bytes per navigation the fitted line may lose
+
+typedef struct {
+    char url[MAX_URL_LENGTH];
+    int done;
+    double n, sum_x, sum_y, sum_xy, sum_xx;
+    size_t first_free;
+} soak_t;
+
+static soak_t soak;
+
+static void soak_finish(void) {
+    double denominator = soak.n * soak.sum_xx - soak.sum_x * soak.sum_x;
+    double slope = denominator > 0 ? (soak.n * soak.sum_xy - soak.sum_x * soak.sum_y) / denominator : 0;
+    bool pass = soak.n > 1 && -slope <= SOAK_LEAK_LIMIT;
+    printf("[soak] %d navigations: %lu free after warmup, %lu at the end, %+.2f bytes per navigation, %s\n",
+           soak.done - 1, (unsigned long)soak.first_free, (unsigned long)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+           slope, pass ? "PASS" : "FAIL, heap trends downward");
+    log_heap("soak done");
+}
+
+// Called once each navigation has been rendered (or failed); starts the next
+static void soak_step(void) {
+    if (soak.done > SOAK_NAVIGATIONS) return;
+    if (soak.done == 0) snprintf(soak.url, sizeof(soak.url), "%s", nav.url);
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (soak.done >= SOAK_WARMUP) {
+        double x = soak.n, y = (double)free_bytes;
+        if (soak.n == 0) soak.first_free = free_bytes;
+        soak.n++;
+        soak.sum_x += x;
+        soak.sum_y += y;
+        soak.sum_xy += x * y;
+        soak.sum_xx += x * x;
+    }
+    if (soak.done++ == SOAK_NAVIGATIONS) {
+        soak_finish();
+        return;
+    }
+    navigate(soak.url);
+}
+#endif
+
+// Hand the queued navigation to a fresh worker
+static void start_fetch(void) {
+    strncpy(nav.url, nav.pending_url, MAX_URL_LENGTH - 1);
+    nav.url[MAX_URL_LENGTH - 1] = 0;
+    nav.has_pending = false;
+    nav.job_generation = nav.generation;
+    nav.read_len = 0;
+    nav.bytes_read = 0;
+    nav.error[0] = 0;
+    nav.started_ms = lv_tick_get();
+
+    nav.thread = tt_thread_alloc_ext("browser_fetch", FETCH_STACK_SIZE, fetch_worker, NULL);
+    tt_thread_start(nav.thread);
+    lv_timer_resume(nav.poll_timer);
+}
+
+// Collect a finished worker: render its page if it is still the latest
+// navigation, otherwise count it as wasted and start the one that replaced it
+static void fetch_poll_cb(lv_timer_t* timer) {
+    if (!nav.thread) {
+        lv_timer_pause(timer);
+        return;
+    }
+    if (tt_thread_get_state(nav.thread) != ThreadStateStopped) return;
+
+    tt_thread_join(nav.thread, portMAX_DELAY);
+    tt_thread_free(nav.thread);
+    nav.thread = NULL;
+
+    if (fetch_superseded() || !nav.parent) {
+        nav.abandoned++;
+        nav.wasted_bytes += nav.bytes_read;
+        nav.wasted_ms += lv_tick_elaps(nav.started_ms);
+        ESP_LOGD(TAG, "nav dropped %s: %lu abandoned, %lu bytes and %lu ms wasted so far", nav.url,
+                 (unsigned long)nav.abandoned, (unsigned long)nav.wasted_bytes, (unsigned long)nav.wasted_ms);
+        if (nav.has_pending) start_fetch();
+        return;
+    }
+
+    lv_obj_clean(nav.parent);
+    page_rendered = !nav.error[0];
+    if (nav.error[0]) {
+        lv_obj_t* err_lbl = lv_label_create(nav.parent);
+        lv_label_set_text(err_lbl, nav.error);
+        lv_obj_set_style_text_color(err_lbl, lv_color_hex(0x808080), 0);
+    } else {
+        render_page(nav.parent, nav.read_len);
+    }
+#ifdef SOAK_NAVIGATIONS
+    soak_step();
+#endif
+}
+
+static uint32_t widget_bytes(lv_obj_t* obj) {
+    uint32_t bytes = WIDGET_OVERHEAD;
+    if (lv_obj_check_type(obj, &lv_label_class)) bytes += strlen(lv_label_get_text(obj)) + 1;
+    uint32_t child_cnt = lv_obj_get_child_cnt(obj);
+    for (uint32_t i = 0; i < child_cnt; i++) bytes += widget_bytes(lv_obj_get_child(obj, i));
+    return bytes;
+}
+
+static void drop_frozen(history_entry_t* entry) {
+    if (!entry->frozen) return;
+    lv_obj_delete(entry->frozen);
+    entry->frozen = NULL;
+}
+
+// Keep the most recently frozen pages within BFCACHE_PAGES and BFCACHE_BUDGET
+static void bfcache_evict(void) {
+    for (;;) {
+        int pages = 0;
+        uint32_t bytes = 0;
+        history_entry_t* oldest = NULL;
+        for (int i = 0; i < history_count; i++) {
+            if (!history[i].frozen) continue;
+            pages++;
+            bytes += history[i].bytes;
+            if (!oldest || history[i].frozen_seq < oldest->frozen_seq) oldest = &history[i];
         }
-        child = lxb_dom_node_next(child);
+        if (pages <= BFCACHE_PAGES && bytes <= BFCACHE_BUDGET) return;
+        drop_frozen(oldest);
     }
-    
-    if (body) {
-        int y_offset = 0;
-        render_node_tree(body, parent, &y_offset);
+}
+
+// Take the page off screen: hide it under the current history entry when it
+// rendered, delete it otherwise
+static void leave_page(bool freeze) {
+    if (!page_obj) return;
+    if (freeze && page_rendered && history_index >= 0) {
+        history_entry_t* entry = &history[history_index];
+        drop_frozen(entry);
+        entry->frozen = page_obj;
+        entry->scroll_y = lv_obj_get_scroll_y(content_container);
+        entry->bytes = widget_bytes(page_obj);
+        entry->frozen_seq = ++frozen_seq;
+        lv_obj_add_flag(page_obj, LV_OBJ_FLAG_HIDDEN);
+        bfcache_evict();
     } else {
-        // No body found, try to render the root
-        int y_offset = 0;
-        render_node_tree(lxb_dom_interface_node(root), parent, &y_offset);
+        lv_obj_delete(page_obj);
+    }
+    page_obj = NULL;
+    page_rendered = false;
+}
+
+// Make `url` the current entry, dropping the forward entries
+static void history_push(const char* url) {
+    while (history_count > history_index + 1) drop_frozen(&history[--history_count]);
+    if (history_count == HISTORY_LENGTH) {
+        drop_frozen(&history[0]);
+        memmove(history, history + 1, (HISTORY_LENGTH - 1) * sizeof(history_entry_t));
+        history_count--;
     }
+    history_entry_t* entry = &history[history_count++];
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->url, url, MAX_URL_LENGTH - 1);
+    history_index = history_count - 1;
+}
+
+static void update_history_buttons(void) {
+    lv_obj_set_state(back_btn, LV_STATE_DISABLED, history_index <= 0);
+    lv_obj_set_state(forward_btn, LV_STATE_DISABLED, history_index >= history_count - 1);
+}
+
+// Start loading `url` into a fresh page container. A navigation still in
+// flight is superseded: its worker stops at the next read and its result is
+// dropped.
+static void begin_load(const char* url) {
+    nav.generation++;
+    strncpy(nav.pending_url, url, MAX_URL_LENGTH - 1);
+    nav.pending_url[MAX_URL_LENGTH - 1] = 0;
+    nav.has_pending = true;
+
+    page_obj = lv_obj_create(content_container);
+    lv_obj_remove_style_all(page_obj);
+    lv_obj_set_size(page_obj, lv_pct(100), LV_SIZE_CONTENT);
+    lv_obj_remove_flag(page_obj, LV_OBJ_FLAG_SCROLLABLE);
+    nav.parent = page_obj;
     
-    lxb_html_document_destroy(document);
+    // Show loading indicator
+    lv_obj_t* loading_lbl = lv_label_create(page_obj);
+    lv_label_set_text(loading_lbl, "Loading...");
+    lv_obj_set_style_text_color(loading_lbl, lv_color_hex(0x808080), 0);
+
+    if (!nav.poll_timer) nav.poll_timer = lv_timer_create(fetch_poll_cb, FETCH_POLL_MS, NULL);
+    // html_buffer belongs to the running worker until it stops; the poll
+    // timer starts the pending navigation then
+    if (!nav.thread) start_fetch();
+}
+
+// Navigate to a new URL, adding it to the history
+static void navigate(const char* url) {
+    if (!url || strlen(url) == 0) return;
+    leave_page(true);
+    history_push(url);
+    update_history_buttons();
+    begin_load(url);
+}
+
+// Back (-1) or forward (+1). A frozen page is simply shown again.
+static void go_history(int delta) {
+    int target = history_index + delta;
+    if (history_index < 0 || target < 0 || target >= history_count) return;
+
+    leave_page(true);
+    history_index = target;
+    history_entry_t* entry = &history[target];
+    lv_textarea_set_text(address_bar, entry->url);
+    update_history_buttons();
+
+    if (!entry->frozen) {
+        begin_load(entry->url);
+        return;
+    }
+    // Whatever was loading is no longer wanted
+    nav.generation++;
+    nav.has_pending = false;
+    page_obj = entry->frozen;
+    page_rendered = true;
+    entry->frozen = NULL;
+    lv_obj_remove_flag(page_obj, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_update_layout(content_container);
+    lv_obj_scroll_to_y(content_container, entry->scroll_y, LV_ANIM_OFF);
 }
 
 // Button event callback
 static void fetch_btn_event_cb(lv_event_t* e) {
     if (lv_event_get_code(e) != LV_EVENT_CLICKED) return;
     
-    lv_obj_t* btn = lv_event_get_target(e);
-    lv_obj_t* parent = lv_obj_get_parent(btn);
-    
-    // Find components
-    lv_obj_t* addr_bar = NULL;
-    lv_obj_t* content_cont = NULL;
-    
-    uint32_t child_cnt = lv_obj_get_child_cnt(parent);
-    for (uint32_t i = 0; i < child_cnt; i++) {
-        lv_obj_t* child = lv_obj_get_child(parent, i);
-        if (lv_obj_check_type(child, &lv_textarea_class)) {
-            addr_bar = child;
-        } else if (child != btn && !lv_obj_check_type(child, &lv_label_class)) {
-            content_cont = child;
-        }
-    }
-    
-    if (!addr_bar || !content_cont) return;
-    
     // Get URL and validate
-    const char* url = lv_textarea_get_text(addr_bar);
+    const char* url = lv_textarea_get_text(address_bar);
     if (!url || strlen(url) == 0) return;
     
     // Copy URL to buffer for safety
@@ -436,54 +772,63 @@ static void fetch_btn_event_cb(lv_event_t* e) {
     url_buffer[MAX_URL_LENGTH - 1] = 0;
     
     // Fetch and render
-    fetch_and_render(global_app, url_buffer, content_cont);
+    navigate(url_buffer);
 }
 
-// Enhanced address bar with history - Fixed event handling
+// User pressed Enter in the address bar
 static void addr_bar_event_cb(lv_event_t* e) {
     if (lv_event_get_code(e) == LV_EVENT_READY) {
-        // User pressed Enter - simulate a button click by calling the function directly
-        lv_obj_t* addr_bar = lv_event_get_target(e);
-        lv_obj_t* parent = lv_obj_get_parent(addr_bar);
-        
-        // Find the content container and execute fetch directly
-        lv_obj_t* content_cont = NULL;
-        uint32_t child_cnt = lv_obj_get_child_cnt(parent);
-        for (uint32_t i = 0; i < child_cnt; i++) {
-            lv_obj_t* child = lv_obj_get_child(parent, i);
-            if (child != addr_bar && !lv_obj_check_type(child, &lv_button_class) && 
-                !lv_obj_check_type(child, &lv_label_class)) {
-                content_cont = child;
-                break;
-            }
-        }
-        
-        if (content_cont) {
-            const char* url = lv_textarea_get_text(addr_bar);
-            if (url && strlen(url) > 0) {
-                strncpy(url_buffer, url, MAX_URL_LENGTH - 1);
-                url_buffer[MAX_URL_LENGTH - 1] = 0;
-                fetch_and_render(global_app, url_buffer, content_cont);
-            }
+        const char* url = lv_textarea_get_text(address_bar);
+        if (url && strlen(url) > 0) {
+            strncpy(url_buffer, url, MAX_URL_LENGTH - 1);
+            url_buffer[MAX_URL_LENGTH - 1] = 0;
+            navigate(url_buffer);
         }
     }
 }
 
+static void back_btn_event_cb(lv_event_t* e) {
+    go_history(-1);
+}
+
+static void forward_btn_event_cb(lv_event_t* e) {
+    go_history(1);
+}
+
+static lv_obj_t* create_nav_button(lv_obj_t* parent, const char* symbol, lv_coord_t x, lv_event_cb_t cb) {
+    lv_obj_t* btn = lv_btn_create(parent);
+    lv_obj_set_size(btn, 35, 35);
+    lv_obj_align(btn, LV_ALIGN_TOP_LEFT, x, 30);
+    lv_obj_t* label = lv_label_create(btn);
+    lv_label_set_text(label, symbol);
+    lv_obj_center(label);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_add_state(btn, LV_STATE_DISABLED);
+    return btn;
+}
+
 static void onShow(AppHandle app, void* data, lv_obj_t* parent) {
     global_app = app;
+    // Taken before any page so it comes from unbroken heap
+    if (!page_arena_init(&page_arena, PAGE_ARENA_SIZE)) {
+        printf("[mem] no room for the page arena, pages allocate from the heap\n");
+    }
     
     // Create toolbar
     tt_lvgl_toolbar_create_for_app(parent, app);
     
+    back_btn = create_nav_button(parent, LV_SYMBOL_LEFT, 10, back_btn_event_cb);
+    forward_btn = create_nav_button(parent, LV_SYMBOL_RIGHT, 50, forward_btn_event_cb);
+
     // Address bar with better styling
-    lv_obj_t* addr_bar = lv_textarea_create(parent);
-    lv_obj_set_width(addr_bar, lv_pct(75));
-    lv_obj_set_height(addr_bar, 35);
-    lv_textarea_set_one_line(addr_bar, true);
-    lv_textarea_set_text(addr_bar, "http://example.com");
-    lv_textarea_set_placeholder_text(addr_bar, "Enter URL...");
-    lv_obj_align(addr_bar, LV_ALIGN_TOP_LEFT, 10, 30);
-    lv_obj_add_event_cb(addr_bar, addr_bar_event_cb, LV_EVENT_READY, NULL);
+    address_bar = lv_textarea_create(parent);
+    lv_obj_set_width(address_bar, lv_pct(45));
+    lv_obj_set_height(address_bar, 35);
+    lv_textarea_set_one_line(address_bar, true);
+    lv_textarea_set_text(address_bar, "http://example.com");
+    lv_textarea_set_placeholder_text(address_bar, "Enter URL...");
+    lv_obj_align(address_bar, LV_ALIGN_TOP_LEFT, 90, 30);
+    lv_obj_add_event_cb(address_bar, addr_bar_event_cb, LV_EVENT_READY, NULL);
     
     // Go button with better styling
     lv_obj_t* fetch_btn = lv_btn_create(parent);
@@ -499,22 +844,52 @@ static void onShow(AppHandle app, void* data, lv_obj_t* parent) {
     lv_obj_add_event_cb(fetch_btn, fetch_btn_event_cb, LV_EVENT_CLICKED, NULL);
     
     // Content container with better scrolling
-    lv_obj_t* content_cont = lv_obj_create(parent);
-    lv_obj_set_size(content_cont, lv_pct(100), lv_pct(85));
-    lv_obj_align(content_cont, LV_ALIGN_TOP_LEFT, 0, 75);
-    lv_obj_set_scroll_dir(content_cont, LV_DIR_VER);
-    lv_obj_set_style_pad_all(content_cont, 10, 0);
-    lv_obj_set_style_bg_color(content_cont, lv_color_white(), 0);
-    lv_obj_set_style_border_width(content_cont, 1, 0);
-    lv_obj_set_style_border_color(content_cont, lv_color_hex(0xCCCCCC), 0);
-    
-    // Initial page load
-    fetch_and_render(app, "http://example.com", content_cont);
+    content_container = lv_obj_create(parent);
+    lv_obj_set_size(content_container, lv_pct(100), lv_pct(85));
+    lv_obj_align(content_container, LV_ALIGN_TOP_LEFT, 0, 75);
+    lv_obj_set_scroll_dir(content_container, LV_DIR_VER);
+    lv_obj_set_style_pad_all(content_container, 10, 0);
+    lv_obj_set_style_bg_color(content_container, lv_color_white(), 0);
+    lv_obj_set_style_border_width(content_container, 1, 0);
+    lv_obj_set_style_border_color(content_container, lv_color_hex(0xCCCCCC), 0);
+    
+    // Initial page load, or back to where the user was
+    if (history_index >= 0) {
+        lv_textarea_set_text(address_bar, history[history_index].url);
+        update_history_buttons();
+        begin_load(history[history_index].url);
+    } else {
+        navigate("http://example.com");
+    }
+}
+
+// Supersede any load in flight and wait for its worker: it must not outlive
+// the app's code or write into a page that no longer exists
+static void onHide(AppHandle app, void* data) {
+    nav.generation++;
+    nav.has_pending = false;
+    nav.parent = NULL;
+    // The widgets go with the app's view; only the URLs survive
+    for (int i = 0; i < history_count; i++) history[i].frozen = NULL;
+    page_obj = NULL;
+    page_rendered = false;
+    if (nav.thread) {
+        tt_thread_join(nav.thread, portMAX_DELAY);
+        tt_thread_free(nav.thread);
+        nav.thread = NULL;
+    }
+    if (nav.poll_timer) {
+        lv_timer_delete(nav.poll_timer);
+        nav.poll_timer = NULL;
+    }
+    page_arena_deinit(&page_arena);
+    log_heap("hidden");
 }
 
 ExternalAppManifest manifest = {
     .name = "Tactile Browser",
-    .onShow = onShow
+    .onShow = onShow,
+    .onHide = onHide
 };
 
 int main(int argc, char* argv[]) {
@@ -0,0 +1,114 @@
+#include "page_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <lexbor/core/lexbor.h>
+
+#define ARENA_ALIGN 8
+
+// Each allocation is preceded by its size so realloc knows how much to copy
+typedef struct {
+    size_t size;
+    size_t prev; // Offset of the previous header
+} block_header_t;
+
+// lexbor's hooks take no context
+static page_arena_t* active;
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static bool in_arena(const void* ptr) {
+    return active && (const uint8_t*)ptr >= active->base && (const uint8_t*)ptr < active->base + active->size;
+}
+
+static block_header_t* header_of(void* ptr) {
+    return (block_header_t*)((uint8_t*)ptr - sizeof(block_header_t));
+}
+
+static void* arena_malloc(size_t size) {
+    size_t need = sizeof(block_header_t) + align_up(size);
+    if (!active->base || active->size - active->used < need) {
+        active->fallbacks++;
+        return malloc(size);
+    }
+    block_header_t* header = (block_header_t*)(active->base + active->used);
+    header->size = size;
+    header->prev = active->last;
+    active->last = active->used;
+    active->used += need;
+    if (active->used > active->high_water) active->high_water = active->used;
+    return header + 1;
+}
+
+static void* arena_calloc(size_t num, size_t size) {
+    if (size && num > SIZE_MAX / size) return NULL;
+    void* ptr = arena_malloc(num * size);
+    if (ptr) memset(ptr, 0, num * size);
+    return ptr;
+}
+
+static bool is_newest(void* ptr) {
+    return active->used > 0 && (uint8_t*)header_of(ptr) == active->base + active->last;
+}
+
+static void arena_free(void* ptr) {
+    if (!ptr) return;
+    if (!in_arena(ptr)) {
+        free(ptr);
+        return;
+    }
+    // Only the newest block can be given back early; the rest wait for the reset
+    if (is_newest(ptr)) {
+        active->used = active->last;
+        active->last = header_of(ptr)->prev;
+    }
+}
+
+static void* arena_realloc(void* ptr, size_t size) {
+    if (!ptr) return arena_malloc(size);
+    if (!in_arena(ptr)) return realloc(ptr, size);
+
+    block_header_t* header = header_of(ptr);
+    if (size <= header->size) return ptr;
+    if (is_newest(ptr) && active->size - active->last >= sizeof(block_header_t) + align_up(size)) {
+        // Grow in place at the end of the arena
+        header->size = size;
+        active->used = active->last + sizeof(block_header_t) + align_up(size);
+        if (active->used > active->high_water) active->high_water = active->used;
+        return ptr;
+    }
+    void* grown = arena_malloc(size);
+    if (grown) memcpy(grown, ptr, header->size);
+    return grown;
+}
+
+bool page_arena_init(page_arena_t* arena, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->base = malloc(size);
+    if (!arena->base) return false;
+    arena->size = size;
+    return true;
+}
+
+void page_arena_deinit(page_arena_t* arena) {
+    if (active == arena) page_arena_end(arena);
+    free(arena->base);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void page_arena_begin(page_arena_t* arena) {
+    active = arena;
+    arena->used = 0;
+    arena->last = 0;
+    arena->fallbacks = 0;
+    lexbor_memory_setup(arena_malloc, arena_realloc, arena_calloc, arena_free);
+}
+
+void page_arena_end(page_arena_t* arena) {
+    lexbor_memory_setup(malloc, realloc, calloc, free);
+    active = NULL;
+    arena->used = 0;
+    arena->last = 0;
+}
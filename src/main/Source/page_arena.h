@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// One block of memory that lexbor allocates from while a page is parsed and
+// turned into widgets. The document's many small nodes and its string and
+// hash chunks all land in it instead of being spread across the heap, and
+// the whole block is reset at once after the document is destroyed, so
+// browsing does not leave the heap in pieces too small for the next page.
+//
+// The block is taken when the app is shown and given back when it hides.
+// Requests that no longer fit go to the heap as before.
+#ifndef PAGE_ARENA_SIZE
+#define PAGE_ARENA_SIZE (64 * 1024)
+#endif
+
+typedef struct {
+    uint8_t* base;     // NULL if the block could not be allocated
+    size_t size;
+    size_t used;
+    size_t last;       // Offset of the newest allocation's header, for in-place realloc
+    size_t high_water; // Most `used` has been since init
+    uint32_t fallbacks; // Requests of the current page that went to the heap
+} page_arena_t;
+
+bool page_arena_init(page_arena_t* arena, size_t size);
+void page_arena_deinit(page_arena_t* arena);
+
+// Route lexbor's allocations into `arena` until page_arena_end(), which
+// restores the heap allocators and resets the arena. Everything lexbor
+// allocated in between must have been freed (its document destroyed).
+void page_arena_begin(page_arena_t* arena);
+void page_arena_end(page_arena_t* arena);
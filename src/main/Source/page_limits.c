@@ -0,0 +1,25 @@
+#include "page_limits.h"
+
+#include <stdio.h>
+
+bool page_limits_notice(uint32_t hits, char* out, size_t size) {
+    if (!hits || size == 0) return false;
+    static const struct {
+        page_limit_hit_t hit;
+        const char* reason;
+    } reasons[] = {
+        {PAGE_LIMIT_HIT_NODES, "too many elements"},
+        {PAGE_LIMIT_HIT_TEXT, "too much text"},
+        {PAGE_LIMIT_HIT_DEPTH, "nested too deeply"},
+        {PAGE_LIMIT_HIT_WIDGETS, "too much content to show"},
+        {PAGE_LIMIT_HIT_TIME, "took too long to lay out"},
+    };
+    size_t used = (size_t)snprintf(out, size, "This page was shortened:");
+    const char* separator = " ";
+    for (size_t i = 0; i < sizeof(reasons) / sizeof(reasons[0]) && used < size; i++) {
+        if (!(hits & reasons[i].hit)) continue;
+        used += (size_t)snprintf(out + used, size - used, "%s%s", separator, reasons[i].reason);
+        separator = ", ";
+    }
+    return true;
+}
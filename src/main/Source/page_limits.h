@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Resource limits for one page: the ESP profile of the limits the desktop
+// build also enforces, under the same names. The token gate in front of the
+// tree builder enforces nodes and text; the render tree enforces depth and
+// widgets; painting enforces time. A page that hits one is cut short and
+// shows a notice instead of running the heap dry.
+#ifndef MAX_HTML_SIZE
+#define MAX_HTML_SIZE 6144            // Page bytes kept after decoding; the rest is not read
+#endif
+#ifndef PAGE_LIMIT_NODES
+#define PAGE_LIMIT_NODES 1024         // Elements and text runs parsed
+#endif
+#ifndef PAGE_LIMIT_DEPTH
+#define PAGE_LIMIT_DEPTH 24           // Nesting recorded; deeper content is left out
+#endif
+#ifndef PAGE_LIMIT_WIDGETS
+#define PAGE_LIMIT_WIDGETS 384        // LVGL objects created
+#endif
+#ifndef PAGE_LIMIT_TEXT_BYTES
+#define PAGE_LIMIT_TEXT_BYTES 4096    // Page text kept
+#endif
+#ifndef PAGE_LIMIT_RENDER_MS
+#define PAGE_LIMIT_RENDER_MS 400      // Building the widgets
+#endif
+
+typedef enum {
+    PAGE_LIMIT_HIT_NODES   = 1 << 0,
+    PAGE_LIMIT_HIT_DEPTH   = 1 << 1,
+    PAGE_LIMIT_HIT_WIDGETS = 1 << 2,
+    PAGE_LIMIT_HIT_TEXT    = 1 << 3,
+    PAGE_LIMIT_HIT_TIME    = 1 << 4,
+} page_limit_hit_t;
+
+// "This page was shortened: ..." for `hits`; false if there is nothing to say
+bool page_limits_notice(uint32_t hits, char* out, size_t size);
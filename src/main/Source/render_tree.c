@@ -0,0 +1,273 @@
+#include "render_tree.h"
+
+#include <string.h>
+#include <lexbor/dom/interfaces/document.h>
+#include <lexbor/dom/interfaces/element.h>
+#include <lexbor/dom/interfaces/text.h>
+#include "text_chunk.h"
+
+void render_tree_reset(render_tree_t* tree) {
+    tree->count = 0;
+    tree->style_count = 0;
+    tree->link_count = 0;
+    tree->strings_used = 0;
+    tree->hits = 0;
+    tree->path_len = 0;
+}
+
+// Copy `len` bytes into the string block; RENDER_NONE when full
+static uint16_t add_string(render_tree_t* tree, const char* str, size_t len) {
+    if (len + 1 > (size_t)(RENDER_TREE_TEXT_SIZE - tree->strings_used)) {
+        tree->hits |= PAGE_LIMIT_HIT_TEXT;
+        return RENDER_NONE;
+    }
+    uint16_t offset = tree->strings_used;
+    memcpy(&tree->strings[offset], str, len);
+    tree->strings[offset + len] = 0;
+    tree->strings_used += (uint16_t)(len + 1);
+    return offset;
+}
+
+
+// Pages repeat the same few inline styles, so each is stored once
+static uint16_t add_style(render_tree_t* tree, const lxb_char_t* style, size_t len) {
+    if (!style || len == 0 || len >= RENDER_STYLE_MAX) return RENDER_NONE;
+    for (uint16_t i = 0; i < tree->style_count; i++) {
+        const char* known = &tree->strings[tree->style_offset[i]];
+        if (strlen(known) == len && memcmp(known, style, len) == 0) return i;
+    }
+    if (tree->style_count == RENDER_TREE_MAX_STYLES) return RENDER_NONE; // Shown unstyled
+    uint16_t offset = add_string(tree, (const char*)style, len);
+    if (offset == RENDER_NONE) return RENDER_NONE;
+    tree->style_offset[tree->style_count] = offset;
+    return tree->style_count++;
+}
+
+static uint16_t add_link(render_tree_t* tree, const lxb_char_t* href, size_t len) {
+    bool absolute = href && ((len > 7 && memcmp(href, "http://", 7) == 0) || (len > 8 && memcmp(href, "https://", 8) == 0));
+    if (!absolute || len >= RENDER_LINK_MAX) return RENDER_NONE;
+    if (tree->link_count == RENDER_TREE_MAX_LINKS) return RENDER_NONE; // Shown, not followable
+    uint16_t offset = add_string(tree, (const char*)href, len);
+    if (offset == RENDER_NONE) return RENDER_NONE;
+    tree->link_offset[tree->link_count] = offset;
+    return tree->link_count++;
+}
+
+static bool tag_is(const lxb_char_t* tag, size_t len, const char* name) {
+    return len == strlen(name) && memcmp(tag, name, len) == 0;
+}
+
+static render_kind_t element_kind(lxb_dom_element_t* el) {
+    size_t len;
+    const lxb_char_t* tag = lxb_dom_element_local_name(el, &len);
+    if (!tag) return RENDER_BOX;
+    if (tag_is(tag, len, "h1") || tag_is(tag, len, "h2") || tag_is(tag, len, "h3")) return RENDER_HEADING;
+    if (tag_is(tag, len, "p")) return RENDER_PARAGRAPH;
+    if (tag_is(tag, len, "a")) return RENDER_LINK;
+    if (tag_is(tag, len, "button")) return RENDER_BUTTON;
+    if (tag_is(tag, len, "div")) return RENDER_DIV;
+    if (tag_is(tag, len, "span")) return RENDER_SPAN;
+    return RENDER_BOX;
+}
+
+// Append one node; false when the arrays are full
+static bool add_node(render_tree_t* tree, render_kind_t kind, int depth, uint16_t style, uint16_t text,
+                     uint16_t link) {
+    if (tree->count == RENDER_TREE_MAX_NODES) {
+        tree->hits |= PAGE_LIMIT_HIT_WIDGETS;
+        return false;
+    }
+    uint16_t i = tree->count++;
+    tree->kind[i] = (uint8_t)kind;
+    tree->depth[i] = (uint8_t)depth;
+    tree->style[i] = style;
+    tree->text[i] = text;
+    tree->link[i] = link;
+    return true;
+}
+
+// A text node becomes one or more text runs of under RENDER_TEXT_MAX bytes,
+// split between words, so long paragraphs are shown rather than dropped
+static void add_text_runs(render_tree_t* tree, const lxb_char_t* text, size_t len, int depth) {
+    text_chunker_t chunker;
+    text_chunker_init(&chunker, (const char*)text, len, RENDER_TEXT_MAX - 1);
+    const char* piece;
+    size_t piece_len;
+    while (text_chunker_next(&chunker, &piece, &piece_len)) {
+        uint16_t offset = add_string(tree, piece, piece_len);
+        if (offset == RENDER_NONE || !add_node(tree, RENDER_TEXT, depth, RENDER_NONE, offset, RENDER_NONE)) return;
+    }
+}
+
+static void record_node(render_tree_t* tree, lxb_dom_node_t* node, int depth);
+
+static void record_children(render_tree_t* tree, lxb_dom_node_t* node, int depth) {
+    for (lxb_dom_node_t* child = lxb_dom_node_first_child(node); child; child = lxb_dom_node_next(child)) {
+        record_node(tree, child, depth);
+    }
+}
+
+// The element's own node, without its children; false if it is left out
+static bool record_entry(render_tree_t* tree, lxb_dom_element_t* el, int depth) {
+    if (depth >= RENDER_TREE_MAX_DEPTH) {
+        tree->hits |= PAGE_LIMIT_HIT_DEPTH;
+        return false;
+    }
+    lxb_dom_node_t* node = lxb_dom_interface_node(el);
+    render_kind_t kind = element_kind(el);
+
+    size_t len;
+    const lxb_char_t* value = lxb_dom_element_get_attribute(el, (const lxb_char_t*)"style", 5, &len);
+    uint16_t style = add_style(tree, value, len);
+
+    uint16_t text = RENDER_NONE, link = RENDER_NONE;
+    if (kind == RENDER_BUTTON) {
+        lxb_char_t* label = lxb_dom_node_text_content(node, &len);
+        if (label) {
+            if (len > 0 && len < RENDER_TEXT_MAX) text = add_string(tree, (const char*)label, len);
+            lxb_dom_document_destroy_text(node->owner_document, label);
+        }
+    } else if (kind == RENDER_LINK) {
+        value = lxb_dom_element_get_attribute(el, (const lxb_char_t*)"href", 4, &len);
+        link = add_link(tree, value, len);
+    }
+    return add_node(tree, kind, depth, style, text, link);
+}
+
+static void record_node(render_tree_t* tree, lxb_dom_node_t* node, int depth) {
+    if (node->type == LXB_DOM_NODE_TYPE_TEXT) {
+        // Read in place: text_content would copy it into the document first
+        lxb_dom_character_data_t* data = lxb_dom_interface_character_data(node);
+        add_text_runs(tree, data->data.data, data->data.length, depth);
+    } else if (node->type == LXB_DOM_NODE_TYPE_ELEMENT) {
+        if (record_entry(tree, lxb_dom_interface_element(node), depth)) record_children(tree, node, depth + 1);
+    }
+}
+
+static lxb_dom_node_t* find_body(lxb_dom_document_t* document) {
+    lxb_dom_element_t* root = lxb_dom_document_element(document);
+    if (!root) return NULL;
+    lxb_dom_node_t* child = lxb_dom_node_first_child(lxb_dom_interface_node(root));
+    for (; child; child = lxb_dom_node_next(child)) {
+        if (child->type == LXB_DOM_NODE_TYPE_ELEMENT && lxb_dom_node_tag_id(child) == LXB_TAG_BODY) return child;
+    }
+    return NULL;
+}
+
+// `node` is `ancestor` or inside it
+static bool is_inside(lxb_dom_node_t* node, lxb_dom_node_t* ancestor) {
+    for (; node; node = node->parent) {
+        if (node == ancestor) return true;
+    }
+    return false;
+}
+
+static bool list_has(lexbor_array_t* list, lxb_dom_node_t* node) {
+    for (size_t i = 0; i < lexbor_array_length(list); i++) {
+        if (lexbor_array_get(list, i) == node) return true;
+    }
+    return false;
+}
+
+static bool list_has_inside(lexbor_array_t* list, lxb_dom_node_t* subtree) {
+    for (size_t i = 0; i < lexbor_array_length(list); i++) {
+        if (is_inside((lxb_dom_node_t*)lexbor_array_get(list, i), subtree)) return true;
+    }
+    return false;
+}
+
+// Nothing the tree builder does from here on can change `node` or what is
+// inside it. The builder only changes what it still holds: open elements,
+// formatting elements it may reopen or move content out of, and the open
+// form. Text is only ever added at the end of an open element or, for
+// stray table content, just before an open table.
+static bool is_settled(render_tree_t* tree, lxb_dom_node_t* node) {
+    lxb_html_tree_t* builder = tree->builder;
+    if (list_has_inside(builder->open_elements, node) || list_has_inside(builder->active_formatting, node) ||
+        (builder->form && is_inside(lxb_dom_interface_node(builder->form), node))) {
+        return false;
+    }
+    lxb_dom_node_t* next = lxb_dom_node_next(node);
+    if (!next) return !list_has(builder->open_elements, lxb_dom_node_parent(node));
+    return lxb_dom_node_tag_id(next) != LXB_TAG_TABLE || !list_has(builder->open_elements, next);
+}
+
+// An element still being built whose own node can be recorded now and its
+// children as each settles. The builder may move content out of formatting
+// elements and in front of tables, a template's content is not its
+// children, and a button's label is all of its text.
+static bool can_enter(render_tree_t* tree, lxb_dom_node_t* node) {
+    if (node->type != LXB_DOM_NODE_TYPE_ELEMENT) return false;
+    lxb_tag_id_t tag = lxb_dom_node_tag_id(node);
+    if (tag == LXB_TAG_TABLE || tag == LXB_TAG_TEMPLATE) return false;
+    if (element_kind(lxb_dom_interface_element(node)) == RENDER_BUTTON) return false;
+    return !list_has(tree->builder->active_formatting, node);
+}
+
+// Record and destroy everything in the body that has settled, in document
+// order, walking into elements that are still open
+static void record_settled(render_tree_t* tree) {
+    if (tree->path_len == 0) {
+        lxb_dom_node_t* body = find_body(lxb_dom_interface_document(tree->builder->document));
+        if (!body) return;
+        tree->path[0] = body;
+        tree->path_len = 1;
+    }
+    for (;;) {
+        lxb_dom_node_t* parent = tree->path[tree->path_len - 1];
+        int depth = tree->path_len - 1;
+        lxb_dom_node_t* child = lxb_dom_node_first_child(parent);
+        if (!child) {
+            // Recorded when it was entered, its children since
+            if (tree->path_len == 1 || !is_settled(tree, parent)) return;
+            tree->path_len--;
+            lxb_dom_node_remove(parent);
+            lxb_dom_node_destroy_deep(parent);
+        } else if (is_settled(tree, child)) {
+            record_node(tree, child, depth);
+            lxb_dom_node_remove(child);
+            lxb_dom_node_destroy_deep(child);
+        } else if (can_enter(tree, child) && record_entry(tree, lxb_dom_interface_element(child), depth)) {
+            tree->path[tree->path_len++] = child;
+        } else {
+            return;
+        }
+    }
+}
+
+static lxb_html_token_t* stream_token(lxb_html_tokenizer_t* tkz, lxb_html_token_t* token, void* ctx) {
+    render_tree_t* tree = (render_tree_t*)ctx;
+    token = tree->next_callback(tkz, token, tree->next_ctx);
+    if (token) record_settled(tree);
+    return token;
+}
+
+void render_tree_attach(render_tree_t* tree, lxb_html_parser_t* parser) {
+    render_tree_reset(tree);
+    tree->builder = parser->tree;
+    tree->next_callback = parser->tkz->callback_token_done;
+    tree->next_ctx = parser->tkz->callback_token_ctx;
+    lxb_html_tokenizer_callback_token_done_set(parser->tkz, stream_token, tree);
+}
+
+void render_tree_finish(render_tree_t* tree, lxb_dom_document_t* document) {
+    if (tree->path_len == 0) {
+        lxb_dom_node_t* body = find_body(document);
+        if (!body) {
+            // No body, try to render the root
+            lxb_dom_element_t* root = lxb_dom_document_element(document);
+            if (root) record_children(tree, lxb_dom_interface_node(root), 0);
+            return;
+        }
+        tree->path[0] = body;
+        tree->path_len = 1;
+    }
+    // Parsing is over, so everything left is settled. Each element on the
+    // path is recorded already, and so is everything before it.
+    for (int i = tree->path_len - 1; i >= 0; i--) {
+        lxb_dom_node_t* child = i == tree->path_len - 1 ? lxb_dom_node_first_child(tree->path[i])
+                                                         : lxb_dom_node_next(tree->path[i + 1]);
+        for (; child; child = lxb_dom_node_next(child)) record_node(tree, child, i);
+    }
+    tree->path_len = 0;
+}
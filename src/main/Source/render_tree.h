@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <lexbor/dom/interfaces/node.h>
+#include <lexbor/html/parser.h>
+#include "page_limits.h"
+
+// What a page turns into between parsing and painting. Every node that
+// will become a widget is written here, in document order, as parallel
+// arrays plus one block of strings. It is built while the page is parsed:
+// after each token, whatever part of the body the tree builder can no
+// longer change is recorded and its DOM subtree destroyed, and lexbor
+// reuses that memory for the nodes that follow. The DOM never exists
+// whole, only the part still being built, and the document is freed before
+// any widget exists.
+//
+// A node's parent is the nearest earlier node one level shallower.
+#define RENDER_TREE_MAX_NODES PAGE_LIMIT_WIDGETS
+#define RENDER_TREE_MAX_DEPTH PAGE_LIMIT_DEPTH
+#define RENDER_TREE_TEXT_SIZE (PAGE_LIMIT_TEXT_BYTES + 1024) // Text, inline styles and link targets
+#define RENDER_TREE_MAX_STYLES 32   // Distinct inline styles
+#define RENDER_TREE_MAX_LINKS 48
+#define RENDER_TEXT_MAX 512         // Longer text is split into several runs
+#define RENDER_STYLE_MAX 256        // Longer style attributes are ignored
+#define RENDER_LINK_MAX 256         // Longer link targets are ignored
+#define RENDER_NONE 0xFFFF
+
+typedef enum {
+    RENDER_TEXT,
+    RENDER_HEADING,   // h1 to h3
+    RENDER_PARAGRAPH,
+    RENDER_LINK,
+    RENDER_BUTTON,    // Text holds the button's label
+    RENDER_DIV,
+    RENDER_SPAN,
+    RENDER_BOX,       // Any other element
+} render_kind_t;
+
+typedef struct {
+    uint16_t count;
+    uint8_t kind[RENDER_TREE_MAX_NODES];   // render_kind_t
+    uint8_t depth[RENDER_TREE_MAX_NODES];  // 0 for children of the walked node
+    uint16_t style[RENDER_TREE_MAX_NODES]; // Index into style_offset, or RENDER_NONE
+    uint16_t text[RENDER_TREE_MAX_NODES];  // Offset into strings, or RENDER_NONE
+    uint16_t link[RENDER_TREE_MAX_NODES];  // Index into link_offset, or RENDER_NONE
+
+    uint16_t style_offset[RENDER_TREE_MAX_STYLES];
+    uint16_t style_count;
+    uint16_t link_offset[RENDER_TREE_MAX_LINKS]; // Absolute http(s) targets only
+    uint16_t link_count;
+
+    char strings[RENDER_TREE_TEXT_SIZE]; // NUL-terminated, back to back
+    uint16_t strings_used;
+    uint32_t hits;  // page_limit_hit_t flags for content left out
+
+    // While parsing: the path from <body> to the element whose children
+    // are being recorded, each element on it recorded already
+    lxb_dom_node_t* path[RENDER_TREE_MAX_DEPTH + 1];
+    uint8_t path_len; // 0 until there is a body
+    lxb_html_tree_t* builder;
+    lxb_html_tokenizer_token_f next_callback; // The hook it was put in front of
+    void* next_ctx;
+} render_tree_t;
+
+void render_tree_reset(render_tree_t* tree);
+
+// Build `tree` from `parser` as it runs. Call after subtree_filter_attach(),
+// once per document, so only tokens the filter keeps reach the tree.
+void render_tree_attach(render_tree_t* tree, lxb_html_parser_t* parser);
+
+// Record what is left of the body once parsing has ended, or the children
+// of the root element when the document has no body
+void render_tree_finish(render_tree_t* tree, lxb_dom_document_t* document);
+
+static inline const char* render_tree_string(const render_tree_t* tree, uint16_t offset) {
+    return offset == RENDER_NONE ? NULL : &tree->strings[offset];
+}
@@ -0,0 +1,117 @@
+#include "subtree_filter.h"
+
+#include <lexbor/html/tokenizer/state_rawtext.h>
+#include <lexbor/html/tokenizer/state_rcdata.h>
+#include <lexbor/html/tokenizer/state_script.h>
+
+static uint32_t skip_flag(lxb_tag_id_t tag) {
+    switch (tag) {
+        case LXB_TAG_SCRIPT: return SUBTREE_SKIP_SCRIPT;
+        case LXB_TAG_STYLE: return SUBTREE_SKIP_STYLE;
+        case LXB_TAG_SVG: return SUBTREE_SKIP_SVG;
+        case LXB_TAG_NOSCRIPT: return SUBTREE_SKIP_NOSCRIPT;
+        case LXB_TAG__EM_COMMENT: return SUBTREE_SKIP_COMMENTS;
+        case LXB_TAG_META: case LXB_TAG_LINK: case LXB_TAG_BASE: case LXB_TAG_TITLE:
+            return SUBTREE_SKIP_METADATA;
+        default:
+            return 0;
+    }
+}
+
+// The tree builder would have switched the tokenizer for these; with the
+// start tag dropped, the filter has to
+static void enter_text_state(lxb_html_tokenizer_t* tkz, lxb_tag_id_t tag) {
+    switch (tag) {
+        case LXB_TAG_SCRIPT:
+            lxb_html_tokenizer_tmp_tag_id_set(tkz, tag);
+            lxb_html_tokenizer_state_set(tkz, lxb_html_tokenizer_state_script_data_before);
+            break;
+        case LXB_TAG_STYLE:
+            lxb_html_tokenizer_tmp_tag_id_set(tkz, tag);
+            lxb_html_tokenizer_state_set(tkz, lxb_html_tokenizer_state_rawtext_before);
+            break;
+        case LXB_TAG_TITLE:
+            lxb_html_tokenizer_tmp_tag_id_set(tkz, tag);
+            lxb_html_tokenizer_state_set(tkz, lxb_html_tokenizer_state_rcdata_before);
+            break;
+        default:
+            break;
+    }
+}
+
+static lxb_html_token_t* drop(subtree_filter_t* filter, lxb_html_token_t* token) {
+    filter->bytes_skipped += (uint32_t)(token->end - token->begin);
+    if (!(token->type & LXB_HTML_TOKEN_TYPE_CLOSE)) filter->nodes_skipped++;
+    return token;
+}
+
+// Back up to the start of a UTF-8 sequence so a cut never splits a character
+static size_t utf8_boundary(const lxb_char_t* text, size_t len) {
+    while (len > 0 && (text[len] & 0xC0) == 0x80) len--;
+    return len;
+}
+
+// Pass a token on to the tree builder, within the page limits
+static lxb_html_token_t* keep(subtree_filter_t* filter, lxb_html_tokenizer_t* tkz, lxb_html_token_t* token) {
+    if (token->type & LXB_HTML_TOKEN_TYPE_CLOSE) return filter->tree_callback(tkz, token, filter->tree_ctx);
+    if (filter->nodes_kept >= PAGE_LIMIT_NODES) {
+        filter->hits |= PAGE_LIMIT_HIT_NODES;
+        return drop(filter, token);
+    }
+    if (token->tag_id == LXB_TAG__TEXT) {
+        size_t len = (size_t)(token->text_end - token->text_start);
+        size_t left = PAGE_LIMIT_TEXT_BYTES - filter->text_kept;
+        if (len > left) {
+            filter->hits |= PAGE_LIMIT_HIT_TEXT;
+            len = utf8_boundary(token->text_start, left);
+            if (len == 0) return drop(filter, token);
+            token->text_end = token->text_start + len;
+        }
+        filter->text_kept += (uint32_t)len;
+    }
+    filter->nodes_kept++;
+    return filter->tree_callback(tkz, token, filter->tree_ctx);
+}
+
+static lxb_html_token_t* filter_token(lxb_html_tokenizer_t* tkz, lxb_html_token_t* token, void* ctx) {
+    subtree_filter_t* filter = (subtree_filter_t*)ctx;
+    // The tree builder must always see the end of input
+    if (token->tag_id == LXB_TAG__END_OF_FILE) return filter->tree_callback(tkz, token, filter->tree_ctx);
+
+    bool close = token->type & LXB_HTML_TOKEN_TYPE_CLOSE;
+    bool self_closing = token->type & LXB_HTML_TOKEN_TYPE_CLOSE_SELF;
+    if (filter->open_tag != LXB_TAG__UNDEF) {
+        if (token->tag_id == filter->open_tag) {
+            if (close && --filter->open_depth == 0) filter->open_tag = LXB_TAG__UNDEF;
+            else if (!close && !self_closing) filter->open_depth++;
+        }
+        if (!close && !self_closing) enter_text_state(tkz, token->tag_id);
+        return drop(filter, token);
+    }
+
+    if (!(filter->skip & skip_flag(token->tag_id))) return keep(filter, tkz, token);
+    // Void and self-closed elements, comments and stray end tags go alone
+    bool has_content = !close && !self_closing && token->tag_id != LXB_TAG__EM_COMMENT &&
+                       token->tag_id != LXB_TAG_META && token->tag_id != LXB_TAG_LINK &&
+                       token->tag_id != LXB_TAG_BASE;
+    if (has_content) {
+        filter->open_tag = token->tag_id;
+        filter->open_depth = 1;
+        enter_text_state(tkz, token->tag_id);
+    }
+    return drop(filter, token);
+}
+
+void subtree_filter_attach(subtree_filter_t* filter, lxb_html_parser_t* parser, uint32_t skip) {
+    filter->skip = skip;
+    filter->open_tag = LXB_TAG__UNDEF;
+    filter->open_depth = 0;
+    filter->nodes_skipped = 0;
+    filter->bytes_skipped = 0;
+    filter->nodes_kept = 0;
+    filter->text_kept = 0;
+    filter->hits = 0;
+    filter->tree_callback = parser->tkz->callback_token_done;
+    filter->tree_ctx = parser->tkz->callback_token_ctx;
+    lxb_html_tokenizer_callback_token_done_set(parser->tkz, filter_token, filter);
+}
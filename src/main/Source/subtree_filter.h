@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <lexbor/html/parser.h>
+#include "page_limits.h"
+
+// Drops content the renderer never shows on its way from lexbor's
+// tokenizer to the tree builder, so no DOM node is ever allocated for it.
+// A dropped start tag takes everything up to its matching end tag with it.
+// Raw-text elements (script, style, title) still switch the tokenizer to
+// the right state, so their content is not mistaken for markup.
+//
+// The filter is also where the page's node and text limits are enforced:
+// past PAGE_LIMIT_NODES nothing new reaches the tree, and text beyond
+// PAGE_LIMIT_TEXT_BYTES is cut off.
+typedef enum {
+    SUBTREE_SKIP_SCRIPT   = 1 << 0,
+    SUBTREE_SKIP_STYLE    = 1 << 1, // Until stylesheets are supported
+    SUBTREE_SKIP_SVG      = 1 << 2,
+    SUBTREE_SKIP_NOSCRIPT = 1 << 3,
+    SUBTREE_SKIP_COMMENTS = 1 << 4,
+    SUBTREE_SKIP_METADATA = 1 << 5, // <meta>, <link>, <base> and <title>
+} subtree_skip_t;
+
+#ifndef SUBTREE_SKIP_DEFAULT
+#define SUBTREE_SKIP_DEFAULT (SUBTREE_SKIP_SCRIPT | SUBTREE_SKIP_STYLE | SUBTREE_SKIP_SVG | \
+                              SUBTREE_SKIP_NOSCRIPT | SUBTREE_SKIP_COMMENTS | SUBTREE_SKIP_METADATA)
+#endif
+
+typedef struct {
+    uint32_t skip;           // subtree_skip_t flags
+    lxb_tag_id_t open_tag;   // Element being dropped, LXB_TAG__UNDEF when none
+    uint32_t open_depth;     // Nested elements of the same tag inside it
+    lxb_html_tokenizer_token_f tree_callback; // The tree builder's own hook
+    void* tree_ctx;
+    // Per page
+    uint32_t nodes_skipped;  // Elements, text runs and comments never built
+    uint32_t bytes_skipped;  // Source bytes they covered
+    uint32_t nodes_kept;
+    uint32_t text_kept;      // Bytes
+    uint32_t hits;           // page_limit_hit_t flags
+} subtree_filter_t;
+
+// Put the filter between the tokenizer and tree builder of `parser`. Call
+// after lxb_html_parse_chunk_begin(), once per document.
+void subtree_filter_attach(subtree_filter_t* filter, lxb_html_parser_t* parser, uint32_t skip);
@@ -0,0 +1,44 @@
+#include "text_chunk.h"
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+void text_chunker_init(text_chunker_t* chunker, const char* text, size_t len, size_t window) {
+    chunker->text = text;
+    chunker->len = text ? len : 0;
+    chunker->pos = 0;
+    chunker->window = window ? window : 1;
+}
+
+bool text_chunker_next(text_chunker_t* chunker, const char** piece, size_t* piece_len) {
+    const char* text = chunker->text;
+    size_t pos = chunker->pos;
+    while (pos < chunker->len && is_space(text[pos])) pos++;
+    if (pos == chunker->len) {
+        chunker->pos = pos;
+        return false;
+    }
+
+    size_t end = chunker->len;
+    if (end - pos > chunker->window) {
+        end = pos + chunker->window;
+        if (!is_space(text[end])) {
+            // Break after the last whole word in the window
+            size_t cut = end;
+            while (cut > pos && !is_space(text[cut - 1])) cut--;
+            if (cut > pos) {
+                end = cut;
+            } else {
+                // One word longer than the window: cut it between characters
+                while (end > pos + 1 && ((unsigned char)text[end] & 0xC0) == 0x80) end--;
+            }
+        }
+    }
+
+    chunker->pos = end;
+    while (end > pos && is_space(text[end - 1])) end--;
+    *piece = text + pos;
+    *piece_len = end - pos;
+    return true;
+}
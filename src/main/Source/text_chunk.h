@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Splits a run of text into pieces of at most `window` bytes, breaking at
+// whitespace so words stay whole. A single word longer than the window is
+// cut at a UTF-8 character boundary instead. Pieces are views into the
+// original text, trimmed of surrounding whitespace; nothing is copied or
+// allocated, so text of any length goes through in constant memory.
+//
+// Plain C with no LVGL or lexbor dependency.
+typedef struct {
+    const char* text;
+    size_t len;
+    size_t pos;
+    size_t window;
+} text_chunker_t;
+
+void text_chunker_init(text_chunker_t* chunker, const char* text, size_t len, size_t window);
+
+// Next piece; false once only whitespace is left
+bool text_chunker_next(text_chunker_t* chunker, const char** piece, size_t* piece_len);
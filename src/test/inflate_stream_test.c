@@ -0,0 +1,356 @@
+// inflate_stream against zlib: every framing, level and strategy, fed in
+// chunks down to single bytes, plus truncated and corrupt input and the
+// clamp that keeps a page inside html_buffer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "inflate_stream.h"
+#include "page_limits.h"
+
+static int failures;
+
+#define CHECK(cond, ...)                                          \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            failures++;                                           \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);     \
+            printf(__VA_ARGS__);                                  \
+            printf("\n");                                         \
+        }                                                         \
+    } while (0)
+
+static const char* format_name[] = { "raw", "zlib", "gzip" };
+static const size_t chunk_sizes[] = { 1, 2, 3, 7, 64, 512, 4096, 1 << 20 };
+#define CHUNK_SIZE_COUNT (sizeof(chunk_sizes) / sizeof(chunk_sizes[0]))
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+} blob_t;
+
+// Markup-like text: repeated tags for the matcher, random words for literals
+static blob_t make_page(size_t len, uint32_t seed) {
+    static const char* pieces[] = {
+        "<div class=\"item\">", "</div>\n", "<a href=\"/page?id=", "\">", "</a>",
+        "<p>", "</p>\n", " the ", " browser ", " tactile ", "\xC3\xA9t\xC3\xA9 ", "\xE6\x97\xA5\xE6\x9C\xAC ",
+    };
+    blob_t page = { malloc(len ? len : 1), len };
+    size_t pos = 0;
+    while (pos < len) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t pick = (seed >> 16) % 16;
+        if (pick < sizeof(pieces) / sizeof(pieces[0])) {
+            const char* piece = pieces[pick];
+            for (size_t i = 0; piece[i] && pos < len; i++) page.data[pos++] = (uint8_t)piece[i];
+        } else {
+            page.data[pos++] = (uint8_t)('a' + (seed >> 8) % 26);
+        }
+    }
+    return page;
+}
+
+static blob_t make_noise(size_t len, uint32_t seed) {
+    blob_t noise = { malloc(len ? len : 1), len };
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        noise.data[i] = (uint8_t)(seed >> 16);
+    }
+    return noise;
+}
+
+static int window_bits_for(inflate_format_t format, int bits) {
+    return format == INFLATE_FORMAT_RAW ? -bits : format == INFLATE_FORMAT_GZIP ? bits + 16 : bits;
+}
+
+static blob_t compress_with(const blob_t* input, inflate_format_t format, int level, int strategy, int bits) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    blob_t out = { NULL, 0 };
+    if (deflateInit2(&z, level, Z_DEFLATED, window_bits_for(format, bits), 8, strategy) != Z_OK) return out;
+    size_t capacity = deflateBound(&z, (uLong)input->len);
+    out.data = malloc(capacity);
+    z.next_in = input->data;
+    z.avail_in = (uInt)input->len;
+    z.next_out = out.data;
+    z.avail_out = (uInt)capacity;
+    if (deflate(&z, Z_FINISH) == Z_STREAM_END) out.len = z.total_out;
+    deflateEnd(&z);
+    return out;
+}
+
+// zlib's own reading of a stream, as the reference
+static blob_t zlib_inflate(const blob_t* input, inflate_format_t format, size_t expected) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    blob_t out = { malloc(expected + 1), 0 };
+    if (inflateInit2(&z, window_bits_for(format, 15)) != Z_OK) return out;
+    z.next_in = input->data;
+    z.avail_in = (uInt)input->len;
+    z.next_out = out.data;
+    z.avail_out = (uInt)expected + 1;
+    if (inflate(&z, Z_FINISH) == Z_STREAM_END) out.len = z.total_out;
+    inflateEnd(&z);
+    return out;
+}
+
+// Feed `input` in `chunk` sized pieces the way fetch_worker does: stop on
+// anything but INFLATE_NEED_INPUT
+static inflate_status_t run(const uint8_t* input, size_t len, inflate_format_t format, size_t chunk,
+                            inflate_buffer_t* out) {
+    static inflate_stream_t stream;
+    inflate_stream_init(&stream, format);
+    inflate_status_t status = INFLATE_NEED_INPUT;
+    for (size_t pos = 0; pos < len && status == INFLATE_NEED_INPUT; pos += chunk) {
+        size_t n = len - pos < chunk ? len - pos : chunk;
+        status = inflate_stream_feed(&stream, input + pos, n, inflate_buffer_sink, out);
+    }
+    return status;
+}
+
+static void test_round_trips(void) {
+    static const int levels[] = { 0, 1, 6, 9 };
+    static const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FIXED, Z_HUFFMAN_ONLY, Z_RLE, Z_FILTERED };
+    blob_t inputs[] = {
+        make_page(0, 1), make_page(1, 2), make_page(300, 3), make_page(6000, 4),
+        make_page(INFLATE_WINDOW_SIZE, 5), make_noise(5000, 6),
+    };
+    size_t input_count = sizeof(inputs) / sizeof(inputs[0]);
+    uint8_t* out = malloc(1 << 16);
+
+    for (size_t in = 0; in < input_count; in++) {
+        for (int format = INFLATE_FORMAT_RAW; format <= INFLATE_FORMAT_GZIP; format++) {
+            for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+                for (size_t s = 0; s < sizeof(strategies) / sizeof(strategies[0]); s++) {
+                    blob_t packed = compress_with(&inputs[in], format, levels[l], strategies[s], 15);
+                    blob_t reference = zlib_inflate(&packed, format, inputs[in].len);
+                    CHECK(reference.len == inputs[in].len && memcmp(reference.data, inputs[in].data, reference.len) == 0,
+                          "zlib reference disagrees");
+                    for (size_t c = 0; c < CHUNK_SIZE_COUNT; c++) {
+                        inflate_buffer_t buffer = { out, 1 << 16, 0 };
+                        inflate_status_t status = run(packed.data, packed.len, format, chunk_sizes[c], &buffer);
+                        CHECK(status == INFLATE_DONE && buffer.len == reference.len &&
+                              memcmp(buffer.data, reference.data, buffer.len) == 0,
+                              "%s input %zu level %d strategy %d chunk %zu: status %d, %zu of %zu bytes",
+                              format_name[format], in, levels[l], strategies[s], chunk_sizes[c], status,
+                              buffer.len, reference.len);
+                    }
+                    free(packed.data);
+                    free(reference.data);
+                }
+            }
+        }
+    }
+    for (size_t in = 0; in < input_count; in++) free(inputs[in].data);
+    free(out);
+}
+
+// Long pages wrap the history window many times; an 8 KB compressor window
+// keeps every distance inside ours
+static void test_long_stream(void) {
+    blob_t page = make_page(200000, 7);
+    uint8_t* out = malloc(page.len);
+    for (int format = INFLATE_FORMAT_RAW; format <= INFLATE_FORMAT_GZIP; format++) {
+        blob_t packed = compress_with(&page, format, 9, Z_DEFAULT_STRATEGY, 13);
+        for (size_t c = 0; c < CHUNK_SIZE_COUNT; c++) {
+            inflate_buffer_t buffer = { out, page.len, 0 };
+            inflate_status_t status = run(packed.data, packed.len, format, chunk_sizes[c], &buffer);
+            // Filling the buffer exactly stops the stream at the last byte
+            CHECK((status == INFLATE_DONE || status == INFLATE_STOPPED) && buffer.len == page.len &&
+                  memcmp(out, page.data, page.len) == 0,
+                  "%s chunk %zu: status %d, %zu bytes", format_name[format], chunk_sizes[c], status, buffer.len);
+        }
+        free(packed.data);
+    }
+    free(out);
+    free(page.data);
+}
+
+// "deflate" responses are sometimes bare DEFLATE without the zlib header
+static void test_deflate_without_header(void) {
+    blob_t page = make_page(3000, 8);
+    blob_t packed = compress_with(&page, INFLATE_FORMAT_RAW, 6, Z_DEFAULT_STRATEGY, 15);
+    uint8_t* out = malloc(page.len + 1);
+    for (size_t c = 0; c < CHUNK_SIZE_COUNT; c++) {
+        inflate_buffer_t buffer = { out, page.len + 1, 0 };
+        inflate_status_t status = run(packed.data, packed.len, INFLATE_FORMAT_ZLIB, chunk_sizes[c], &buffer);
+        CHECK(status == INFLATE_DONE && buffer.len == page.len && memcmp(out, page.data, page.len) == 0,
+              "chunk %zu: status %d, %zu bytes", chunk_sizes[c], status, buffer.len);
+    }
+    free(out);
+    free(packed.data);
+    free(page.data);
+}
+
+// A page bigger than html_buffer keeps exactly its first MAX_HTML_SIZE - 1
+// bytes and stops the stream, whatever the chunking
+static void test_clamp(void) {
+    blob_t page = make_page(40000, 9);
+    uint8_t* out = malloc(MAX_HTML_SIZE);
+    for (int format = INFLATE_FORMAT_RAW; format <= INFLATE_FORMAT_GZIP; format++) {
+        blob_t packed = compress_with(&page, format, 6, Z_DEFAULT_STRATEGY, 15);
+        for (size_t c = 0; c < CHUNK_SIZE_COUNT; c++) {
+            memset(out, 0xAA, MAX_HTML_SIZE);
+            inflate_buffer_t buffer = { out, MAX_HTML_SIZE - 1, 0 };
+            inflate_status_t status = run(packed.data, packed.len, format, chunk_sizes[c], &buffer);
+            CHECK(status == INFLATE_STOPPED && buffer.len == MAX_HTML_SIZE - 1 &&
+                  memcmp(out, page.data, buffer.len) == 0 && out[MAX_HTML_SIZE - 1] == 0xAA,
+                  "%s chunk %zu: status %d, %zu bytes", format_name[format], chunk_sizes[c], status, buffer.len);
+        }
+        free(packed.data);
+    }
+    free(out);
+    free(page.data);
+}
+
+// Cut inside the DEFLATE data: more input is wanted and what came out so
+// far is a prefix of the page
+static void test_truncated(void) {
+    static const size_t trailer[] = { 0, 4, 8 };
+    blob_t page = make_page(5000, 10);
+    uint8_t* out = malloc(page.len + 1);
+    for (int format = INFLATE_FORMAT_RAW; format <= INFLATE_FORMAT_GZIP; format++) {
+        blob_t packed = compress_with(&page, format, 6, Z_DEFAULT_STRATEGY, 15);
+        size_t deflate_end = packed.len - trailer[format];
+        size_t cuts[] = { 1, 5, packed.len / 4, packed.len / 2, deflate_end - 1 };
+        for (size_t k = 0; k < sizeof(cuts) / sizeof(cuts[0]); k++) {
+            for (size_t c = 0; c < CHUNK_SIZE_COUNT; c++) {
+                // Room to spare, so a full buffer cannot stop the stream first
+                inflate_buffer_t buffer = { out, page.len + 1, 0 };
+                inflate_status_t status = run(packed.data, cuts[k], format, chunk_sizes[c], &buffer);
+                CHECK(status == INFLATE_NEED_INPUT && buffer.len <= page.len && memcmp(out, page.data, buffer.len) == 0,
+                      "%s cut at %zu, chunk %zu: status %d, %zu bytes", format_name[format], cuts[k],
+                      chunk_sizes[c], status, buffer.len);
+            }
+        }
+        free(packed.data);
+    }
+    free(out);
+    free(page.data);
+}
+
+// LSB-first bit packing, as DEFLATE stores everything but Huffman codes
+typedef struct {
+    uint8_t data[64];
+    size_t bits;
+} bit_writer_t;
+
+static void put_bits(bit_writer_t* w, uint32_t value, unsigned n) {
+    for (unsigned i = 0; i < n; i++, w->bits++) {
+        if (value >> i & 1) w->data[w->bits / 8] |= (uint8_t)(1u << (w->bits % 8));
+    }
+}
+
+// Huffman codes go in most significant bit first
+static void put_code(bit_writer_t* w, uint32_t code, unsigned n) {
+    for (unsigned i = n; i-- > 0; w->bits++) {
+        if (code >> i & 1) w->data[w->bits / 8] |= (uint8_t)(1u << (w->bits % 8));
+    }
+}
+
+static inflate_status_t run_bits(const bit_writer_t* w, inflate_format_t format, size_t* out_len) {
+    uint8_t out[64];
+    inflate_buffer_t buffer = { out, sizeof(out), 0 };
+    inflate_status_t status = run(w->data, (w->bits + 7) / 8, format, 1, &buffer);
+    *out_len = buffer.len;
+    return status;
+}
+
+static void test_corrupt(void) {
+    size_t out_len;
+    bit_writer_t w;
+
+    // Reserved block type
+    memset(&w, 0, sizeof(w));
+    put_bits(&w, 1, 1);
+    put_bits(&w, 3, 2);
+    put_bits(&w, 0, 13);
+    CHECK(run_bits(&w, INFLATE_FORMAT_RAW, &out_len) == INFLATE_ERROR, "reserved block type");
+
+    // Stored block whose length and its complement disagree
+    memset(&w, 0, sizeof(w));
+    put_bits(&w, 1, 1);
+    put_bits(&w, 0, 2);
+    put_bits(&w, 0, 5);
+    put_bits(&w, 4, 16);
+    put_bits(&w, 0x1234, 16);
+    CHECK(run_bits(&w, INFLATE_FORMAT_RAW, &out_len) == INFLATE_ERROR, "stored length check");
+
+    // Fixed block opening with a match: distance 1 before any output
+    memset(&w, 0, sizeof(w));
+    put_bits(&w, 1, 1);
+    put_bits(&w, 1, 2);
+    put_code(&w, 1, 7); // Length 3
+    put_code(&w, 0, 5); // Distance 1
+    put_code(&w, 0, 7); // End of block
+    CHECK(run_bits(&w, INFLATE_FORMAT_RAW, &out_len) == INFLATE_ERROR && out_len == 0, "distance before start");
+
+    // Fixed block with "a", then a distance code past the 30 valid ones
+    memset(&w, 0, sizeof(w));
+    put_bits(&w, 1, 1);
+    put_bits(&w, 1, 2);
+    put_code(&w, 0x30 + 'a', 8);
+    put_code(&w, 1, 7);
+    put_code(&w, 30, 5);
+    put_bits(&w, 0, 16); // Enough bits to tell the code is not in the table
+    CHECK(run_bits(&w, INFLATE_FORMAT_RAW, &out_len) == INFLATE_ERROR && out_len == 1, "invalid distance code");
+
+    // gzip magic and compression method
+    static const uint8_t bad_magic[] = { 0x1F, 0x8C, 8, 0, 0, 0, 0, 0, 0, 3, 3, 0 };
+    static const uint8_t bad_method[] = { 0x1F, 0x8B, 7, 0, 0, 0, 0, 0, 0, 3, 3, 0 };
+    uint8_t out[16];
+    inflate_buffer_t buffer = { out, sizeof(out), 0 };
+    CHECK(run(bad_magic, sizeof(bad_magic), INFLATE_FORMAT_GZIP, 1, &buffer) == INFLATE_ERROR, "gzip magic");
+    CHECK(run(bad_method, sizeof(bad_method), INFLATE_FORMAT_GZIP, 1, &buffer) == INFLATE_ERROR, "gzip method");
+
+    // Flipped bits anywhere: no crash and nothing written past the buffer
+    blob_t page = make_page(4000, 11);
+    uint8_t* decoded = malloc(page.len + 16);
+    for (int format = INFLATE_FORMAT_RAW; format <= INFLATE_FORMAT_GZIP; format++) {
+        blob_t packed = compress_with(&page, format, 6, Z_DEFAULT_STRATEGY, 15);
+        uint32_t seed = 12;
+        for (int trial = 0; trial < 500; trial++) {
+            seed = seed * 1103515245u + 12345u;
+            size_t at = (seed >> 8) % packed.len;
+            uint8_t flip = (uint8_t)(1u << (seed >> 4) % 8);
+            packed.data[at] ^= flip;
+            memset(decoded + page.len, 0x55, 16);
+            inflate_buffer_t damaged = { decoded, page.len, 0 };
+            inflate_status_t status = run(packed.data, packed.len, format, 1 + trial % 64, &damaged);
+            CHECK(damaged.len <= page.len && decoded[page.len] == 0x55,
+                  "%s flip at %zu: status %d, %zu bytes", format_name[format], at, status, damaged.len);
+            packed.data[at] ^= flip;
+        }
+        free(packed.data);
+    }
+    free(decoded);
+    free(page.data);
+}
+
+static void test_encodings(void) {
+    inflate_format_t format;
+    CHECK(inflate_format_for_encoding("gzip", &format) && format == INFLATE_FORMAT_GZIP, "gzip");
+    CHECK(inflate_format_for_encoding("X-GZIP", &format) && format == INFLATE_FORMAT_GZIP, "x-gzip");
+    CHECK(inflate_format_for_encoding("deflate", &format) && format == INFLATE_FORMAT_ZLIB, "deflate");
+    CHECK(!inflate_format_for_encoding("br", &format), "br");
+    CHECK(!inflate_format_for_encoding("identity", &format), "identity");
+    CHECK(!inflate_format_for_encoding(NULL, &format), "missing header");
+}
+
+int main(void) {
+    test_round_trips();
+    test_long_stream();
+    test_deflate_without_header();
+    test_clamp();
+    test_truncated();
+    test_corrupt();
+    test_encodings();
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("inflate_stream: ok\n");
+    return 0;
+}
@@ -0,0 +1,219 @@
+// text_chunker: splits between words, cuts over-long words between UTF-8
+// characters, and yields nothing for empty or whitespace-only text. Fixed
+// cases check exact pieces; generated text checks the invariants every
+// split must keep.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "text_chunk.h"
+
+static int failures;
+
+#define CHECK(cond, ...)                                          \
+    do {                                                          \
+        if (!(cond)) {                                            \
+            failures++;                                           \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);     \
+            printf(__VA_ARGS__);                                  \
+            printf("\n");                                         \
+        }                                                         \
+    } while (0)
+
+#define MAX_JOINED 1024
+
+typedef struct {
+    const char* text;
+    size_t window;
+    const char* expected; // Pieces joined with '|'
+} case_t;
+
+static const case_t cases[] = {
+    // Word boundaries
+    { "hello world", 11, "hello world" },
+    { "hello world", 5, "hello|world" },
+    { "hello world", 8, "hello|world" },
+    { "hello world", 6, "hello|world" },
+    { "the quick brown fox", 10, "the quick|brown fox" },
+    { "a b c d e", 3, "a b|c d|e" },
+    { "one\ttwo\nthree", 8, "one\ttwo|three" },
+    { "  leading and trailing  ", 12, "leading and|trailing" },
+
+    // A word longer than the window is cut, its neighbours are not
+    { "abcdefghij", 4, "abcd|efgh|ij" },
+    { "ab abcdefgh cd", 4, "ab|abcd|efgh|cd" },
+    { "xxxxxxxxxx", 1, "x|x|x|x|x|x|x|x|x|x" },
+    { "abc", 0, "a|b|c" }, // A zero window is taken as one byte
+
+    // Multi-byte UTF-8 at the cut point: é is 2 bytes, 日本語 3 each
+    { "\xC3\xA9\xC3\xA9\xC3\xA9", 5, "\xC3\xA9\xC3\xA9|\xC3\xA9" },
+    { "\xC3\xA9\xC3\xA9\xC3\xA9", 3, "\xC3\xA9|\xC3\xA9|\xC3\xA9" },
+    { "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E", 4, "\xE6\x97\xA5|\xE6\x9C\xAC|\xE8\xAA\x9E" },
+    { "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E", 7, "\xE6\x97\xA5\xE6\x9C\xAC|\xE8\xAA\x9E" },
+    { "\xF0\x9F\x98\x80\xF0\x9F\x98\x80", 6, "\xF0\x9F\x98\x80|\xF0\x9F\x98\x80" },
+    { "word \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E", 8,
+      "word|\xE6\x97\xA5\xE6\x9C\xAC|\xE8\xAA\x9E\xE6\x97\xA5|\xE6\x9C\xAC\xE8\xAA\x9E" },
+    { "caf\xC3\xA9 au lait", 4, "caf|\xC3\xA9|au|lait" },
+
+    // Nothing to show
+    { "", 8, "" },
+    { " ", 8, "" },
+    { " \t\n\r\f\v ", 3, "" },
+};
+
+// All pieces of `text` joined with '|'; false if they do not fit
+static bool join_pieces(const char* text, size_t len, size_t window, char* out, size_t out_size) {
+    text_chunker_t chunker;
+    text_chunker_init(&chunker, text, len, window);
+    const char* piece;
+    size_t piece_len, used = 0;
+    bool first = true;
+    while (text_chunker_next(&chunker, &piece, &piece_len)) {
+        if (used + piece_len + 2 > out_size) return false;
+        if (!first) out[used++] = '|';
+        memcpy(out + used, piece, piece_len);
+        used += piece_len;
+        first = false;
+    }
+    out[used] = 0;
+    return true;
+}
+
+static void test_cases(void) {
+    char joined[MAX_JOINED];
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const case_t* c = &cases[i];
+        bool fits = join_pieces(c->text, strlen(c->text), c->window, joined, sizeof(joined));
+        CHECK(fits && strcmp(joined, c->expected) == 0, "\"%s\" window %lu: got \"%s\", expected \"%s\"", c->text,
+              (unsigned long)c->window, fits ? joined : "(too long)", c->expected);
+    }
+}
+
+static void test_null_text(void) {
+    text_chunker_t chunker;
+    const char* piece;
+    size_t piece_len;
+    text_chunker_init(&chunker, NULL, 16, 8);
+    CHECK(!text_chunker_next(&chunker, &piece, &piece_len), "NULL text yields a piece");
+}
+
+// Only the first `len` bytes are read, even without a terminator there
+static void test_length_bound(void) {
+    char joined[MAX_JOINED];
+    CHECK(join_pieces("hello world", 5, 8, joined, sizeof(joined)) && strcmp(joined, "hello") == 0,
+          "got \"%s\"", joined);
+}
+
+// Once finished the chunker stays finished
+static void test_exhausted(void) {
+    text_chunker_t chunker;
+    const char* piece;
+    size_t piece_len;
+    text_chunker_init(&chunker, "one two", 7, 3);
+    int pieces = 0;
+    while (text_chunker_next(&chunker, &piece, &piece_len)) pieces++;
+    CHECK(pieces == 2, "%d pieces", pieces);
+    CHECK(!text_chunker_next(&chunker, &piece, &piece_len), "piece after the end");
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool is_continuation(char c) {
+    return ((unsigned char)c & 0xC0) == 0x80;
+}
+
+static uint32_t next_random(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Words of ASCII and 2-, 3- and 4-byte characters with runs of whitespace
+static size_t make_text(char* out, size_t size, uint32_t* state) {
+    static const char* chars[] = { "a", "b", "z", "\xC3\xA9", "\xE6\x97\xA5", "\xF0\x9F\x98\x80" };
+    static const char* spaces[] = { " ", "  ", "\t", "\n", " \n " };
+    size_t len = 0;
+    size_t target = next_random(state) % (size - 8);
+    while (len < target) {
+        size_t word = 1 + next_random(state) % 24;
+        for (size_t k = 0; k < word && len + 4 < size; k++) {
+            const char* ch = chars[next_random(state) % 6];
+            size_t n = strlen(ch);
+            memcpy(out + len, ch, n);
+            len += n;
+        }
+        const char* space = spaces[next_random(state) % 5];
+        size_t n = strlen(space);
+        if (len + n >= size) break;
+        memcpy(out + len, space, n);
+        len += n;
+    }
+    return len;
+}
+
+// Every piece is a trimmed, in-order view of at most `window` bytes; the
+// pieces hold every non-space byte; only words longer than the window are
+// cut, and with room for any character they are cut between characters
+static void check_invariants(const char* text, size_t len, size_t window) {
+    text_chunker_t chunker;
+    text_chunker_init(&chunker, text, len, window);
+    const char* piece;
+    size_t piece_len, covered = 0, visible = 0;
+    while (text_chunker_next(&chunker, &piece, &piece_len)) {
+        size_t start = (size_t)(piece - text);
+        if (piece_len == 0 || piece_len > window || start < covered || start + piece_len > len) {
+            CHECK(false, "window %lu: piece at %lu of %lu bytes after %lu", (unsigned long)window,
+                  (unsigned long)start, (unsigned long)piece_len, (unsigned long)covered);
+            return;
+        }
+        for (size_t i = covered; i < start; i++) CHECK(is_space(text[i]), "byte %lu skipped", (unsigned long)i);
+        CHECK(!is_space(piece[0]) && !is_space(piece[piece_len - 1]), "untrimmed piece at %lu", (unsigned long)start);
+        size_t end = start + piece_len;
+        if (end < len && !is_space(text[end])) {
+            // Cut inside a word: only one word, filling the window give or
+            // take a partial character
+            bool one_word = true;
+            for (size_t i = 0; i < piece_len; i++) one_word = one_word && !is_space(piece[i]);
+            CHECK(one_word && piece_len + 3 >= window, "word cut short at %lu (%lu bytes, window %lu)",
+                  (unsigned long)start, (unsigned long)piece_len, (unsigned long)window);
+        }
+        if (window >= 4) {
+            CHECK(!is_continuation(piece[0]) && (end == len || !is_continuation(text[end])),
+                  "character split at %lu..%lu", (unsigned long)start, (unsigned long)end);
+        }
+        for (size_t i = 0; i < piece_len; i++) visible += !is_space(piece[i]);
+        covered = end;
+    }
+    for (size_t i = covered; i < len; i++) CHECK(is_space(text[i]), "byte %lu dropped at the end", (unsigned long)i);
+    size_t expected = 0;
+    for (size_t i = 0; i < len; i++) expected += !is_space(text[i]);
+    CHECK(visible == expected, "window %lu: %lu of %lu visible bytes", (unsigned long)window, (unsigned long)visible,
+          (unsigned long)expected);
+}
+
+static void test_generated(void) {
+    static const size_t windows[] = { 1, 2, 3, 4, 5, 7, 8, 16, 31, 64, 511 };
+    char text[2048];
+    uint32_t state = 12345;
+    for (int round = 0; round < 300; round++) {
+        size_t len = make_text(text, sizeof(text), &state);
+        for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) check_invariants(text, len, windows[w]);
+    }
+}
+
+int main(void) {
+    test_cases();
+    test_null_text();
+    test_length_bound();
+    test_exhausted();
+    test_generated();
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("text_chunk: ok\n");
+    return 0;
+}